@@ -2192,7 +2192,7 @@ int CBaumerOptronic::StartSequenceAcquisition(long numImages, double interval_ms
    pWorkerThread_->CurrentImageSize(xDim, yDim, bitsInOneColor, nColors, bufSize);
 
    // make sure the circular buffer is properly sized
-   GetCoreCallback()->InitializeImageBuffer(1, 1, xDim, yDim, BytesInOneComponent(bitsInOneColor) * nColors);
+   GetCoreCallback()->InitializeImageBuffer(this, 1, 1, xDim, yDim, BytesInOneComponent(bitsInOneColor) * nColors);
 
    pWorkerThread_->Command(::StartSequence);
 
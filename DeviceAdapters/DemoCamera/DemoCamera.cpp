@@ -3592,9 +3592,12 @@ CXYStageBase<CDemoXYStage>(),
 stepSize_um_(0.015),
 posX_um_(0.0),
 posY_um_(0.0),
+startX_um_(0.0),
+startY_um_(0.0),
+moveDurationMs_(0.0),
 busy_(false),
 timeOutTimer_(0),
-velocity_(10.0), // in micron per second
+velocity_(10.0),
 initialized_(false),
 lowerLimit_(0.0),
 upperLimit_(20000.0)
@@ -3643,6 +3646,13 @@ int CDemoXYStage::Initialize()
    if (DEVICE_OK != ret)
       return ret;
 
+   // Speed (mm/s)
+   CPropertyAction* pAct = new CPropertyAction (this, &CDemoXYStage::OnSpeed);
+   ret = CreateFloatProperty(MM::g_Keyword_Speed, velocity_, false, pAct);
+   if (DEVICE_OK != ret)
+      return ret;
+   SetPropertyLimits(MM::g_Keyword_Speed, 0.001, 100.0);
+
    ret = UpdateStatus();
    if (ret != DEVICE_OK)
       return ret;
@@ -3675,19 +3685,24 @@ bool CDemoXYStage::Busy()
 
 int CDemoXYStage::SetPositionSteps(long x, long y)
 {
+   // A move commanded during another one starts from where the stage is now
+   MM::MMTime now = GetCurrentMMTime();
+   double curX, curY;
+   GetCurrentPositionUm(now, curX, curY);
    if (timeOutTimer_ != 0)
-   {
-      if (!timeOutTimer_->expired(GetCurrentMMTime()))
-         return ERR_STAGE_MOVING;
       delete (timeOutTimer_);
-   }
+
    double newPosX = x * stepSize_um_;
    double newPosY = y * stepSize_um_;
-   double difX = newPosX - posX_um_;
-   double difY = newPosY - posY_um_;
+   double difX = newPosX - curX;
+   double difY = newPosY - curY;
    double distance = sqrt( (difX * difX) + (difY * difY) );
    long timeOut = (long) (distance / velocity_);
-   timeOutTimer_ = new MM::TimeoutMs(GetCurrentMMTime(),  timeOut);
+   moveStart_ = now;
+   moveDurationMs_ = distance / velocity_;
+   timeOutTimer_ = new MM::TimeoutMs(moveStart_,  timeOut);
+   startX_um_ = curX;
+   startY_um_ = curY;
    posX_um_ = x * stepSize_um_;
    posY_um_ = y * stepSize_um_;
    int ret = OnXYStagePositionChanged(posX_um_, posY_um_);
@@ -3699,11 +3714,48 @@ int CDemoXYStage::SetPositionSteps(long x, long y)
 
 int CDemoXYStage::GetPositionSteps(long& x, long& y)
 {
-   x = (long)(posX_um_ / stepSize_um_);
-   y = (long)(posY_um_ / stepSize_um_);
+   double xUm, yUm;
+   GetCurrentPositionUm(xUm, yUm);
+   x = (long)(xUm / stepSize_um_);
+   y = (long)(yUm / stepSize_um_);
+   return DEVICE_OK;
+}
+
+int CDemoXYStage::Stop()
+{
+   if (timeOutTimer_ != 0)
+   {
+      GetCurrentPositionUm(posX_um_, posY_um_);
+      delete (timeOutTimer_);
+      timeOutTimer_ = 0;
+      return OnXYStagePositionChanged(posX_um_, posY_um_);
+   }
    return DEVICE_OK;
 }
 
+/**
+ * The simulated stage moves in a straight line at constant speed, so during
+ * a move the position is interpolated between the start and the target.
+ */
+void CDemoXYStage::GetCurrentPositionUm(double& x, double& y)
+{
+   GetCurrentPositionUm(GetCurrentMMTime(), x, y);
+}
+
+void CDemoXYStage::GetCurrentPositionUm(MM::MMTime now, double& x, double& y)
+{
+   x = posX_um_;
+   y = posY_um_;
+   if (timeOutTimer_ == 0 || moveDurationMs_ <= 0.0)
+      return;
+   double elapsedMs = (now - moveStart_).getMsec();
+   if (elapsedMs >= moveDurationMs_)
+      return;
+   double fraction = elapsedMs / moveDurationMs_;
+   x = startX_um_ + fraction * (posX_um_ - startX_um_);
+   y = startY_um_ + fraction * (posY_um_ - startY_um_);
+}
+
 int CDemoXYStage::SetRelativePositionSteps(long x, long y)
 {
    long xSteps, ySteps;
@@ -3716,7 +3768,26 @@ int CDemoXYStage::SetRelativePositionSteps(long x, long y)
 ///////////////////////////////////////////////////////////////////////////////
 // Action handlers
 ///////////////////////////////////////////////////////////////////////////////
-// none implemented
+
+int CDemoXYStage::OnSpeed(MM::PropertyBase* pProp, MM::ActionType eAct)
+{
+   if (eAct == MM::BeforeGet)
+   {
+      pProp->Set(velocity_);
+   }
+   else if (eAct == MM::AfterSet)
+   {
+      double speed;
+      pProp->Get(speed);
+      if (speed <= 0.0)
+      {
+         pProp->Set(velocity_); // revert
+         return DEVICE_INVALID_PROPERTY_VALUE;
+      }
+      velocity_ = speed; // mm/s is the same as micron/ms
+   }
+   return DEVICE_OK;
+}
 
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -553,7 +553,7 @@ public:
    virtual int GetPositionSteps(long& x, long& y);
    virtual int SetRelativePositionSteps(long x, long y);
    virtual int Home() { return DEVICE_OK; }
-   virtual int Stop() { return DEVICE_OK; }
+   virtual int Stop();
 
    /* This sets the 0,0 position of the adapter to the current position.  
     * If possible, the stage controller itself should also be set to 0,0
@@ -582,14 +582,22 @@ public:
    // action interface
    // ----------------
    int OnPosition(MM::PropertyBase* pProp, MM::ActionType eAct);
+   int OnSpeed(MM::PropertyBase* pProp, MM::ActionType eAct);
 
 private:
+   void GetCurrentPositionUm(double& x, double& y);
+   void GetCurrentPositionUm(MM::MMTime now, double& x, double& y);
+
    double stepSize_um_;
    double posX_um_;
    double posY_um_;
+   double startX_um_; // Of the current move
+   double startY_um_;
+   MM::MMTime moveStart_;
+   double moveDurationMs_;
    bool busy_;
    MM::TimeoutMs* timeOutTimer_;
-   double velocity_;
+   double velocity_; // in micron per millisecond (= mm per second)
    bool initialized_;
    double lowerLimit_;
    double upperLimit_;
@@ -28,9 +28,10 @@
 #include "DeviceBase.h"
 
 #ifdef __linux__
-// This include has been added for compile on Ubuntu 18.04 and newer.
-// The include refers to libopencv version 3.2
-#include <opencv/cv.hpp>
+// OpenCV 3.x or 4.x, which no longer has the opencv/ headers
+#include <opencv2/core.hpp>
+#include <opencv2/imgcodecs.hpp>
+#include <opencv2/imgproc.hpp>
 #else
 #include "opencv/highgui.h"
 #endif
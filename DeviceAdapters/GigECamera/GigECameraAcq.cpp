@@ -222,7 +222,7 @@ int CGigECamera::StartSequenceAcquisition( long numImages, double interval_ms, b
 		return ret;
 
 	// make sure the circular buffer is properly sized
-	GetCoreCallback()->InitializeImageBuffer(1, 1, GetImageWidth(), GetImageHeight(), GetImageBytesPerPixel());
+	GetCoreCallback()->InitializeImageBuffer(this, 1, 1, GetImageWidth(), GetImageHeight(), GetImageBytesPerPixel());
 
 
 	stopContinuousAcquisition = false;
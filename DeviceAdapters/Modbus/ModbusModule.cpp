@@ -16,6 +16,7 @@
 
 #include <string>
 #include <iostream>
+#include <cstdlib>
 #include "ModuleInterface.h"
 
 using namespace std;
@@ -26,6 +27,9 @@ using namespace std;
 
 const char* g_ModbusDeviceName = "Modbus";
 
+// Poll cycles in which a coalesced write is tried before it is given up
+const int g_MaxWriteAttempts = 3;
+
 MODULE_API void InitializeModuleData()
 {
 	RegisterDevice(g_ModbusDeviceName, MM::GenericDevice, g_ModbusDeviceName);
@@ -56,19 +60,62 @@ void CModbusDevice::GetName(char* pszName) const {
 }
 
 bool CModbusDevice::Busy() {
+	// Writes are only busy while waiting for the next poll cycle to send them
+	MMThreadGuard g(busLock);
+	for(vector<ModbusDevice>::iterator i = deviceConfiguration.begin(); i != deviceConfiguration.end(); i++) {
+		if(i->writePending)
+			return true;
+	}
 	return false;
 }
 
 //
 
+ModbusPollThread::ModbusPollThread(CModbusDevice *device) : device(device), intervalMs(0), stop(true) {
+}
+
+void ModbusPollThread::Start(long interval) {
+	MMThreadGuard g(stopLock);
+	intervalMs = interval;
+	stop = false;
+	activate();
+}
+
+void ModbusPollThread::Stop() {
+	MMThreadGuard g(stopLock);
+	stop = true;
+}
+
+bool ModbusPollThread::IsStopped() {
+	MMThreadGuard g(stopLock);
+	return stop;
+}
+
+int ModbusPollThread::svc() {
+	while(!IsStopped()) {
+		// Errors are logged by the device; keep polling so that a transient
+		// communication failure does not stop the updates for good
+		device->PollCycle();
+
+		// Sleep in short slices so that Stop() takes effect promptly
+		for(long slept = 0; slept < intervalMs && !IsStopped(); slept += 10) {
+			CDeviceUtils::SleepMs(min(10L, intervalMs - slept));
+		}
+	}
+	return 0;
+}
+
+//
+
 CModbusDevice::CModbusDevice() {
 
 	
-	coilBuffer = NULL;
-	registerBuffer = NULL;
+	ctx = NULL;
+	pollThread = NULL;
 
 	ready = false;
 	debugFlag = 0;
+	pollIntervalMs = 0;
 
 	connectionURI = "tcp://127.0.0.1:502";
 
@@ -79,11 +126,18 @@ CModbusDevice::CModbusDevice() {
 	CreateProperty("DebugFlag", "0", MM::Integer, false, new DeviceAction(this, &CModbusDevice::OnDebugFlag), true);
 	AddAllowedValue("DebugFlag", "0");
 	AddAllowedValue("DebugFlag", "1");
+	// 0 reads from the bus on every property access; otherwise a background
+	// thread refreshes all devices at this interval using block reads, and
+	// property writes are coalesced and sent once per cycle.
+	CreateProperty("PollIntervalMs", "0", MM::Integer, false, new DeviceAction(this, &CModbusDevice::OnPollInterval), true);
+	SetPropertyLimits("PollIntervalMs", 0, 60000);
+
+	SetErrorText(ERR_MODBUS_WRITE_FAILED, "A value set on this Modbus device could not be written");
 
 }
 
 CModbusDevice::~CModbusDevice() {
-	// nop
+	Shutdown();
 }
 
 
@@ -126,6 +180,19 @@ int CModbusDevice::OnDebugFlag(MM::PropertyBase *pProp, MM::ActionType eAct) {
 	return DEVICE_OK;
 }
 
+int CModbusDevice::OnPollInterval(MM::PropertyBase *pProp, MM::ActionType eAct) {
+	if(eAct == MM::BeforeGet)
+	{
+		pProp->Set(pollIntervalMs);
+	}
+	else if(eAct == MM::AfterSet)
+	{
+		pProp->Get(pollIntervalMs);
+	}
+
+	return DEVICE_OK;
+}
+
 inline int CModbusDevice::checkContextAndContinue() {
 	if(ctx == NULL)
 		return DEVICE_ERR;
@@ -135,6 +202,7 @@ inline int CModbusDevice::checkContextAndContinue() {
 	if(modbus_connect(ctx) == -1) {
 		LogMessage(string("libmodbus returned the following error: ") + modbus_strerror(errno)); // WHY is errno a global variable? ...
 		modbus_free(ctx);
+		ctx = NULL;
 		return DEVICE_ERR;
 	}
 
@@ -220,8 +288,7 @@ int CModbusDevice::Initialize() {
 				if(kv.second == "coils") {
 					d.type = MD_COILS;
 				} else if(kv.second == "registers") { 
-					LogMessage("Not yet implemented.");
-					return DEVICE_ERR;
+					d.type = MD_REGISTER;
 				} else {
 					LogMessage("Unsupported type passed.");
 				}
@@ -257,7 +324,7 @@ int CModbusDevice::Initialize() {
 
 	int currentNumber = 0;
 
-	largestCount = 0;
+	int largestCount = 0;
 
 	for(vector<ModbusDevice>::iterator i = deviceConfiguration.begin(); i != deviceConfiguration.end(); i++) {
 		largestCount = largestCount > i->count ? largestCount : i->count;
@@ -276,79 +343,335 @@ int CModbusDevice::Initialize() {
 		currentNumber ++;
 	}
 
-	coilBuffer = new unsigned char[largestCount];
-	registerBuffer = new unsigned short[largestCount];
+	buildReadBlocks();
+
+	for(vector<ModbusReadBlock>::iterator b = readBlocks.begin(); b != readBlocks.end(); b++) {
+		largestCount = largestCount > b->count ? largestCount : b->count;
+	}
+
+	coilBuffer.assign(largestCount, 0);
+	registerBuffer.assign(largestCount, 0);
+
+	CreateProperty("general-read-blocks", CDeviceUtils::ConvertToString((int)readBlocks.size()), MM::Integer, true, NULL, false);
+
+	if(pollIntervalMs > 0) {
+		LogMessage(string("Polling ") + CDeviceUtils::ConvertToString((int)deviceConfiguration.size()) + " devices in " + CDeviceUtils::ConvertToString((int)readBlocks.size()) + " block reads every " + CDeviceUtils::ConvertToString(pollIntervalMs) + " ms");
+		PollCycle(); // Fill the caches before the first property access
+		pollThread = new ModbusPollThread(this);
+		pollThread->Start(pollIntervalMs);
+	}
+
+	ready = true;
 
 	return DEVICE_OK;
 }
 
+// Group the read ranges of all devices of the same type into as few
+// contiguous blocks as the protocol limits allow. Overlapping and adjacent
+// ranges are merged; gaps are not bridged, since reading unmapped addresses
+// may fail on some servers.
+void CModbusDevice::buildReadBlocks() {
+	readBlocks.clear();
+	deviceBlock.assign(deviceConfiguration.size(), -1);
+
+	vector<int> order;
+	for(int i = 0; i < (int)deviceConfiguration.size(); i++) {
+		if(deviceConfiguration[i].count > 0)
+			order.push_back(i);
+	}
+
+	struct ByTypeAndAddress {
+		const vector<ModbusDevice> &devices;
+		ByTypeAndAddress(const vector<ModbusDevice> &devices) : devices(devices) {}
+		bool operator()(int a, int b) const {
+			if(devices[a].type != devices[b].type)
+				return devices[a].type < devices[b].type;
+			return devices[a].read_address < devices[b].read_address;
+		}
+	};
+	sort(order.begin(), order.end(), ByTypeAndAddress(deviceConfiguration));
+
+	for(vector<int>::iterator i = order.begin(); i != order.end(); i++) {
+		ModbusDevice &d = deviceConfiguration[*i];
+		int maxCount = d.type == MD_COILS ? MODBUS_MAX_READ_BITS : MODBUS_MAX_READ_REGISTERS;
+
+		if(!readBlocks.empty()) {
+			ModbusReadBlock &last = readBlocks.back();
+			int end = max(last.address + last.count, d.read_address + d.count);
+			if(last.type == d.type && d.read_address <= last.address + last.count && end - last.address <= maxCount) {
+				last.count = end - last.address;
+				last.members.push_back(*i);
+				deviceBlock[*i] = (int)readBlocks.size() - 1;
+				continue;
+			}
+		}
 
+		ModbusReadBlock block;
+		block.type = d.type;
+		block.address = d.read_address;
+		block.count = d.count;
+		block.members.push_back(*i);
+		readBlocks.push_back(block);
+		deviceBlock[*i] = (int)readBlocks.size() - 1;
+	}
+}
 
-int CModbusDevice::OnDeviceValue(MM::PropertyBase *pProp, MM::ActionType eAct, long data) {
-	string helper;
+// Must be called with busLock held. Refreshes the cached value of every member
+// device and appends the indices of those whose value changed to changed.
+int CModbusDevice::readBlock(ModbusReadBlock &block, vector<int> &changed) {
+	int result;
+	if(block.type == MD_COILS) {
+		result = modbus_read_bits(ctx, block.address, block.count, &coilBuffer[0]);
+	} else {
+		result = modbus_read_registers(ctx, block.address, block.count, &registerBuffer[0]);
+	}
+
+	if(result == -1) {
+		LogMessage(string("libmodbus returned the following error: ") + modbus_strerror(errno));
+		for(vector<int>::iterator m = block.members.begin(); m != block.members.end(); m++) {
+			deviceConfiguration[*m].cacheValid = false;
+		}
+		return DEVICE_ERR;
+	}
+
+	for(vector<int>::iterator m = block.members.begin(); m != block.members.end(); m++) {
+		ModbusDevice &d = deviceConfiguration[*m];
+		int offset = d.read_address - block.address;
+
+		string helper;
+		for(int i = 0; i < d.count; i++) {
+			if(block.type == MD_COILS) {
+				helper += coilBuffer[offset + i] ? "1" : "0";
+			} else {
+				if(i > 0)
+					helper += ",";
+				helper += CDeviceUtils::ConvertToString((long)registerBuffer[offset + i]);
+			}
+		}
+
+		if(!d.cacheValid || d.valueCache != helper) {
+			if(d.cacheValid)
+				changed.push_back(*m);
+			d.valueCache = helper;
+			d.cacheValid = true;
+		}
+	}
+
+	return DEVICE_OK;
+}
+
+// Must be called with busLock held. value must have been produced by
+// parseValue().
+int CModbusDevice::writeDevice(ModbusDevice &d, const string &value) {
+	int result;
+	if(d.type == MD_COILS) {
+		for(int i = 0; i < d.count; i++) coilBuffer[i] = (value[i] == '1') ? 1 : 0;
+		result = modbus_write_bits(ctx, d.write_address, d.count, &coilBuffer[0]);
+	} else {
+		istringstream is(value);
+		string item;
+		for(int i = 0; i < d.count && getline(is, item, ','); i++) {
+			registerBuffer[i] = (unsigned short)atol(item.c_str());
+		}
+		result = modbus_write_registers(ctx, d.write_address, d.count, &registerBuffer[0]);
+	}
+
+	if(result == -1) {
+		LogMessage(string("libmodbus returned the following error: ") + modbus_strerror(errno));
+		d.cacheValid = false;
+		return DEVICE_ERR;
+	}
+
+	// Keep the cache in line with what we wrote; the next read will confirm
+	// it (and report a change if the device did not accept the value).
+	if(d.read_address == d.write_address) {
+		d.valueCache = value;
+		d.cacheValid = true;
+	}
+	return DEVICE_OK;
+}
 
-	ModbusDevice d = deviceConfiguration[data];
+// Convert a user supplied value into the canonical form used in the cache:
+// a string of 0 and 1 for coils, comma-separated decimals for registers.
+int CModbusDevice::parseValue(const ModbusDevice &d, const string &input, string &value) {
+	value = "";
 
 	if(d.type == MD_COILS) {
-		memset(coilBuffer, 0, sizeof(unsigned char) * (largestCount));
+		if(input == "off") {
+			value.assign(d.count, '0');
+		} else if(input == "on") {
+			value.assign(d.count, '1');
+		} else {
+			if(input.size() != (unsigned) d.count)
+				return DEVICE_INVALID_PROPERTY_VALUE;
+			for(int i = 0; i < d.count; i++) {
+				if(input[i] != '0' && input[i] != '1')
+					return DEVICE_INVALID_PROPERTY_VALUE;
+			}
+			value = input;
+		}
+		return DEVICE_OK;
+	}
+
+	istringstream is(input);
+	string item;
+	int n = 0;
+	while(getline(is, item, ',')) {
+		char *end = NULL;
+		long v = strtol(item.c_str(), &end, 10);
+		if(item.empty() || *end != '\0' || v < 0 || v > 65535)
+			return DEVICE_INVALID_PROPERTY_VALUE;
+		if(n > 0)
+			value += ",";
+		value += CDeviceUtils::ConvertToString(v);
+		n++;
+	}
+	if(n != d.count)
+		return DEVICE_INVALID_PROPERTY_VALUE;
+	return DEVICE_OK;
+}
+
+// Must be called with busLock held. Only the last value set for each device
+// since the previous cycle is sent. A write that fails stays pending and is
+// retried in the next cycle; after g_MaxWriteAttempts failures it is dropped
+// and the error is returned by the next access to the device's property.
+int CModbusDevice::flushPendingWrites() {
+	int ret = DEVICE_OK;
+	for(vector<ModbusDevice>::iterator i = deviceConfiguration.begin(); i != deviceConfiguration.end(); i++) {
+		if(!i->writePending)
+			continue;
+		if(writeDevice(*i, i->pendingValue) == DEVICE_OK) {
+			i->writePending = false;
+			i->writeAttempts = 0;
+			continue;
+		}
+		ret = DEVICE_ERR;
+		if(++i->writeAttempts < g_MaxWriteAttempts)
+			continue;
+		LogMessage("Giving up writing " + i->pendingValue + " to " + i->name + " after " + CDeviceUtils::ConvertToString(i->writeAttempts) + " attempts");
+		i->writePending = false;
+		i->writeAttempts = 0;
+		i->writeFailed = true;
+	}
+	return ret;
+}
+
+void CModbusDevice::notifyChanged(const vector<int> &changed) {
+	for(vector<int>::const_iterator i = changed.begin(); i != changed.end(); i++) {
+		string name, value;
+		{
+			MMThreadGuard g(busLock);
+			name = deviceConfiguration[*i].name;
+			value = deviceConfiguration[*i].valueCache;
+		}
+		OnPropertyChanged(name.c_str(), value.c_str());
+	}
+}
+
+int CModbusDevice::PollCycle() {
+	int ret = DEVICE_OK;
+	vector<int> changed;
+	{
+		MMThreadGuard g(busLock);
+		if(flushPendingWrites() != DEVICE_OK)
+			ret = DEVICE_ERR;
+		for(vector<ModbusReadBlock>::iterator b = readBlocks.begin(); b != readBlocks.end(); b++) {
+			if(readBlock(*b, changed) != DEVICE_OK)
+				ret = DEVICE_ERR;
+		}
+	}
+	// Notify without holding the lock, since the Core may call back into us
+	notifyChanged(changed);
+	return ret;
+}
+
+
+
+int CModbusDevice::OnDeviceValue(MM::PropertyBase *pProp, MM::ActionType eAct, long data) {
+	string helper;
+	vector<int> changed;
+
+	{
+		MMThreadGuard g(busLock);
+		ModbusDevice &d = deviceConfiguration[data];
+		bool polling = pollThread != NULL;
+
+		if(d.writeFailed) {
+			// The value last set was never written; the cache has been
+			// invalidated, so the next access reads the device again
+			d.writeFailed = false;
+			return ERR_MODBUS_WRITE_FAILED;
+		}
 
 		if(eAct == MM::BeforeGet)
 		{
-			int result;
-			result = modbus_read_bits(ctx, d.read_address, d.count, coilBuffer);
-			for(int i = 0; i < d.count; i++) {
-				if(coilBuffer[i]) {
-					helper += "1";
-				} else {
-					helper += "0";
+			if(d.writePending) {
+				helper = d.pendingValue;
+			} else {
+				// Without polling, always go to the bus; the block read also
+				// refreshes the neighbouring devices
+				if(!polling || !d.cacheValid) {
+					if(deviceBlock[data] < 0 || readBlock(readBlocks[deviceBlock[data]], changed) != DEVICE_OK)
+						return DEVICE_ERR;
 				}
+				helper = d.valueCache;
 			}
 			//
 			pProp->Set(helper.c_str());
 		}
 		else if(eAct == MM::AfterSet)
 		{
+			string value;
 			pProp->Get(helper);
 
-			if(helper == "off") {
-				for(int i = 0; i < d.count; i++) coilBuffer[i] = 0;
-			} else if(helper == "on") {
-				for(int i = 0; i < d.count; i++) coilBuffer[i] = 1;
-			} else {
-				if(helper.size() != (unsigned) d.count) {
-					LogMessage("ERROR. Malfomed Value set! Rereading from device.");
-					return OnDeviceValue(pProp, MM::BeforeGet, data);
-				} 
-
-				for(int i = 0; i < d.count; i++) {
-					if(helper[i] == '1') {
-						coilBuffer[i] = 1;
-					} else if(helper[i] == '0') {
-						coilBuffer[i] = 0;
-					} else {
-						LogMessage("ERROR. Malfomed Value set! Rereading from device.");
-						return OnDeviceValue(pProp, MM::BeforeGet, data);
-					}
-				}
+			if(parseValue(d, helper, value) != DEVICE_OK) {
+				LogMessage("ERROR. Malfomed Value set! Rereading from device.");
+				if(deviceBlock[data] >= 0 && readBlock(readBlocks[deviceBlock[data]], changed) == DEVICE_OK)
+					pProp->Set(d.valueCache.c_str());
+				return DEVICE_INVALID_PROPERTY_VALUE;
 			}
 
-			modbus_write_bits(ctx, d.write_address, d.count, coilBuffer);
-
+			if(polling) {
+				// Coalesced with any other writes until the next poll cycle
+				d.pendingValue = value;
+				d.writePending = true;
+				d.writeAttempts = 0;
+			} else {
+				if(writeDevice(d, value) != DEVICE_OK)
+					return DEVICE_ERR;
+			}
 		}
-
-		return DEVICE_OK;
-	} else {
-		return DEVICE_ERR;
 	}
+
+	notifyChanged(changed);
+	return DEVICE_OK;
 }
 
 int CModbusDevice::Shutdown() {
+	if(pollThread != NULL) {
+		pollThread->Stop();
+		pollThread->wait();
+		delete pollThread;
+		pollThread = NULL;
+
+		// Do not lose values set just before shutdown
+		MMThreadGuard g(busLock);
+		flushPendingWrites();
+	}
+
 	ready = false;
 
-	if(coilBuffer != NULL)
-		delete coilBuffer;
-	if(registerBuffer != NULL)
-		delete registerBuffer;
+	if(ctx != NULL) {
+		modbus_close(ctx);
+		modbus_free(ctx);
+		ctx = NULL;
+	}
+
+	readBlocks.clear();
+	deviceBlock.clear();
+	deviceConfiguration.clear();
+	coilBuffer.clear();
+	registerBuffer.clear();
 
 	return DEVICE_OK;
 }
@@ -21,6 +21,8 @@
 
 using namespace std;
 
+#define ERR_MODBUS_WRITE_FAILED 10001
+
 inline pair<string, string> split(string input, string sep) {
     pair<string, string> result;
     size_t position = input.find(sep);
@@ -81,9 +83,46 @@ struct ModbusDevice {
 	string typeStr;
 	int count;
 
+	// Guarded by CModbusDevice::busLock
 	string valueCache;
+	bool cacheValid;
+	string pendingValue;
+	bool writePending;
+	int writeAttempts; // failed attempts to send pendingValue
+	bool writeFailed; // reported by the next property access
+
+	inline ModbusDevice() : read_address(0), write_address(0), write_only(0), read_only(0), type(MD_COILS), count(0), cacheValid(false), writePending(false), writeAttempts(0), writeFailed(false) {};
+};
+
+// A contiguous range of coils or registers covering the read ranges of one or
+// more devices, so that all of them can be refreshed in a single transaction.
+struct ModbusReadBlock {
+	ModbusDeviceType type;
+	int address;
+	int count;
+	vector<int> members; // indices into deviceConfiguration
+
+	inline ModbusReadBlock() : type(MD_COILS), address(0), count(0) {};
+};
+
+class CModbusDevice;
 
-	inline ModbusDevice() : read_address(0), write_address(0), type(MD_COILS), count(0), write_only(0), read_only(0) {};
+class ModbusPollThread : public MMDeviceThreadBase
+{
+public:
+	ModbusPollThread(CModbusDevice *device);
+
+	void Start(long intervalMs);
+	void Stop();
+	bool IsStopped();
+
+private:
+	int svc();
+
+	CModbusDevice *device;
+	long intervalMs;
+	bool stop;
+	MMThreadLock stopLock;
 };
 
 class CModbusDevice: public CGenericBase<CModbusDevice>
@@ -101,13 +140,24 @@ public:
 	int OnConnectionURI(MM::PropertyBase *, MM::ActionType eAct);
 	int OnDeviceString(MM::PropertyBase *, MM::ActionType eAct);
 	int OnDebugFlag(MM::PropertyBase *pProp, MM::ActionType eAct);
+	int OnPollInterval(MM::PropertyBase *pProp, MM::ActionType eAct);
 
 	int OnDeviceValue(MM::PropertyBase *pProp, MM::ActionType eAct, long data);
 
+	// Called by the poll thread
+	int PollCycle();
+
 private:
 
 	int checkContextAndContinue();
 
+	void buildReadBlocks();
+	int readBlock(ModbusReadBlock &block, vector<int> &changed);
+	int writeDevice(ModbusDevice &d, const string &value);
+	int parseValue(const ModbusDevice &d, const string &input, string &value);
+	int flushPendingWrites();
+	void notifyChanged(const vector<int> &changed);
+
 	modbus_t *ctx;
 
 	string connectionURI;
@@ -115,17 +165,23 @@ private:
 
 	
 	vector<ModbusDevice> deviceConfiguration;
+	vector<ModbusReadBlock> readBlocks;
+	vector<int> deviceBlock; // block index for each device, -1 if none
 
 	int ready;
 
 	long debugFlag;
+	long pollIntervalMs;
 
 	int retriesLeft;
 	long retries;
 
-	int largestCount;
-	unsigned char *coilBuffer;
-	unsigned short *registerBuffer;
+	vector<unsigned char> coilBuffer;
+	vector<unsigned short> registerBuffer;
+
+	// Guards ctx, the buffers and the value caches of deviceConfiguration
+	MMThreadLock busLock;
+	ModbusPollThread *pollThread;
 
 };
 
@@ -0,0 +1,206 @@
+///////////////////////////////////////////////////////////////////////////////
+// FILE:          ModbusModule-Tests.cpp
+// PROJECT:       Micro-Manager
+// SUBSYSTEM:     DeviceAdapters
+//-----------------------------------------------------------------------------
+// DESCRIPTION:   Tests of the Modbus adapter against a libmodbus TCP server
+//
+// LICENSE:       BSD (2-clause/FreeBSD license)
+
+#include <gtest/gtest.h>
+
+#include "ModbusModule.h"
+
+#include <poll.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <thread>
+
+
+// A Modbus TCP server on a free local port, serving 16 coils and 16 holding
+// registers to a single connection. Writes can be made to fail with a
+// server failure exception.
+class ModbusModuleTest : public ::testing::Test
+{
+protected:
+   modbus_t* server_;
+   modbus_mapping_t* mapping_;
+   int listenSocket_;
+   int port_;
+   std::thread serverThread_;
+   std::mutex mappingMutex_;
+   std::atomic<int> writesToFail_;
+   std::atomic<int> writesReceived_;
+
+   virtual void SetUp()
+   {
+      server_ = NULL;
+      listenSocket_ = -1;
+      writesToFail_ = 0;
+      writesReceived_ = 0;
+      mapping_ = modbus_mapping_new(16, 0, 16, 0);
+      ASSERT_TRUE(mapping_ != NULL);
+      server_ = modbus_new_tcp("127.0.0.1", 0);
+      ASSERT_TRUE(server_ != NULL);
+      listenSocket_ = modbus_tcp_listen(server_, 1);
+      ASSERT_NE(-1, listenSocket_);
+
+      sockaddr_in addr = sockaddr_in();
+      socklen_t len = sizeof(addr);
+      ASSERT_EQ(0, getsockname(listenSocket_,
+               reinterpret_cast<sockaddr*>(&addr), &len));
+      port_ = ntohs(addr.sin_port);
+
+      serverThread_ = std::thread([this] { Serve(); });
+   }
+
+   virtual void TearDown()
+   {
+      if (serverThread_.joinable())
+         serverThread_.join();
+      if (listenSocket_ != -1)
+         close(listenSocket_);
+      if (server_ != NULL)
+         modbus_free(server_);
+      if (mapping_ != NULL)
+         modbus_mapping_free(mapping_);
+   }
+
+   // Returns once the client disconnects, or if none connects in time
+   void Serve()
+   {
+      pollfd pfd = { listenSocket_, POLLIN, 0 };
+      if (poll(&pfd, 1, 5000) != 1 ||
+            modbus_tcp_accept(server_, &listenSocket_) == -1)
+         return;
+
+      uint8_t request[MODBUS_TCP_MAX_ADU_LENGTH];
+      const int functionOffset = modbus_get_header_length(server_);
+      for (;;)
+      {
+         const int len = modbus_receive(server_, request);
+         if (len == -1)
+            break;
+         if (len == 0)
+            continue; // Not for us
+
+         const uint8_t function = request[functionOffset];
+         const bool isWrite = function == MODBUS_FC_WRITE_MULTIPLE_COILS ||
+            function == MODBUS_FC_WRITE_MULTIPLE_REGISTERS;
+         if (isWrite)
+            ++writesReceived_;
+         if (isWrite && writesToFail_ > 0)
+         {
+            --writesToFail_;
+            modbus_reply_exception(server_, request,
+                  MODBUS_EXCEPTION_SLAVE_OR_SERVER_FAILURE);
+            continue;
+         }
+         std::lock_guard<std::mutex> lock(mappingMutex_);
+         modbus_reply(server_, request, len, mapping_);
+      }
+      modbus_close(server_);
+   }
+
+   std::string Coils()
+   {
+      std::lock_guard<std::mutex> lock(mappingMutex_);
+      std::string coils;
+      for (int i = 0; i < 8; ++i)
+         coils += mapping_->tab_bits[i] ? "1" : "0";
+      return coils;
+   }
+
+   void SetCoils(const std::string& coils)
+   {
+      std::lock_guard<std::mutex> lock(mappingMutex_);
+      for (int i = 0; i < 8; ++i)
+         mapping_->tab_bits[i] = coils[i] == '1';
+   }
+
+   int Initialize(CModbusDevice& device, long pollIntervalMs)
+   {
+      const std::string uri = "tcp://127.0.0.1:" + std::to_string(port_);
+      device.SetProperty("ConnectionURI", uri.c_str());
+      device.SetProperty("Devices",
+            "name=valves type=coils write_address=0 read_address=0 count=8");
+      device.SetProperty("PollIntervalMs",
+            std::to_string(pollIntervalMs).c_str());
+      return device.Initialize();
+   }
+
+   static bool WaitUntilNotBusy(CModbusDevice& device)
+   {
+      for (int i = 0; i < 200 && device.Busy(); ++i)
+         std::this_thread::sleep_for(std::chrono::milliseconds(10));
+      return !device.Busy();
+   }
+};
+
+
+TEST_F(ModbusModuleTest, UnpolledAccessGoesToTheServer)
+{
+   CModbusDevice device;
+   ASSERT_EQ(DEVICE_OK, Initialize(device, 0));
+
+   ASSERT_EQ(DEVICE_OK, device.SetProperty("valves", "10100000"));
+   EXPECT_EQ("10100000", Coils());
+
+   SetCoils("01000001");
+   char value[MM::MaxStrLength];
+   ASSERT_EQ(DEVICE_OK, device.GetProperty("valves", value));
+   EXPECT_STREQ("01000001", value);
+}
+
+TEST_F(ModbusModuleTest, PolledWritesAreCoalesced)
+{
+   CModbusDevice device;
+   ASSERT_EQ(DEVICE_OK, Initialize(device, 50));
+   const int writesBefore = writesReceived_;
+
+   ASSERT_EQ(DEVICE_OK, device.SetProperty("valves", "10000000"));
+   ASSERT_EQ(DEVICE_OK, device.SetProperty("valves", "11000000"));
+   ASSERT_EQ(DEVICE_OK, device.SetProperty("valves", "11100000"));
+   ASSERT_TRUE(WaitUntilNotBusy(device));
+   EXPECT_EQ("11100000", Coils());
+   EXPECT_LE(writesReceived_ - writesBefore, 2);
+}
+
+TEST_F(ModbusModuleTest, FailedPolledWriteIsRetried)
+{
+   CModbusDevice device;
+   ASSERT_EQ(DEVICE_OK, Initialize(device, 20));
+
+   writesToFail_ = 1;
+   ASSERT_EQ(DEVICE_OK, device.SetProperty("valves", "00001111"));
+   ASSERT_TRUE(WaitUntilNotBusy(device));
+   EXPECT_EQ("00001111", Coils());
+
+   char value[MM::MaxStrLength];
+   EXPECT_EQ(DEVICE_OK, device.GetProperty("valves", value));
+   EXPECT_STREQ("00001111", value);
+}
+
+TEST_F(ModbusModuleTest, PolledWriteThatKeepsFailingIsReported)
+{
+   CModbusDevice device;
+   ASSERT_EQ(DEVICE_OK, Initialize(device, 20));
+   SetCoils("11110000");
+
+   writesToFail_ = 1000;
+   ASSERT_EQ(DEVICE_OK, device.SetProperty("valves", "00001111"));
+   ASSERT_TRUE(WaitUntilNotBusy(device));
+   EXPECT_EQ("11110000", Coils());
+
+   // Reported once, by the next access; then the device is read again
+   char value[MM::MaxStrLength];
+   EXPECT_EQ(ERR_MODBUS_WRITE_FAILED, device.GetProperty("valves", value));
+   EXPECT_EQ(DEVICE_OK, device.GetProperty("valves", value));
+   EXPECT_STREQ("11110000", value);
+}
@@ -0,0 +1,101 @@
+// Mock device adapter for testing of device change notifications
+//
+// Copyright (C) 2024 Board of Regents of the University of Wisconsin System
+//
+// This file is distributed under the BSD license. License text is included
+// with the source distribution.
+//
+// This file is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE.
+//
+// IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES.
+
+#pragma once
+
+#include <cassert>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+
+// NotificationStorm calls an action a given number of times at a given rate,
+// on a background thread, for measuring notification latency and throughput.
+// The action receives a sequence number starting at 0. If the action takes
+// longer than the period, the storm falls behind and catches up without
+// sleeping (it does not skip sequence numbers). Member functions are
+// thread-safe, but must not be called from the action.
+
+class NotificationStorm {
+   using Clock = std::chrono::steady_clock;
+
+   std::mutex mut_;
+   std::condition_variable cv_;
+   bool running_ = false;
+   bool stopRequested_ = false;
+   std::thread thread_;
+
+   void Run(long count, double rateHz, std::function<void(long)> action) {
+      const auto period = std::chrono::duration_cast<Clock::duration>(
+            std::chrono::duration<double>(1.0 / rateHz));
+      const auto start = Clock::now();
+      for (long seq = 0; seq < count; ++seq) {
+         {
+            std::unique_lock<std::mutex> lock(mut_);
+            cv_.wait_until(lock, start + seq * period,
+                  [&] { return stopRequested_; });
+            if (stopRequested_) {
+               break;
+            }
+         }
+         action(seq);
+      }
+      std::lock_guard<std::mutex> lock(mut_);
+      running_ = false;
+   }
+
+public:
+   ~NotificationStorm() {
+      Stop();
+   }
+
+   // Start a storm, stopping any storm in progress.
+   void Start(long count, double rateHz, std::function<void(long)> action) {
+      assert(rateHz > 0.0);
+      assert(action);
+      Stop();
+      std::lock_guard<std::mutex> lock(mut_);
+      stopRequested_ = false;
+      running_ = true;
+      thread_ = std::thread([this, count, rateHz, action] {
+         Run(count, rateHz, action);
+      });
+   }
+
+   void Stop() {
+      {
+         std::lock_guard<std::mutex> lock(mut_);
+         stopRequested_ = true;
+      }
+      cv_.notify_one();
+      if (thread_.joinable()) {
+         thread_.join();
+      }
+   }
+
+   bool IsRunning() {
+      std::lock_guard<std::mutex> lock(mut_);
+      return running_;
+   }
+
+   // Value identifying a notification: "<seq>;<steady_clock ns>". The time is
+   // only comparable with std::chrono::steady_clock in the same process.
+   static std::string Stamp(long seq) {
+      const auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            Clock::now().time_since_epoch()).count();
+      return std::to_string(seq) + ";" + std::to_string(ns);
+   }
+};
@@ -15,6 +15,7 @@
 // Author: Mark A. Tsuchida
 
 #include "DelayedNotifier.h"
+#include "NotificationStorm.h"
 #include "ProcessModel.h"
 
 #include "DeviceBase.h"
@@ -33,6 +34,7 @@ constexpr char DEVNAME_ASYNC_STAGE[] = "NTAsyncStage";
 constexpr char DEVNAME_SYNC_XY_STAGE[] = "NTSyncXYStage";
 constexpr char DEVNAME_ASYNC_XY_STAGE[] = "NTAsyncXYStage";
 constexpr char PROPNAME_TEST_PROPERTY[] = "TestProperty";
+constexpr char PROPNAME_STORM_STAMP[] = "StormStamp";
 
 std::pair<bool, std::array<long, 2>> ParseIntegerPair(const std::string& s) {
    // Strings like " 100 ; -200  ", all spaces optional.
@@ -68,6 +70,13 @@ class NTestProp : public CGenericBase<NTestProp<ProcModel>>
    std::mutex notificationMut_;
    bool notificationsEnabled_ = false;
 
+   // Notification storm, for benchmarking (see NotificationBenchmark in
+   // MMCore)
+   NotificationStorm storm_;
+   double stormRateHz_ = 1000.0;
+   std::mutex stormStampMut_;
+   std::string lastStormStamp_;
+
 public:
    explicit NTestProp(std::string name) :
       name_(std::move(name)),
@@ -186,17 +195,68 @@ public:
          this->SetPropertyLimits("NotificationDelay_s", 0.0, 1.0);
       }
 
+      // Setting StormCount fires that many notifications of StormStamp, at
+      // StormRate_Hz, from a background thread. The device is busy until the
+      // storm has finished.
+      this->CreateStringProperty(PROPNAME_STORM_STAMP, "", true,
+            new MM::ActionLambda([this](MM::PropertyBase* pProp,
+                                        MM::ActionType eAct) {
+               if (eAct == MM::BeforeGet) {
+                  std::lock_guard<std::mutex> lock(stormStampMut_);
+                  pProp->Set(lastStormStamp_.c_str());
+               }
+               return DEVICE_OK;
+            }));
+
+      this->CreateFloatProperty("StormRate_Hz", stormRateHz_, false,
+            new MM::ActionLambda([this](MM::PropertyBase* pProp,
+                                        MM::ActionType eAct) {
+               if (eAct == MM::BeforeGet) {
+                  pProp->Set(stormRateHz_);
+               } else if (eAct == MM::AfterSet) {
+                  pProp->Get(stormRateHz_);
+               }
+               return DEVICE_OK;
+            }));
+      this->SetPropertyLimits("StormRate_Hz", 1.0, 1000000.0);
+
+      this->CreateIntegerProperty("StormCount", 0, false,
+            new MM::ActionLambda([this](MM::PropertyBase* pProp,
+                                        MM::ActionType eAct) {
+               if (eAct == MM::BeforeGet) {
+                  // Keep last-set value
+               } else if (eAct == MM::AfterSet) {
+                  long count{};
+                  pProp->Get(count);
+                  if (count <= 0) {
+                     storm_.Stop();
+                     return DEVICE_OK;
+                  }
+                  storm_.Start(count, stormRateHz_, [this](long seq) {
+                     const std::string stamp = NotificationStorm::Stamp(seq);
+                     {
+                        std::lock_guard<std::mutex> lock(stormStampMut_);
+                        lastStormStamp_ = stamp;
+                     }
+                     this->OnPropertyChanged(PROPNAME_STORM_STAMP,
+                                             stamp.c_str());
+                  });
+               }
+               return DEVICE_OK;
+            }));
+
       return DEVICE_OK;
    }
 
    int Shutdown() final {
+      storm_.Stop();
       model_.Halt();
       delayer_.CancelAll();
       return DEVICE_OK;
    }
 
    bool Busy() final {
-      return model_.IsSlewing();
+      return model_.IsSlewing() || storm_.IsRunning();
    }
 
    void GetName(char *name) const final {
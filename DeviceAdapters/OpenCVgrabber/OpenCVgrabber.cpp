@@ -32,6 +32,7 @@
 #include "ModuleInterface.h"
 #include <sstream>
 #include <algorithm>
+#include <chrono>
 
 #include <iostream>
 
@@ -39,8 +40,19 @@
 using namespace cv;
 using namespace std;
 
-CvCapture* capture_;
-IplImage* frame_; // do not modify, do not release!
+#if CV_MAJOR_VERSION < 3
+// OpenCV 2.4 (used for the Windows build) only has the C names
+namespace cv {
+enum {
+   CAP_PROP_POS_FRAMES = CV_CAP_PROP_POS_FRAMES,
+   CAP_PROP_FRAME_WIDTH = CV_CAP_PROP_FRAME_WIDTH,
+   CAP_PROP_FRAME_HEIGHT = CV_CAP_PROP_FRAME_HEIGHT,
+   CAP_PROP_FPS = CV_CAP_PROP_FPS,
+   CAP_PROP_GAIN = CV_CAP_PROP_GAIN,
+   CAP_PROP_EXPOSURE = CV_CAP_PROP_EXPOSURE,
+};
+}
+#endif
 
 const double COpenCVgrabber::nominalPixelSizeUm_ = 1.0;
 
@@ -49,6 +61,8 @@ const double COpenCVgrabber::nominalPixelSizeUm_ = 1.0;
 // to load particular device from the "DemoCamera.dll" library
 const char* g_CameraDeviceName = "OpenCVgrabber";
 const char* cIDName = "Camera";
+const char* g_Keyword_Source = "Source";
+const char* g_Keyword_FPS = "FPS";
 
 // constants for naming pixel types (allowed values of the "PixelType" property)
 const char* g_PixelType_8bit = "8bit";
@@ -147,6 +161,7 @@ COpenCVgrabber::COpenCVgrabber() :
    roiX_(0),
    roiY_(0),
    sequenceStartTime_(0),
+   imageCounter_(0),
 	binSize_(1),
 	cameraCCDXSize_(800),
 	cameraCCDYSize_(600),
@@ -154,7 +169,19 @@ COpenCVgrabber::COpenCVgrabber() :
    xFlip_(false),
    yFlip_(false),
    triggerDevice_(""),
-   stopOnOverFlow_(false)
+   stopOnOverFlow_(false),
+   isFileSource_(false),
+   fps_(30.0),
+   ring_(ringSize),
+   newestSlot_(0),
+   frameSeq_(0),
+   format_(),
+   formatGeneration_(0),
+   stopGrabbing_(true),
+   sequenceActive_(false),
+   sequenceLength_(0),
+   sequenceIntervalMs_(0.0),
+   sequenceFormat_()
 {
    // call the base class method to set-up default error codes/messages
    InitializeDefaultErrorMessages();
@@ -183,8 +210,12 @@ COpenCVgrabber::COpenCVgrabber() :
    AddAllowedValue(cIDNameReally.c_str(), "3");
 #endif
 
+   // A video file or image sequence (e.g. "frames/img_%04d.png") can be used
+   // instead of a camera, for testing without hardware
+   pAct = new CPropertyAction(this, &COpenCVgrabber::OnSource);
+   CreateProperty(g_Keyword_Source, "", MM::String, false, pAct, true);
+
    readoutStartTime_ = GetCurrentMMTime();
-   thd_ = new MySequenceThread(this);
 }
 
 /**
@@ -196,11 +227,7 @@ COpenCVgrabber::COpenCVgrabber() :
 */
 COpenCVgrabber::~COpenCVgrabber()
 {
-   if(capture_)
-   {
-	   cvReleaseCapture(&capture_);
-	}
-   delete thd_;
+   Shutdown();
 }
 
 /**
@@ -231,30 +258,24 @@ int COpenCVgrabber::Initialize()
 
    // init the hardware
 
-   // start opencv capture_ from first device, 
+   // start opencv capture from the camera (or the video source),
    // we need to initialise hardware early on to discover properties
-   capture_ = cvCaptureFromCAM(cameraID_);
+   int nRet = OpenCapture();
+   if (nRet != DEVICE_OK)
+      return nRet;
 
-   if (!capture_) // do we have a capture_ device?
+   cv::Mat frame;
    {
-     return DEVICE_NOT_CONNECTED;
-   }
-   // ignore first frame to make it work with more cameras
-   cvQueryFrame(capture_);
-   frame_ = cvQueryFrame(capture_);
-   if (!frame_)
-   {
-      return FAILED_TO_GET_IMAGE;
+      std::lock_guard<std::mutex> lock(captureLock_);
+      // ignore first frame to make it work with more cameras
+      if (!isFileSource_)
+         ReadFrame(frame);
+      if (!ReadFrame(frame))
+         return FAILED_TO_GET_IMAGE;
    }
 
-#ifdef __APPLE__
-   long w = frame_->width;
-   long h = frame_->height;
-#else
-   long w = (long) cvGetCaptureProperty(capture_, CV_CAP_PROP_FRAME_WIDTH);
-   long h = (long) cvGetCaptureProperty(capture_, CV_CAP_PROP_FRAME_HEIGHT);
-#endif
-
+   long w = frame.cols;
+   long h = frame.rows;
 
    if(w > 0 && h > 0){
 		cameraCCDXSize_ = w;
@@ -267,7 +288,7 @@ int COpenCVgrabber::Initialize()
    // -----------------
 
    // Name
-   int nRet = CreateProperty(MM::g_Keyword_Name, g_CameraDeviceName, MM::String, true);
+   nRet = CreateProperty(MM::g_Keyword_Name, g_CameraDeviceName, MM::String, true);
    if (DEVICE_OK != nRet)
       return nRet;
 
@@ -370,6 +391,11 @@ int COpenCVgrabber::Initialize()
    assert(nRet == DEVICE_OK);
    SetPropertyLimits(MM::g_Keyword_Exposure, 0, 10000);
 
+   // frame rate
+   pAct = new CPropertyAction (this, &COpenCVgrabber::OnFPS);
+   nRet = CreateProperty(g_Keyword_FPS, CDeviceUtils::ConvertToString(fps_), MM::Float, false, pAct);
+   assert(nRet == DEVICE_OK);
+
    // camera offset
    nRet = CreateProperty(MM::g_Keyword_Offset, "0", MM::Integer, false);
    assert(nRet == DEVICE_OK);
@@ -410,6 +436,10 @@ int COpenCVgrabber::Initialize()
 
    // initialize image buffer
    GenerateEmptyImage(img_);
+
+   // capture continuously from now on
+   UpdateFrameFormat();
+   StartGrabbing();
    return DEVICE_OK;
 
 
@@ -425,9 +455,12 @@ int COpenCVgrabber::Initialize()
 */
 int COpenCVgrabber::Shutdown()
 {
-	if(capture_){
-	   cvReleaseCapture(&capture_);
-	}
+   StopSequenceAcquisition();
+   StopGrabbing();
+   {
+      std::lock_guard<std::mutex> lock(captureLock_);
+      capture_.release();
+   }
 
    initialized_ = false;
    return DEVICE_OK;
@@ -438,36 +471,35 @@ int COpenCVgrabber::Shutdown()
 * This function should block during the actual exposure and return immediately afterwards 
 * (i.e., before readout).  This behavior is needed for proper synchronization with the shutter.
 * Required by the MM::Camera API.
+* The grab thread captures continuously, so the frame completed next may have
+* been exposed before this call; we wait for the one after it, converted with
+* the current settings.
 */
 int COpenCVgrabber::SnapImage()
 {
    if (!initialized_)
       return CAMERA_NOT_INITIALIZED;
 
-   MM::MMTime startTime = GetCurrentMMTime();
-   double exp = GetExposure();
-   double expUs = exp * 1000.0;
+   const long timeoutMs = 5000 + (long) GetExposure() + (long) (2000.0 / fps_);
+
+   std::unique_lock<std::mutex> lock(frameLock_);
+   const long long firstSeq = frameSeq_ + 2;
+   const unsigned long generation = formatGeneration_;
+   const bool ready = frameCond_.wait_for(lock, std::chrono::milliseconds(timeoutMs),
+      [&] {
+         const FrameSlot& newest = ring_[newestSlot_];
+         return newest.seq >= firstSeq && newest.generation == generation;
+      });
+   if (!ready)
+      return FAILED_TO_GET_IMAGE;
 
-   cvGrabFrame(capture_);
-   
-   MM::MMTime s0(0,0);
-   MM::MMTime t2 = GetCurrentMMTime();
-   if( s0 < startTime )
+   // The grab thread never writes to the newest slot
    {
-      // ensure wait time is non-negative
-      long naptime = (long)(0.5 + expUs - (double)(t2-startTime).getUsec());
-      if( naptime < 1)
-         naptime = 1;
-      // longest possible nap is about 38 minutes
-      CDeviceUtils::NapMicros((unsigned long) naptime);
+      MMThreadGuard g(imgPixelsLock_);
+      img_ = ring_[newestSlot_].img;
    }
-   else
-   {
-      std::cerr << "You are operating this device adapter without setting the core callback, timing functions aren't yet available" << std::endl;
-      // called without the core callback probably in off line test program
-      // need way to build the core in the test program
+   lock.unlock();
 
-   }   
    readoutStartTime_ = GetCurrentMMTime();
 
    return DEVICE_OK;
@@ -489,7 +521,6 @@ const unsigned char* COpenCVgrabber::GetImageBuffer()
    if (!initialized_)
       return NULL;
 
-   IplImage* temp; // used during conversion
    MMThreadGuard g(imgPixelsLock_);
    MM::MMTime readoutTime(readoutUs_);
    while (readoutTime > (GetCurrentMMTime() - readoutStartTime_))
@@ -497,87 +528,10 @@ const unsigned char* COpenCVgrabber::GetImageBuffer()
       CDeviceUtils::SleepMs(1);
    }
 
-   cvRetrieveFrame(capture_); // throw away old image
-   temp = cvRetrieveFrame(capture_);
-   if(!temp) return 0;
-   //Mat temp_mat (temp);
-
-   if(xFlip_ == true){ 
-      cvFlip(temp,NULL,1);
-   }
-   if(yFlip_ == true){
-      cvFlip(temp,NULL,0);
-   }
-
-   char buf[MM::MaxStrLength];
-   GetProperty(MM::g_Keyword_PixelType, buf);
-   std::string pixelType(buf);
-
-   if (pixelType.compare(g_PixelType_32bitRGB) == 0)
-   {
-      /*
-      Mat rgba( img_.Width(), img_.Height(),CV_8UC4, Scalar(255,128,0,0) );
-      Mat rgb(img_.Width(), img_.Height(),CV_8UC3, Scalar(0,0,0));
-      Mat alpha(  img_.Width(), img_.Height(),CV_8UC1 ,Scalar(0));
-
-
-      int from_to[] = {0,0,  1,1,  2,2, 3,3};
-
-      Mat in[] = {rgb,alpha};
-
-      mixChannels( in, 2, &rgba, 1, from_to, 4);
-
-      IplImage ipl_img = rgba;
-      memcpy(img_.GetPixelsRW(),ipl_img.imageData,img_.Width() * img_.Height() * 4);
-      */
-
-      if(roiX_ == 0 && roiY_ == 0){
-         RGB3toRGB4(temp->imageData, (char *) img_.GetPixelsRW(), temp->width, temp->height);
-      } else {
-         cvSetImageROI(temp,cvRect(roiX_,roiY_,img_.Width(),img_.Height()));
-         IplImage *ROI = cvCreateImage(cvSize(img_.Width(),img_.Height()),
-            temp->depth,
-            temp->nChannels);
-
-
-         if(!ROI) return 0; //failed to create ROI image
-         cvCopy(temp,ROI,NULL);
-         cvResetImageROI(temp);
-         RGB3toRGB4(temp->imageData, (char *) img_.GetPixelsRW(), ROI->width, ROI->height);		
-         //cvCvtColor(&ROI,(CvArr *) temp->imageData,CV_RGB2RGBA);// possible alternative to the padding loop - if I can get it not to break!
-         cvReleaseImage(&ROI);
-      }
-
-   } else {
-      unsigned int srcOffset = 0;
-      for(int i=0; i < temp->width * temp->height; i++){
-         memcpy(img_.GetPixelsRW()+i, temp->imageData+srcOffset,1);
-         srcOffset += 3;
-      } 
-   }
-
-
-
    unsigned char *pB = (unsigned char*)(img_.GetPixels());
    return pB;
 }
 
-/**
-* Converts three-byte image to four bytes
-*/
-void COpenCVgrabber::RGB3toRGB4(const char* srcPixels, char* destPixels, int width, int height)
-{
-   // nasty padding loop
-   unsigned int srcOffset = 0;
-   unsigned int dstOffset = 0;
-   int totalSize = width * height;
-   for(int i=0; i < totalSize; i++){
-      memcpy(destPixels+dstOffset, srcPixels+srcOffset,3);
-      srcOffset += 3;
-      dstOffset += 4;
-   }
-}
-
 
 /**
 * Returns image buffer X-size in pixels.
@@ -657,6 +611,7 @@ int COpenCVgrabber::SetROI(unsigned x, unsigned y, unsigned xSize, unsigned ySiz
       roiX_ = x;
       roiY_ = y;
    }
+   UpdateFrameFormat();
    return DEVICE_OK;
 }
 
@@ -686,6 +641,7 @@ int COpenCVgrabber::ClearROI()
    ResizeImageBuffer();
    roiX_ = 0;
    roiY_ = 0;
+   UpdateFrameFormat();
       
    return DEVICE_OK;
 }
@@ -696,7 +652,11 @@ int COpenCVgrabber::ClearROI()
 */
 double COpenCVgrabber::GetExposure() const
 {
-	double exp = cvGetCaptureProperty(capture_,CV_CAP_PROP_EXPOSURE); // try to get the exposure from OpenCV - not all drivers allow this
+   double exp;
+   {
+      std::lock_guard<std::mutex> lock(captureLock_);
+      exp = capture_.get(cv::CAP_PROP_EXPOSURE); // try to get the exposure from OpenCV - not all drivers allow this
+   }
 	if(exp >= 1)
       return exp; // if it works, great, return it, otherwise...
 
@@ -716,7 +676,10 @@ double COpenCVgrabber::GetExposure() const
 void COpenCVgrabber::SetExposure(double exp)
 {
    SetProperty(MM::g_Keyword_Exposure, CDeviceUtils::ConvertToString(exp));
-   cvSetCaptureProperty(capture_,CV_CAP_PROP_EXPOSURE,(long)exp); 
+   {
+      std::lock_guard<std::mutex> lock(captureLock_);
+      capture_.set(cv::CAP_PROP_EXPOSURE, exp);
+   }
    // there is no benefit from checking if this works (many capture_ drivers via opencv 
    // just don't allow this) - just carry on regardless.
 }
@@ -763,24 +726,32 @@ int COpenCVgrabber::StartSequenceAcquisition(double interval) {
    return StartSequenceAcquisition(LONG_MAX, interval, false);            
 }
 
-/**                                                                       
-* Stop and wait for the Sequence thread finished                                   
-*/                                                                        
-int COpenCVgrabber::StopSequenceAcquisition()                                     
-{                                                                         
-
-   if (!thd_->IsStopped()) {
-      thd_->Stop();                                                       
-      thd_->wait();                                                       
-   }                                                                      
-                                                                          
-   return DEVICE_OK;                                                      
-} 
+/**
+* Stops inserting frames into the MMCore circular buffer.
+*/
+int COpenCVgrabber::StopSequenceAcquisition()
+{
+   bool wasActive;
+   {
+      std::lock_guard<std::mutex> lock(sequenceLock_);
+      wasActive = sequenceActive_;
+      sequenceActive_ = false;
+   }
+
+   if (wasActive)
+   {
+      LogMessage("SeqAcquisition interrupted by the user\n");
+      if (GetCoreCallback())
+         GetCoreCallback()->AcqFinished(this, 0);
+   }
+   return DEVICE_OK;
+}
 
 /**
-* Simple implementation of Sequence Acquisition
-* A sequence acquisition should run on its own thread and transport new images
-* coming from the camera into the MMCore circular buffer.
+* Sequence acquisition.
+* The grab thread inserts the frames it has converted into the MMCore circular
+* buffer as they arrive (see InsertSequenceFrame()), so no further copy or
+* conversion is done per frame.
 */
 int COpenCVgrabber::StartSequenceAcquisition(long numImages, double interval_ms, bool stopOnOverflow)
 {
@@ -791,43 +762,48 @@ int COpenCVgrabber::StartSequenceAcquisition(long numImages, double interval_ms,
    int ret = GetCoreCallback()->PrepareForAcq(this);
    if (ret != DEVICE_OK)
       return ret;
+
+   FrameFormat format;
+   {
+      std::lock_guard<std::mutex> lock(frameLock_);
+      format = format_;
+   }
+
+   std::lock_guard<std::mutex> lock(sequenceLock_);
    sequenceStartTime_ = GetCurrentMMTime();
    stopOnOverFlow_ = stopOnOverflow;
    imageCounter_ = 0;
-   thd_->Start(numImages,interval_ms);
+   sequenceLength_ = numImages;
+   sequenceIntervalMs_ = interval_ms;
+   sequenceFormat_ = format;
+   sequenceActive_ = true;
    return DEVICE_OK;
 }
 
 /*
  * Inserts Image and MetaData into MMCore circular Buffer
+ * Called from the grab thread with sequenceLock_ held
  */
-int COpenCVgrabber::InsertImage()
+int COpenCVgrabber::InsertImage(const FrameSlot& slot)
 {
-   MM::MMTime timeStamp = this->GetCurrentMMTime();
    char label[MM::MaxStrLength];
    this->GetLabel(label);
  
    // Important:  metadata about the image are generated here:
    Metadata md;
    md.put("Camera", label);
-   md.put(MM::g_Keyword_Elapsed_Time_ms, CDeviceUtils::ConvertToString((timeStamp - sequenceStartTime_).getMsec()));
+   md.put(MM::g_Keyword_Elapsed_Time_ms, CDeviceUtils::ConvertToString((slot.timestamp - sequenceStartTime_).getMsec()));
    md.put(MM::g_Keyword_Metadata_ImageNumber, CDeviceUtils::ConvertToString(imageCounter_));
-   md.put(MM::g_Keyword_Metadata_ROI_X, CDeviceUtils::ConvertToString( (long) roiX_)); 
-   md.put(MM::g_Keyword_Metadata_ROI_Y, CDeviceUtils::ConvertToString( (long) roiY_)); 
+   md.put(MM::g_Keyword_Metadata_ROI_X, CDeviceUtils::ConvertToString( (long) slot.format.roiX)); 
+   md.put(MM::g_Keyword_Metadata_ROI_Y, CDeviceUtils::ConvertToString( (long) slot.format.roiY)); 
+   md.put(MM::g_Keyword_Binning, CDeviceUtils::ConvertToString(slot.format.binning));
    
    imageCounter_++;
-   
-   char buf[MM::MaxStrLength];
-   GetProperty(MM::g_Keyword_Binning, buf);
-   md.put(MM::g_Keyword_Binning, buf);
-   
-   MMThreadGuard g(imgPixelsLock_);
-
 
-   const unsigned char* pI = GetImageBuffer();
-   unsigned int w = GetImageWidth();
-   unsigned int h = GetImageHeight();
-   unsigned int b = GetImageBytesPerPixel();
+   const unsigned char* pI = slot.img.GetPixels();
+   unsigned int w = slot.img.Width();
+   unsigned int h = slot.img.Height();
+   unsigned int b = slot.img.Depth();
 
    int ret = GetCoreCallback()->InsertImage(this, pI, w, h, b, md.Serialize().c_str());
    if (!stopOnOverFlow_ && ret == DEVICE_BUFFER_OVERFLOW)
@@ -836,132 +812,54 @@ int COpenCVgrabber::InsertImage()
       GetCoreCallback()->ClearImageBuffer(this);
       // don't process this same image again...
 	  return GetCoreCallback()->InsertImage(this, pI, w, h, b, md.Serialize().c_str(), false);
-	  //return GetCoreCallback()->InsertImage(this, pI, w, h, b);
    } else
       return ret;
 }
 
 /*
- * Do actual capturing
- * Called from inside the thread  
+ * Hands a newly converted frame to the sequence acquisition, if one is
+ * running. Called from the grab thread.
  */
-int COpenCVgrabber::ThreadRun (void)
+void COpenCVgrabber::InsertSequenceFrame(const FrameSlot& slot)
 {
-   int ret=DEVICE_ERR;
-   
-   // Trigger
-   if (triggerDevice_.length() > 0) {
-      MM::Device* triggerDev = GetDevice(triggerDevice_.c_str());
-      if (triggerDev != 0) {
-      	//char label[256];
-      	//triggerDev->GetLabel(label);
-      	LogMessage("trigger requested");
-      	triggerDev->SetProperty("Trigger","+");
-      }
-   }
-      
-   ret = SnapImage();
-   if (ret != DEVICE_OK) return ret;
-
-   ret = InsertImage();
-   if (ret != DEVICE_OK) return ret;
-
-   return ret;
-};
-
-bool COpenCVgrabber::IsCapturing() {
-   return !thd_->IsStopped();
-}
-
-/*
- * called from the thread function before exit 
- */
-void COpenCVgrabber::OnThreadExiting() throw()
-{
-   try
+   bool finished = false;
    {
-      LogMessage(g_Msg_SEQUENCE_ACQUISITION_THREAD_EXITING);
-      GetCoreCallback()?GetCoreCallback()->AcqFinished(this,0):DEVICE_OK;
-   }
-   catch(...)
-   {
-      LogMessage(g_Msg_EXCEPTION_IN_ON_THREAD_EXITING, false);
+      std::lock_guard<std::mutex> lock(sequenceLock_);
+      if (!sequenceActive_)
+         return;
+
+      // Skip frames converted before a change of image size (and those that
+      // come too early for the requested interval)
+      if (slot.format.width != sequenceFormat_.width ||
+            slot.format.height != sequenceFormat_.height ||
+            slot.format.depth != sequenceFormat_.depth)
+         return;
+      if (imageCounter_ > 0 &&
+            (slot.timestamp - lastInsertTime_).getMsec() < sequenceIntervalMs_)
+         return;
+      lastInsertTime_ = slot.timestamp;
+
+      int ret = InsertImage(slot);
+      if (ret != DEVICE_OK)
+      {
+         LogMessage("Failed to insert image; stopping sequence acquisition");
+         finished = true;
+      }
+      else if (imageCounter_ >= sequenceLength_)
+      {
+         finished = true;
+      }
+      if (finished)
+         sequenceActive_ = false;
    }
-}
-
-
-MySequenceThread::MySequenceThread(COpenCVgrabber* pCam)
-   :intervalMs_(default_intervalMS)
-   ,numImages_(default_numImages)
-   ,imageCounter_(0)
-   ,stop_(true)
-   ,suspend_(false)
-   ,camera_(pCam)
-   ,startTime_(0)
-   ,actualDuration_(0)
-   ,lastFrameTime_(0)
-{};
-
-MySequenceThread::~MySequenceThread() {};
 
-void MySequenceThread::Stop() {
-   MMThreadGuard(this->stopLock_);
-   stop_=true;
+   if (finished)
+      GetCoreCallback()->AcqFinished(this, 0);
 }
 
-void MySequenceThread::Start(long numImages, double intervalMs)
-{
-   MMThreadGuard(this->stopLock_);
-   MMThreadGuard(this->suspendLock_);
-   numImages_=numImages;
-   intervalMs_=intervalMs;
-   imageCounter_=0;
-   stop_ = false;
-   suspend_=false;
-   activate();
-   actualDuration_ = MM::MMTime{};
-   startTime_= camera_->GetCurrentMMTime();
-   lastFrameTime_ = MM::MMTime{};
-}
-
-bool MySequenceThread::IsStopped(){
-   MMThreadGuard(this->stopLock_);
-   return stop_;
-}
-
-void MySequenceThread::Suspend() {
-   MMThreadGuard(this->suspendLock_);
-   suspend_ = true;
-}
-
-bool MySequenceThread::IsSuspended() {
-   MMThreadGuard(this->suspendLock_);
-   return suspend_;
-}
-
-void MySequenceThread::Resume() {
-   MMThreadGuard(this->suspendLock_);
-   suspend_ = false;
-}
-
-int MySequenceThread::svc(void) throw()
-{
-   int ret=DEVICE_ERR;
-   try 
-   {
-      do
-      {  
-         ret=camera_->ThreadRun();
-      } while (DEVICE_OK == ret && !IsStopped() && imageCounter_++ < numImages_-1);
-      if (IsStopped())
-         camera_->LogMessage("SeqAcquisition interrupted by the user\n");
-   }catch(...){
-      camera_->LogMessage(g_Msg_EXCEPTION_IN_THREAD, false);
-   }
-   stop_=true;
-   actualDuration_ = camera_->GetCurrentMMTime() - startTime_;
-   camera_->OnThreadExiting();
-   return ret;
+bool COpenCVgrabber::IsCapturing() {
+   std::lock_guard<std::mutex> lock(sequenceLock_);
+   return sequenceActive_;
 }
 
 
@@ -1011,6 +909,7 @@ int COpenCVgrabber::OnFlipX(MM::PropertyBase* pProp, MM::ActionType eAct)
          long val=0;
          pProp->Get(val);
          xFlip_ = (val != 0);
+         UpdateFrameFormat();
          
 		   ret=DEVICE_OK;
       }break;
@@ -1043,6 +942,7 @@ int COpenCVgrabber::OnFlipY(MM::PropertyBase* pProp, MM::ActionType eAct)
          long val=0;
          pProp->Get(val);
          yFlip_ = (val != 0);
+         UpdateFrameFormat();
          
 		   ret=DEVICE_OK;
       }break;
@@ -1064,6 +964,19 @@ int COpenCVgrabber::OnFlipY(MM::PropertyBase* pProp, MM::ActionType eAct)
    return ret; 
 }
 
+int COpenCVgrabber::OnSource(MM::PropertyBase* pProp, MM::ActionType eAct)
+{
+   if (eAct == MM::AfterSet)
+   {
+      pProp->Get(source_);
+   }
+   else if (eAct == MM::BeforeGet)
+   {
+      pProp->Set(source_.c_str());
+   }
+   return DEVICE_OK;
+}
+
 int COpenCVgrabber::OnCameraID(MM::PropertyBase* pProp, MM::ActionType eAct)
 {
 #ifdef WIN32
@@ -1099,14 +1012,18 @@ int COpenCVgrabber::OnGain(MM::PropertyBase* pProp, MM::ActionType eAct)
 
          long gain;
          pProp->Get(gain);
-		 cvSetCaptureProperty(capture_,CV_CAP_PROP_GAIN,gain);
+		 std::lock_guard<std::mutex> lock(captureLock_);
+		 capture_.set(cv::CAP_PROP_GAIN, gain);
 		 ret=DEVICE_OK;
       }break;
    case MM::BeforeGet:
       {
          
 		 double gain;
-		 gain = cvGetCaptureProperty(capture_,CV_CAP_PROP_GAIN);
+		 {
+			 std::lock_guard<std::mutex> lock(captureLock_);
+			 gain = capture_.get(cv::CAP_PROP_GAIN);
+		 }
 		 if(!gain) return DEVICE_ERR;
 		 ret=DEVICE_OK;
 			pProp->Set((double)gain);
@@ -1175,6 +1092,7 @@ int COpenCVgrabber::OnBinning(MM::PropertyBase* pProp, MM::ActionType eAct)
 			{
 				img_.Resize(cameraCCDXSize_/binFactor, cameraCCDYSize_/binFactor);
 				binSize_ = binFactor;
+            UpdateFrameFormat();
             std::ostringstream os;
             os << binSize_;
             OnPropertyChanged("Binning", os.str().c_str());
@@ -1238,6 +1156,7 @@ int COpenCVgrabber::OnPixelType(MM::PropertyBase* pProp, MM::ActionType eAct)
             pProp->Set(g_PixelType_8bit);
             ret = ERR_UNKNOWN_MODE;
          }
+         UpdateFrameFormat();
       } break;
    case MM::BeforeGet:
       {
@@ -1332,6 +1251,7 @@ int COpenCVgrabber::OnBitDepth(MM::PropertyBase* pProp, MM::ActionType eAct)
 			}
 			
 			img_.Resize(img_.Width(), img_.Height(), bytesPerPixel);
+         UpdateFrameFormat();
 
       } break;
    case MM::BeforeGet:
@@ -1375,11 +1295,21 @@ int COpenCVgrabber::OnResolution(MM::PropertyBase* pProp, MM::ActionType eAct)
 		 long w = atoi(width.c_str());
 		 long h = atoi(height.c_str());
 
-		 cvSetCaptureProperty(capture_, CV_CAP_PROP_FRAME_WIDTH, (double) w);
-		 cvSetCaptureProperty(capture_, CV_CAP_PROP_FRAME_HEIGHT, (double) h);
-
-		 cameraCCDXSize_ = (long) cvGetCaptureProperty(capture_, CV_CAP_PROP_FRAME_WIDTH);
-		 cameraCCDYSize_ = (long) cvGetCaptureProperty(capture_, CV_CAP_PROP_FRAME_HEIGHT);
+		 if (isFileSource_)
+		 {
+			 // frames from files are scaled to the requested size
+			 cameraCCDXSize_ = w;
+			 cameraCCDYSize_ = h;
+		 }
+		 else
+		 {
+			 std::lock_guard<std::mutex> lock(captureLock_);
+			 capture_.set(cv::CAP_PROP_FRAME_WIDTH, (double) w);
+			 capture_.set(cv::CAP_PROP_FRAME_HEIGHT, (double) h);
+
+			 cameraCCDXSize_ = (long) capture_.get(cv::CAP_PROP_FRAME_WIDTH);
+			 cameraCCDYSize_ = (long) capture_.get(cv::CAP_PROP_FRAME_HEIGHT);
+		 }
 		 if(!(cameraCCDXSize_ > 0) || !(cameraCCDYSize_ > 0))
 			 return DEVICE_ERR;
 		 ret = ResizeImageBuffer();
@@ -1407,6 +1337,37 @@ int COpenCVgrabber::OnResolution(MM::PropertyBase* pProp, MM::ActionType eAct)
    return ret; 
 }
 
+/**
+* Handles "FPS" property.
+* Sets the frame rate of the camera, if the driver allows it. Video files and
+* image sequences are played back at this rate.
+*/
+int COpenCVgrabber::OnFPS(MM::PropertyBase* pProp, MM::ActionType eAct)
+{
+   if (eAct == MM::AfterSet)
+   {
+      double fps;
+      pProp->Get(fps);
+      if (fps <= 0.0)
+         return DEVICE_INVALID_PROPERTY_VALUE;
+
+      std::lock_guard<std::mutex> lock(captureLock_);
+      if (!isFileSource_)
+      {
+         capture_.set(cv::CAP_PROP_FPS, fps);
+         const double actual = capture_.get(cv::CAP_PROP_FPS);
+         if (actual > 0.0)
+            fps = actual;
+      }
+      fps_ = fps;
+   }
+   else if (eAct == MM::BeforeGet)
+   {
+      pProp->Set(fps_);
+   }
+   return DEVICE_OK;
+}
+
 /**
 * Handles "ReadoutTime" property.
 */
@@ -1470,6 +1431,7 @@ int COpenCVgrabber::OnCameraCCDXSize(MM::PropertyBase* pProp , MM::ActionType eA
 		{
 			cameraCCDXSize_ = value;
 			img_.Resize(cameraCCDXSize_/binSize_, cameraCCDYSize_/binSize_);
+			UpdateFrameFormat();
 		}
    }
 	return DEVICE_OK;
@@ -1493,6 +1455,7 @@ int COpenCVgrabber::OnCameraCCDYSize(MM::PropertyBase* pProp, MM::ActionType eAc
 		{
 			cameraCCDYSize_ = value;
 			img_.Resize(cameraCCDXSize_/binSize_, cameraCCDYSize_/binSize_);
+			UpdateFrameFormat();
 		}
    }
 	return DEVICE_OK;
@@ -1547,6 +1510,9 @@ int COpenCVgrabber::ResizeImageBuffer()
 	}
 	
    img_.Resize(cameraCCDXSize_/binSize_, cameraCCDYSize_/binSize_, byteDepth);
+   roiX_ = 0;
+   roiY_ = 0;
+   UpdateFrameFormat();
    return DEVICE_OK;
 }
 
@@ -1558,3 +1524,244 @@ void COpenCVgrabber::GenerateEmptyImage(ImgBuffer& img)
    unsigned char* pBuf = const_cast<unsigned char*>(img.GetPixels());
    memset(pBuf, 0, img.Height()*img.Width()*img.Depth());
 }
+
+/**
+* Opens the camera, or the video file or image sequence given as the source.
+*/
+int COpenCVgrabber::OpenCapture()
+{
+   std::lock_guard<std::mutex> lock(captureLock_);
+
+   isFileSource_ = !source_.empty();
+   bool opened = isFileSource_ ? capture_.open(source_) : capture_.open((int) cameraID_);
+   if (!opened || !capture_.isOpened())
+   {
+      if (isFileSource_)
+         LogMessage("Cannot open video source " + source_);
+      return DEVICE_NOT_CONNECTED;
+   }
+
+   double fps = capture_.get(cv::CAP_PROP_FPS);
+   fps_ = fps > 0.0 ? fps : 30.0;
+   return DEVICE_OK;
+}
+
+/**
+* Reads the next frame. Video files and image sequences are played in a loop.
+* Must be called with captureLock_ held.
+*/
+bool COpenCVgrabber::ReadFrame(cv::Mat& frame)
+{
+   if (capture_.read(frame) && !frame.empty())
+      return true;
+   if (!isFileSource_)
+      return false;
+
+   // rewind (or reopen, if the backend cannot seek)
+   if (!capture_.set(cv::CAP_PROP_POS_FRAMES, 0))
+      capture_.open(source_);
+   return capture_.read(frame) && !frame.empty();
+}
+
+void COpenCVgrabber::StartGrabbing()
+{
+   {
+      std::lock_guard<std::mutex> lock(frameLock_);
+      stopGrabbing_ = false;
+   }
+   grabThread_ = std::thread(&COpenCVgrabber::GrabLoop, this);
+}
+
+void COpenCVgrabber::StopGrabbing()
+{
+   {
+      std::lock_guard<std::mutex> lock(frameLock_);
+      stopGrabbing_ = true;
+   }
+   frameCond_.notify_all();
+   if (grabThread_.joinable())
+      grabThread_.join();
+}
+
+/**
+* Body of the grab thread.
+* Reads frames continuously and converts each one once, into the ring (see
+* PublishFrame()). Cameras deliver frames at their own rate; video files and
+* image sequences are paced at the FPS property.
+*/
+void COpenCVgrabber::GrabLoop()
+{
+   typedef std::chrono::steady_clock Clock;
+
+   cv::Mat frame;
+   Clock::time_point nextFrameTime = Clock::now();
+   bool failing = false;
+   for (;;)
+   {
+      {
+         std::unique_lock<std::mutex> lock(frameLock_);
+         frameCond_.wait_until(lock, nextFrameTime, [this] { return stopGrabbing_; });
+         if (stopGrabbing_)
+            return;
+      }
+
+      try
+      {
+         bool ok;
+         double fps;
+         {
+            std::lock_guard<std::mutex> lock(captureLock_);
+            ok = ReadFrame(frame);
+            fps = fps_;
+         }
+
+         const Clock::time_point now = Clock::now();
+         if (!ok)
+         {
+            if (!failing)
+               LogMessage("Failed to read a frame; retrying");
+            failing = true;
+            nextFrameTime = now + std::chrono::milliseconds(10);
+            continue;
+         }
+         failing = false;
+
+         if (isFileSource_)
+         {
+            nextFrameTime += std::chrono::duration_cast<Clock::duration>(
+               std::chrono::duration<double>(1.0 / fps));
+            if (nextFrameTime < now)
+               nextFrameTime = now;
+         }
+         else
+         {
+            nextFrameTime = now;
+         }
+
+         PublishFrame(frame);
+      }
+      catch (const std::exception& e)
+      {
+         LogMessage(std::string("Exception in grab thread: ") + e.what());
+         nextFrameTime = Clock::now() + std::chrono::milliseconds(10);
+      }
+   }
+}
+
+/**
+* Converts a frame into the next ring slot, makes it the newest frame and
+* hands it to the sequence acquisition. Called from the grab thread, which is
+* the only writer of the slots; readers only access the newest slot, with
+* frameLock_ held.
+*/
+void COpenCVgrabber::PublishFrame(const cv::Mat& frame)
+{
+   size_t index;
+   FrameFormat format;
+   unsigned long generation;
+   {
+      std::lock_guard<std::mutex> lock(frameLock_);
+      index = (newestSlot_ + 1) % ring_.size();
+      format = format_;
+      generation = formatGeneration_;
+   }
+
+   FrameSlot& slot = ring_[index];
+   ConvertFrame(frame, format, slot.img);
+   const MM::MMTime timestamp = GetCurrentMMTime();
+
+   {
+      std::lock_guard<std::mutex> lock(frameLock_);
+      slot.format = format;
+      slot.generation = generation;
+      slot.timestamp = timestamp;
+      slot.seq = ++frameSeq_;
+      newestSlot_ = index;
+   }
+   frameCond_.notify_all();
+
+   InsertSequenceFrame(slot);
+}
+
+/**
+* Converts a captured frame to the output format: scaled to the nominal frame
+* size and binned, cropped to the ROI, flipped, and converted to 8-bit gray or
+* BGRA. Writes directly into the destination buffer.
+*/
+void COpenCVgrabber::ConvertFrame(const cv::Mat& frame, const FrameFormat& format, ImgBuffer& dest)
+{
+   dest.Resize(format.width, format.height, format.depth);
+   if (format.width == 0 || format.height == 0)
+      return;
+   cv::Mat out(format.height, format.width, format.depth == 1 ? CV_8UC1 : CV_8UC4,
+      dest.GetPixelsRW());
+
+   cv::Mat src = frame;
+   if (src.depth() != CV_8U)
+      src.convertTo(src, CV_8U, src.depth() == CV_16U ? 1.0 / 256.0 : 1.0);
+
+   // Scale to the nominal size (for file sources, or drivers that did not
+   // honor the requested resolution) and bin in a single step
+   const cv::Size binnedSize(format.frameWidth / format.binning,
+      format.frameHeight / format.binning);
+   cv::Mat binned = src;
+   if (src.size() != binnedSize)
+      cv::resize(src, binned, binnedSize, 0, 0, cv::INTER_AREA);
+
+   // The ROI refers to the flipped image
+   cv::Rect roi(format.roiX, format.roiY, format.width, format.height);
+   if (format.xFlip)
+      roi.x = binnedSize.width - roi.x - roi.width;
+   if (format.yFlip)
+      roi.y = binnedSize.height - roi.y - roi.height;
+   if ((roi & cv::Rect(cv::Point(0, 0), binnedSize)) != roi)
+   {
+      out.setTo(cv::Scalar::all(0));
+      return;
+   }
+   const cv::Mat cropped = binned(roi);
+
+   const int channels = cropped.channels();
+   if (format.depth == 1)
+   {
+      if (channels == 1)
+         cropped.copyTo(out);
+      else
+         cv::cvtColor(cropped, out, channels == 4 ? cv::COLOR_BGRA2GRAY : cv::COLOR_BGR2GRAY);
+   }
+   else
+   {
+      if (channels == 4)
+         cropped.copyTo(out);
+      else
+         cv::cvtColor(cropped, out, channels == 1 ? cv::COLOR_GRAY2BGRA : cv::COLOR_BGR2BGRA);
+   }
+
+   if (format.xFlip && format.yFlip)
+      cv::flip(out, out, -1);
+   else if (format.xFlip)
+      cv::flip(out, out, 1);
+   else if (format.yFlip)
+      cv::flip(out, out, 0);
+}
+
+/**
+* Passes the current image settings to the grab thread. Must be called
+* whenever they change; frames converted with earlier settings are not
+* returned by SnapImage().
+*/
+void COpenCVgrabber::UpdateFrameFormat()
+{
+   std::lock_guard<std::mutex> lock(frameLock_);
+   format_.frameWidth = cameraCCDXSize_;
+   format_.frameHeight = cameraCCDYSize_;
+   format_.binning = binSize_;
+   format_.roiX = roiX_;
+   format_.roiY = roiY_;
+   format_.width = img_.Width();
+   format_.height = img_.Height();
+   format_.depth = img_.Depth();
+   format_.xFlip = xFlip_;
+   format_.yFlip = yFlip_;
+   ++formatGeneration_;
+}
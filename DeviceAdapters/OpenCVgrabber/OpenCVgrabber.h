@@ -40,12 +40,21 @@
 #include <string>
 #include <map>
 #include <algorithm>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
 
 #ifdef _MSC_VER
 #pragma warning(push)
 #pragma warning(disable: 4267)
 #endif
-#include "opencv/highgui.h"
+#include "opencv2/core/core.hpp"
+#include "opencv2/imgproc/imgproc.hpp"
+#include "opencv2/highgui/highgui.hpp"
+#if CV_MAJOR_VERSION >= 3
+#include "opencv2/videoio.hpp" // VideoCapture moved out of highgui
+#endif
 #ifdef _MSC_VER
 #pragma warning(pop)
 #endif
@@ -66,8 +75,6 @@
 // COpenCVgrabber class
 //////////////////////////////////////////////////////////////////////////////
 
-class MySequenceThread;
-
 class COpenCVgrabber : public CCameraBase<COpenCVgrabber>  
 {
 public:
@@ -104,10 +111,7 @@ public:
    int StartSequenceAcquisition(double interval);
    int StartSequenceAcquisition(long numImages, double interval_ms, bool stopOnOverflow);
    int StopSequenceAcquisition();
-   int InsertImage();
-   int ThreadRun();
    bool IsCapturing();
-   void OnThreadExiting() throw(); 
    double GetNominalPixelSizeUm() const {return nominalPixelSizeUm_;}
    double GetPixelSizeUm() const {return nominalPixelSizeUm_ * GetBinning();}
    int GetBinning() const;
@@ -120,6 +124,8 @@ public:
    // ----------------
 
 	int OnCameraID(MM::PropertyBase* pProp, MM::ActionType eAct);
+   int OnSource(MM::PropertyBase* pProp, MM::ActionType eAct);
+   int OnFPS(MM::PropertyBase* pProp, MM::ActionType eAct);
 	int OnGain(MM::PropertyBase* pProp, MM::ActionType eAct);
    int OnBinning(MM::PropertyBase* pProp, MM::ActionType eAct);
    int OnPixelType(MM::PropertyBase* pProp, MM::ActionType eAct);
@@ -135,19 +141,52 @@ public:
    int OnFlipX(MM::PropertyBase* pProp, MM::ActionType eAct);
    int OnFlipY(MM::PropertyBase* pProp, MM::ActionType eAct);
 private:
+   // Output format of the converted frames, as set by the properties
+   struct FrameFormat
+   {
+      long frameWidth;  // nominal size of the captured frames
+      long frameHeight;
+      long binning;
+      unsigned roiX;
+      unsigned roiY;
+      unsigned width;   // size of the converted image
+      unsigned height;
+      unsigned depth;   // bytes per pixel: 1 (gray) or 4 (BGRA)
+      bool xFlip;
+      bool yFlip;
+   };
+
+   // Converted frame in the ring filled by the grab thread
+   struct FrameSlot
+   {
+      ImgBuffer img;
+      FrameFormat format;
+      long long seq;
+      unsigned long generation; // of the format used for the conversion
+      MM::MMTime timestamp;
+      FrameSlot() : format(), seq(0), generation(0) {}
+   };
+
+   enum { ringSize = 4 };
+
    int SetAllowedBinning();
 
    void GenerateEmptyImage(ImgBuffer& img);
 
-   void RGB3toRGB4(const char* srcPixels, char* destPixels, int width, int height);
-
    int ResizeImageBuffer();
 
-   static const double nominalPixelSizeUm_;
-
+   int OpenCapture();
+   bool ReadFrame(cv::Mat& frame);
+   void StartGrabbing();
+   void StopGrabbing();
+   void GrabLoop();
+   void PublishFrame(const cv::Mat& frame);
+   static void ConvertFrame(const cv::Mat& frame, const FrameFormat& format, ImgBuffer& dest);
+   void UpdateFrameFormat();
+   void InsertSequenceFrame(const FrameSlot& slot);
+   int InsertImage(const FrameSlot& slot);
 
-   // CvCapture* capture_;
-   // IplImage* frame_; // do not modify, do not release!
+   static const double nominalPixelSizeUm_;
 
    long int cameraID_;
    ImgBuffer img_;
@@ -170,50 +209,36 @@ private:
    bool stopOnOverFlow_;
 
    MMThreadLock imgPixelsLock_;
-   
 
-   friend class MySequenceThread;
-   MySequenceThread * thd_;
+   std::string source_; // video file or image sequence; empty for a camera
+   bool isFileSource_;
+   double fps_;
+
+   // Used by the grab thread and by the property handlers. Mutable because
+   // VideoCapture::get() is not const in OpenCV 2.4.
+   mutable cv::VideoCapture capture_;
+   mutable std::mutex captureLock_;
+
+   // Ring of converted frames and the format they are converted to; written
+   // by the grab thread and the property handlers, guarded by frameLock_
+   std::mutex frameLock_;
+   std::condition_variable frameCond_;
+   std::vector<FrameSlot> ring_;
+   size_t newestSlot_;
+   long long frameSeq_;
+   FrameFormat format_;
+   unsigned long formatGeneration_;
+   bool stopGrabbing_;
+   std::thread grabThread_;
+
+   // Sequence acquisition state (along with sequenceStartTime_,
+   // imageCounter_ and stopOnOverFlow_), guarded by sequenceLock_
+   std::mutex sequenceLock_;
+   bool sequenceActive_;
+   long sequenceLength_;
+   double sequenceIntervalMs_;
+   FrameFormat sequenceFormat_;
+   MM::MMTime lastInsertTime_;
 };
 
-class MySequenceThread : public MMDeviceThreadBase
-{
-   friend class COpenCVgrabber;
-   enum { default_numImages=1, default_intervalMS = 100 };
-   public:
-      MySequenceThread(COpenCVgrabber* pCam);
-      ~MySequenceThread();
-      void Stop()/* {MMThreadGuard(this->stopLock_); stop_ = true;} */;
-      void Start(long numImages, double intervalMs);
-      bool IsStopped();
-      void Suspend();
-      bool IsSuspended();
-      void Resume();
-      double GetIntervalMs(){return intervalMs_;}                               
-      void SetLength(long images) {numImages_ = images;}                        
-      long GetLength() const {return numImages_;}
-      long GetImageCounter(){return imageCounter_;}                             
-      MM::MMTime GetStartTime(){return startTime_;}                             
-      MM::MMTime GetActualDuration(){return actualDuration_;}
-
-   private:                                                                     
-      int svc(void) throw();
-
-      double intervalMs_;                                                       
-      long numImages_;                                                          
-      long imageCounter_;                                                       
-      bool stop_;                                                               
-      bool suspend_;                                                            
-      COpenCVgrabber* camera_;   
-      MM::MMTime startTime_;                                                    
-      MM::MMTime actualDuration_;                                               
-      MM::MMTime lastFrameTime_;                                                
-
-      MMThreadLock stopLock_;                                                   
-      MMThreadLock suspendLock_;                                                
-}; 
-
-
-
-
 #endif //_DEMOCAMERA_H_
@@ -0,0 +1,166 @@
+///////////////////////////////////////////////////////////////////////////////
+// FILE:          OpenCVgrabber-Tests.cpp
+// PROJECT:       Micro-Manager
+// SUBSYSTEM:     DeviceAdapters
+//-----------------------------------------------------------------------------
+// DESCRIPTION:   Tests of the OpenCVgrabber adapter with a video file source
+//
+// LICENSE:       This file is distributed under the BSD license.
+//                License text is included with the source distribution.
+//
+//                This file is distributed in the hope that it will be useful,
+//                but WITHOUT ANY WARRANTY; without even the implied warranty
+//                of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+//
+//                IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+//                CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+//                INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES.
+
+#include <gtest/gtest.h>
+
+#include "OpenCVgrabber.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <set>
+#include <string>
+
+
+namespace {
+
+const int frameWidth = 64;
+const int frameHeight = 48;
+const int grayLevels[] = { 40, 100, 160, 220 };
+const int numFrames = sizeof(grayLevels) / sizeof(grayLevels[0]);
+const int tolerance = 8; // MJPEG is lossy
+
+// The gray level that a mean pixel value stands for, or -1
+int MatchGrayLevel(double mean)
+{
+   for (int i = 0; i < numFrames; ++i)
+   {
+      if (mean > grayLevels[i] - tolerance && mean < grayLevels[i] + tolerance)
+         return grayLevels[i];
+   }
+   return -1;
+}
+
+// Mean of the given byte of each pixel
+double MeanOfComponent(const unsigned char* pixels, unsigned numPixels,
+   unsigned bytesPerPixel, unsigned component)
+{
+   double sum = 0.0;
+   for (unsigned i = 0; i < numPixels; ++i)
+      sum += pixels[i * bytesPerPixel + component];
+   return sum / numPixels;
+}
+
+} // anonymous namespace
+
+
+// A short Motion JPEG video of uniformly gray frames, written with OpenCV's
+// built-in AVI writer, so that no codec library or camera is needed.
+class OpenCVgrabberTest : public ::testing::Test
+{
+protected:
+   std::string videoFile_;
+
+   virtual void SetUp()
+   {
+      const char* dir = std::getenv("TMPDIR");
+      videoFile_ = std::string(dir && *dir ? dir : "/tmp") +
+         "/OpenCVgrabber-Tests.avi";
+
+      cv::VideoWriter writer(videoFile_,
+         cv::VideoWriter::fourcc('M', 'J', 'P', 'G'), 30.0,
+         cv::Size(frameWidth, frameHeight), true);
+      ASSERT_TRUE(writer.isOpened());
+      for (int i = 0; i < numFrames; ++i)
+      {
+         const int v = grayLevels[i];
+         writer.write(cv::Mat(frameHeight, frameWidth, CV_8UC3,
+            cv::Scalar(v, v, v)));
+      }
+   }
+
+   virtual void TearDown()
+   {
+      std::remove(videoFile_.c_str());
+   }
+
+   int Initialize(COpenCVgrabber& camera)
+   {
+      camera.SetProperty("Source", videoFile_.c_str());
+      return camera.Initialize();
+   }
+};
+
+
+TEST_F(OpenCVgrabberTest, FrameSizeIsTakenFromTheVideo)
+{
+   COpenCVgrabber camera;
+   ASSERT_EQ(DEVICE_OK, Initialize(camera));
+   ASSERT_EQ(DEVICE_OK, camera.SnapImage());
+   EXPECT_EQ(unsigned(frameWidth), camera.GetImageWidth());
+   EXPECT_EQ(unsigned(frameHeight), camera.GetImageHeight());
+   EXPECT_EQ(4u, camera.GetImageBytesPerPixel());
+}
+
+TEST_F(OpenCVgrabberTest, SnapsReturnFramesOfTheLoopedVideo)
+{
+   COpenCVgrabber camera;
+   ASSERT_EQ(DEVICE_OK, Initialize(camera));
+
+   const unsigned numPixels = frameWidth * frameHeight;
+   std::set<int> seen;
+   for (int i = 0; i < 3 * numFrames; ++i)
+   {
+      ASSERT_EQ(DEVICE_OK, camera.SnapImage());
+      const unsigned char* pixels = camera.GetImageBuffer();
+      ASSERT_TRUE(pixels != NULL);
+      // BGRA
+      const int level = MatchGrayLevel(MeanOfComponent(pixels, numPixels, 4, 0));
+      EXPECT_NE(-1, level);
+      EXPECT_EQ(level, MatchGrayLevel(MeanOfComponent(pixels, numPixels, 4, 2)));
+      seen.insert(level);
+   }
+   // Each snap waits for new frames, and the video keeps playing
+   EXPECT_GE(seen.size(), 2u);
+}
+
+TEST_F(OpenCVgrabberTest, EightBitFramesAreGray)
+{
+   COpenCVgrabber camera;
+   ASSERT_EQ(DEVICE_OK, Initialize(camera));
+   ASSERT_EQ(DEVICE_OK, camera.SetProperty(MM::g_Keyword_PixelType, "8bit"));
+
+   ASSERT_EQ(DEVICE_OK, camera.SnapImage());
+   ASSERT_EQ(1u, camera.GetImageBytesPerPixel());
+   const unsigned numPixels = camera.GetImageWidth() * camera.GetImageHeight();
+   EXPECT_NE(-1, MatchGrayLevel(
+      MeanOfComponent(camera.GetImageBuffer(), numPixels, 1, 0)));
+}
+
+TEST_F(OpenCVgrabberTest, SnapsAreCroppedToTheROI)
+{
+   COpenCVgrabber camera;
+   ASSERT_EQ(DEVICE_OK, Initialize(camera));
+   ASSERT_EQ(DEVICE_OK, camera.SetROI(8, 4, 16, 10));
+
+   ASSERT_EQ(DEVICE_OK, camera.SnapImage());
+   EXPECT_EQ(16u, camera.GetImageWidth());
+   EXPECT_EQ(10u, camera.GetImageHeight());
+   EXPECT_NE(-1, MatchGrayLevel(
+      MeanOfComponent(camera.GetImageBuffer(), 16 * 10, 4, 1)));
+
+   ASSERT_EQ(DEVICE_OK, camera.ClearROI());
+   ASSERT_EQ(DEVICE_OK, camera.SnapImage());
+   EXPECT_EQ(unsigned(frameWidth), camera.GetImageWidth());
+}
+
+TEST_F(OpenCVgrabberTest, MissingSourceFailsToInitialize)
+{
+   COpenCVgrabber camera;
+   camera.SetProperty("Source", (videoFile_ + ".missing").c_str());
+   EXPECT_EQ(DEVICE_NOT_CONNECTED, camera.Initialize());
+}
@@ -2020,7 +2020,7 @@ int Universal::PrepareSequenceAcqusition()
         int ret = (this->*resizeImageBufferFn)();
         if (ret != DEVICE_OK)
             return ret;
-        GetCoreCallback()->InitializeImageBuffer(1, 1, GetImageWidth(), GetImageHeight(), GetImageBytesPerPixel());
+        GetCoreCallback()->InitializeImageBuffer(this, 1, 1, GetImageWidth(), GetImageHeight(), GetImageBytesPerPixel());
         modeReadyFlag = true;
         callPrepareForAcq_ = true;
     }
@@ -7117,7 +7117,7 @@ int Universal::applyAcqConfig(bool forceSetup)
             return nRet;
         }
 
-        GetCoreCallback()->InitializeImageBuffer(1, 1, GetImageWidth(), GetImageHeight(), GetImageBytesPerPixel());
+        GetCoreCallback()->InitializeImageBuffer(this, 1, 1, GetImageWidth(), GetImageHeight(), GetImageBytesPerPixel());
         callPrepareForAcq_ = true;
     }
 
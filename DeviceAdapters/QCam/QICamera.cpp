@@ -4219,7 +4219,7 @@ int QICamera::ResizeImageBuffer()
    }
 
    // make sure the circular buffer is properly sized
-   GetCoreCallback()->InitializeImageBuffer(1, 1, m_imageWidth, m_imageHeight, GetImageBytesPerPixel());
+   GetCoreCallback()->InitializeImageBuffer(this, 1, 1, m_imageWidth, m_imageHeight, GetImageBytesPerPixel());
 
    return DEVICE_OK;
 }
@@ -440,7 +440,7 @@ if (ret != DEVICE_OK)
 	{return ret;}
 
 // make sure the circular buffer is properly sized
-GetCoreCallback()->InitializeImageBuffer(1, 1, GetImageWidth(), 
+GetCoreCallback()->InitializeImageBuffer(this, 1, 1, GetImageWidth(), 
 							GetImageHeight(), GetImageBytesPerPixel());
 
 stopOnOverflow_ = stopOnOverflow;
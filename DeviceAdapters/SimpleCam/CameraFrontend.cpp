@@ -1718,7 +1718,7 @@ int CCameraFrontend::LoadImage(fipImage frameBitmap)
             numberOfComponents = 1;
          else
             numberOfComponents = 4;
-         GetCoreCallback()->InitializeImageBuffer(numberOfComponents, 1, frameBitmap.getWidth(), frameBitmap.getHeight(), bytesPerPixel);
+         GetCoreCallback()->InitializeImageBuffer(this, numberOfComponents, 1, frameBitmap.getWidth(), frameBitmap.getHeight(), bytesPerPixel);
       }
 
       /* Micro-manager expects 16-bit color images as 64bpp bgra. Convert 48bpp rgb to 64bpp bgra. */
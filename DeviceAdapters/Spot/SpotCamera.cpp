@@ -1641,7 +1641,7 @@ int SpotCamera::ResizeImageBuffer(int , int)
 	if (!IsCapturing())
 	{
 	 // make sure the circular buffer is properly sized => use 2 Buffers
-	 GetCoreCallback()->InitializeImageBuffer(GetNumberOfComponents(), SPOTCAM_CIRCULAR_BUFFER_IMG_COUNT, GetImageWidth(), GetImageHeight(), GetImageBytesPerPixel());
+	 GetCoreCallback()->InitializeImageBuffer(this, GetNumberOfComponents(), SPOTCAM_CIRCULAR_BUFFER_IMG_COUNT, GetImageWidth(), GetImageHeight(), GetImageBytesPerPixel());
 	}
 
 	return DEVICE_OK;
@@ -0,0 +1,1080 @@
+///////////////////////////////////////////////////////////////////////////////
+// FILE:          TraceReplay.cpp
+// PROJECT:       Micro-Manager
+// SUBSYSTEM:     DeviceAdapters
+//-----------------------------------------------------------------------------
+// DESCRIPTION:   Devices that replay a trace of device calls recorded by the
+//                Core (CMMCore::startDeviceTraceRecording()), responding with
+//                the recorded results, images and latencies.
+//
+// LICENSE:       This file is distributed under the BSD license.
+//                License text is included with the source distribution.
+//
+//                This file is distributed in the hope that it will be useful,
+//                but WITHOUT ANY WARRANTY; without even the implied warranty
+//                of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+//
+//                IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+//                CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+//                INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES.
+
+#include "TraceReplay.h"
+
+#include "ModuleInterface.h"
+
+#include <algorithm>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+
+const char* g_Keyword_TraceFile = "TraceFile";
+const char* g_Keyword_RecordedLabel = "RecordedLabel";
+
+const char* g_CameraDeviceName = "TRCamera";
+const char* g_StageDeviceName = "TRStage";
+const char* g_XYStageDeviceName = "TRXYStage";
+const char* g_ShutterDeviceName = "TRShutter";
+const char* g_StateDeviceName = "TRState";
+const char* g_GenericDeviceName = "TRGeneric";
+
+const char* const g_TraceHeader = "# Micro-Manager device trace 1";
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Exported MMDevice API
+///////////////////////////////////////////////////////////////////////////////
+
+MODULE_API void InitializeModuleData()
+{
+   RegisterDevice(g_CameraDeviceName, MM::CameraDevice, "Replayed camera");
+   RegisterDevice(g_StageDeviceName, MM::StageDevice, "Replayed stage");
+   RegisterDevice(g_XYStageDeviceName, MM::XYStageDevice, "Replayed XY stage");
+   RegisterDevice(g_ShutterDeviceName, MM::ShutterDevice, "Replayed shutter");
+   RegisterDevice(g_StateDeviceName, MM::StateDevice, "Replayed state device");
+   RegisterDevice(g_GenericDeviceName, MM::GenericDevice, "Replayed generic device");
+}
+
+MODULE_API MM::Device* CreateDevice(const char* deviceName)
+{
+   if (deviceName == 0)
+      return 0;
+
+   if (strcmp(deviceName, g_CameraDeviceName) == 0)
+      return new TRCamera();
+   else if (strcmp(deviceName, g_StageDeviceName) == 0)
+      return new TRStage();
+   else if (strcmp(deviceName, g_XYStageDeviceName) == 0)
+      return new TRXYStage();
+   else if (strcmp(deviceName, g_ShutterDeviceName) == 0)
+      return new TRShutter();
+   else if (strcmp(deviceName, g_StateDeviceName) == 0)
+      return new TRState();
+   else if (strcmp(deviceName, g_GenericDeviceName) == 0)
+      return new TRGeneric();
+
+   return 0;
+}
+
+MODULE_API void DeleteDevice(MM::Device* pDevice)
+{
+   delete pDevice;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// TracePlayer
+///////////////////////////////////////////////////////////////////////////////
+
+namespace
+{
+
+std::vector<std::string> SplitFields(const std::string& line)
+{
+   std::vector<std::string> fields;
+   std::istringstream ss(line);
+   std::string field;
+   while (std::getline(ss, field, '\t'))
+      fields.push_back(field);
+   if (!line.empty() && line.back() == '\t')
+      fields.push_back(std::string());
+   return fields;
+}
+
+bool ChangesState(const std::string& function)
+{
+   return function != "Busy" && function.compare(0, 3, "Get") != 0;
+}
+
+bool StartsSequence(const std::string& function)
+{
+   return function == "StartSequenceAcquisition" ||
+      function == "StartContinuousSequenceAcquisition";
+}
+
+TraceImage ParseImage(const std::vector<std::string>& fields, size_t first)
+{
+   TraceImage image;
+   image.width = static_cast<unsigned>(std::strtoul(fields[first].c_str(), 0, 10));
+   image.height = static_cast<unsigned>(std::strtoul(fields[first + 1].c_str(), 0, 10));
+   image.bytesPerPixel = static_cast<unsigned>(std::strtoul(fields[first + 2].c_str(), 0, 10));
+   image.components = static_cast<unsigned>(std::strtoul(fields[first + 3].c_str(), 0, 10));
+   image.offset = std::strtoll(fields[first + 4].c_str(), 0, 10);
+   image.size = std::strtoll(fields[first + 5].c_str(), 0, 10);
+   return image;
+}
+
+} // anonymous namespace
+
+
+TracePlayer::TracePlayer() :
+   busyDuration_(0)
+{
+}
+
+
+int TracePlayer::Load(const std::string& filename, const std::string& label)
+{
+   std::ifstream file(filename.c_str());
+   if (!file)
+      return ERR_CANNOT_READ_TRACE;
+
+   std::string line;
+   if (!std::getline(file, line) || line.compare(0, strlen(g_TraceHeader), g_TraceHeader) != 0)
+      return ERR_INVALID_TRACE;
+
+   bool deviceFound = false;
+   long long busyTotal = 0;
+   long long busyCount = 0;
+   while (std::getline(file, line))
+   {
+      if (!line.empty() && line.back() == '\r')
+         line.pop_back();
+      if (line.empty() || line[0] == '#')
+         continue;
+
+      std::vector<std::string> fields = SplitFields(line);
+      const std::string& type = fields[0];
+      if (type == "Device" && fields.size() == 5)
+      {
+         if (fields[1] != label)
+            continue;
+         deviceFound = true;
+         adapter_ = fields[2];
+         name_ = fields[3];
+      }
+      else if (type == "Property" && fields.size() == 5)
+      {
+         if (fields[1] != label)
+            continue;
+         TraceProperty prop;
+         prop.name = fields[2];
+         prop.value = fields[3];
+         prop.readOnly = (fields[4] == "1");
+         properties_.push_back(prop);
+      }
+      else if (type == "PositionLabel" && fields.size() == 4)
+      {
+         if (fields[1] != label)
+            continue;
+         positionLabels_[std::atol(fields[2].c_str())] = fields[3];
+      }
+      else if ((type == "Call" && fields.size() == 8) ||
+            (type == "Image" && fields.size() == 13))
+      {
+         if (fields[3] != label)
+            continue;
+         TraceCall call;
+         call.time = std::strtoll(fields[1].c_str(), 0, 10);
+         call.duration = std::strtoll(fields[2].c_str(), 0, 10);
+         call.function = fields[4];
+         call.ret = std::atoi(fields[5].c_str());
+         call.arg = fields[6];
+         if (type == "Call")
+         {
+            call.result = fields[7];
+         }
+         else
+         {
+            call.image = ParseImage(fields, 7);
+            call.image.time = call.time;
+         }
+         if (call.function == "Busy")
+         {
+            busyTotal += call.duration;
+            ++busyCount;
+         }
+         if (StartsSequence(call.function))
+            sequenceStarts_.push_back(call.time);
+         calls_.push_back(call);
+      }
+      else if (type == "Frame" && fields.size() == 9)
+      {
+         if (fields[2] != label)
+            continue;
+         TraceImage frame = ParseImage(fields, 3);
+         frame.time = std::strtoll(fields[1].c_str(), 0, 10);
+         frames_.push_back(frame);
+      }
+      else
+      {
+         return ERR_INVALID_TRACE;
+      }
+   }
+   if (!deviceFound)
+      return ERR_LABEL_NOT_IN_TRACE;
+
+   if (busyCount > 0)
+      busyDuration_ = busyTotal / busyCount;
+   ComputeBusyPeriods();
+
+   for (size_t i = 0; i < calls_.size(); ++i)
+   {
+      cursors_[calls_[i].function + '\t' + calls_[i].arg].indices.push_back(i);
+      cursors_[calls_[i].function].indices.push_back(i);
+   }
+
+   pixelFile_.open((filename + ".pixels").c_str(), std::ios::binary);
+   return DEVICE_OK;
+}
+
+
+// Only the first Busy() call after a state-changing call, and the first one
+// to return false after that, are recorded; the busy period ends with the
+// latter.
+void TracePlayer::ComputeBusyPeriods()
+{
+   for (size_t i = 0; i < calls_.size(); ++i)
+   {
+      if (!ChangesState(calls_[i].function))
+         continue;
+      const long long end = calls_[i].time + calls_[i].duration;
+      for (size_t j = i + 1; j < calls_.size(); ++j)
+      {
+         if (ChangesState(calls_[j].function))
+            break;
+         if (calls_[j].function == "Busy" && calls_[j].result == "0")
+         {
+            calls_[i].busy = std::max(0LL, calls_[j].time + calls_[j].duration - end);
+            break;
+         }
+      }
+   }
+}
+
+
+const TracePlayer::Cursor* TracePlayer::FindCursor(const std::string& function,
+      const std::string& arg) const
+{
+   std::map<std::string, Cursor>::const_iterator it = cursors_.find(function + '\t' + arg);
+   if (it == cursors_.end())
+      it = cursors_.find(function);
+   if (it == cursors_.end())
+      return 0;
+   return &it->second;
+}
+
+
+bool TracePlayer::Next(const std::string& function, const std::string& arg,
+      TraceCall& call)
+{
+   std::lock_guard<std::mutex> lock(mutex_);
+   Cursor* cursor = const_cast<Cursor*>(FindCursor(function, arg));
+   if (!cursor)
+      return false;
+   call = calls_[cursor->indices[cursor->next]];
+   if (cursor->next + 1 < cursor->indices.size())
+      ++cursor->next;
+   return true;
+}
+
+
+bool TracePlayer::Peek(const std::string& function, const std::string& arg,
+      TraceCall& call) const
+{
+   std::lock_guard<std::mutex> lock(mutex_);
+   const Cursor* cursor = FindCursor(function, arg);
+   if (!cursor)
+      return false;
+   call = calls_[cursor->indices[cursor->next]];
+   return true;
+}
+
+
+int TracePlayer::Play(const TraceCall& call)
+{
+   if (call.duration > 0)
+      std::this_thread::sleep_for(std::chrono::microseconds(call.duration));
+   if (call.busy > 0)
+   {
+      std::lock_guard<std::mutex> lock(mutex_);
+      busyUntil_ = std::chrono::steady_clock::now() +
+         std::chrono::microseconds(call.busy);
+   }
+   return call.ret;
+}
+
+
+int TracePlayer::Replay(const std::string& function, const std::string& arg,
+      std::string* result)
+{
+   TraceCall call;
+   if (!Next(function, arg, call))
+      return DEVICE_OK;
+   if (result)
+      *result = call.result;
+   return Play(call);
+}
+
+
+bool TracePlayer::Busy()
+{
+   if (busyDuration_ > 0)
+      std::this_thread::sleep_for(std::chrono::microseconds(busyDuration_));
+   std::lock_guard<std::mutex> lock(mutex_);
+   return std::chrono::steady_clock::now() < busyUntil_;
+}
+
+
+bool TracePlayer::GetFirstImage(TraceImage& image) const
+{
+   for (std::vector<TraceCall>::const_iterator it = calls_.begin(),
+         end = calls_.end(); it != end; ++it)
+   {
+      if (it->image.size > 0)
+      {
+         image = it->image;
+         return true;
+      }
+   }
+   if (frames_.empty())
+      return false;
+   image = frames_.front();
+   return true;
+}
+
+
+std::vector<TraceImage> TracePlayer::GetFrames(const TraceCall& sequenceStart) const
+{
+   long long end = LLONG_MAX;
+   std::vector<long long>::const_iterator next = std::upper_bound(
+         sequenceStarts_.begin(), sequenceStarts_.end(), sequenceStart.time);
+   if (next != sequenceStarts_.end())
+      end = *next;
+
+   std::vector<TraceImage> frames;
+   for (std::vector<TraceImage>::const_iterator it = frames_.begin(),
+         itEnd = frames_.end(); it != itEnd; ++it)
+   {
+      if (it->time >= sequenceStart.time && it->time < end)
+         frames.push_back(*it);
+   }
+   return frames;
+}
+
+
+int TracePlayer::ReadPixels(const TraceImage& image,
+      std::vector<unsigned char>& pixels)
+{
+   if (image.offset < 0 || image.size <= 0)
+      return ERR_NO_RECORDED_IMAGE;
+
+   std::lock_guard<std::mutex> lock(pixelMutex_);
+   pixels.resize(static_cast<size_t>(image.size));
+   pixelFile_.clear();
+   pixelFile_.seekg(image.offset);
+   pixelFile_.read(reinterpret_cast<char*>(pixels.data()), image.size);
+   if (!pixelFile_)
+      return ERR_CANNOT_READ_PIXELS;
+   return DEVICE_OK;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// TraceReplayDevice
+///////////////////////////////////////////////////////////////////////////////
+
+template <class TBase, class TDevice>
+TraceReplayDevice<TBase, TDevice>::TraceReplayDevice(const char* description)
+{
+   this->InitializeDefaultErrorMessages();
+   this->SetErrorText(ERR_CANNOT_READ_TRACE, "Cannot open the trace file");
+   this->SetErrorText(ERR_INVALID_TRACE, "The trace file is not a valid device trace");
+   this->SetErrorText(ERR_LABEL_NOT_IN_TRACE, "The recorded device label is not in the trace");
+   this->SetErrorText(ERR_CANNOT_READ_PIXELS, "Cannot read the recorded image from the trace pixel file");
+   this->SetErrorText(ERR_NO_RECORDED_IMAGE, "The trace does not contain a recorded image for this call");
+
+   this->CreateProperty(MM::g_Keyword_Description, description, MM::String, true);
+   this->CreateProperty(g_Keyword_TraceFile, "", MM::String, false, 0, true);
+   this->CreateProperty(g_Keyword_RecordedLabel, "", MM::String, false, 0, true);
+}
+
+
+template <class TBase, class TDevice>
+int TraceReplayDevice<TBase, TDevice>::LoadTrace()
+{
+   char buf[MM::MaxStrLength];
+   this->GetProperty(g_Keyword_TraceFile, buf);
+   traceFile_ = buf;
+   this->GetProperty(g_Keyword_RecordedLabel, buf);
+   recordedLabel_ = buf;
+
+   int ret = player_.Load(traceFile_, recordedLabel_);
+   if (ret != DEVICE_OK)
+      return ret;
+
+   const std::vector<TraceProperty>& props = player_.GetProperties();
+   for (std::vector<TraceProperty>::const_iterator it = props.begin(),
+         end = props.end(); it != end; ++it)
+   {
+      if (this->HasProperty(it->name.c_str()))
+         continue;
+      recordedValues_[it->name] = it->value;
+      typename TBase::CPropertyActionEx* pAct =
+         new typename TBase::CPropertyActionEx(static_cast<TDevice*>(this),
+               &TraceReplayDevice::OnRecordedProperty,
+               static_cast<long>(recordedNames_.size()));
+      recordedNames_.push_back(it->name);
+      ret = this->CreateProperty(it->name.c_str(), it->value.c_str(),
+            MM::String, it->readOnly, pAct);
+      if (ret != DEVICE_OK)
+         return ret;
+   }
+   return DEVICE_OK;
+}
+
+
+template <class TBase, class TDevice>
+std::string TraceReplayDevice<TBase, TDevice>::GetRecordedValue(
+      const std::string& name) const
+{
+   std::map<std::string, std::string>::const_iterator it = recordedValues_.find(name);
+   if (it == recordedValues_.end())
+      return std::string();
+   return it->second;
+}
+
+
+template <class TBase, class TDevice>
+int TraceReplayDevice<TBase, TDevice>::OnRecordedProperty(MM::PropertyBase* pProp,
+      MM::ActionType eAct, long index)
+{
+   const std::string& name = recordedNames_[index];
+   if (eAct == MM::BeforeGet)
+   {
+      TraceCall call;
+      if (player_.Next("GetProperty", name, call))
+      {
+         int ret = player_.Play(call);
+         if (ret != DEVICE_OK)
+            return ret;
+         recordedValues_[name] = call.result;
+         pProp->Set(call.result.c_str());
+      }
+   }
+   else if (eAct == MM::AfterSet)
+   {
+      std::string value;
+      pProp->Get(value);
+      int ret = player_.Replay("SetProperty", name);
+      if (ret != DEVICE_OK)
+         return ret;
+      recordedValues_[name] = value;
+   }
+   return DEVICE_OK;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// TRCamera
+///////////////////////////////////////////////////////////////////////////////
+
+TRCamera::TRCamera() :
+   TraceReplayDevice<CCameraBase<TRCamera>, TRCamera>("Camera replaying a device trace"),
+   exposureMs_(10.0),
+   capturing_(false),
+   stopRequested_(false)
+{
+}
+
+
+TRCamera::~TRCamera()
+{
+   JoinReplayThread();
+}
+
+
+void TRCamera::GetName(char* name) const
+{
+   CDeviceUtils::CopyLimitedString(name, g_CameraDeviceName);
+}
+
+
+int TRCamera::Initialize()
+{
+   int ret = LoadTrace();
+   if (ret != DEVICE_OK)
+      return ret;
+
+   if (!HasProperty(MM::g_Keyword_Binning))
+   {
+      ret = CreateIntegerProperty(MM::g_Keyword_Binning, 1, true);
+      if (ret != DEVICE_OK)
+         return ret;
+   }
+
+   const std::string exposure = GetRecordedValue(MM::g_Keyword_Exposure);
+   if (!exposure.empty())
+      exposureMs_ = std::atof(exposure.c_str());
+
+   if (!player_.GetFirstImage(image_))
+   {
+      image_.width = 1;
+      image_.height = 1;
+   }
+   pixels_.assign(static_cast<size_t>(GetImageBufferSize()), 0);
+   return DEVICE_OK;
+}
+
+
+int TRCamera::Shutdown()
+{
+   StopSequenceAcquisition();
+   return DEVICE_OK;
+}
+
+
+int TRCamera::SnapImage()
+{
+   int ret = player_.Replay("SnapImage", "");
+   if (ret != DEVICE_OK)
+      return ret;
+
+   // The Core asks for the image size before getting the image, so the next
+   // recorded image is loaded now.
+   TraceCall next;
+   if (player_.Peek("GetImageBuffer", "", next) && next.image.size > 0)
+   {
+      ret = player_.ReadPixels(next.image, pixels_);
+      if (ret != DEVICE_OK)
+         return ret;
+      image_ = next.image;
+   }
+   return DEVICE_OK;
+}
+
+
+const unsigned char* TRCamera::GetImageBuffer()
+{
+   TraceCall call;
+   if (player_.Next("GetImageBuffer", "", call))
+   {
+      player_.Play(call);
+      if (call.ret != DEVICE_OK)
+         return 0;
+   }
+   return pixels_.data();
+}
+
+
+unsigned TRCamera::GetBitDepth() const
+{
+   if (image_.components > 1)
+      return 8;
+   return 8 * image_.bytesPerPixel;
+}
+
+
+long TRCamera::GetImageBufferSize() const
+{
+   return static_cast<long>(image_.width) * image_.height * image_.bytesPerPixel;
+}
+
+
+double TRCamera::GetExposure() const
+{
+   std::string result;
+   if (player_.Replay("GetExposure", "", &result) == DEVICE_OK && !result.empty())
+      return std::atof(result.c_str());
+   return exposureMs_;
+}
+
+
+void TRCamera::SetExposure(double exp_ms)
+{
+   player_.Replay("SetExposure", std::to_string(exp_ms));
+   exposureMs_ = exp_ms;
+}
+
+
+int TRCamera::GetROI(unsigned& x, unsigned& y, unsigned& xSize, unsigned& ySize)
+{
+   x = 0;
+   y = 0;
+   xSize = image_.width;
+   ySize = image_.height;
+   return DEVICE_OK;
+}
+
+
+int TRCamera::GetBinning() const
+{
+   const std::string binning = GetRecordedValue(MM::g_Keyword_Binning);
+   return binning.empty() ? 1 : std::atoi(binning.c_str());
+}
+
+
+int TRCamera::SetBinning(int binSize)
+{
+   return SetProperty(MM::g_Keyword_Binning, CDeviceUtils::ConvertToString(binSize));
+}
+
+
+int TRCamera::StartSequenceAcquisition(long numImages, double interval_ms,
+      bool stopOnOverflow)
+{
+   TraceCall call;
+   player_.Next("StartSequenceAcquisition", std::to_string(numImages) + " " +
+         std::to_string(interval_ms) + " " + (stopOnOverflow ? "1" : "0"), call);
+   return StartReplayThread(call, numImages, stopOnOverflow);
+}
+
+
+int TRCamera::StartSequenceAcquisition(double interval_ms)
+{
+   TraceCall call;
+   player_.Next("StartContinuousSequenceAcquisition", std::to_string(interval_ms), call);
+   return StartReplayThread(call, LONG_MAX, false);
+}
+
+
+int TRCamera::StartReplayThread(const TraceCall& start, long numImages,
+      bool stopOnOverflow)
+{
+   if (capturing_)
+      return DEVICE_CAMERA_BUSY_ACQUIRING;
+   JoinReplayThread();
+
+   int ret = player_.Play(start);
+   if (ret != DEVICE_OK)
+      return ret;
+   ret = GetCoreCallback()->PrepareForAcq(this);
+   if (ret != DEVICE_OK)
+      return ret;
+
+   stopRequested_ = false;
+   capturing_ = true;
+   thread_ = std::thread(&TRCamera::ReplayFrames, this,
+         player_.GetFrames(start), start.time + start.duration, numImages,
+         stopOnOverflow);
+   return DEVICE_OK;
+}
+
+
+// Inserts the recorded frames with the recorded delays after the start of
+// sequence acquisition.
+void TRCamera::ReplayFrames(std::vector<TraceImage> frames, long long startTime,
+      long numImages, bool stopOnOverflow)
+{
+   const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+   const std::string serializedMd = Metadata().Serialize();
+   std::vector<unsigned char> pixels;
+   long count = 0;
+   for (std::vector<TraceImage>::const_iterator it = frames.begin(),
+         end = frames.end(); it != end && count < numImages; ++it, ++count)
+   {
+      const std::chrono::steady_clock::time_point due = start +
+         std::chrono::microseconds(std::max(0LL, it->time - startTime));
+      while (!stopRequested_ && std::chrono::steady_clock::now() < due)
+      {
+         std::this_thread::sleep_for(std::min<std::chrono::steady_clock::duration>(
+                  due - std::chrono::steady_clock::now(), std::chrono::milliseconds(5)));
+      }
+      if (stopRequested_)
+         break;
+
+      if (player_.ReadPixels(*it, pixels) != DEVICE_OK)
+         break;
+      int ret = GetCoreCallback()->InsertImage(this, pixels.data(), it->width,
+            it->height, it->bytesPerPixel, it->components, serializedMd.c_str());
+      if (ret == DEVICE_BUFFER_OVERFLOW)
+      {
+         if (stopOnOverflow)
+            break;
+         GetCoreCallback()->ClearImageBuffer(this);
+      }
+      else if (ret != DEVICE_OK)
+      {
+         break;
+      }
+   }
+   capturing_ = false;
+   GetCoreCallback()->AcqFinished(this, 0);
+}
+
+
+int TRCamera::StopSequenceAcquisition()
+{
+   if (!thread_.joinable())
+      return DEVICE_OK;
+   JoinReplayThread();
+   return player_.Replay("StopSequenceAcquisition", "");
+}
+
+
+void TRCamera::JoinReplayThread()
+{
+   stopRequested_ = true;
+   if (thread_.joinable())
+      thread_.join();
+   capturing_ = false;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// TRStage
+///////////////////////////////////////////////////////////////////////////////
+
+const double TRStage::stepSizeUm_ = 0.1;
+
+TRStage::TRStage() :
+   TraceReplayDevice<CStageBase<TRStage>, TRStage>("Stage replaying a device trace"),
+   posUm_(0.0)
+{
+}
+
+
+void TRStage::GetName(char* name) const
+{
+   CDeviceUtils::CopyLimitedString(name, g_StageDeviceName);
+}
+
+
+int TRStage::Initialize()
+{
+   int ret = LoadTrace();
+   if (ret != DEVICE_OK)
+      return ret;
+
+   TraceCall call;
+   if (player_.Peek("GetPositionUm", "", call))
+      posUm_ = std::atof(call.result.c_str());
+   return DEVICE_OK;
+}
+
+
+int TRStage::SetPositionUm(double pos)
+{
+   int ret = player_.Replay("SetPositionUm", std::to_string(pos));
+   if (ret != DEVICE_OK)
+      return ret;
+   posUm_ = pos;
+   return DEVICE_OK;
+}
+
+
+int TRStage::SetRelativePositionUm(double d)
+{
+   int ret = player_.Replay("SetRelativePositionUm", std::to_string(d));
+   if (ret != DEVICE_OK)
+      return ret;
+   posUm_ += d;
+   return DEVICE_OK;
+}
+
+
+int TRStage::GetPositionUm(double& pos)
+{
+   std::string result;
+   int ret = player_.Replay("GetPositionUm", "", &result);
+   if (ret != DEVICE_OK)
+      return ret;
+   if (!result.empty())
+      posUm_ = std::atof(result.c_str());
+   pos = posUm_;
+   return DEVICE_OK;
+}
+
+
+int TRStage::GetPositionSteps(long& steps)
+{
+   double pos;
+   int ret = GetPositionUm(pos);
+   if (ret != DEVICE_OK)
+      return ret;
+   steps = static_cast<long>(pos / stepSizeUm_);
+   return DEVICE_OK;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// TRXYStage
+///////////////////////////////////////////////////////////////////////////////
+
+const double TRXYStage::stepSizeUm_ = 0.1;
+
+TRXYStage::TRXYStage() :
+   TraceReplayDevice<CXYStageBase<TRXYStage>, TRXYStage>("XY stage replaying a device trace"),
+   xUm_(0.0),
+   yUm_(0.0)
+{
+}
+
+
+void TRXYStage::GetName(char* name) const
+{
+   CDeviceUtils::CopyLimitedString(name, g_XYStageDeviceName);
+}
+
+
+int TRXYStage::Initialize()
+{
+   int ret = LoadTrace();
+   if (ret != DEVICE_OK)
+      return ret;
+
+   TraceCall call;
+   if (player_.Peek("GetPositionUm", "", call))
+   {
+      std::istringstream ss(call.result);
+      ss >> xUm_ >> yUm_;
+   }
+   return DEVICE_OK;
+}
+
+
+int TRXYStage::SetPositionUm(double x, double y)
+{
+   int ret = player_.Replay("SetPositionUm",
+         std::to_string(x) + " " + std::to_string(y));
+   if (ret != DEVICE_OK)
+      return ret;
+   xUm_ = x;
+   yUm_ = y;
+   return DEVICE_OK;
+}
+
+
+int TRXYStage::SetRelativePositionUm(double dx, double dy)
+{
+   int ret = player_.Replay("SetRelativePositionUm",
+         std::to_string(dx) + " " + std::to_string(dy));
+   if (ret != DEVICE_OK)
+      return ret;
+   xUm_ += dx;
+   yUm_ += dy;
+   return DEVICE_OK;
+}
+
+
+int TRXYStage::GetPositionUm(double& x, double& y)
+{
+   std::string result;
+   int ret = player_.Replay("GetPositionUm", "", &result);
+   if (ret != DEVICE_OK)
+      return ret;
+   if (!result.empty())
+   {
+      std::istringstream ss(result);
+      ss >> xUm_ >> yUm_;
+   }
+   x = xUm_;
+   y = yUm_;
+   return DEVICE_OK;
+}
+
+
+int TRXYStage::GetPositionSteps(long& x, long& y)
+{
+   double xUm, yUm;
+   int ret = GetPositionUm(xUm, yUm);
+   if (ret != DEVICE_OK)
+      return ret;
+   x = static_cast<long>(xUm / stepSizeUm_);
+   y = static_cast<long>(yUm / stepSizeUm_);
+   return DEVICE_OK;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// TRShutter
+///////////////////////////////////////////////////////////////////////////////
+
+TRShutter::TRShutter() :
+   TraceReplayDevice<CShutterBase<TRShutter>, TRShutter>("Shutter replaying a device trace"),
+   open_(false)
+{
+}
+
+
+void TRShutter::GetName(char* name) const
+{
+   CDeviceUtils::CopyLimitedString(name, g_ShutterDeviceName);
+}
+
+
+int TRShutter::Initialize()
+{
+   int ret = LoadTrace();
+   if (ret != DEVICE_OK)
+      return ret;
+
+   TraceCall call;
+   if (player_.Peek("GetOpen", "", call))
+      open_ = (call.result == "1");
+   return DEVICE_OK;
+}
+
+
+int TRShutter::SetOpen(bool open)
+{
+   int ret = player_.Replay("SetOpen", open ? "1" : "0");
+   if (ret != DEVICE_OK)
+      return ret;
+   open_ = open;
+   return DEVICE_OK;
+}
+
+
+int TRShutter::GetOpen(bool& open)
+{
+   std::string result;
+   int ret = player_.Replay("GetOpen", "", &result);
+   if (ret != DEVICE_OK)
+      return ret;
+   if (!result.empty())
+      open_ = (result == "1");
+   open = open_;
+   return DEVICE_OK;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// TRState
+///////////////////////////////////////////////////////////////////////////////
+
+TRState::TRState() :
+   TraceReplayDevice<CStateDeviceBase<TRState>, TRState>("State device replaying a device trace"),
+   numPositions_(1),
+   position_(0)
+{
+}
+
+
+void TRState::GetName(char* name) const
+{
+   CDeviceUtils::CopyLimitedString(name, g_StateDeviceName);
+}
+
+
+int TRState::Initialize()
+{
+   // State and Label are created here rather than as recorded properties,
+   // because CStateDeviceBase relies on them.
+   CPropertyAction* pAct = new CPropertyAction(this, &TRState::OnState);
+   int ret = CreateIntegerProperty(MM::g_Keyword_State, 0, false, pAct);
+   if (ret != DEVICE_OK)
+      return ret;
+   pAct = new CPropertyAction(this, &CStateBase::OnLabel);
+   ret = CreateStringProperty(MM::g_Keyword_Label, "", false, pAct);
+   if (ret != DEVICE_OK)
+      return ret;
+
+   ret = LoadTrace();
+   if (ret != DEVICE_OK)
+      return ret;
+
+   const std::map<long, std::string>& labels = player_.GetPositionLabels();
+   for (std::map<long, std::string>::const_iterator it = labels.begin(),
+         end = labels.end(); it != end; ++it)
+   {
+      SetPositionLabel(it->first, it->second.c_str());
+      numPositions_ = std::max(numPositions_,
+            static_cast<unsigned long>(it->first + 1));
+   }
+
+   const std::vector<TraceProperty>& props = player_.GetProperties();
+   for (std::vector<TraceProperty>::const_iterator it = props.begin(),
+         end = props.end(); it != end; ++it)
+   {
+      if (it->name == MM::g_Keyword_State)
+         position_ = std::atol(it->value.c_str());
+   }
+   return DEVICE_OK;
+}
+
+
+int TRState::SetPosition(long pos)
+{
+   int ret = player_.Replay("SetPosition", std::to_string(pos));
+   if (ret != DEVICE_OK)
+      return ret;
+   position_ = pos;
+   return DEVICE_OK;
+}
+
+
+int TRState::SetPosition(const char* label)
+{
+   long pos;
+   int ret = GetLabelPosition(label, pos);
+   if (ret != DEVICE_OK)
+      return ret;
+   ret = player_.Replay("SetPositionLabel", label);
+   if (ret != DEVICE_OK)
+      return ret;
+   position_ = pos;
+   return DEVICE_OK;
+}
+
+
+int TRState::GetPosition(long& pos) const
+{
+   std::string result;
+   int ret = player_.Replay("GetPosition", "", &result);
+   if (ret != DEVICE_OK)
+      return ret;
+   if (!result.empty())
+      position_ = std::atol(result.c_str());
+   pos = position_;
+   return DEVICE_OK;
+}
+
+
+int TRState::OnState(MM::PropertyBase* pProp, MM::ActionType eAct)
+{
+   if (eAct == MM::BeforeGet)
+   {
+      std::string result;
+      int ret = player_.Replay("GetProperty", MM::g_Keyword_State, &result);
+      if (ret != DEVICE_OK)
+         return ret;
+      if (!result.empty())
+         position_ = std::atol(result.c_str());
+      pProp->Set(position_);
+   }
+   else if (eAct == MM::AfterSet)
+   {
+      int ret = player_.Replay("SetProperty", MM::g_Keyword_State);
+      if (ret != DEVICE_OK)
+         return ret;
+      pProp->Get(position_);
+   }
+   return DEVICE_OK;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// TRGeneric
+///////////////////////////////////////////////////////////////////////////////
+
+TRGeneric::TRGeneric() :
+   TraceReplayDevice<CGenericBase<TRGeneric>, TRGeneric>("Generic device replaying a device trace")
+{
+}
+
+
+void TRGeneric::GetName(char* name) const
+{
+   CDeviceUtils::CopyLimitedString(name, g_GenericDeviceName);
+}
@@ -0,0 +1,326 @@
+///////////////////////////////////////////////////////////////////////////////
+// FILE:          TraceReplay.h
+// PROJECT:       Micro-Manager
+// SUBSYSTEM:     DeviceAdapters
+//-----------------------------------------------------------------------------
+// DESCRIPTION:   Devices that replay a trace of device calls recorded by the
+//                Core (CMMCore::startDeviceTraceRecording()), responding with
+//                the recorded results, images and latencies.
+//
+// LICENSE:       This file is distributed under the BSD license.
+//                License text is included with the source distribution.
+//
+//                This file is distributed in the hope that it will be useful,
+//                but WITHOUT ANY WARRANTY; without even the implied warranty
+//                of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+//
+//                IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+//                CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+//                INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES.
+
+#pragma once
+
+#include "DeviceBase.h"
+
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#define ERR_CANNOT_READ_TRACE    101
+#define ERR_INVALID_TRACE        102
+#define ERR_LABEL_NOT_IN_TRACE   103
+#define ERR_CANNOT_READ_PIXELS   104
+#define ERR_NO_RECORDED_IMAGE    105
+
+extern const char* g_Keyword_TraceFile;
+extern const char* g_Keyword_RecordedLabel;
+
+
+struct TraceImage
+{
+   unsigned width = 0;
+   unsigned height = 0;
+   unsigned bytesPerPixel = 1;
+   unsigned components = 1;
+   long long offset = -1; // In the pixel file; -1 if no image was returned
+   long long size = 0;
+   long long time = 0; // Microseconds since start of recording
+};
+
+struct TraceCall
+{
+   long long time = 0; // Microseconds since start of recording
+   long long duration = 0;
+   long long busy = 0; // Until Busy() first returned false after the call
+   std::string function;
+   std::string arg;
+   std::string result;
+   int ret = DEVICE_OK;
+   TraceImage image; // For calls that returned an image
+};
+
+struct TraceProperty
+{
+   std::string name;
+   std::string value;
+   bool readOnly = false;
+};
+
+
+/// The recorded calls of one device, and the state of their replay.
+/**
+ * Calls are replayed in the recorded order: each replayed call takes the
+ * next recorded call of the same function with the same argument, or if
+ * there is none, of the same function. The last matching call is repeated
+ * once all have been replayed.
+ */
+class TracePlayer
+{
+public:
+   TracePlayer();
+
+   int Load(const std::string& filename, const std::string& label);
+
+   std::string GetRecordedAdapter() const { return adapter_; }
+   std::string GetRecordedName() const { return name_; }
+   const std::vector<TraceProperty>& GetProperties() const { return properties_; }
+   const std::map<long, std::string>& GetPositionLabels() const { return positionLabels_; }
+
+   bool Next(const std::string& function, const std::string& arg, TraceCall& call);
+   bool Peek(const std::string& function, const std::string& arg, TraceCall& call) const;
+
+   /// Wait for the recorded duration and start the recorded busy period.
+   int Play(const TraceCall& call);
+
+   /// Next() and Play(); DEVICE_OK if the function was never recorded.
+   int Replay(const std::string& function, const std::string& arg,
+         std::string* result = 0);
+
+   bool Busy();
+
+   /// The first image returned or inserted by the camera, if any.
+   bool GetFirstImage(TraceImage& image) const;
+
+   /// The frames inserted after a call starting sequence acquisition.
+   std::vector<TraceImage> GetFrames(const TraceCall& sequenceStart) const;
+
+   int ReadPixels(const TraceImage& image, std::vector<unsigned char>& pixels);
+
+private:
+   struct Cursor
+   {
+      std::vector<size_t> indices;
+      size_t next = 0;
+   };
+   const Cursor* FindCursor(const std::string& function, const std::string& arg) const;
+   void ComputeBusyPeriods();
+
+   std::string adapter_;
+   std::string name_;
+   std::vector<TraceProperty> properties_;
+   std::map<long, std::string> positionLabels_;
+   std::vector<TraceCall> calls_;
+   std::vector<TraceImage> frames_;
+   std::vector<long long> sequenceStarts_;
+   long long busyDuration_; // Mean duration of the recorded Busy() calls
+
+   mutable std::mutex mutex_;
+   std::map<std::string, Cursor> cursors_; // By "function<TAB>arg" and by "function"
+   std::chrono::steady_clock::time_point busyUntil_;
+
+   std::mutex pixelMutex_;
+   std::ifstream pixelFile_;
+};
+
+
+/// Properties and Busy() common to all replay devices.
+template <class TBase, class TDevice>
+class TraceReplayDevice : public TBase
+{
+public:
+   bool Busy() { return player_.Busy(); }
+
+   int OnRecordedProperty(MM::PropertyBase* pProp, MM::ActionType eAct, long index);
+
+protected:
+   TraceReplayDevice(const char* description);
+
+   /// Read the trace and create the recorded properties not already present.
+   int LoadTrace();
+   std::string GetRecordedValue(const std::string& name) const;
+
+   mutable TracePlayer player_;
+
+private:
+   std::string traceFile_;
+   std::string recordedLabel_;
+   std::vector<std::string> recordedNames_; // By handler index
+   std::map<std::string, std::string> recordedValues_;
+};
+
+
+class TRCamera : public TraceReplayDevice<CCameraBase<TRCamera>, TRCamera>
+{
+public:
+   TRCamera();
+   ~TRCamera();
+
+   int Initialize();
+   int Shutdown();
+   void GetName(char* name) const;
+
+   int SnapImage();
+   const unsigned char* GetImageBuffer();
+   unsigned GetNumberOfComponents() const { return image_.components; }
+   unsigned GetImageWidth() const { return image_.width; }
+   unsigned GetImageHeight() const { return image_.height; }
+   unsigned GetImageBytesPerPixel() const { return image_.bytesPerPixel; }
+   unsigned GetBitDepth() const;
+   long GetImageBufferSize() const;
+   double GetExposure() const;
+   void SetExposure(double exp_ms);
+   int SetROI(unsigned, unsigned, unsigned, unsigned) { return DEVICE_OK; }
+   int GetROI(unsigned& x, unsigned& y, unsigned& xSize, unsigned& ySize);
+   int ClearROI() { return DEVICE_OK; }
+   int GetBinning() const;
+   int SetBinning(int binSize);
+   int IsExposureSequenceable(bool& isSequenceable) const
+   { isSequenceable = false; return DEVICE_OK; }
+
+   int StartSequenceAcquisition(long numImages, double interval_ms, bool stopOnOverflow);
+   int StartSequenceAcquisition(double interval_ms);
+   int StopSequenceAcquisition();
+   bool IsCapturing() { return capturing_; }
+
+private:
+   int StartReplayThread(const TraceCall& start, long numImages, bool stopOnOverflow);
+   void ReplayFrames(std::vector<TraceImage> frames, long long startTime,
+         long numImages, bool stopOnOverflow);
+   void JoinReplayThread();
+
+   TraceImage image_;
+   std::vector<unsigned char> pixels_;
+   double exposureMs_;
+
+   std::thread thread_;
+   std::atomic<bool> capturing_;
+   std::atomic<bool> stopRequested_;
+};
+
+
+class TRStage : public TraceReplayDevice<CStageBase<TRStage>, TRStage>
+{
+public:
+   TRStage();
+
+   int Initialize();
+   int Shutdown() { return DEVICE_OK; }
+   void GetName(char* name) const;
+
+   int SetPositionUm(double pos);
+   int SetRelativePositionUm(double d);
+   int GetPositionUm(double& pos);
+   int SetPositionSteps(long steps) { return SetPositionUm(steps * stepSizeUm_); }
+   int GetPositionSteps(long& steps);
+   int SetOrigin() { return DEVICE_OK; }
+   int GetLimits(double&, double&) { return DEVICE_UNSUPPORTED_COMMAND; }
+   bool IsContinuousFocusDrive() const { return false; }
+   int IsStageSequenceable(bool& isSequenceable) const
+   { isSequenceable = false; return DEVICE_OK; }
+
+private:
+   static const double stepSizeUm_;
+   double posUm_;
+};
+
+
+class TRXYStage : public TraceReplayDevice<CXYStageBase<TRXYStage>, TRXYStage>
+{
+public:
+   TRXYStage();
+
+   int Initialize();
+   int Shutdown() { return DEVICE_OK; }
+   void GetName(char* name) const;
+
+   // The recorded positions are those seen by the Core, so the coordinate
+   // transformations of CXYStageBase are bypassed.
+   int SetPositionUm(double x, double y);
+   int SetRelativePositionUm(double dx, double dy);
+   int GetPositionUm(double& x, double& y);
+   int SetPositionSteps(long x, long y)
+   { return SetPositionUm(x * stepSizeUm_, y * stepSizeUm_); }
+   int GetPositionSteps(long& x, long& y);
+   int Home() { return DEVICE_OK; }
+   int Stop() { return DEVICE_OK; }
+   int SetOrigin() { return DEVICE_OK; }
+   int GetLimitsUm(double&, double&, double&, double&)
+   { return DEVICE_UNSUPPORTED_COMMAND; }
+   int GetStepLimits(long&, long&, long&, long&)
+   { return DEVICE_UNSUPPORTED_COMMAND; }
+   double GetStepSizeXUm() { return stepSizeUm_; }
+   double GetStepSizeYUm() { return stepSizeUm_; }
+   int IsXYStageSequenceable(bool& isSequenceable) const
+   { isSequenceable = false; return DEVICE_OK; }
+
+private:
+   static const double stepSizeUm_;
+   double xUm_;
+   double yUm_;
+};
+
+
+class TRShutter : public TraceReplayDevice<CShutterBase<TRShutter>, TRShutter>
+{
+public:
+   TRShutter();
+
+   int Initialize();
+   int Shutdown() { return DEVICE_OK; }
+   void GetName(char* name) const;
+
+   int SetOpen(bool open = true);
+   int GetOpen(bool& open);
+   int Fire(double) { return DEVICE_UNSUPPORTED_COMMAND; }
+
+private:
+   bool open_;
+};
+
+
+class TRState : public TraceReplayDevice<CStateDeviceBase<TRState>, TRState>
+{
+public:
+   TRState();
+
+   int Initialize();
+   int Shutdown() { return DEVICE_OK; }
+   void GetName(char* name) const;
+
+   unsigned long GetNumberOfPositions() const { return numPositions_; }
+   int SetPosition(long pos);
+   int SetPosition(const char* label);
+   int GetPosition(long& pos) const;
+
+   int OnState(MM::PropertyBase* pProp, MM::ActionType eAct);
+
+private:
+   unsigned long numPositions_;
+   mutable long position_;
+};
+
+
+class TRGeneric : public TraceReplayDevice<CGenericBase<TRGeneric>, TRGeneric>
+{
+public:
+   TRGeneric();
+
+   int Initialize() { return LoadTrace(); }
+   int Shutdown() { return DEVICE_OK; }
+   void GetName(char* name) const;
+};
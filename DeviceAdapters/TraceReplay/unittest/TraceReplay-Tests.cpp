@@ -0,0 +1,141 @@
+///////////////////////////////////////////////////////////////////////////////
+// FILE:          TraceReplay-Tests.cpp
+// PROJECT:       Micro-Manager
+// SUBSYSTEM:     DeviceAdapters
+//-----------------------------------------------------------------------------
+// DESCRIPTION:   Unit tests for TraceReplay
+//
+// LICENSE:       This file is distributed under the BSD license.
+//                License text is included with the source distribution.
+//
+//                This file is distributed in the hope that it will be useful,
+//                but WITHOUT ANY WARRANTY; without even the implied warranty
+//                of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+//
+//                IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+//                CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+//                INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES.
+
+#include <gtest/gtest.h>
+
+#include "TraceReplay.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <thread>
+
+
+// A trace as written by CMMCore::startDeviceTraceRecording(), with a stage
+// and a generic device. The stage stays busy until 20 ms after the first
+// move.
+class TraceReplayTest : public ::testing::Test
+{
+protected:
+   std::string traceFile_;
+
+   virtual void SetUp()
+   {
+#ifdef _WIN32
+      const char* dir = std::getenv("TEMP");
+      const char* defaultDir = ".";
+#else
+      const char* dir = std::getenv("TMPDIR");
+      const char* defaultDir = "/tmp";
+#endif
+      traceFile_ = std::string(dir && *dir ? dir : defaultDir) +
+         "/TraceReplay-Tests.tmp";
+
+      const std::string stage = std::to_string(static_cast<int>(MM::StageDevice));
+      const std::string generic = std::to_string(static_cast<int>(MM::GenericDevice));
+      std::ofstream file(traceFile_.c_str());
+      file << "# Micro-Manager device trace 1\n"
+         "Device\tZ\tDemoCamera\tDStage\t" << stage << "\n"
+         "Property\tZ\tSpeed\tFast\t0\n"
+         "Device\tG\tSomeAdapter\tSomeDevice\t" << generic << "\n"
+         "Property\tG\tMode\tFast\t0\n"
+         "Call\t1000\t200\tZ\tSetPositionUm\t0\t10.000000\t\n"
+         "Call\t1300\t100\tZ\tBusy\t0\t\t1\n"
+         "Call\t21000\t100\tZ\tBusy\t0\t\t0\n"
+         "Call\t22000\t50\tZ\tGetPositionUm\t0\t\t10.000000\n"
+         "Call\t23000\t200\tZ\tSetPositionUm\t0\t20.000000\t\n"
+         "Call\t24000\t50\tZ\tGetPositionUm\t0\t\t20.000000\n"
+         "Call\t25000\t100\tZ\tSetPositionUm\t11\t99.000000\t\n"
+         "Call\t26000\t50\tG\tGetProperty\t0\tMode\tSlow\n"
+         "Call\t27000\t50\tG\tSetProperty\t12\tMode\tBroken\n";
+   }
+
+   virtual void TearDown()
+   {
+      std::remove(traceFile_.c_str());
+   }
+
+   template <class TDevice>
+   int Initialize(TDevice& device, const char* label)
+   {
+      device.SetProperty(g_Keyword_TraceFile, traceFile_.c_str());
+      device.SetProperty(g_Keyword_RecordedLabel, label);
+      return device.Initialize();
+   }
+};
+
+
+TEST_F(TraceReplayTest, StageReplaysRecordedCallsInOrder)
+{
+   TRStage stage;
+   ASSERT_EQ(DEVICE_OK, Initialize(stage, "Z"));
+
+   double pos;
+   ASSERT_EQ(DEVICE_OK, stage.GetPositionUm(pos));
+   EXPECT_DOUBLE_EQ(10.0, pos);
+
+   ASSERT_EQ(DEVICE_OK, stage.SetPositionUm(20.0));
+   ASSERT_EQ(DEVICE_OK, stage.GetPositionUm(pos));
+   EXPECT_DOUBLE_EQ(20.0, pos);
+
+   // The last recorded call is repeated
+   ASSERT_EQ(DEVICE_OK, stage.GetPositionUm(pos));
+   EXPECT_DOUBLE_EQ(20.0, pos);
+}
+
+TEST_F(TraceReplayTest, StageReplaysErrorsAndBusyPeriod)
+{
+   TRStage stage;
+   ASSERT_EQ(DEVICE_OK, Initialize(stage, "Z"));
+
+   // Matched by argument, not by order
+   EXPECT_EQ(11, stage.SetPositionUm(99.0));
+
+   ASSERT_EQ(DEVICE_OK, stage.SetPositionUm(10.0));
+   EXPECT_TRUE(stage.Busy());
+   std::this_thread::sleep_for(std::chrono::milliseconds(40));
+   EXPECT_FALSE(stage.Busy());
+}
+
+TEST_F(TraceReplayTest, GenericDeviceReplaysRecordedProperties)
+{
+   TRGeneric device;
+   ASSERT_EQ(DEVICE_OK, Initialize(device, "G"));
+   ASSERT_TRUE(device.HasProperty("Mode"));
+
+   char value[MM::MaxStrLength];
+   ASSERT_EQ(DEVICE_OK, device.GetProperty("Mode", value));
+   EXPECT_EQ(std::string("Slow"), value);
+
+   EXPECT_EQ(12, device.SetProperty("Mode", "Other"));
+}
+
+TEST_F(TraceReplayTest, LabelNotInTraceIsAnError)
+{
+   TRGeneric device;
+   EXPECT_EQ(ERR_LABEL_NOT_IN_TRACE, Initialize(device, "NoSuchDevice"));
+}
+
+
+int main(int argc, char **argv)
+{
+   ::testing::InitGoogleTest(&argc, argv);
+   return RUN_ALL_TESTS();
+}
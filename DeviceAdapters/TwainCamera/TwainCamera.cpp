@@ -1217,7 +1217,7 @@ int TwainCamera::StartSequenceAcquisition(long numImages, double interval_ms, bo
       return ret;
 
    // make sure the circular buffer is properly sized
-   GetCoreCallback()->InitializeImageBuffer(1, 1, GetImageWidth(), GetImageHeight(), GetImageBytesPerPixel());
+   GetCoreCallback()->InitializeImageBuffer(this, 1, 1, GetImageWidth(), GetImageHeight(), GetImageBytesPerPixel());
 
    double actualIntervalMs = max(GetExposure(), interval_ms);
    SetProperty(MM::g_Keyword_ActualInterval_ms, CDeviceUtils::ConvertToString(actualIntervalMs)); 
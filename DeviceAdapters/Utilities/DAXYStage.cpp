@@ -384,8 +384,10 @@ int DAXYStage::IsXYStageSequenceable(bool& isSequenceable) const
       return ERR_NO_DA_DEVICE;
 
    bool x, y;
-   da_x->IsDASequenceable(x);
-   da_y->IsDASequenceable(y);
+   int ret = da_x->IsDASequenceable(x);
+   if (ret != DEVICE_OK) return ret;
+   ret = da_y->IsDASequenceable(y);
+   if (ret != DEVICE_OK) return ret;
    isSequenceable = x && y;
    return DEVICE_OK;
 }
@@ -457,14 +459,15 @@ int DAXYStage::AddToXYStageSequence(double positionX, double positionY)
 
    double voltageX, voltageY;
 
-   voltageX = ((positionX + originPosX_) / (maxStagePosX_ - minStagePosX_)) *
+   // Same mapping as SetPositionUm(), clamped to the stage voltage range
+   voltageX = ((positionX - originPosX_) / (maxStagePosX_ - minStagePosX_)) *
       (maxStageVoltX_ - minStageVoltX_);
    if (voltageX > maxStageVoltX_)
       voltageX = maxStageVoltX_;
    else if (voltageX < minStageVoltX_)
       voltageX = minStageVoltX_;
 
-   voltageY = ((positionY + originPosY_) / (maxStagePosY_ - minStagePosY_)) *
+   voltageY = ((positionY - originPosY_) / (maxStagePosY_ - minStagePosY_)) *
       (maxStageVoltY_ - minStageVoltY_);
    if (voltageY > maxStageVoltY_)
       voltageY = maxStageVoltY_;
@@ -47,7 +47,9 @@ DAZStage::DAZStage() :
    minStagePos_(0.0),
    maxStagePos_(200.0),
    pos_(0.0),
-   originPos_(0.0)
+   originPos_(0.0),
+   linearSequenceStepUm_(0.0),
+   linearSequenceSlices_(0)
 {
    InitializeDefaultErrorMessages();
 
@@ -175,7 +177,7 @@ int DAZStage::SetPositionUm(double pos)
    if (da == 0)
       return ERR_NO_DA_DEVICE;
 
-   double volt = (pos - minStagePos_) / (maxStagePos_ - minStagePos_) * (maxStageVolt_ - minStageVolt_) + minStageVolt_;
+   double volt = PositionToVoltage(pos);
    if (volt > maxStageVolt_ || volt < minStageVolt_)
       return ERR_POS_OUT_OF_RANGE;
 
@@ -283,6 +285,15 @@ int DAZStage::IsStageSequenceable(bool& isSequenceable) const
    return da->IsDASequenceable(isSequenceable);
 }
 
+/*
+ * Any DA sequence can be generated for an evenly spaced stack, so linear
+ * sequencing is available whenever the DA is sequenceable.
+ */
+int DAZStage::IsStageLinearSequenceable(bool& isSequenceable) const
+{
+   return IsStageSequenceable(isSequenceable);
+}
+
 int DAZStage::GetStageSequenceMaxLength(long& nrEvents) const
 {
    MM::SignalIO* da = (MM::SignalIO*)GetDevice(DADeviceName_.c_str());
@@ -296,6 +307,13 @@ int DAZStage::StartStageSequence()
    MM::SignalIO* da = (MM::SignalIO*)GetDevice(DADeviceName_.c_str());
    if (da == 0)
       return ERR_NO_DA_DEVICE;
+
+   if (linearSequenceSlices_ > 0)
+   {
+      int ret = SendLinearSequence(da);
+      if (ret != DEVICE_OK)
+         return ret;
+   }
    return da->StartDASequence();
 }
 
@@ -312,6 +330,7 @@ int DAZStage::ClearStageSequence()
    MM::SignalIO* da = (MM::SignalIO*)GetDevice(DADeviceName_.c_str());
    if (da == 0)
       return ERR_NO_DA_DEVICE;
+   linearSequenceSlices_ = 0;
    return da->ClearDASequence();
 }
 
@@ -321,7 +340,9 @@ int DAZStage::AddToStageSequence(double pos)
    if (da == 0)
       return ERR_NO_DA_DEVICE;
 
-   double voltage = (pos - minStagePos_) / (maxStagePos_ - minStagePos_) * (maxStageVolt_ - minStageVolt_) + minStageVolt_;
+   linearSequenceSlices_ = 0;
+
+   double voltage = PositionToVoltage(pos);
 
    if (voltage > maxStageVolt_)
       voltage = maxStageVolt_;
@@ -339,6 +360,64 @@ int DAZStage::SendStageSequence()
    return da->SendDASequence();
 }
 
+/*
+ * The voltages are computed when the sequence is started, since the stack
+ * must begin at the position the stage is at at that time.
+ */
+int DAZStage::SetStageLinearSequence(double dZ_um, long nSlices)
+{
+   MM::SignalIO* da = (MM::SignalIO*)GetDevice(DADeviceName_.c_str());
+   if (da == 0)
+      return ERR_NO_DA_DEVICE;
+
+   if (nSlices < 1)
+      return DEVICE_INVALID_INPUT_PARAM;
+
+   long maxLength;
+   int ret = da->GetDASequenceMaxLength(maxLength);
+   if (ret != DEVICE_OK)
+      return ret;
+   if (nSlices > maxLength)
+      return DEVICE_SEQUENCE_TOO_LARGE;
+
+   linearSequenceStepUm_ = dZ_um;
+   linearSequenceSlices_ = nSlices;
+   return DEVICE_OK;
+}
+
+double DAZStage::PositionToVoltage(double pos) const
+{
+   return (pos - minStagePos_) / (maxStagePos_ - minStagePos_) * (maxStageVolt_ - minStageVolt_) + minStageVolt_;
+}
+
+/*
+ * Uploads one voltage per slice, starting at the current position. The DA
+ * cycles through its sequence, so the stage returns to the start position on
+ * the Nth trigger.
+ */
+int DAZStage::SendLinearSequence(MM::SignalIO* da)
+{
+   double start;
+   int ret = GetPositionUm(start);
+   if (ret != DEVICE_OK)
+      return ret;
+
+   ret = da->ClearDASequence();
+   if (ret != DEVICE_OK)
+      return ret;
+
+   for (long i = 0; i < linearSequenceSlices_; ++i)
+   {
+      double voltage = PositionToVoltage(start + i * linearSequenceStepUm_);
+      if (voltage > maxStageVolt_ || voltage < minStageVolt_)
+         return ERR_POS_OUT_OF_RANGE;
+      ret = da->AddToDASequence(voltage);
+      if (ret != DEVICE_OK)
+         return ret;
+   }
+   return da->SendDASequence();
+}
+
 
 ///////////////////////////////////////
 // Action Interface
@@ -482,14 +482,19 @@ public:
 
    // Sequence functions
    int IsStageSequenceable(bool& isSequenceable) const;
+   int IsStageLinearSequenceable(bool& isSequenceable) const;
    int GetStageSequenceMaxLength(long& nrEvents) const;
    int StartStageSequence();
    int StopStageSequence();
    int ClearStageSequence();
    int AddToStageSequence(double position);
    int SendStageSequence();
+   int SetStageLinearSequence(double dZ_um, long nSlices);
 
 private:
+   double PositionToVoltage(double pos) const;
+   int SendLinearSequence(MM::SignalIO* da);
+
    std::vector<std::string> availableDAs_;
    std::string DADeviceName_;
    bool initialized_;
@@ -501,6 +506,10 @@ private:
    double maxStagePos_;
    double pos_;
    double originPos_;
+   // Linear sequence, translated into DA voltages when started (0 slices:
+   // use the sequence built with AddToStageSequence())
+   double linearSequenceStepUm_;
+   long linearSequenceSlices_;
 };
 
 // DAXYStage 
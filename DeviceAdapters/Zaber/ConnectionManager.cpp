@@ -1,5 +1,7 @@
 #include "ConnectionManager.h"
 
+const int ConnectionManager::POLL_MAX_AGE_MS;
+
 std::shared_ptr<zml::Connection> ConnectionManager::getConnection(std::string port)
 {	
 	std::lock_guard<std::mutex> lockGuard(lock_);
@@ -35,5 +37,96 @@ bool ConnectionManager::removeConnection(std::string port, int interfaceId)
 	}
 
 	connections_.erase(port);
+	pollers_.erase(port);
 	return true;
-}
\ No newline at end of file
+}
+
+std::shared_ptr<ChainPoller> ConnectionManager::getPoller(std::string port, std::shared_ptr<zml::Connection> connection)
+{
+	std::lock_guard<std::mutex> lockGuard(lock_);
+	if (pollers_.count(port) > 0) {
+		auto pollerPtr = pollers_.at(port).lock();
+		if (pollerPtr && pollerPtr->getConnection() == connection) {
+			return pollerPtr;
+		}
+	}
+
+	auto poller = std::make_shared<ChainPoller>(connection, POLL_MAX_AGE_MS);
+	pollers_[port] = poller;
+	return poller;
+}
+
+ChainPoller::ChainPoller(std::shared_ptr<zml::Connection> connection, int maxAgeMs) :
+	connection_(connection),
+	maxAge_(std::chrono::milliseconds(maxAgeMs)),
+	generation_(0)
+{
+}
+
+bool ChainPoller::getReply(const std::string& command, int device, zml::Response& reply)
+{
+	std::unique_lock<std::mutex> lockGuard(lock_);
+	Snapshot& snapshot = snapshots_[command];
+	for (;;) {
+		if (snapshot.valid && Clock::now() - snapshot.time <= maxAge_) {
+			auto it = snapshot.replies.find(device);
+			if (it == snapshot.replies.end()) {
+				return false;
+			}
+			reply = it->second;
+			return reply.getReplyFlag() == "OK";
+		}
+		if (!snapshot.inFlight) {
+			break;
+		}
+		// Share the result of the query in flight; if it fails or is
+		// invalidated, we send our own.
+		done_.wait(lockGuard);
+	}
+
+	snapshot.inFlight = true;
+	snapshot.valid = false;
+	unsigned long generation = generation_;
+	lockGuard.unlock();
+
+	std::vector<zml::Response> responses;
+	try
+	{
+		responses = connection_->genericCommandMultiResponse(command, 0, 0, false);
+	}
+	catch (...)
+	{
+		lockGuard.lock();
+		snapshot.inFlight = false;
+		done_.notify_all();
+		throw;
+	}
+
+	std::map<int, zml::Response> replies;
+	for (const auto& response : responses) {
+		replies[response.getDeviceAddress()] = response;
+	}
+
+	lockGuard.lock();
+	snapshot.inFlight = false;
+	snapshot.replies = replies;
+	snapshot.time = Clock::now();
+	snapshot.valid = generation == generation_;
+	done_.notify_all();
+
+	auto it = replies.find(device);
+	if (it == replies.end()) {
+		return false;
+	}
+	reply = it->second;
+	return reply.getReplyFlag() == "OK";
+}
+
+void ChainPoller::invalidate()
+{
+	std::lock_guard<std::mutex> lockGuard(lock_);
+	++generation_;
+	for (auto& snapshot : snapshots_) {
+		snapshot.second.valid = false;
+	}
+}
@@ -6,17 +6,71 @@
 #include <string>
 #include <mutex>
 #include <memory>
+#include <chrono>
+#include <condition_variable>
 
 namespace zmlbase = zaber::motion;
 namespace zml = zaber::motion::ascii;
 
+// Shares status and setting polls among all devices on a daisy chain.
+//
+// Instead of each device querying its own address, a poll is sent as a
+// broadcast query answered by every device on the chain, and the replies are
+// kept for maxAgeMs so that other devices (or the other axis of an XY stage)
+// polling at about the same time are served without another round trip.
+// Concurrent callers wait for the query already in flight rather than
+// sending their own. Any command that may change the state of the chain must
+// be followed by invalidate(), so that later polls never see replies older
+// than the command.
+class ChainPoller
+{
+public:
+	ChainPoller(std::shared_ptr<zml::Connection> connection, int maxAgeMs);
+
+	// Return the reply of the device to the broadcast of the command (e.g.
+	// "" for status or "get pos"). Returns false if the device did not reply
+	// or rejected the command, in which case the caller should fall back to
+	// addressing the device directly. Throws zmlbase::MotionLibException.
+	bool getReply(const std::string& command, int device, zml::Response& reply);
+
+	void invalidate();
+
+	std::shared_ptr<zml::Connection> getConnection() const { return connection_; }
+
+private:
+	typedef std::chrono::steady_clock Clock;
+
+	struct Snapshot
+	{
+		Snapshot() : valid(false), inFlight(false) {}
+		std::map<int, zml::Response> replies;
+		Clock::time_point time;
+		bool valid;
+		bool inFlight;
+	};
+
+	std::shared_ptr<zml::Connection> connection_;
+	const Clock::duration maxAge_;
+
+	std::mutex lock_;
+	std::condition_variable done_;
+	std::map<std::string, Snapshot> snapshots_;
+	unsigned long generation_;
+};
+
 class ConnectionManager
 {
 public:
 	std::shared_ptr<zml::Connection> getConnection(std::string port);
+	std::shared_ptr<ChainPoller> getPoller(std::string port, std::shared_ptr<zml::Connection> connection);
 	bool removeConnection(std::string port, int interfaceId = -1);
+
+	// Replies older than this are not shared between devices. Kept short, as
+	// it bounds how late a change not caused by a command from this process
+	// (e.g. the end of a move) is noticed.
+	static const int POLL_MAX_AGE_MS = 5;
 private:
 	std::mutex lock_;
 	std::map<std::string, std::weak_ptr<zml::Connection>> connections_;
+	std::map<std::string, std::weak_ptr<ChainPoller>> pollers_;
 };
-
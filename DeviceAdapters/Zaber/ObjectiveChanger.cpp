@@ -93,8 +93,7 @@ int ObjectiveChanger::Initialize()
 
 	this->LogMessage("ObjectiveChanger::Initialize\n", true);
 
-	auto ret = handleException([=]() {
-		ensureConnected();
+	auto ret = handleStateChange([=]() {
 		if (!this->changer_.getFocusAxis().isHomed()) {
 			this->changer_.change(1);
 		}
@@ -350,8 +349,7 @@ int ObjectiveChanger::FocusOffsetGetSet(MM::PropertyBase* pProp, MM::ActionType
 }
 
 int ObjectiveChanger::setObjective(long objective, bool applyOffset) {
-	return handleException([=]() {
-		ensureConnected();
+	return handleStateChange([=]() {
 		zmlbase::Measurement offset;
 		if (applyOffset) {
 			offset = zmlbase::Measurement(focusOffset_ * ObjectiveChanger_::xLdaNativePerMm);
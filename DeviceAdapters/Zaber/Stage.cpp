@@ -166,7 +166,7 @@ int Stage::GetPositionUm(double& pos)
 	this->LogMessage("Stage::GetPositionUm\n", true);
 
 	long steps;
-	int ret =  GetSetting(deviceAddress_, axisNumber_, "pos", steps);
+	int ret =  GetPolledPosition(deviceAddress_, axisNumber_, steps);
 	if (ret != DEVICE_OK)
 	{
 		return ret;
@@ -178,7 +178,7 @@ int Stage::GetPositionUm(double& pos)
 int Stage::GetPositionSteps(long& steps)
 {
 	this->LogMessage("Stage::GetPositionSteps\n", true);
-	return GetSetting(deviceAddress_, axisNumber_, "pos", steps);
+	return GetPolledPosition(deviceAddress_, axisNumber_, steps);
 }
 
 int Stage::SetPositionUm(double pos)
@@ -255,13 +255,13 @@ int XYStage::GetPositionSteps(long& x, long& y)
 {
 	this->LogMessage("XYStage::GetPositionSteps\n", true);
 
-	int ret = GetSetting(deviceAddressX_, axisX_, "pos", x);
+	int ret = GetPolledPosition(deviceAddressX_, axisX_, x);
 	if (ret != DEVICE_OK)
 	{
 		return ret;
 	}
 
-	return GetSetting(deviceAddressY_, axisY_, "pos", y);
+	return GetPolledPosition(deviceAddressY_, axisY_, y);
 }
 
 
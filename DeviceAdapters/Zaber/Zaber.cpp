@@ -128,10 +128,28 @@ int ZaberBase::Command(long device, long axis, const string command, zml::Respon
 {
 	core_->LogMessage(device_, "ZaberBase::Command\n", true);
 
-	return handleException([&]() {
+	int ret = handleException([&]() {
 		ensureConnected();
 		reply = connection_->genericCommand(command, static_cast<int>(device), static_cast<int>(axis));
 	});
+	invalidatePolls(command);
+	return ret;
+}
+
+
+// Discard shared poll replies that may predate the command. Done after
+// sending (even if it failed), so that no poll started before the command
+// can be served afterwards.
+void ZaberBase::invalidatePolls(const std::string& command)
+{
+	if (command.empty() || command.compare(0, 4, "get ") == 0 || command == "warnings")
+	{
+		return;
+	}
+	if (poller_)
+	{
+		poller_->invalidate();
+	}
 }
 
 
@@ -140,6 +158,7 @@ void ZaberBase::ensureConnected() {
 		core_->LogMessage(device_, "ZaberBase::ensureConnected\n", true);
 		connection_ = ZaberBase::connections.getConnection(port_);
 		connection_->enableAlerts();
+		poller_ = ZaberBase::connections.getPoller(port_, connection_);
 		onNewConnection();
 	}
 }
@@ -151,6 +170,7 @@ void ZaberBase::resetConnection() {
 	try
 	{
 		// the connection destructor can throw in the rarest occasions
+		poller_ = nullptr;
 		connection_ = nullptr;
 	}
 	catch (const zmlbase::MotionLibException e) 
@@ -233,8 +253,17 @@ bool ZaberBase::IsBusy(long device)
 	core_->LogMessage(device_, "ZaberBase::IsBusy\n", true);
 
 	zml::Response resp;
+	bool shared = false;
 
-	int ret = Command(device, 0, "", resp);
+	// The status of all devices on the chain is polled at once
+	int ret = handleException([&]() {
+		ensureConnected();
+		shared = poller_->getReply("", static_cast<int>(device), resp);
+	});
+	if (ret == DEVICE_OK && !shared)
+	{
+		ret = Command(device, 0, "", resp);
+	}
 	if (ret != DEVICE_OK)
 	{
 		ostringstream os;
@@ -247,6 +276,40 @@ bool ZaberBase::IsBusy(long device)
 }
 
 
+// Like GetSetting(device, axis, "pos", steps), but the positions of all axes
+// on the chain are polled at once and shared between devices.
+int ZaberBase::GetPolledPosition(long device, long axis, long& steps)
+{
+	core_->LogMessage(device_, "ZaberBase::GetPolledPosition\n", true);
+
+	zml::Response resp;
+	bool shared = false;
+	int ret = handleException([&]() {
+		ensureConnected();
+		shared = poller_->getReply("get pos", static_cast<int>(device), resp);
+	});
+	if (ret != DEVICE_OK)
+	{
+		return ret;
+	}
+
+	if (shared)
+	{
+		// The device-scope reply lists the positions of all its axes
+		std::vector<string> tokens;
+		CDeviceUtils::Tokenize(resp.getData(), tokens, " ");
+		size_t index = axis > 0 ? static_cast<size_t>(axis - 1) : 0;
+		if (index < tokens.size() && tokens[index] != "NA")
+		{
+			stringstream(tokens[index]) >> steps;
+			return DEVICE_OK;
+		}
+	}
+
+	return GetSetting(device, axis, "pos", steps);
+}
+
+
 int ZaberBase::Stop(long device, long lockstepGroup)
 {
 	core_->LogMessage(device_, "ZaberBase::Stop\n", true);
@@ -305,6 +368,7 @@ int ZaberBase::SendAndPollUntilIdle(long device, long axis, string command)
 	{
 		ensureConnected();
 		connection_->genericCommand(command, static_cast<int>(device), static_cast<int>(axis));
+		invalidatePolls(command);
 		auto zmlDevice = connection_->getDevice(device);
 		if (axis == 0) {
 			zmlDevice.getAllAxes().waitUntilIdle();
@@ -460,6 +524,28 @@ int ZaberBase::handleException(std::function<void()> wrapped) {
 }
 
 
+// Like handleException(), for calls into the Zaber Motion Library that
+// command devices on the chain without going through Command() (e.g. the
+// microscopy classes). The connection is opened first, and shared poll
+// replies are invalidated afterwards, as Command() does.
+int ZaberBase::handleStateChange(std::function<void()> wrapped)
+{
+	std::shared_ptr<ChainPoller> poller;
+	int ret = handleException([&]() {
+		ensureConnected();
+		poller = poller_;
+		wrapped();
+	});
+	// Also when the connection was reset by the failure, as other devices
+	// may still share the poller
+	if (poller)
+	{
+		poller->invalidate();
+	}
+	return ret;
+}
+
+
 void ZaberBase::setErrorMessages(std::function<void(int, const char*)> setter) {
 	setter(ERR_PORT_CHANGE_FORBIDDEN, g_Msg_PORT_CHANGE_FORBIDDEN);
 	setter(ERR_DRIVER_DISABLED, g_Msg_DRIVER_DISABLED);
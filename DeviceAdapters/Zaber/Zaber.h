@@ -71,6 +71,7 @@ protected:
 	int GetSettings(long device, long axis, std::string setting, std::vector<double>& data);
 	int SetSetting(long device, long axis, std::string setting, double data, int decimalPlaces = -1);
 	bool IsBusy(long device);
+	int GetPolledPosition(long device, long axis, long& steps);
 	int Stop(long device, long lockstepGroup = 0);
 	int GetLimits(long device, long axis, long& min, long& max);
 	int SendMoveCommand(long device, long axis, std::string type, long data, bool lockstep = false);
@@ -79,6 +80,7 @@ protected:
 	int GetFirmwareVersion(long device, double& version);
 	int ActivatePeripheralsIfNeeded(long device);
 	int handleException(std::function<void()> wrapped);
+	int handleStateChange(std::function<void()> wrapped);
 	void ensureConnected();
 	virtual void onNewConnection();
 	void resetConnection();
@@ -88,8 +90,11 @@ protected:
 	MM::Device *device_;
 	MM::Core *core_;
 	std::shared_ptr<zml::Connection> connection_;
+	std::shared_ptr<ChainPoller> poller_;
 
 private:
+	void invalidatePolls(const std::string& command);
+
 	static ConnectionManager connections;
 };
 
@@ -0,0 +1,450 @@
+///////////////////////////////////////////////////////////////////////////////
+// FILE:          ZaberChain-Tests.cpp
+// PROJECT:       Micro-Manager
+// SUBSYSTEM:     DeviceAdapters
+//-----------------------------------------------------------------------------
+// DESCRIPTION:   Tests of the shared chain polls of the Zaber adapter, against
+//                a daisy chain emulated on a pseudo-terminal
+//
+// LICENSE:       This file is distributed under the BSD license.
+//                License text is included with the source distribution.
+//
+//                This file is distributed in the hope that it will be useful,
+//                but WITHOUT ANY WARRANTY; without even the implied warranty
+//                of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+//
+//                IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+//                CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+//                INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES.
+
+#include <gtest/gtest.h>
+
+#include "ConnectionManager.h"
+#include "ObjectiveChanger.h"
+#include "Stage.h"
+
+#include <fcntl.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+namespace {
+
+// The parts of the core used by the Zaber devices: logging and the time
+class StubCore : public MM::Core
+{
+public:
+	int LogMessage(const MM::Device*, const char*, bool) const { return DEVICE_OK; }
+	MM::MMTime GetCurrentMMTime()
+	{
+		using namespace std::chrono;
+		return MM::MMTime::fromUs(static_cast<double>(duration_cast<microseconds>(
+			steady_clock::now().time_since_epoch()).count()));
+	}
+	unsigned long GetClockTicksUs(const MM::Device*)
+	{
+		return static_cast<unsigned long>(GetCurrentMMTime().getUsec());
+	}
+
+	MM::Device* GetDevice(const MM::Device*, const char*) { return 0; }
+	int GetDeviceProperty(const char*, const char*, char*) { return DEVICE_ERR; }
+	int SetDeviceProperty(const char*, const char*, const char*) { return DEVICE_ERR; }
+	void GetLoadedDeviceOfType(const MM::Device*, MM::DeviceType, char* name, const unsigned int) { name[0] = 0; }
+	int SetSerialProperties(const char*, const char*, const char*, const char*, const char*, const char*, const char*) { return DEVICE_ERR; }
+	int SetSerialCommand(const MM::Device*, const char*, const char*, const char*) { return DEVICE_ERR; }
+	int GetSerialAnswer(const MM::Device*, const char*, unsigned long, char*, const char*) { return DEVICE_ERR; }
+	int WriteToSerial(const MM::Device*, const char*, const unsigned char*, unsigned long) { return DEVICE_ERR; }
+	int ReadFromSerial(const MM::Device*, const char*, unsigned char*, unsigned long, unsigned long&) { return DEVICE_ERR; }
+	int PurgeSerial(const MM::Device*, const char*) { return DEVICE_ERR; }
+	MM::PortType GetSerialPortType(const char*) const { return MM::InvalidPort; }
+	int OnPropertiesChanged(const MM::Device*) { return DEVICE_OK; }
+	int OnPropertyChanged(const MM::Device*, const char*, const char*) { return DEVICE_OK; }
+	int OnStagePositionChanged(const MM::Device*, double) { return DEVICE_OK; }
+	int OnXYStagePositionChanged(const MM::Device*, double, double) { return DEVICE_OK; }
+	int OnExposureChanged(const MM::Device*, double) { return DEVICE_OK; }
+	int OnSLMExposureChanged(const MM::Device*, double) { return DEVICE_OK; }
+	int OnMagnifierChanged(const MM::Device*) { return DEVICE_OK; }
+	int AcqFinished(const MM::Device*, int) { return DEVICE_OK; }
+	int PrepareForAcq(const MM::Device*) { return DEVICE_OK; }
+	int InsertImage(const MM::Device*, const ImgBuffer&) { return DEVICE_ERR; }
+	int InsertImage(const MM::Device*, const unsigned char*, unsigned, unsigned, unsigned, unsigned, const char*, const bool) { return DEVICE_ERR; }
+	int InsertImage(const MM::Device*, const unsigned char*, unsigned, unsigned, unsigned, const Metadata*, const bool) { return DEVICE_ERR; }
+	int InsertImage(const MM::Device*, const unsigned char*, unsigned, unsigned, unsigned, const char*, const bool) { return DEVICE_ERR; }
+	void ClearImageBuffer(const MM::Device*) {}
+	bool InitializeImageBuffer(const MM::Device*, unsigned, unsigned, unsigned int, unsigned int, unsigned int) { return false; }
+	bool InitializeImageBuffer(unsigned, unsigned, unsigned int, unsigned int, unsigned int) { return false; }
+	int InsertMultiChannel(const MM::Device*, const unsigned char*, unsigned, unsigned, unsigned, unsigned, Metadata*) { return DEVICE_ERR; }
+	bool IsImageBufferBackpressured(const MM::Device*) { return false; }
+	const char* GetImage() { return 0; }
+	int GetImageDimensions(int&, int&, int&) { return DEVICE_ERR; }
+	int GetFocusPosition(double&) { return DEVICE_ERR; }
+	int SetFocusPosition(double) { return DEVICE_ERR; }
+	int MoveFocus(double) { return DEVICE_ERR; }
+	int SetXYPosition(double, double) { return DEVICE_ERR; }
+	int GetXYPosition(double&, double&) { return DEVICE_ERR; }
+	int MoveXYStage(double, double) { return DEVICE_ERR; }
+	int SetExposure(double) { return DEVICE_ERR; }
+	int GetExposure(double&) { return DEVICE_ERR; }
+	int SetConfig(const char*, const char*) { return DEVICE_ERR; }
+	int GetCurrentConfig(const char*, int, char*) { return DEVICE_ERR; }
+	int GetChannelConfig(char*, const unsigned int) { return DEVICE_ERR; }
+	MM::ImageProcessor* GetImageProcessor(const MM::Device*) { return 0; }
+	MM::AutoFocus* GetAutoFocus(const MM::Device*) { return 0; }
+	MM::Hub* GetParentHub(const MM::Device*) const { return 0; }
+	MM::State* GetStateDevice(const MM::Device*, const char*) { return 0; }
+	MM::SignalIO* GetSignalIODevice(const MM::Device*, const char*) { return 0; }
+	void NextPostedError(int& code, char*, int, int& length) { code = 0; length = 0; }
+	void PostError(const int, const char*) {}
+	void ClearPostedErrors() {}
+};
+
+
+// A daisy chain of single-axis devices speaking the Zaber ASCII protocol on
+// the master side of a pseudo-terminal. Each device has a position and a
+// table of settings; "get" and "set" work on the settings ("pos" included),
+// and moves complete at once. Requests to device 0 are answered by every
+// device, in order of address. Other commands are accepted and ignored.
+class EmulatedChain
+{
+public:
+	EmulatedChain() : master_(-1), stop_(false)
+	{
+		master_ = posix_openpt(O_RDWR | O_NOCTTY);
+		if (master_ == -1 || grantpt(master_) != 0 || unlockpt(master_) != 0)
+			return;
+		portName_ = ptsname(master_);
+
+		// No echo or line-ending translation on the device side
+		int slave = open(portName_.c_str(), O_RDWR | O_NOCTTY);
+		if (slave != -1)
+		{
+			termios tio;
+			tcgetattr(slave, &tio);
+			cfmakeraw(&tio);
+			tcsetattr(slave, TCSANOW, &tio);
+			close(slave);
+		}
+		thread_ = std::thread([this] { Serve(); });
+	}
+
+	~EmulatedChain()
+	{
+		stop_ = true;
+		if (thread_.joinable())
+			thread_.join();
+		if (master_ != -1)
+			close(master_);
+	}
+
+	const std::string& PortName() const { return portName_; }
+
+	void AddDevice(int address, const std::string& deviceId)
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		std::map<std::string, std::string>& settings = devices_[address];
+		settings["device.id"] = deviceId;
+		settings["system.axiscount"] = "1";
+		settings["peripheral.id"] = "0";
+		settings["version"] = "7.30";
+		settings["version.build"] = "12345";
+		settings["system.serial"] = std::to_string(10000 + address);
+		settings["resolution"] = "64";
+		settings["pos"] = "0";
+		settings["limit.min"] = "0";
+		settings["limit.max"] = "1000000";
+		settings["limit.home.triggered"] = "0";
+		settings["maxspeed"] = "153600";
+		settings["accel"] = "2000";
+		settings["comm.alert"] = "0";
+	}
+
+	void Set(int address, const std::string& setting, const std::string& value)
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		devices_[address][setting] = value;
+	}
+
+	long Position(int address)
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		return std::stol(devices_[address]["pos"]);
+	}
+
+	// Number of requests received with the given command, e.g. "get pos"
+	int Requests(int address, const std::string& command)
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		return requests_[std::make_pair(address, command)];
+	}
+
+private:
+	void Serve()
+	{
+		std::string line;
+		while (!stop_)
+		{
+			pollfd pfd = { master_, POLLIN, 0 };
+			if (poll(&pfd, 1, 20) != 1)
+				continue;
+			char buf[256];
+			const ssize_t n = read(master_, buf, sizeof(buf));
+			if (n <= 0)
+				continue;
+			for (ssize_t i = 0; i < n; ++i)
+			{
+				if (buf[i] == '\n' || buf[i] == '\r')
+				{
+					if (!line.empty())
+						Reply(line);
+					line.clear();
+				}
+				else
+				{
+					line += buf[i];
+				}
+			}
+		}
+	}
+
+	// "/[device [axis [id]]] command[:checksum]"
+	void Reply(std::string request)
+	{
+		if (request[0] != '/')
+			return;
+		const std::size_t colon = request.find(':');
+		if (colon != std::string::npos)
+			request.erase(colon);
+
+		std::istringstream in(request.substr(1));
+		std::vector<std::string> tokens;
+		std::string token;
+		while (in >> token)
+			tokens.push_back(token);
+
+		std::vector<long> numbers;
+		std::size_t i = 0;
+		for (; i < tokens.size() && i < 3 &&
+			tokens[i].find_first_not_of("0123456789") == std::string::npos; ++i)
+		{
+			numbers.push_back(std::stol(tokens[i]));
+		}
+		const int address = numbers.size() > 0 ? static_cast<int>(numbers[0]) : 0;
+		const int axis = numbers.size() > 1 ? static_cast<int>(numbers[1]) : 0;
+		const std::string id = numbers.size() > 2 ? " " + std::to_string(numbers[2]) : "";
+		std::vector<std::string> words(tokens.begin() + i, tokens.end());
+		std::string command;
+		for (const auto& word : words)
+			command += (command.empty() ? "" : " ") + word;
+
+		std::string replies;
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			++requests_[std::make_pair(address, command)];
+			for (auto& device : devices_)
+			{
+				if (address != 0 && address != device.first)
+					continue;
+				std::string flag = "OK";
+				const std::string data = Execute(device.second, words, flag);
+				char header[32];
+				std::snprintf(header, sizeof(header), "@%02d %d", device.first, axis);
+				replies += header + id + " " + flag + " IDLE -- " + data + "\r\n";
+			}
+		}
+		const ssize_t written = write(master_, replies.data(), replies.size());
+		(void)written;
+	}
+
+	static std::string Execute(std::map<std::string, std::string>& settings,
+		const std::vector<std::string>& words, std::string& flag)
+	{
+		if (words.size() == 2 && words[0] == "get")
+		{
+			auto it = settings.find(words[1]);
+			if (it == settings.end())
+			{
+				flag = "RJ";
+				return "BADCOMMAND";
+			}
+			return it->second;
+		}
+		if (words.size() == 3 && words[0] == "set")
+		{
+			settings[words[1]] = words[2];
+			return "0";
+		}
+		if (words.size() >= 2 && words[0] == "move")
+		{
+			long pos = std::stol(settings["pos"]);
+			if (words[1] == "min")
+				pos = std::stol(settings["limit.min"]);
+			else if (words[1] == "max")
+				pos = std::stol(settings["limit.max"]);
+			else if (words[1] == "abs" && words.size() == 3)
+				pos = std::stol(words[2]);
+			else if (words[1] == "rel" && words.size() == 3)
+				pos += std::stol(words[2]);
+			else if (words[1] == "index" && words.size() == 3)
+			{
+				settings["motion.index.num"] = words[2];
+				pos = (std::stol(words[2]) - 1) * std::stol(settings["motion.index.dist"]);
+			}
+			settings["pos"] = std::to_string(pos);
+			return "0";
+		}
+		if (words.size() == 1 && words[0] == "home")
+		{
+			settings["pos"] = "0";
+			settings["limit.home.triggered"] = "1";
+			if (settings.count("motion.index.num"))
+				settings["motion.index.num"] = "1";
+			return "0";
+		}
+		if (words.size() == 1 && words[0] == "warnings")
+			return "00";
+		return "0";
+	}
+
+	int master_;
+	std::string portName_;
+	std::atomic<bool> stop_;
+	std::thread thread_;
+	std::mutex mutex_;
+	std::map<int, std::map<std::string, std::string>> devices_;
+	std::map<std::pair<int, std::string>, int> requests_;
+};
+
+// Device IDs of an X-MOR objective changer and an X-LDA focus stage
+const char* const xMorDeviceId = "53001";
+const char* const xLdaDeviceId = "53002";
+
+const int xMorAddress = 1;
+const int xLdaAddress = 2;
+const long indexDist = 120000;
+
+} // anonymous namespace
+
+
+// An objective changer (device 1) and its focus stage (device 2), with the
+// focus stage also used as a Z stage, as in a typical configuration.
+class ZaberChainTest : public ::testing::Test
+{
+protected:
+	StubCore core_;
+	EmulatedChain chain_;
+
+	virtual void SetUp()
+	{
+		ASSERT_FALSE(chain_.PortName().empty());
+		chain_.AddDevice(xMorAddress, xMorDeviceId);
+		chain_.Set(xMorAddress, "limit.cycle.dist", std::to_string(6 * indexDist));
+		chain_.Set(xMorAddress, "motion.index.dist", std::to_string(indexDist));
+		chain_.Set(xMorAddress, "motion.index.num", "1");
+		chain_.AddDevice(xLdaAddress, xLdaDeviceId);
+	}
+
+	int Initialize(ObjectiveChanger& changer)
+	{
+		changer.SetCallback(&core_);
+		changer.SetProperty("Zaber Serial Port", chain_.PortName().c_str());
+		changer.SetProperty("Objective Changer Device Number", std::to_string(xMorAddress).c_str());
+		changer.SetProperty("Focus Stage Device Number", std::to_string(xLdaAddress).c_str());
+		return changer.Initialize();
+	}
+
+	int Initialize(Stage& stage)
+	{
+		stage.SetCallback(&core_);
+		stage.SetProperty("Zaber Serial Port", chain_.PortName().c_str());
+		stage.SetProperty("Controller Device Number", std::to_string(xLdaAddress).c_str());
+		return stage.Initialize();
+	}
+};
+
+
+TEST_F(ZaberChainTest, PollRepliesAreSharedUntilInvalidated)
+{
+	auto connection = std::make_shared<zml::Connection>(
+		zml::Connection::openSerialPort(chain_.PortName()));
+	ChainPoller poller(connection, 60000);
+
+	zml::Response reply;
+	ASSERT_TRUE(poller.getReply("get pos", xLdaAddress, reply));
+	EXPECT_EQ("0", reply.getData());
+	ASSERT_TRUE(poller.getReply("get pos", xMorAddress, reply));
+	EXPECT_EQ(1, chain_.Requests(0, "get pos"));
+
+	chain_.Set(xLdaAddress, "pos", "5000");
+	ASSERT_TRUE(poller.getReply("get pos", xLdaAddress, reply));
+	EXPECT_EQ("0", reply.getData());
+
+	poller.invalidate();
+	ASSERT_TRUE(poller.getReply("get pos", xLdaAddress, reply));
+	EXPECT_EQ("5000", reply.getData());
+	EXPECT_EQ(2, chain_.Requests(0, "get pos"));
+}
+
+TEST_F(ZaberChainTest, MissingDeviceFallsBackToDirectQuery)
+{
+	auto connection = std::make_shared<zml::Connection>(
+		zml::Connection::openSerialPort(chain_.PortName()));
+	ChainPoller poller(connection, 60000);
+
+	zml::Response reply;
+	EXPECT_FALSE(poller.getReply("get pos", 7, reply));
+}
+
+TEST_F(ZaberChainTest, ObjectiveChangerInitializesOverThePort)
+{
+	ObjectiveChanger changer;
+	ASSERT_EQ(DEVICE_OK, Initialize(changer));
+	EXPECT_EQ(6u, changer.GetNumberOfPositions());
+
+	long state = -1;
+	ASSERT_EQ(DEVICE_OK, changer.GetPosition(state));
+	EXPECT_EQ(0, state);
+	changer.Shutdown();
+}
+
+TEST_F(ZaberChainTest, ObjectiveChangeIsSeenByTheNextPoll)
+{
+	ObjectiveChanger changer;
+	Stage focus;
+	ASSERT_EQ(DEVICE_OK, Initialize(changer));
+	ASSERT_EQ(DEVICE_OK, Initialize(focus));
+
+	long steps = -1;
+	ASSERT_EQ(DEVICE_OK, focus.GetPositionSteps(steps));
+	const long focusBefore = steps;
+	EXPECT_FALSE(changer.Busy());
+
+	// The change moves both devices through the Zaber Motion Library rather
+	// than through ZaberBase::Command(); the polls shared by the chain must
+	// not serve replies from before it
+	ASSERT_EQ(DEVICE_OK, changer.SetPosition(2L));
+	EXPECT_EQ(2 * indexDist, chain_.Position(xMorAddress));
+
+	// The next poll must not be served from replies taken before the change
+	chain_.Set(xLdaAddress, "pos", std::to_string(focusBefore + 4321));
+	ASSERT_EQ(DEVICE_OK, focus.GetPositionSteps(steps));
+	EXPECT_EQ(chain_.Position(xLdaAddress), steps);
+
+	long state = -1;
+	ASSERT_EQ(DEVICE_OK, changer.GetPosition(state));
+	EXPECT_EQ(2, state);
+
+	focus.Shutdown();
+	changer.Shutdown();
+}
@@ -25,16 +25,21 @@
 // 
 #include "CircularBuffer.h"
 #include "CoreUtils.h"
+#include "PixelPacking.h"
 
 #include "TaskSet_CopyMemory.h"
+#include "TaskSet_PackPixels.h"
 
 #include "../MMDevice/DeviceUtils.h"
 
+#include <atomic>
 #include <chrono>
+#include <cstdint>
 #include <cstdio>
 #include <ctime>
 #include <memory>
 #include <string>
+#include <thread>
 
 #ifdef _MSC_VER
 #pragma warning(disable: 4290) // 'C++ exception specification ignored'
@@ -53,27 +58,41 @@ const long adjustThreshold = LONG_MAX / 2;
 // division by zero can be added.
 const unsigned long maxCBSize = 10000000;
 
+// Source of format generations, shared by all buffers so that a replaced
+// buffer never reuses the generation of the one it replaces
+static std::atomic<unsigned long> g_nextFormatGeneration(0);
+
 CircularBuffer::CircularBuffer(unsigned int memorySizeMB) :
    width_(0), 
    height_(0), 
    pixDepth_(0), 
+   packingEnabled_(false),
+   packedBits_(0),
    imageCounter_(0), 
    insertIndex_(0), 
    saveIndex_(0), 
    memorySizeMB_(memorySizeMB), 
    overflow_(false),
+   backpressureActive_(false),
+   backpressureCount_(0),
+   droppedImages_(0),
+   droppedSinceInsert_(0),
+   saturationReported_(false),
+   formatGeneration_(++g_nextFormatGeneration),
    threadPool_(std::make_shared<ThreadPool>()),
-   tasksMemCopy_(std::make_shared<TaskSet_CopyMemory>(threadPool_))
+   tasksMemCopy_(std::make_shared<TaskSet_CopyMemory>(threadPool_)),
+   tasksPackPixels_(std::make_shared<TaskSet_PackPixels>(threadPool_))
 {
 }
 
 CircularBuffer::~CircularBuffer() {}
 
-bool CircularBuffer::Initialize(unsigned channels, unsigned int w, unsigned int h, unsigned int pixDepth)
+bool CircularBuffer::Initialize(unsigned channels, unsigned int w, unsigned int h, unsigned int pixDepth, unsigned int bitDepth)
 {
    MMThreadGuard guard(g_bufferLock);
    imageNumbers_.clear();
    startTime_ = std::chrono::steady_clock::now();
+   saturationReported_ = false;
 
    bool ret = true;
    try
@@ -81,23 +100,35 @@ bool CircularBuffer::Initialize(unsigned channels, unsigned int w, unsigned int
       if (w == 0 || h==0 || pixDepth == 0 || channels == 0)
          return false; // does not make sense
 
-      if (w == width_ && height_ == h && pixDepth_ == pixDepth && channels == numChannels_)
+      const unsigned packedBits = (packingEnabled_ && pixDepth == 2 &&
+            mm::IsPackableBitDepth(bitDepth)) ? bitDepth : 0;
+
+      if (w == width_ && height_ == h && pixDepth_ == pixDepth && channels == numChannels_ &&
+            packedBits == packedBits_)
          if (frameArray_.size() > 0)
             return true; // nothing to change
 
       width_ = w;
       height_ = h;
       pixDepth_ = pixDepth;
+      packedBits_ = packedBits;
       numChannels_ = channels;
+      formatGeneration_ = ++g_nextFormatGeneration;
 
       insertIndex_ = 0;
       saveIndex_ = 0;
       overflow_ = false;
+      backpressureActive_ = false;
+      droppedImages_ = 0;
+      droppedSinceInsert_ = 0;
 
       // calculate the size of the entire buffer array once all images get allocated
       // the actual size at the time of the creation is going to be less, because
       // images are not allocated until pixels become available
-      unsigned long frameSizeBytes = width_ * height_ * pixDepth_ * numChannels_;
+      const std::size_t pixelCount = (std::size_t)width_ * height_;
+      unsigned long frameSizeBytes = (unsigned long)(packedBits_ ?
+            mm::PackedSize(pixelCount, packedBits_) :
+            pixelCount * pixDepth_) * numChannels_;
       unsigned long cbSize = (unsigned long) ((memorySizeMB_ * bytesInMB) / frameSizeBytes);
 
       if (cbSize == 0) 
@@ -119,7 +150,7 @@ bool CircularBuffer::Initialize(unsigned channels, unsigned int w, unsigned int
       frameArray_.resize(cbSize);
       for (unsigned long i=0; i<frameArray_.size(); i++)
       {
-         frameArray_[i].Resize(w, h, pixDepth);
+         frameArray_[i].Resize(w, h, pixDepth, packedBits_);
          frameArray_[i].Preallocate(numChannels_);
       }
    }
@@ -134,12 +165,28 @@ bool CircularBuffer::Initialize(unsigned channels, unsigned int w, unsigned int
 
 void CircularBuffer::Clear() 
 {
-   MMThreadGuard guard(g_bufferLock); 
-   insertIndex_=0; 
-   saveIndex_=0; 
-   overflow_ = false;
-   startTime_ = std::chrono::steady_clock::now();
-   imageNumbers_.clear();
+   bool wasActive;
+   {
+      MMThreadGuard guard(g_bufferLock); 
+      insertIndex_=0; 
+      saveIndex_=0; 
+      overflow_ = false;
+      startTime_ = std::chrono::steady_clock::now();
+      imageNumbers_.clear();
+      wasActive = backpressureActive_;
+      backpressureActive_ = false;
+      droppedImages_ = 0;
+      droppedSinceInsert_ = 0;
+      saturationReported_ = false;
+   }
+   if (wasActive)
+      NotifyBackpressure(false, 0.0);
+}
+
+unsigned long CircularBuffer::GetFormatGeneration() const
+{
+   MMThreadGuard guard(g_bufferLock);
+   return formatGeneration_;
 }
 
 unsigned long CircularBuffer::GetSize() const
@@ -224,6 +271,8 @@ bool CircularBuffer::InsertMultiChannel(const unsigned char* pixArray, unsigned
  
     mm::ImgBuffer* pImg;
     unsigned long singleChannelSize = (unsigned long)width * height * byteDepth;
+    unsigned packedBits;
+    std::size_t saturated = 0;
  
     {
        MMThreadGuard guard(g_bufferLock);
@@ -231,12 +280,26 @@ bool CircularBuffer::InsertMultiChannel(const unsigned char* pixArray, unsigned
        // check image dimensions
        if (width != width_ || height != height_ || byteDepth != pixDepth_)
           throw CMMError("Incompatible image dimensions in the circular buffer", MMERR_CircularBufferIncompatibleImage);
- 
+       packedBits = packedBits_;
+    }
+
+    if (ApplyBackpressure(numChannels, pMd))
+       return true; // Dropped on purpose; not an overflow
+
+    unsigned long droppedBefore;
+    unsigned long droppedTotal;
+    {
+       MMThreadGuard guard(g_bufferLock);
+
        bool overflowed = (insertIndex_ - saveIndex_) >= static_cast<long>(frameArray_.size());
        if (overflowed) {
           overflow_ = true;
           return false;
        }
+
+       droppedBefore = droppedSinceInsert_;
+       droppedTotal = droppedImages_;
+       droppedSinceInsert_ = 0;
     }
  
     for (unsigned i=0; i<numChannels; i++)
@@ -300,16 +363,34 @@ bool CircularBuffer::InsertMultiChannel(const unsigned char* pixArray, unsigned
       else
          md.PutImageTag("PixelType","Unknown"); 
 
+      // Record images dropped under backpressure, so that the gap is
+      // explicit (their image numbers are skipped as well)
+      if (droppedTotal > 0)
+      {
+         md.PutImageTag("BackpressureDroppedImages", droppedBefore);
+         md.PutImageTag("BackpressureDroppedImagesTotal", droppedTotal);
+      }
+
       pImg->SetMetadata(md);
       //pImg->SetPixels(pixArray + i * singleChannelSize);
       // TODO: In MMCore the ImgBuffer::GetPixels() returns const pointer.
       //       It would be better to have something like ImgBuffer::GetPixelsRW() in MMDevice.
       //       Or even better - pass tasksMemCopy_ to ImgBuffer constructor
       //       and utilize parallel copy also in single snap acquisitions.
-      tasksMemCopy_->MemCopy((void*)pImg->GetPixels(),
-            pixArray + i * singleChannelSize, singleChannelSize);
+      if (packedBits)
+      {
+         saturated += tasksPackPixels_->Pack(pImg->GetPixelsRW(),
+               reinterpret_cast<const std::uint16_t*>(pixArray + i * singleChannelSize),
+               (std::size_t)width * height, packedBits);
+      }
+      else
+      {
+         tasksMemCopy_->MemCopy((void*)pImg->GetPixels(),
+               pixArray + i * singleChannelSize, singleChannelSize);
+      }
    }
 
+   SaturationListener saturationListener;
    {
       MMThreadGuard guard(g_bufferLock);
 
@@ -321,12 +402,49 @@ bool CircularBuffer::InsertMultiChannel(const unsigned char* pixArray, unsigned
          insertIndex_ -= adjustThreshold;
          saveIndex_ -= adjustThreshold;
       }
+
+      // Report only the first such image, so as not to flood the log
+      if (saturated > 0 && !saturationReported_)
+      {
+         saturationReported_ = true;
+         saturationListener = saturationListener_;
+      }
    }
+   if (saturationListener)
+      saturationListener(saturated, packedBits);
 
    return true;
 }
  
 
+/**
+* Returns the image, or an unpacked copy of it if it is stored packed. The
+* copy is only valid until the calling thread unpacks another image of the
+* same channel (see SetPackingEnabled()).
+*/
+const mm::ImgBuffer* CircularBuffer::Unpacked(const mm::ImgBuffer* img,
+      unsigned channel) const
+{
+   if (!img || !img->PackedBits())
+      return img;
+
+   // One buffer per thread and channel, so that concurrent readers (e.g.
+   // popping images while the GUI displays the latest one) do not interfere
+   thread_local std::vector<std::unique_ptr<mm::ImgBuffer>> unpacked;
+   if (unpacked.size() <= channel)
+      unpacked.resize(channel + 1);
+   std::unique_ptr<mm::ImgBuffer>& out = unpacked[channel];
+   if (!out)
+      out.reset(new mm::ImgBuffer(img->Width(), img->Height(), img->Depth()));
+   else
+      out->Resize(img->Width(), img->Height(), img->Depth());
+
+   mm::UnpackPixels(img->GetPixels(), (std::size_t)img->Width() * img->Height(),
+         img->PackedBits(), reinterpret_cast<std::uint16_t*>(out->GetPixelsRW()));
+   out->SetMetadata(img->GetMetadata());
+   return out.get();
+}
+
 const unsigned char* CircularBuffer::GetTopImage() const
 {
    const mm::ImgBuffer* img = GetNthFromTopImageBuffer(0, 0);
@@ -348,18 +466,22 @@ const mm::ImgBuffer* CircularBuffer::GetNthFromTopImageBuffer(unsigned long n) c
 const mm::ImgBuffer* CircularBuffer::GetNthFromTopImageBuffer(long n,
       unsigned channel) const
 {
-   MMThreadGuard guard(g_bufferLock);
+   const mm::ImgBuffer* img;
+   {
+      MMThreadGuard guard(g_bufferLock);
 
-   long availableImages = insertIndex_ - saveIndex_;
-   if (n + 1 > availableImages)
-      return 0;
+      long availableImages = insertIndex_ - saveIndex_;
+      if (n + 1 > availableImages)
+         return 0;
 
-   long targetIndex = insertIndex_ - n - 1L;
-   while (targetIndex < 0)
-      targetIndex += (long) frameArray_.size();
-   targetIndex %= frameArray_.size();
+      long targetIndex = insertIndex_ - n - 1L;
+      while (targetIndex < 0)
+         targetIndex += (long) frameArray_.size();
+      targetIndex %= frameArray_.size();
 
-   return frameArray_[targetIndex].FindImage(channel);
+      img = frameArray_[targetIndex].FindImage(channel);
+   }
+   return Unpacked(img, channel);
 }
 
 const unsigned char* CircularBuffer::GetNextImage()
@@ -371,14 +493,197 @@ const unsigned char* CircularBuffer::GetNextImage()
 }
 
 const mm::ImgBuffer* CircularBuffer::GetNextImageBuffer(unsigned channel)
+{
+   const mm::ImgBuffer* img;
+   bool changed;
+   double fill;
+   {
+      MMThreadGuard guard(g_bufferLock);
+
+      long availableImages = insertIndex_ - saveIndex_;
+      if (availableImages < 1)
+         return 0;
+
+      long targetIndex = saveIndex_ % frameArray_.size();
+      ++saveIndex_;
+      img = frameArray_[targetIndex].FindImage(channel);
+
+      changed = UpdateBackpressure();
+      fill = FillFraction();
+   }
+   if (changed)
+      NotifyBackpressure(false, fill);
+   return Unpacked(img, channel);
+}
+
+void CircularBuffer::SetBackpressureSettings(const BackpressureSettings& settings)
 {
    MMThreadGuard guard(g_bufferLock);
+   backpressureSettings_ = settings;
+   backpressureCount_ = 0;
+}
 
-   long availableImages = insertIndex_ - saveIndex_;
-   if (availableImages < 1)
-      return 0;
+CircularBuffer::BackpressureSettings CircularBuffer::GetBackpressureSettings() const
+{
+   MMThreadGuard guard(g_bufferLock);
+   return backpressureSettings_;
+}
+
+void CircularBuffer::SetBackpressureListener(BackpressureListener listener)
+{
+   MMThreadGuard guard(g_bufferLock);
+   backpressureListener_ = listener;
+}
+
+void CircularBuffer::SetSaturationListener(SaturationListener listener)
+{
+   MMThreadGuard guard(g_bufferLock);
+   saturationListener_ = listener;
+}
+
+bool CircularBuffer::IsBackpressureActive() const
+{
+   MMThreadGuard guard(g_bufferLock);
+   return backpressureActive_;
+}
+
+unsigned long CircularBuffer::GetDroppedImageCount() const
+{
+   MMThreadGuard guard(g_bufferLock);
+   return droppedImages_;
+}
+
+void CircularBuffer::SetPackingEnabled(bool enable)
+{
+   MMThreadGuard guard(g_bufferLock);
+   packingEnabled_ = enable;
+}
+
+bool CircularBuffer::IsPackingEnabled() const
+{
+   MMThreadGuard guard(g_bufferLock);
+   return packingEnabled_;
+}
+
+unsigned CircularBuffer::GetPackedBitDepth() const
+{
+   MMThreadGuard guard(g_bufferLock);
+   return packedBits_;
+}
+
+/**
+* Updates the backpressure state before inserting an image, and applies the
+* policy while it is active. Called with g_insertLock held.
+* Returns true if the image is to be dropped.
+*/
+bool CircularBuffer::ApplyBackpressure(unsigned numChannels, const Metadata* pMd)
+{
+   bool changed;
+   bool active;
+   double fill;
+   BackpressureSettings settings;
+   {
+      MMThreadGuard guard(g_bufferLock);
+      changed = UpdateBackpressure();
+      active = backpressureActive_;
+      fill = FillFraction();
+      settings = backpressureSettings_;
+   }
+   if (changed)
+      NotifyBackpressure(active, fill);
+   if (!active)
+      return false;
+
+   switch (settings.policy)
+   {
+      case BackpressurePause:
+      {
+         // Hold the camera's inserting thread (and thus, for most cameras,
+         // the triggering of new images) until the consumer catches up
+         using namespace std::chrono;
+         const steady_clock::time_point deadline =
+            steady_clock::now() + milliseconds(settings.parameter);
+         while (active && steady_clock::now() < deadline)
+         {
+            std::this_thread::sleep_for(milliseconds(1));
+            {
+               MMThreadGuard guard(g_bufferLock);
+               changed = UpdateBackpressure();
+               active = backpressureActive_;
+               fill = FillFraction();
+            }
+            if (changed)
+               NotifyBackpressure(active, fill);
+         }
+         return false;
+      }
+
+      case BackpressureDropEveryNth:
+      case BackpressureDecimate:
+      {
+         MMThreadGuard guard(g_bufferLock);
+         const long n = settings.parameter > 0 ? settings.parameter : 1;
+         const long k = backpressureCount_++;
+         const bool drop = (settings.policy == BackpressureDropEveryNth) ?
+            ((k + 1) % n == 0) : (k % n != 0);
+         if (!drop)
+            return false;
+
+         ++droppedImages_;
+         ++droppedSinceInsert_;
+         std::string cameraName;
+         if (pMd)
+         {
+            Metadata md(*pMd); // HasTag() is not const
+            if (md.HasTag("Camera"))
+               cameraName = md.GetSingleTag("Camera").GetValue();
+         }
+         imageNumbers_[cameraName] += numChannels;
+         return true;
+      }
+
+      default:
+         return false;
+   }
+}
+
+/**
+* Applies the watermarks to the current fill level. Called with g_bufferLock
+* held. Returns true if the backpressure state changed.
+*/
+bool CircularBuffer::UpdateBackpressure()
+{
+   if (frameArray_.empty())
+      return false;
+
+   const double fill = FillFraction();
+   bool active = backpressureActive_;
+   if (!active && fill >= backpressureSettings_.highWatermark)
+      active = true;
+   else if (active && fill <= backpressureSettings_.lowWatermark)
+      active = false;
+   if (active == backpressureActive_)
+      return false;
+
+   backpressureActive_ = active;
+   backpressureCount_ = 0;
+   return true;
+}
 
-   long targetIndex = saveIndex_ % frameArray_.size();
-   ++saveIndex_;
-   return frameArray_[targetIndex].FindImage(channel);
+double CircularBuffer::FillFraction() const
+{
+   if (frameArray_.empty())
+      return 0.0;
+   return static_cast<double>(insertIndex_ - saveIndex_) / frameArray_.size();
+}
+
+void CircularBuffer::NotifyBackpressure(bool active, double fillFraction)
+{
+   BackpressureListener listener;
+   {
+      MMThreadGuard guard(g_bufferLock);
+      listener = backpressureListener_;
+   }
+   if (listener)
+      listener(active, fillFraction);
 }
@@ -32,6 +32,7 @@
 #include "../MMDevice/MMDevice.h"
 
 #include <chrono>
+#include <functional>
 #include <memory>
 #include <vector>
 
@@ -48,16 +49,51 @@
 
 class ThreadPool;
 class TaskSet_CopyMemory;
+class TaskSet_PackPixels;
 
 class CircularBuffer
 {
 public:
+   /// What to do with incoming images while the buffer is above its high
+   /// watermark.
+   enum BackpressurePolicy
+   {
+      BackpressureNone, // Store all images (until overflow)
+      BackpressureDropEveryNth, // Drop every Nth image
+      BackpressureDecimate, // Store only every Nth image
+      BackpressurePause, // Block the inserting thread for up to N ms
+   };
+
+   struct BackpressureSettings
+   {
+      double highWatermark = 0.8; // Fraction of the buffer size
+      double lowWatermark = 0.5;
+      BackpressurePolicy policy = BackpressureNone;
+      long parameter = 2; // N
+   };
+
+   /// Called, without the buffer locks held, when the fill level crosses the
+   /// high watermark (active) or drops to the low watermark (inactive).
+   typedef std::function<void (bool active, double fillFraction)>
+      BackpressureListener;
+
+   /// Called, without the buffer locks held, for the first image since
+   /// Initialize() or Clear() that had pixel values saturated by packing
+   /// (because they exceed the bit depth given to Initialize()).
+   typedef std::function<void (std::size_t saturatedPixels, unsigned bitDepth)>
+      SaturationListener;
+
    CircularBuffer(unsigned int memorySizeMB);
    ~CircularBuffer();
 
    unsigned GetMemorySizeMB() const { return memorySizeMB_; }
 
-   bool Initialize(unsigned channels, unsigned int xSize, unsigned int ySize, unsigned int pixDepth);
+   // bitDepth is the number of significant bits of the pixels, if known; it
+   // selects packed storage for 16-bit images if packing is enabled
+   bool Initialize(unsigned channels, unsigned int xSize, unsigned int ySize, unsigned int pixDepth, unsigned int bitDepth = 0);
+   // Changes whenever Initialize() changes the image format (and discards
+   // the images); unique across all buffers
+   unsigned long GetFormatGeneration() const;
    unsigned long GetSize() const;
    unsigned long GetFreeSize() const;
    unsigned long GetRemainingImageCount() const;
@@ -80,13 +116,41 @@ public:
 
    bool Overflow() {MMThreadGuard guard(g_bufferLock); return overflow_;}
 
+   void SetBackpressureSettings(const BackpressureSettings& settings);
+   BackpressureSettings GetBackpressureSettings() const;
+   void SetBackpressureListener(BackpressureListener listener);
+   bool IsBackpressureActive() const;
+   unsigned long GetDroppedImageCount() const;
+
+   // Store 16-bit images of 10, 12 or 14 significant bits bit-packed, so that
+   // more images fit; takes effect at the next Initialize(). Packed images are
+   // unpacked when retrieved (by any of the Get...Image...() functions above),
+   // into a per-thread, per-channel buffer: unlike an image stored unpacked,
+   // the returned image stays valid only until the same thread retrieves
+   // another image of the same channel (from any buffer), so callers must copy
+   // the pixels before retrieving the next image.
+   void SetPackingEnabled(bool enable);
+   bool IsPackingEnabled() const;
+   // The bit depth of the packed images, or 0 if images are stored unpacked
+   unsigned GetPackedBitDepth() const;
+   void SetSaturationListener(SaturationListener listener);
+
    mutable MMThreadLock g_bufferLock;
    mutable MMThreadLock g_insertLock;
 
 private:
+   bool ApplyBackpressure(unsigned numChannels, const Metadata* pMd);
+   bool UpdateBackpressure();
+   double FillFraction() const;
+   void NotifyBackpressure(bool active, double fillFraction);
+   const mm::ImgBuffer* Unpacked(const mm::ImgBuffer* img,
+         unsigned channel) const;
+
    unsigned int width_;
    unsigned int height_;
    unsigned int pixDepth_;
+   bool packingEnabled_;
+   unsigned int packedBits_; // 0 if stored unpacked
    long imageCounter_;
    std::chrono::time_point<std::chrono::steady_clock> startTime_;
    std::map<std::string, long> imageNumbers_;
@@ -102,8 +166,23 @@ private:
    bool overflow_;
    std::vector<mm::FrameBuffer> frameArray_;
 
+   // Backpressure state, synchronized by g_bufferLock. Once active, it stays
+   // so until the fill level drops to the low watermark.
+   BackpressureSettings backpressureSettings_;
+   BackpressureListener backpressureListener_;
+   bool backpressureActive_;
+   long backpressureCount_; // Images offered since becoming active
+   unsigned long droppedImages_; // Since Clear()
+   unsigned long droppedSinceInsert_;
+
+   SaturationListener saturationListener_;
+   bool saturationReported_; // Since Initialize() or Clear()
+
+   unsigned long formatGeneration_;
+
    std::shared_ptr<ThreadPool> threadPool_;
    std::shared_ptr<TaskSet_CopyMemory> tasksMemCopy_;
+   std::shared_ptr<TaskSet_PackPixels> tasksPackPixels_;
 };
 
 #if defined(__GNUC__) && !defined(__clang__)
@@ -31,6 +31,13 @@
 #include "CircularBuffer.h"
 #include "CoreCallback.h"
 #include "DeviceManager.h"
+#include "DeviceTrace.h"
+#include "LivePropertyChanges.h"
+#include "MoveScheduler.h"
+#include "ProcessedImageTracker.h"
+#include "SoftwareBinning.h"
+#include "StateLog.h"
+#include "XYScan.h"
 
 #include <cassert>
 #include <chrono>
@@ -207,6 +214,12 @@ CoreCallback::Sleep(const MM::Device*, double intervalMs)
 /**
  * Get the metadata tags attached to device caller, and merge them with metadata
  * in pMd (if not null). Returns a metadata object.
+ *
+ * This is called once per frame, so it also requests queued live property
+ * changes (CMMCore::setPropertyAtNextFrame()) to be applied. They are applied
+ * from a Core thread, because the camera may hold its own locks while it
+ * inserts the image. It also marks the camera's buffer as holding a new
+ * image, for getImage() during a sequence acquisition.
  */
 Metadata
 CoreCallback::AddCameraMetadata(const MM::Device* caller, const Metadata* pMd)
@@ -224,6 +237,33 @@ CoreCallback::AddCameraMetadata(const MM::Device* caller, const Metadata* pMd)
    std::string label = camera->GetLabel();
    newMD.put("Camera", label);
 
+   const mm::LivePropertyChanges::Changes applied =
+      core_->livePropertyChanges_->TakeApplied(caller);
+   for (const auto& change : applied)
+   {
+      newMD.put("LivePropertyChange-" + label + "-" + change.first,
+            change.second);
+   }
+   core_->livePropertyChanges_->FrameReceived(caller);
+   core_->processedImageTracker_->NewSnap();
+
+   std::shared_ptr<mm::XYScan> scan = std::atomic_load(&core_->xyScan_);
+   double scanX, scanY;
+   if (scan && scan->StampFrame(caller, mm::XYScan::Clock::now(), scanX, scanY))
+   {
+      newMD.put("ScanXPositionUm", CDeviceUtils::ConvertToString(scanX));
+      newMD.put("ScanYPositionUm", CDeviceUtils::ConvertToString(scanY));
+   }
+
+   if (core_->stateLog_->IsFrameDeltaEnabled())
+   {
+      std::vector<mm::StateLog::Setting> delta;
+      const long version = core_->stateLog_->TakeFrameDelta(label, delta);
+      newMD.put("StateVersion", CDeviceUtils::ConvertToString(version));
+      for (const auto& s : delta)
+         newMD.put("StateDelta-" + s.device + "-" + s.property, s.value);
+   }
+
    std::string serializedMD;
    try
    {
@@ -241,6 +281,78 @@ CoreCallback::AddCameraMetadata(const MM::Device* caller, const Metadata* pMd)
    return newMD;
 }
 
+void
+CoreCallback::RecordTraceFrame(const MM::Device* caller,
+      const unsigned char* buf, unsigned width, unsigned height,
+      unsigned byteDepth, unsigned nComponents)
+{
+   std::shared_ptr<mm::DeviceTraceRecorder> recorder =
+      std::atomic_load(&core_->deviceTraceRecorder_);
+   if (!recorder)
+      return;
+
+   mm::DeviceTraceRecorder::ImageInfo info;
+   info.width = width;
+   info.height = height;
+   info.bytesPerPixel = byteDepth;
+   info.components = nComponents;
+   recorder->RecordFrame(core_->deviceManager_->GetDevice(caller)->GetLabel(),
+         info, buf, mm::DeviceTraceRecorder::Clock::now());
+}
+
+/**
+ * Reduces an image (of numChannels consecutive channels) by software binning
+ * and cropping, if enabled, replacing buf, width, and height. A component
+ * count of 0 means that the inserting camera did not give it.
+ */
+void CoreCallback::ApplySoftwareBinning(const unsigned char*& buf,
+      unsigned& width, unsigned& height, unsigned byteDepth,
+      unsigned nComponents, unsigned numChannels, Metadata& md)
+{
+   const mm::SoftwareBinning::Settings settings =
+      core_->softwareBinning_->GetSettings();
+   if (!settings.IsActive())
+      return;
+
+   if (nComponents == 0)
+   {
+      nComponents = core_->softwareBinning_->GetCameraComponents();
+      if (!mm::SoftwareBinning::IsSupportedFormat(byteDepth, nComponents))
+         nComponents = 1;
+   }
+
+   unsigned outWidth, outHeight;
+   mm::SoftwareBinning::GetOutputSize(settings, width, height,
+         outWidth, outHeight);
+   const std::size_t inSize = static_cast<std::size_t>(width) * height *
+      byteDepth;
+   const std::size_t outSize = static_cast<std::size_t>(outWidth) *
+      outHeight * byteDepth;
+
+   // Valid until the next image inserted from this thread, by which time the
+   // circular buffer has copied it
+   thread_local std::vector<unsigned char> reduced;
+   reduced.resize(outSize * numChannels);
+   for (unsigned channel = 0; channel < numChannels; ++channel)
+   {
+      mm::SoftwareBinning::Reduce(settings, buf + channel * inSize, width,
+            height, byteDepth, nComponents, reduced.data() + channel * outSize);
+   }
+   buf = reduced.data();
+   width = outWidth;
+   height = outHeight;
+
+   if (settings.binning > 1)
+      md.PutImageTag("SoftwareBinning", settings.binning);
+   if (settings.cropped)
+   {
+      md.PutImageTag("SoftwareCrop", std::to_string(settings.cropX) + "-" +
+            std::to_string(settings.cropY) + "-" +
+            std::to_string(settings.cropWidth) + "-" +
+            std::to_string(settings.cropHeight));
+   }
+}
+
 int CoreCallback::InsertImage(const MM::Device* caller, const unsigned char* buf, unsigned width, unsigned height, unsigned byteDepth, const char* serializedMetadata, const bool doProcess)
 {
    Metadata md;
@@ -252,6 +364,7 @@ int CoreCallback::InsertImage(const MM::Device* caller, const unsigned char* buf
 {
    try 
    {
+      RecordTraceFrame(caller, buf, width, height, byteDepth, 1);
       Metadata md = AddCameraMetadata(caller, pMd);
 
       if(doProcess)
@@ -262,6 +375,7 @@ int CoreCallback::InsertImage(const MM::Device* caller, const unsigned char* buf
             ip->Process(const_cast<unsigned char*>(buf), width, height, byteDepth);
          }
       }
+      ApplySoftwareBinning(buf, width, height, byteDepth, 0, 1, md);
       if (core_->cbuf_->InsertImage(buf, width, height, byteDepth, &md))
          return DEVICE_OK;
       else
@@ -284,6 +398,7 @@ int CoreCallback::InsertImage(const MM::Device* caller, const unsigned char* buf
 {
    try 
    {
+      RecordTraceFrame(caller, buf, width, height, byteDepth, nComponents);
       Metadata md = AddCameraMetadata(caller, pMd);
 
       if(doProcess)
@@ -294,6 +409,7 @@ int CoreCallback::InsertImage(const MM::Device* caller, const unsigned char* buf
             ip->Process(const_cast<unsigned char*>(buf), width, height, byteDepth);
          }
       }
+      ApplySoftwareBinning(buf, width, height, byteDepth, nComponents, 1, md);
       if (core_->cbuf_->InsertImage(buf, width, height, byteDepth, nComponents, &md))
          return DEVICE_OK;
       else
@@ -324,14 +440,63 @@ void CoreCallback::ClearImageBuffer(const MM::Device* /*caller*/)
    core_->cbuf_->Clear();
 }
 
+bool CoreCallback::InitializeImageBuffer(const MM::Device* caller,
+      unsigned channels, unsigned slices,
+      unsigned int w, unsigned int h, unsigned int pixDepth)
+{
+   unsigned bitDepth = 0;
+   try
+   {
+      std::shared_ptr<DeviceInstance> device =
+         core_->deviceManager_->GetDevice(caller);
+      if (device->GetType() == MM::CameraDevice)
+         bitDepth = core_->getCircularBufferBitDepth(
+               std::static_pointer_cast<CameraInstance>(device));
+   }
+   catch (const CMMError&)
+   {
+      // Not a loaded device; store the images unpacked
+   }
+   return InitializeImageBufferForBitDepth(channels, slices, w, h, pixDepth,
+         bitDepth);
+}
+
 bool CoreCallback::InitializeImageBuffer(unsigned channels, unsigned slices,
       unsigned int w, unsigned int h, unsigned int pixDepth)
+{
+   // The caller, and hence the bit depth of its images, is not known, so the
+   // images are stored unpacked
+   return InitializeImageBufferForBitDepth(channels, slices, w, h, pixDepth, 0);
+}
+
+bool CoreCallback::InitializeImageBufferForBitDepth(unsigned channels,
+      unsigned slices, unsigned int w, unsigned int h, unsigned int pixDepth,
+      unsigned bitDepth)
 {
    // Support for multi-slice images has not been implemented
    if (slices != 1)
       return false;
 
-   return core_->cbuf_->Initialize(channels, w, h, pixDepth);
+   const mm::SoftwareBinning::Settings settings =
+      core_->softwareBinning_->GetSettings();
+   if (settings.IsActive())
+   {
+      try
+      {
+         mm::SoftwareBinning::GetOutputSize(settings, w, h, w, h);
+      }
+      catch (const CMMError&)
+      {
+         return false;
+      }
+   }
+
+   return core_->cbuf_->Initialize(channels, w, h, pixDepth, bitDepth);
+}
+
+bool CoreCallback::IsImageBufferBackpressured(const MM::Device* /*caller*/)
+{
+   return core_->cbuf_->IsBackpressureActive();
 }
 
 int CoreCallback::InsertMultiChannel(const MM::Device* caller,
@@ -351,6 +516,7 @@ int CoreCallback::InsertMultiChannel(const MM::Device* caller,
       {
          ip->Process( const_cast<unsigned char*>(buf), width, height, byteDepth);
       }
+      ApplySoftwareBinning(buf, width, height, byteDepth, 0, numChannels, md);
       if (core_->cbuf_->InsertMultiChannel(buf, numChannels, width, height, byteDepth, &md))
          return DEVICE_OK;
       else
@@ -380,7 +546,7 @@ int CoreCallback::AcqFinished(const MM::Device* caller, int /*statusCode*/)
    std::shared_ptr<DeviceInstance> currentCamera =
       core_->currentCameraDevice_.lock();
 
-   if (core_->autoShutter_)
+   if (core_->autoShutter_ && !core_->isShutterHeldForArmedSequence(caller))
    {
       std::shared_ptr<ShutterInstance> shutter =
          core_->currentShutterDevice_.lock();
@@ -426,9 +592,9 @@ int CoreCallback::AcqFinished(const MM::Device* caller, int /*statusCode*/)
    return DEVICE_OK;
 }
 
-int CoreCallback::PrepareForAcq(const MM::Device* /*caller*/)
+int CoreCallback::PrepareForAcq(const MM::Device* caller)
 {
-   if (core_->autoShutter_)
+   if (core_->autoShutter_ && !core_->isShutterHeldForArmedSequence(caller))
    {
       std::shared_ptr<ShutterInstance> shutter =
          core_->currentShutterDevice_.lock();
@@ -447,8 +613,20 @@ int CoreCallback::PrepareForAcq(const MM::Device* /*caller*/)
 /**
  * Handler for the property change event from the device.
  */
-int CoreCallback::OnPropertiesChanged(const MM::Device* /* caller */)
+int CoreCallback::OnPropertiesChanged(const MM::Device* caller)
 {
+   try
+   {
+      std::shared_ptr<DeviceInstance> pDevice =
+         core_->deviceManager_->GetDevice(caller);
+      if (pDevice)
+         pDevice->InvalidateConfirmedPropertyValues();
+   }
+   catch (const CMMError&)
+   {
+      // Not a registered device; nothing to invalidate
+   }
+
    if (core_->externalCallback_)
       core_->externalCallback_->onPropertiesChanged();
 
@@ -463,6 +641,26 @@ int CoreCallback::OnPropertiesChanged(const MM::Device* /* caller */)
  */
 int CoreCallback::OnPropertyChanged(const MM::Device* device, const char* propName, const char* value)
 {
+   {
+      // State devices report new positions through their properties; let
+      // any pending asynchronous move know that it may have finished.
+      char label[MM::MaxStrLength];
+      device->GetLabel(label);
+      core_->moveScheduler_->Notify(label);
+   }
+
+   try
+   {
+      std::shared_ptr<DeviceInstance> pDevice =
+         core_->deviceManager_->GetDevice(device);
+      if (pDevice)
+         pDevice->InvalidateConfirmedPropertyValue(propName);
+   }
+   catch (const CMMError&)
+   {
+      // Not a registered device; nothing to invalidate
+   }
+
    if (core_->externalCallback_) 
    {
       MMThreadGuard g(*pValueChangeLock_);
@@ -473,7 +671,7 @@ int CoreCallback::OnPropertyChanged(const MM::Device* device, const char* propNa
       const PropertySetting* ps = new PropertySetting(label, propName, value, readOnly);
       {
          MMThreadGuard scg(core_->stateCacheLock_);
-         core_->stateCache_.addSetting(*ps);
+         core_->addStateCacheSetting(*ps);
       }
       core_->externalCallback_->onPropertyChanged(label, propName, value);
 
@@ -583,6 +781,14 @@ int CoreCallback::OnPixelSizeAffineChanged(std::vector<double> newPixelSizeAffin
  */
 int CoreCallback::OnStagePositionChanged(const MM::Device* device, double pos)
 {
+   {
+      char label[MM::MaxStrLength];
+      device->GetLabel(label);
+      core_->moveScheduler_->Notify(label);
+      core_->stateLog_->Record(label, "PositionUm",
+            CDeviceUtils::ConvertToString(pos), true);
+   }
+
    if (core_->externalCallback_) {
       char label[MM::MaxStrLength];
       device->GetLabel(label);
@@ -597,6 +803,16 @@ int CoreCallback::OnStagePositionChanged(const MM::Device* device, double pos)
  */
 int CoreCallback::OnXYStagePositionChanged(const MM::Device* device, double xPos, double yPos)
 {
+   {
+      char label[MM::MaxStrLength];
+      device->GetLabel(label);
+      core_->moveScheduler_->Notify(label);
+      core_->stateLog_->Record(label, "XPositionUm",
+            CDeviceUtils::ConvertToString(xPos), true);
+      core_->stateLog_->Record(label, "YPositionUm",
+            CDeviceUtils::ConvertToString(yPos), true);
+   }
+
    if (core_->externalCallback_) {
       char label[MM::MaxStrLength];
       device->GetLabel(label);
@@ -92,7 +92,9 @@ public:
 
    /*Deprecated*/ int InsertMultiChannel(const MM::Device* caller, const unsigned char* buf, unsigned numChannels, unsigned width, unsigned height, unsigned byteDepth, Metadata* pMd = 0);
    void ClearImageBuffer(const MM::Device* caller);
-   bool InitializeImageBuffer(unsigned channels, unsigned slices, unsigned int w, unsigned int h, unsigned int pixDepth);
+   bool InitializeImageBuffer(const MM::Device* caller, unsigned channels, unsigned slices, unsigned int w, unsigned int h, unsigned int pixDepth);
+   /*Deprecated*/ bool InitializeImageBuffer(unsigned channels, unsigned slices, unsigned int w, unsigned int h, unsigned int pixDepth);
+   bool IsImageBufferBackpressured(const MM::Device* caller);
 
    int AcqFinished(const MM::Device* caller, int statusCode);
    int PrepareForAcq(const MM::Device* caller);
@@ -141,6 +143,15 @@ private:
    MMThreadLock* pValueChangeLock_;
 
    Metadata AddCameraMetadata(const MM::Device* caller, const Metadata* pMd);
+   void RecordTraceFrame(const MM::Device* caller, const unsigned char* buf,
+         unsigned width, unsigned height, unsigned byteDepth,
+         unsigned nComponents);
+   void ApplySoftwareBinning(const unsigned char*& buf, unsigned& width,
+         unsigned& height, unsigned byteDepth, unsigned nComponents,
+         unsigned numChannels, Metadata& md);
+   bool InitializeImageBufferForBitDepth(unsigned channels, unsigned slices,
+         unsigned int w, unsigned int h, unsigned int pixDepth,
+         unsigned bitDepth);
 
    int OnConfigGroupChanged(const char* groupName, const char* newConfigName);
    int OnPixelSizeChanged(double newPixelSizeUm);
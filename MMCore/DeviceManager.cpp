@@ -22,6 +22,7 @@
 #include "Devices/DeviceInstance.h"
 #include "Error.h"
 #include "LoadableModules/LoadedDeviceAdapter.h"
+#include "ModuleLockProfiler.h"
 
 #include <algorithm>
 
@@ -292,9 +293,67 @@ DeviceManager::GetParentDevice(std::shared_ptr<DeviceInstance> device) const
 }
 
 
-DeviceModuleLockGuard::DeviceModuleLockGuard(std::shared_ptr<DeviceInstance> device) :
-   g_(device->GetAdapterModule()->GetLock())
-{}
+DeviceModuleLockGuard::DeviceModuleLockGuard(std::shared_ptr<DeviceInstance> device,
+      const char* caller) :
+   lock_(0),
+   caller_(caller),
+   waitMs_(0.0)
+{
+   std::shared_ptr<LoadedDeviceAdapter> module = device->GetAdapterModule();
+   lock_ = module->GetLock();
+   profiler_ = module->GetLockProfiler();
+   if (!profiler_)
+   {
+      if (lock_)
+         lock_->Lock();
+      return;
+   }
+
+   module_ = module;
+   const std::chrono::steady_clock::time_point start =
+      std::chrono::steady_clock::now();
+   if (lock_)
+      lock_->Lock();
+   acquired_ = std::chrono::steady_clock::now();
+   waitMs_ = std::chrono::duration<double, std::milli>(acquired_ - start).count();
+   ModuleLockProfiler::EnterContext(module_->GetName(), caller_);
+}
+
+
+DeviceModuleLockGuard::~DeviceModuleLockGuard()
+{
+   if (!profiler_)
+   {
+      if (lock_)
+         lock_->Unlock();
+      return;
+   }
+
+   const double holdMs = std::chrono::duration<double, std::milli>(
+         std::chrono::steady_clock::now() - acquired_).count();
+   std::string context;
+   if (profiler_->IsLongestHold(holdMs))
+      context = ModuleLockProfiler::CurrentContext();
+   ModuleLockProfiler::LeaveContext();
+   if (lock_)
+      lock_->Unlock();
+   profiler_->Record(module_->GetName(), caller_, waitMs_, holdMs, context);
+}
+
+
+DeviceModuleTryLockGuard::DeviceModuleTryLockGuard(std::shared_ptr<DeviceInstance> device) :
+   lock_(device->GetAdapterModule()->GetLock())
+{
+   if (lock_ && !lock_->TryLock())
+      lock_ = 0;
+}
+
+
+DeviceModuleTryLockGuard::~DeviceModuleTryLockGuard()
+{
+   if (lock_)
+      lock_->Unlock();
+}
 
 
 } // namespace mm
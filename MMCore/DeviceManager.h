@@ -24,11 +24,20 @@
 #include "Error.h"
 #include "Logging/Logger.h"
 
+#include <chrono>
 #include <map>
 #include <memory>
 #include <string>
 #include <vector>
 
+// Name of the calling function, used as a default argument
+#if defined(__GNUC__) || defined(__clang__) || \
+   (defined(_MSC_VER) && _MSC_VER >= 1929)
+#  define MMCORE_CALLER_FUNCTION __builtin_FUNCTION()
+#else
+#  define MMCORE_CALLER_FUNCTION "(unknown)"
+#endif
+
 class CMMCore;
 class HubInstance;
 class LoadedDeviceAdapter;
@@ -37,6 +46,8 @@ class LoadedDeviceAdapter;
 namespace mm
 {
 
+class ModuleLockProfiler;
+
 class DeviceManager /* final */
 {
    // Store devices in an ordered container. We could use a map or hash map to
@@ -132,12 +143,40 @@ public:
 };
 
 
-// Scoped acquisition of a device's module's lock
+// Scoped acquisition of a device's module's lock. If lock profiling is
+// enabled for the module, the wait and hold times are recorded for the
+// calling function.
 class DeviceModuleLockGuard
 {
-   MMThreadGuard g_;
+   MMThreadLock* lock_;
+   std::shared_ptr<LoadedDeviceAdapter> module_; // Only when profiling
+   std::shared_ptr<ModuleLockProfiler> profiler_;
+   const char* caller_;
+   double waitMs_;
+   std::chrono::steady_clock::time_point acquired_;
+public:
+   explicit DeviceModuleLockGuard(std::shared_ptr<DeviceInstance> device,
+         const char* caller = MMCORE_CALLER_FUNCTION);
+   ~DeviceModuleLockGuard();
+
+private:
+   DeviceModuleLockGuard(const DeviceModuleLockGuard&);
+   DeviceModuleLockGuard& operator=(const DeviceModuleLockGuard&);
+};
+
+// Scoped acquisition of a device's module's lock, if it is not held by
+// another thread
+class DeviceModuleTryLockGuard
+{
+   MMThreadLock* lock_;
 public:
-   explicit DeviceModuleLockGuard(std::shared_ptr<DeviceInstance> device);
+   explicit DeviceModuleTryLockGuard(std::shared_ptr<DeviceInstance> device);
+   ~DeviceModuleTryLockGuard();
+   bool IsLocked() const { return lock_ != 0; }
+
+private:
+   DeviceModuleTryLockGuard(const DeviceModuleTryLockGuard&);
+   DeviceModuleTryLockGuard& operator=(const DeviceModuleTryLockGuard&);
 };
 
 } // namespace mm
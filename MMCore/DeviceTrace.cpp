@@ -0,0 +1,261 @@
+// PROJECT:       Micro-Manager
+// SUBSYSTEM:     MMCore
+//
+// DESCRIPTION:   Recording of device calls for later replay
+//
+// LICENSE:       This file is distributed under the "Lesser GPL" (LGPL) license.
+//                License text is included with the source distribution.
+//
+//                This file is distributed in the hope that it will be useful,
+//                but WITHOUT ANY WARRANTY; without even the implied warranty
+//                of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+//
+//                IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+//                CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+//                INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES.
+
+#include "DeviceTrace.h"
+
+#include "CoreUtils.h"
+
+#include <cstring>
+
+namespace mm
+{
+
+namespace
+{
+
+const char* const fileHeader = "# Micro-Manager device trace 1";
+
+std::string Sanitized(const std::string& value)
+{
+   std::string result(value);
+   for (char& ch : result)
+   {
+      if (ch == '\t' || ch == '\r' || ch == '\n')
+         ch = ' ';
+   }
+   return result;
+}
+
+bool ChangesState(const char* function)
+{
+   return std::strcmp(function, "Busy") != 0 &&
+      std::strncmp(function, "Get", 3) != 0;
+}
+
+} // anonymous namespace
+
+
+DeviceTraceRecorder::DeviceTraceRecorder(const std::string& filename) :
+   filename_(filename),
+   startTime_(Clock::now()),
+   closed_(false),
+   failed_(false),
+   recordCount_(0),
+   pixelFileSize_(0)
+{
+   file_.open(filename_.c_str(), std::ios::trunc);
+   pixelFile_.open((filename_ + ".pixels").c_str(),
+         std::ios::trunc | std::ios::binary);
+   if (!file_ || !pixelFile_)
+      throw CMMError("Cannot create device trace file " +
+            ToQuotedString(filename_));
+   file_ << fileHeader << '\n';
+}
+
+
+DeviceTraceRecorder::~DeviceTraceRecorder()
+{
+   try
+   {
+      Close();
+   }
+   catch (const CMMError&)
+   {
+      // Nobody to report to
+   }
+}
+
+
+void
+DeviceTraceRecorder::RecordDevice(const std::string& label,
+      const std::string& adapter, const std::string& name,
+      MM::DeviceType type)
+{
+   std::lock_guard<std::mutex> lock(mutex_);
+   if (closed_)
+      return;
+   file_ << "Device\t" << Sanitized(label) << '\t' << Sanitized(adapter) <<
+      '\t' << Sanitized(name) << '\t' << static_cast<int>(type);
+   EndRecord();
+}
+
+
+void
+DeviceTraceRecorder::RecordProperty(const std::string& label,
+      const std::string& name, const std::string& value, bool readOnly)
+{
+   std::lock_guard<std::mutex> lock(mutex_);
+   if (closed_)
+      return;
+   file_ << "Property\t" << Sanitized(label) << '\t' << Sanitized(name) <<
+      '\t' << Sanitized(value) << '\t' << (readOnly ? 1 : 0);
+   EndRecord();
+}
+
+
+void
+DeviceTraceRecorder::RecordPositionLabel(const std::string& label,
+      long position, const std::string& positionLabel)
+{
+   std::lock_guard<std::mutex> lock(mutex_);
+   if (closed_)
+      return;
+   file_ << "PositionLabel\t" << Sanitized(label) << '\t' << position <<
+      '\t' << Sanitized(positionLabel);
+   EndRecord();
+}
+
+
+void
+DeviceTraceRecorder::RecordCall(const std::string& label,
+      const char* function, const std::string& arg, int ret,
+      const std::string& result, Clock::time_point start,
+      Clock::time_point end)
+{
+   std::lock_guard<std::mutex> lock(mutex_);
+   if (closed_)
+      return;
+
+   if (std::strcmp(function, "Busy") == 0)
+   {
+      auto it = lastBusyResults_.find(label);
+      if (it != lastBusyResults_.end() && it->second == result)
+         return;
+      lastBusyResults_[label] = result;
+   }
+   else if (ChangesState(function))
+   {
+      lastBusyResults_.erase(label);
+   }
+
+   file_ << "Call\t" << Microseconds(start) << '\t' <<
+      Microseconds(end) - Microseconds(start) << '\t' << Sanitized(label) <<
+      '\t' << function << '\t' << ret << '\t' << Sanitized(arg) << '\t' <<
+      Sanitized(result);
+   EndRecord();
+   ++recordCount_;
+}
+
+
+void
+DeviceTraceRecorder::RecordImage(const std::string& label,
+      const char* function, const std::string& arg, int ret,
+      const ImageInfo& info, const unsigned char* pixels,
+      Clock::time_point start, Clock::time_point end)
+{
+   std::lock_guard<std::mutex> lock(mutex_);
+   if (closed_)
+      return;
+   file_ << "Image\t" << Microseconds(start) << '\t' <<
+      Microseconds(end) - Microseconds(start) << '\t' << Sanitized(label) <<
+      '\t' << function << '\t' << ret << '\t' << Sanitized(arg) << '\t';
+   WritePixels(label, info, pixels);
+   EndRecord();
+   ++recordCount_;
+}
+
+
+void
+DeviceTraceRecorder::RecordFrame(const std::string& label,
+      const ImageInfo& info, const unsigned char* pixels,
+      Clock::time_point time)
+{
+   std::lock_guard<std::mutex> lock(mutex_);
+   if (closed_)
+      return;
+   file_ << "Frame\t" << Microseconds(time) << '\t' << Sanitized(label) <<
+      '\t';
+   WritePixels(label, info, pixels);
+   EndRecord();
+   ++recordCount_;
+}
+
+
+unsigned long long
+DeviceTraceRecorder::GetRecordCount() const
+{
+   std::lock_guard<std::mutex> lock(mutex_);
+   return recordCount_;
+}
+
+
+void
+DeviceTraceRecorder::Close()
+{
+   std::lock_guard<std::mutex> lock(mutex_);
+   if (closed_)
+      return;
+   closed_ = true;
+   file_.close();
+   pixelFile_.close();
+   lastImages_.clear();
+   if (failed_ || !file_ || !pixelFile_)
+      throw CMMError("Error writing device trace file " +
+            ToQuotedString(filename_));
+}
+
+
+long long
+DeviceTraceRecorder::Microseconds(Clock::time_point t) const
+{
+   return std::chrono::duration_cast<std::chrono::microseconds>(
+         t - startTime_).count();
+}
+
+
+void
+DeviceTraceRecorder::WritePixels(const std::string& label,
+      const ImageInfo& info, const unsigned char* pixels)
+{
+   const size_t size = pixels ? static_cast<size_t>(info.width) *
+      info.height * info.bytesPerPixel : 0;
+
+   long long offset = -1;
+   if (size > 0)
+   {
+      LastImage& last = lastImages_[label];
+      if (last.pixels.size() == size &&
+            std::memcmp(last.pixels.data(), pixels, size) == 0)
+      {
+         offset = last.offset;
+      }
+      else
+      {
+         offset = pixelFileSize_;
+         pixelFile_.write(reinterpret_cast<const char*>(pixels),
+               static_cast<std::streamsize>(size));
+         pixelFileSize_ += static_cast<long long>(size);
+         last.pixels.assign(pixels, pixels + size);
+         last.offset = offset;
+         if (!pixelFile_)
+            failed_ = true;
+      }
+   }
+
+   file_ << info.width << '\t' << info.height << '\t' << info.bytesPerPixel <<
+      '\t' << info.components << '\t' << offset << '\t' << size;
+}
+
+
+void
+DeviceTraceRecorder::EndRecord()
+{
+   file_ << '\n';
+   if (!file_)
+      failed_ = true;
+}
+
+} // namespace mm
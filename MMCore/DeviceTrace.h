@@ -0,0 +1,182 @@
+// PROJECT:       Micro-Manager
+// SUBSYSTEM:     MMCore
+//
+// DESCRIPTION:   Recording of device calls for later replay
+//
+// LICENSE:       This file is distributed under the "Lesser GPL" (LGPL) license.
+//                License text is included with the source distribution.
+//
+//                This file is distributed in the hope that it will be useful,
+//                but WITHOUT ANY WARRANTY; without even the implied warranty
+//                of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+//
+//                IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+//                CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+//                INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES.
+
+#pragma once
+
+#include "../MMDevice/MMDeviceConstants.h"
+#include "Error.h"
+
+#include <chrono>
+#include <cstddef>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace mm
+{
+
+/// Writes a trace of the calls made to devices.
+/**
+ * A trace consists of a text file with one tab-separated record per line,
+ * and a sidecar file (the trace filename with ".pixels" appended) holding
+ * the raw pixels of the images returned by cameras. Times are in
+ * microseconds since the start of recording.
+ *
+ *    # Micro-Manager device trace 1
+ *    Device<TAB>label<TAB>adapter<TAB>name<TAB>type
+ *    Property<TAB>label<TAB>name<TAB>value<TAB>readOnly
+ *    PositionLabel<TAB>label<TAB>position<TAB>positionLabel
+ *    Call<TAB>time<TAB>duration<TAB>label<TAB>function<TAB>return<TAB>arg<TAB>result
+ *    Image<TAB>time<TAB>duration<TAB>label<TAB>function<TAB>return<TAB>arg<TAB>width<TAB>height<TAB>bytesPerPixel<TAB>components<TAB>offset<TAB>size
+ *    Frame<TAB>time<TAB>label<TAB>width<TAB>height<TAB>bytesPerPixel<TAB>components<TAB>offset<TAB>size
+ *
+ * Device, Property and PositionLabel records describe the state of each
+ * device when it starts being recorded. Call records are written when the
+ * device function returns; Image records are calls that return an image, and
+ * Frame records are images inserted by cameras during sequence acquisition.
+ * Offset and size locate the pixels in the sidecar file; an image identical
+ * to the previous one from the same device is not written again.
+ *
+ * To keep traces of status polling compact, a Busy() call is only recorded
+ * if its result differs from that of the previously recorded Busy() call of
+ * the same device, with no other state-changing call in between.
+ *
+ * Recording errors do not interrupt the device calls; they are reported by
+ * Close().
+ */
+class DeviceTraceRecorder /* final */
+{
+public:
+   typedef std::chrono::steady_clock Clock;
+
+   struct ImageInfo
+   {
+      unsigned width;
+      unsigned height;
+      unsigned bytesPerPixel;
+      unsigned components;
+   };
+
+   /// Throws CMMError if the trace files cannot be created.
+   explicit DeviceTraceRecorder(const std::string& filename);
+   ~DeviceTraceRecorder();
+
+   DeviceTraceRecorder(const DeviceTraceRecorder&) = delete;
+   DeviceTraceRecorder& operator=(const DeviceTraceRecorder&) = delete;
+
+   std::string GetFilename() const { return filename_; }
+
+   void RecordDevice(const std::string& label, const std::string& adapter,
+         const std::string& name, MM::DeviceType type);
+   void RecordProperty(const std::string& label, const std::string& name,
+         const std::string& value, bool readOnly);
+   void RecordPositionLabel(const std::string& label, long position,
+         const std::string& positionLabel);
+
+   void RecordCall(const std::string& label, const char* function,
+         const std::string& arg, int ret, const std::string& result,
+         Clock::time_point start, Clock::time_point end);
+   void RecordImage(const std::string& label, const char* function,
+         const std::string& arg, int ret, const ImageInfo& info,
+         const unsigned char* pixels,
+         Clock::time_point start, Clock::time_point end);
+   void RecordFrame(const std::string& label, const ImageInfo& info,
+         const unsigned char* pixels, Clock::time_point time);
+
+   /// Number of Call, Image and Frame records written so far.
+   unsigned long long GetRecordCount() const;
+
+   /**
+    * \brief Finish writing the trace.
+    *
+    * Throws CMMError if any part of the trace could not be written. Records
+    * passed after closing are ignored.
+    */
+   void Close();
+
+private:
+   // Called with mutex_ held
+   long long Microseconds(Clock::time_point t) const;
+   void WritePixels(const std::string& label, const ImageInfo& info,
+         const unsigned char* pixels);
+   void EndRecord();
+
+   const std::string filename_;
+   const Clock::time_point startTime_;
+
+   mutable std::mutex mutex_;
+   std::ofstream file_;
+   std::ofstream pixelFile_;
+   bool closed_;
+   bool failed_;
+   unsigned long long recordCount_;
+   long long pixelFileSize_;
+
+   struct LastImage
+   {
+      std::vector<unsigned char> pixels;
+      long long offset;
+   };
+   std::map<std::string, LastImage> lastImages_; // By device label
+   std::map<std::string, std::string> lastBusyResults_; // By device label
+};
+
+
+/// Times a single device call for DeviceTraceRecorder.
+/**
+ * Constructed just before calling the device; does nothing if the recorder
+ * is null, so that device calls are not slowed down when not recording.
+ */
+class DeviceTraceCall /* final */
+{
+   std::shared_ptr<DeviceTraceRecorder> recorder_;
+   const std::string* label_;
+   DeviceTraceRecorder::Clock::time_point start_;
+
+public:
+   DeviceTraceCall(std::shared_ptr<DeviceTraceRecorder> recorder,
+         const std::string& label) :
+      recorder_(recorder),
+      label_(&label)
+   {
+      if (recorder_)
+         start_ = DeviceTraceRecorder::Clock::now();
+   }
+
+   bool IsActive() const { return recorder_ != nullptr; }
+
+   void Record(const char* function, const std::string& arg, int ret,
+         const std::string& result = std::string()) const
+   {
+      if (recorder_)
+         recorder_->RecordCall(*label_, function, arg, ret, result, start_,
+               DeviceTraceRecorder::Clock::now());
+   }
+
+   void RecordImage(const char* function, const std::string& arg, int ret,
+         const DeviceTraceRecorder::ImageInfo& info,
+         const unsigned char* pixels) const
+   {
+      if (recorder_)
+         recorder_->RecordImage(*label_, function, arg, ret, info, pixels,
+               start_, DeviceTraceRecorder::Clock::now());
+   }
+};
+
+} // namespace mm
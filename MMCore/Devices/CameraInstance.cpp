@@ -22,9 +22,38 @@
 #include "CameraInstance.h"
 
 
-int CameraInstance::SnapImage() { RequireInitialized(__func__); return GetImpl()->SnapImage(); }
-const unsigned char* CameraInstance::GetImageBuffer() { RequireInitialized(__func__); return GetImpl()->GetImageBuffer(); }
-const unsigned char* CameraInstance::GetImageBuffer(unsigned channelNr) { RequireInitialized(__func__); return GetImpl()->GetImageBuffer(channelNr); }
+
+int CameraInstance::SnapImage()
+{
+   RequireInitialized(__func__);
+   const mm::DeviceTraceCall trace = BeginTraceCall();
+   int ret = GetImpl()->SnapImage();
+   trace.Record("SnapImage", std::string(), ret);
+   return ret;
+}
+
+const unsigned char* CameraInstance::GetImageBuffer()
+{
+   RequireInitialized(__func__);
+   const mm::DeviceTraceCall trace = BeginTraceCall();
+   const unsigned char* pixels = GetImpl()->GetImageBuffer();
+   if (trace.IsActive())
+      trace.RecordImage("GetImageBuffer", std::string(),
+            pixels ? DEVICE_OK : DEVICE_ERR, GetTraceImageInfo(), pixels);
+   return pixels;
+}
+
+const unsigned char* CameraInstance::GetImageBuffer(unsigned channelNr)
+{
+   RequireInitialized(__func__);
+   const mm::DeviceTraceCall trace = BeginTraceCall();
+   const unsigned char* pixels = GetImpl()->GetImageBuffer(channelNr);
+   if (trace.IsActive())
+      trace.RecordImage("GetImageBuffer", ToString(channelNr),
+            pixels ? DEVICE_OK : DEVICE_ERR, GetTraceImageInfo(), pixels);
+   return pixels;
+}
+
 const unsigned int* CameraInstance::GetImageBufferAsRGB32() { RequireInitialized(__func__); return GetImpl()->GetImageBufferAsRGB32(); }
 unsigned CameraInstance::GetNumberOfComponents() const { RequireInitialized(__func__); return GetImpl()->GetNumberOfComponents(); }
 
@@ -57,8 +86,26 @@ unsigned CameraInstance::GetBitDepth() const { RequireInitialized(__func__); ret
 double CameraInstance::GetPixelSizeUm() const { RequireInitialized(__func__); return GetImpl()->GetPixelSizeUm(); }
 int CameraInstance::GetBinning() const { RequireInitialized(__func__); return GetImpl()->GetBinning(); }
 int CameraInstance::SetBinning(int binSize) { RequireInitialized(__func__); return GetImpl()->SetBinning(binSize); }
-void CameraInstance::SetExposure(double exp_ms) { RequireInitialized(__func__); return GetImpl()->SetExposure(exp_ms); }
-double CameraInstance::GetExposure() const { RequireInitialized(__func__); return GetImpl()->GetExposure(); }
+
+void CameraInstance::SetExposure(double exp_ms)
+{
+   RequireInitialized(__func__);
+   const mm::DeviceTraceCall trace = BeginTraceCall();
+   GetImpl()->SetExposure(exp_ms);
+   if (trace.IsActive())
+      trace.Record("SetExposure", ToString(exp_ms), DEVICE_OK);
+}
+
+double CameraInstance::GetExposure() const
+{
+   RequireInitialized(__func__);
+   const mm::DeviceTraceCall trace = BeginTraceCall();
+   double exposure = GetImpl()->GetExposure();
+   if (trace.IsActive())
+      trace.Record("GetExposure", std::string(), DEVICE_OK, ToString(exposure));
+   return exposure;
+}
+
 int CameraInstance::SetROI(unsigned x, unsigned y, unsigned xSize, unsigned ySize) { RequireInitialized(__func__); return GetImpl()->SetROI(x, y, xSize, ySize); }
 int CameraInstance::GetROI(unsigned& x, unsigned& y, unsigned& xSize, unsigned& ySize) { RequireInitialized(__func__); return GetImpl()->GetROI(x, y, xSize, ySize); }
 int CameraInstance::ClearROI() { RequireInitialized(__func__); return GetImpl()->ClearROI(); }
@@ -127,12 +174,50 @@ int CameraInstance::GetMultiROI(unsigned* xs, unsigned* ys, unsigned* widths,
    return GetImpl()->GetMultiROI(xs, ys, widths, heights, length);
 }
 
-int CameraInstance::StartSequenceAcquisition(long numImages, double interval_ms, bool stopOnOverflow) { RequireInitialized(__func__); return GetImpl()->StartSequenceAcquisition(numImages, interval_ms, stopOnOverflow); }
-int CameraInstance::StartSequenceAcquisition(double interval_ms) { RequireInitialized(__func__); return GetImpl()->StartSequenceAcquisition(interval_ms); }
-int CameraInstance::StopSequenceAcquisition() { RequireInitialized(__func__); return GetImpl()->StopSequenceAcquisition(); }
+int CameraInstance::StartSequenceAcquisition(long numImages, double interval_ms, bool stopOnOverflow)
+{
+   RequireInitialized(__func__);
+   const mm::DeviceTraceCall trace = BeginTraceCall();
+   int ret = GetImpl()->StartSequenceAcquisition(numImages, interval_ms, stopOnOverflow);
+   if (trace.IsActive())
+      trace.Record("StartSequenceAcquisition", ToString(numImages) + " " +
+            ToString(interval_ms) + " " + (stopOnOverflow ? "1" : "0"), ret);
+   return ret;
+}
+
+int CameraInstance::StartSequenceAcquisition(double interval_ms)
+{
+   RequireInitialized(__func__);
+   const mm::DeviceTraceCall trace = BeginTraceCall();
+   int ret = GetImpl()->StartSequenceAcquisition(interval_ms);
+   if (trace.IsActive())
+      trace.Record("StartContinuousSequenceAcquisition", ToString(interval_ms),
+            ret);
+   return ret;
+}
+
+int CameraInstance::StopSequenceAcquisition()
+{
+   RequireInitialized(__func__);
+   const mm::DeviceTraceCall trace = BeginTraceCall();
+   int ret = GetImpl()->StopSequenceAcquisition();
+   trace.Record("StopSequenceAcquisition", std::string(), ret);
+   return ret;
+}
+
 int CameraInstance::PrepareSequenceAcqusition() { RequireInitialized(__func__); return GetImpl()->PrepareSequenceAcqusition(); }
 bool CameraInstance::IsCapturing() { RequireInitialized(__func__); return GetImpl()->IsCapturing(); }
 
+mm::DeviceTraceRecorder::ImageInfo CameraInstance::GetTraceImageInfo() const
+{
+   mm::DeviceTraceRecorder::ImageInfo info;
+   info.width = GetImpl()->GetImageWidth();
+   info.height = GetImpl()->GetImageHeight();
+   info.bytesPerPixel = GetImpl()->GetImageBytesPerPixel();
+   info.components = GetImpl()->GetNumberOfComponents();
+   return info;
+}
+
 std::string CameraInstance::GetTags()
 {
    RequireInitialized(__func__);
@@ -154,3 +239,4 @@ int CameraInstance::StopExposureSequence() { RequireInitialized(__func__); retur
 int CameraInstance::ClearExposureSequence() { RequireInitialized(__func__); return GetImpl()->ClearExposureSequence(); }
 int CameraInstance::AddToExposureSequence(double exposureTime_ms) { RequireInitialized(__func__); return GetImpl()->AddToExposureSequence(exposureTime_ms); }
 int CameraInstance::SendExposureSequence() const { RequireInitialized(__func__); return GetImpl()->SendExposureSequence(); }
+bool CameraInstance::SupportsLivePropertyChanges() { RequireInitialized(__func__); return GetImpl()->SupportsLivePropertyChanges(); }
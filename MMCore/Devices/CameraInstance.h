@@ -82,4 +82,8 @@ public:
    int ClearExposureSequence();
    int AddToExposureSequence(double exposureTime_ms);
    int SendExposureSequence() const;
+   bool SupportsLivePropertyChanges();
+
+private:
+   mm::DeviceTraceRecorder::ImageInfo GetTraceImageInfo() const;
 };
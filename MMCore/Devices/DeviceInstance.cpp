@@ -170,10 +170,23 @@ std::string
 DeviceInstance::GetProperty(const std::string& name) const
 {
    DeviceStringBuffer valueBuf(this, "GetProperty");
+   const mm::DeviceTraceCall trace = BeginTraceCall();
    int err = pImpl_->GetProperty(name.c_str(), valueBuf.GetBuffer());
+   if (trace.IsActive())
+      trace.Record("GetProperty", name, err,
+            err == DEVICE_OK ? valueBuf.Get() : std::string());
+   if (err != DEVICE_OK)
+      InvalidateConfirmedPropertyValue(name);
    ThrowIfError(err, "Cannot get value of property " +
          ToQuotedString(name));
-   return valueBuf.Get();
+   const std::string value = valueBuf.Get();
+
+   {
+      std::lock_guard<std::mutex> lock(writeSuppressionMutex_);
+      if (IsRedundantWriteSuppressionEnabledLocked(name))
+         confirmedPropertyValues_[name] = value;
+   }
+   return value;
 }
 
 void
@@ -195,18 +208,132 @@ DeviceInstance::SetProperty(const std::string& name,
       }
    }
 
+   bool suppress;
+   {
+      std::lock_guard<std::mutex> lock(writeSuppressionMutex_);
+      suppress = IsRedundantWriteSuppressionEnabledLocked(name);
+   }
+   // The device ignores the value written to a read-only property, so it
+   // must not be taken as confirmed
+   if (suppress && GetPropertyReadOnly(name.c_str()))
+      suppress = false;
+   if (suppress)
+   {
+      std::lock_guard<std::mutex> lock(writeSuppressionMutex_);
+      auto it = confirmedPropertyValues_.find(name);
+      if (it != confirmedPropertyValues_.end() && it->second == value)
+      {
+         ++suppressedWriteCount_;
+         LOG_TRACE(Logger()) << "Skipped setting property \"" << name <<
+            "\" to unchanged value \"" << value << "\"";
+         return;
+      }
+      // Forget the old value until the device has confirmed the new one
+      confirmedPropertyValues_.erase(name);
+   }
+
    LOG_DEBUG(Logger()) << "Will set property \"" << name << "\" to \"" <<
       value << "\"";
 
+   const mm::DeviceTraceCall trace = BeginTraceCall();
    int err = pImpl_->SetProperty(name.c_str(), value.c_str());
+   trace.Record("SetProperty", name, err, value);
 
    ThrowIfError(err, "Cannot set property " + ToQuotedString(name) +
          " to " + ToQuotedString(value));
 
+   if (suppress)
+   {
+      std::lock_guard<std::mutex> lock(writeSuppressionMutex_);
+      confirmedPropertyValues_[name] = value;
+   }
+
+   if (!initialized_ && GetPropertyInitStatus(name.c_str()))
+      preInitPropertiesSet_.insert(name);
+
    LOG_DEBUG(Logger()) << "Did set property \"" << name << "\" to \"" <<
       value << "\"";
 }
 
+void
+DeviceInstance::SetRedundantWriteSuppression(bool enable)
+{
+   std::lock_guard<std::mutex> lock(writeSuppressionMutex_);
+   suppressRedundantWrites_ = enable;
+   suppressRedundantWritesForProperty_.clear();
+   confirmedPropertyValues_.clear();
+}
+
+void
+DeviceInstance::SetRedundantWriteSuppression(const std::string& propName,
+      bool enable)
+{
+   std::lock_guard<std::mutex> lock(writeSuppressionMutex_);
+   suppressRedundantWritesForProperty_[propName] = enable;
+   confirmedPropertyValues_.erase(propName);
+}
+
+bool
+DeviceInstance::IsRedundantWriteSuppressionEnabled(const std::string& propName) const
+{
+   std::lock_guard<std::mutex> lock(writeSuppressionMutex_);
+   return IsRedundantWriteSuppressionEnabledLocked(propName);
+}
+
+bool
+DeviceInstance::IsRedundantWriteSuppressionEnabledLocked(const std::string& propName) const
+{
+   auto it = suppressRedundantWritesForProperty_.find(propName);
+   if (it != suppressRedundantWritesForProperty_.end())
+      return it->second;
+   return suppressRedundantWrites_;
+}
+
+void
+DeviceInstance::InvalidateConfirmedPropertyValue(const std::string& propName) const
+{
+   std::lock_guard<std::mutex> lock(writeSuppressionMutex_);
+   confirmedPropertyValues_.erase(propName);
+}
+
+void
+DeviceInstance::InvalidateConfirmedPropertyValues() const
+{
+   std::lock_guard<std::mutex> lock(writeSuppressionMutex_);
+   confirmedPropertyValues_.clear();
+}
+
+unsigned long long
+DeviceInstance::GetSuppressedWriteCount() const
+{
+   std::lock_guard<std::mutex> lock(writeSuppressionMutex_);
+   return suppressedWriteCount_;
+}
+
+void
+DeviceInstance::SetTraceRecorder(
+      std::shared_ptr<mm::DeviceTraceRecorder> recorder)
+{
+   if (recorder)
+   {
+      std::atomic_store(&traceRecorder_, recorder);
+      traceRecording_.store(true, std::memory_order_release);
+   }
+   else
+   {
+      traceRecording_.store(false, std::memory_order_release);
+      std::atomic_store(&traceRecorder_, recorder);
+   }
+}
+
+std::shared_ptr<mm::DeviceTraceRecorder>
+DeviceInstance::GetTraceRecorder() const
+{
+   if (!traceRecording_.load(std::memory_order_acquire))
+      return std::shared_ptr<mm::DeviceTraceRecorder>();
+   return std::atomic_load(&traceRecorder_);
+}
+
 bool
 DeviceInstance::HasProperty(const std::string& name) const
 { return pImpl_->HasProperty(name.c_str()); }
@@ -353,7 +480,10 @@ bool
 DeviceInstance::Busy()
 {
    RequireInitialized(__func__);
-   return pImpl_->Busy();
+   const mm::DeviceTraceCall trace = BeginTraceCall();
+   bool busy = pImpl_->Busy();
+   trace.Record("Busy", std::string(), DEVICE_OK, busy ? "1" : "0");
+   return busy;
 }
 
 double
@@ -375,6 +505,7 @@ DeviceInstance::Initialize()
    if (initializeCalled_)
       ThrowError("Device already initialized (or initialization already attempted)");
    initializeCalled_ = true;
+   InvalidateConfirmedPropertyValues();
    ThrowIfError(pImpl_->Initialize());
    initialized_ = true;
 }
@@ -384,6 +515,7 @@ DeviceInstance::Shutdown()
 {
    // Note we do not require device to be initialized before calling Shutdown().
    initialized_ = false;
+   InvalidateConfirmedPropertyValues();
    ThrowIfError(pImpl_->Shutdown());
 }
 
@@ -20,12 +20,17 @@
 #pragma once
 
 #include "../../MMDevice/MMDeviceConstants.h"
+#include "../DeviceTrace.h"
 #include "../Error.h"
 #include "../Logging/Logger.h"
 
+#include <atomic>
 #include <cstring>
 #include <functional>
+#include <map>
 #include <memory>
+#include <mutex>
+#include <set>
 #include <string>
 #include <vector>
 
@@ -74,6 +79,25 @@ private:
    bool initializeCalled_ = false;
    bool initialized_ = false;
 
+   // Suppression of redundant property writes; see SetProperty(). The mutex
+   // is needed because invalidation can come from device threads that do not
+   // hold the module lock.
+   mutable std::mutex writeSuppressionMutex_;
+   bool suppressRedundantWrites_ = false;
+   std::map<std::string, bool> suppressRedundantWritesForProperty_;
+   mutable std::map<std::string, std::string> confirmedPropertyValues_;
+   mutable unsigned long long suppressedWriteCount_ = 0;
+
+   // Pre-init properties set before initialization
+   mutable std::set<std::string> preInitPropertiesSet_;
+
+   // Set and read with std::atomic_store/load, because device threads may
+   // make traced calls (e.g. Busy()) while recording is started or stopped.
+   // The flag is checked first so that calls made while not recording skip
+   // the (lock-based) atomic load of the shared_ptr.
+   std::shared_ptr<mm::DeviceTraceRecorder> traceRecorder_;
+   std::atomic<bool> traceRecording_{false};
+
 public:
    DeviceInstance(const DeviceInstance&) = delete;
    DeviceInstance& operator=(const DeviceInstance&) = delete;
@@ -93,6 +117,36 @@ public:
    bool IsInitialized() const { return initialized_; }
    bool HasInitializationBeenAttempted() const { return initializeCalled_; }
 
+   /// Names of the pre-init properties that were set before initialization
+   /// (as opposed to left at their defaults).
+   std::set<std::string> GetPreInitPropertiesSet() const
+   { return preInitPropertiesSet_; }
+
+   /*
+    * Suppression of redundant property writes.
+    *
+    * When enabled for a property, SetProperty() skips calling the device if
+    * the value equals the last value confirmed by the device (i.e., the last
+    * value successfully set or read). The confirmed value is forgotten when
+    * the device reports a change (through the Core callback) or an error.
+    * This is only safe for properties whose value the device does not change
+    * without notifying the Core, so it is disabled by default. Writes to
+    * read-only properties (which devices ignore) are never skipped.
+    */
+   void SetRedundantWriteSuppression(bool enable);
+   void SetRedundantWriteSuppression(const std::string& propName, bool enable);
+   bool IsRedundantWriteSuppressionEnabled(const std::string& propName) const;
+   void InvalidateConfirmedPropertyValue(const std::string& propName) const;
+   void InvalidateConfirmedPropertyValues() const;
+   unsigned long long GetSuppressedWriteCount() const;
+
+   /*
+    * Recording of device calls (see mm::DeviceTraceRecorder). Calls are
+    * recorded while a recorder is set; pass null to stop recording.
+    */
+   void SetTraceRecorder(std::shared_ptr<mm::DeviceTraceRecorder> recorder);
+   std::shared_ptr<mm::DeviceTraceRecorder> GetTraceRecorder() const;
+
 protected:
    // The DeviceInstance object owns the raw device pointer (pDevice) as soon
    // as the constructor is called, even if the constructor throws.
@@ -119,6 +173,13 @@ protected:
    void ThrowIfError(int code, const std::string& message) const;
    void RequireInitialized(const char *) const;
 
+   mm::DeviceTraceCall BeginTraceCall() const
+   { return mm::DeviceTraceCall(GetTraceRecorder(), label_); }
+
+private:
+   bool IsRedundantWriteSuppressionEnabledLocked(const std::string& propName) const;
+
+protected:
    /// Utility class for getting fixed-length strings from the device interface.
    /**
     * This class should be used in all places where a device member function
@@ -22,6 +22,23 @@
 #include "ShutterInstance.h"
 
 
-int ShutterInstance::SetOpen(bool open) { RequireInitialized(__func__); return GetImpl()->SetOpen(open); }
-int ShutterInstance::GetOpen(bool& open) { RequireInitialized(__func__); return GetImpl()->GetOpen(open); }
+
+int ShutterInstance::SetOpen(bool open)
+{
+   RequireInitialized(__func__);
+   const mm::DeviceTraceCall trace = BeginTraceCall();
+   int ret = GetImpl()->SetOpen(open);
+   trace.Record("SetOpen", open ? "1" : "0", ret);
+   return ret;
+}
+
+int ShutterInstance::GetOpen(bool& open)
+{
+   RequireInitialized(__func__);
+   const mm::DeviceTraceCall trace = BeginTraceCall();
+   int ret = GetImpl()->GetOpen(open);
+   trace.Record("GetOpen", std::string(), ret, open ? "1" : "0");
+   return ret;
+}
+
 int ShutterInstance::Fire(double deltaT) { RequireInitialized(__func__); return GetImpl()->Fire(deltaT); }
@@ -21,14 +21,45 @@
 
 #include "StageInstance.h"
 
+#include "../CoreUtils.h"
+
+
+
+int StageInstance::SetPositionUm(double pos)
+{
+   RequireInitialized(__func__);
+   const mm::DeviceTraceCall trace = BeginTraceCall();
+   int ret = GetImpl()->SetPositionUm(pos);
+   if (trace.IsActive())
+      trace.Record("SetPositionUm", ToString(pos), ret);
+   return ret;
+}
+
+int StageInstance::SetRelativePositionUm(double d)
+{
+   RequireInitialized(__func__);
+   const mm::DeviceTraceCall trace = BeginTraceCall();
+   int ret = GetImpl()->SetRelativePositionUm(d);
+   if (trace.IsActive())
+      trace.Record("SetRelativePositionUm", ToString(d), ret);
+   return ret;
+}
 
-int StageInstance::SetPositionUm(double pos) { RequireInitialized(__func__); return GetImpl()->SetPositionUm(pos); }
-int StageInstance::SetRelativePositionUm(double d) { RequireInitialized(__func__); return GetImpl()->SetRelativePositionUm(d); }
 int StageInstance::Move(double velocity) { RequireInitialized(__func__); return GetImpl()->Move(velocity); }
 int StageInstance::Stop() { RequireInitialized(__func__); return GetImpl()->Stop(); }
 int StageInstance::Home() { RequireInitialized(__func__); return GetImpl()->Home(); }
 int StageInstance::SetAdapterOriginUm(double d) { RequireInitialized(__func__); return GetImpl()->SetAdapterOriginUm(d); }
-int StageInstance::GetPositionUm(double& pos) { RequireInitialized(__func__); return GetImpl()->GetPositionUm(pos); }
+
+int StageInstance::GetPositionUm(double& pos)
+{
+   RequireInitialized(__func__);
+   const mm::DeviceTraceCall trace = BeginTraceCall();
+   int ret = GetImpl()->GetPositionUm(pos);
+   if (trace.IsActive())
+      trace.Record("GetPositionUm", std::string(), ret, ToString(pos));
+   return ret;
+}
+
 int StageInstance::SetPositionSteps(long steps) { RequireInitialized(__func__); return GetImpl()->SetPositionSteps(steps); }
 int StageInstance::GetPositionSteps(long& steps) { RequireInitialized(__func__); return GetImpl()->GetPositionSteps(steps); }
 int StageInstance::SetOrigin() { RequireInitialized(__func__); return GetImpl()->SetOrigin(); }
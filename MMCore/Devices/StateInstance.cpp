@@ -21,10 +21,39 @@
 
 #include "StateInstance.h"
 
+#include "../CoreUtils.h"
+
+
+
+int StateInstance::SetPosition(long pos)
+{
+   RequireInitialized(__func__);
+   const mm::DeviceTraceCall trace = BeginTraceCall();
+   int ret = GetImpl()->SetPosition(pos);
+   if (trace.IsActive())
+      trace.Record("SetPosition", ToString(pos), ret);
+   return ret;
+}
+
+int StateInstance::SetPosition(const char* label)
+{
+   RequireInitialized(__func__);
+   const mm::DeviceTraceCall trace = BeginTraceCall();
+   int ret = GetImpl()->SetPosition(label);
+   trace.Record("SetPositionLabel", label ? label : "", ret);
+   return ret;
+}
+
+int StateInstance::GetPosition(long& pos) const
+{
+   RequireInitialized(__func__);
+   const mm::DeviceTraceCall trace = BeginTraceCall();
+   int ret = GetImpl()->GetPosition(pos);
+   if (trace.IsActive())
+      trace.Record("GetPosition", std::string(), ret, ToString(pos));
+   return ret;
+}
 
-int StateInstance::SetPosition(long pos) { RequireInitialized(__func__); return GetImpl()->SetPosition(pos); }
-int StateInstance::SetPosition(const char* label) { RequireInitialized(__func__); return GetImpl()->SetPosition(label); }
-int StateInstance::GetPosition(long& pos) const { RequireInitialized(__func__); return GetImpl()->GetPosition(pos); }
 
 std::string StateInstance::GetPositionLabel() const
 {
@@ -21,11 +21,44 @@
 
 #include "XYStageInstance.h"
 
+#include "../CoreUtils.h"
+
+
+
+int XYStageInstance::SetPositionUm(double x, double y)
+{
+   RequireInitialized(__func__);
+   const mm::DeviceTraceCall trace = BeginTraceCall();
+   int ret = GetImpl()->SetPositionUm(x, y);
+   if (trace.IsActive())
+      trace.Record("SetPositionUm", ToString(x) + " " + ToString(y), ret);
+   return ret;
+}
+
+int XYStageInstance::SetRelativePositionUm(double dx, double dy)
+{
+   RequireInitialized(__func__);
+   const mm::DeviceTraceCall trace = BeginTraceCall();
+   int ret = GetImpl()->SetRelativePositionUm(dx, dy);
+   if (trace.IsActive())
+      trace.Record("SetRelativePositionUm", ToString(dx) + " " + ToString(dy),
+            ret);
+   return ret;
+}
 
-int XYStageInstance::SetPositionUm(double x, double y) { RequireInitialized(__func__); return GetImpl()->SetPositionUm(x, y); }
-int XYStageInstance::SetRelativePositionUm(double dx, double dy) { RequireInitialized(__func__); return GetImpl()->SetRelativePositionUm(dx, dy); }
 int XYStageInstance::SetAdapterOriginUm(double x, double y) { RequireInitialized(__func__); return GetImpl()->SetAdapterOriginUm(x, y); }
-int XYStageInstance::GetPositionUm(double& x, double& y) { RequireInitialized(__func__); return GetImpl()->GetPositionUm(x, y); }
+
+int XYStageInstance::GetPositionUm(double& x, double& y)
+{
+   RequireInitialized(__func__);
+   const mm::DeviceTraceCall trace = BeginTraceCall();
+   int ret = GetImpl()->GetPositionUm(x, y);
+   if (trace.IsActive())
+      trace.Record("GetPositionUm", std::string(), ret,
+            ToString(x) + " " + ToString(y));
+   return ret;
+}
+
 int XYStageInstance::GetLimitsUm(double& xMin, double& xMax, double& yMin, double& yMax) { RequireInitialized(__func__); return GetImpl()->GetLimitsUm(xMin, xMax, yMin, yMax); }
 int XYStageInstance::Move(double vx, double vy) { RequireInitialized(__func__); return GetImpl()->Move(vx, vy); }
 int XYStageInstance::SetPositionSteps(long x, long y) { RequireInitialized(__func__); return GetImpl()->SetPositionSteps(x, y); }
@@ -18,16 +18,20 @@
 
 #include "FrameBuffer.h"
 
+#include "PixelPacking.h"
+
 #include <cmath>
 #include <cstring>
 
 namespace mm {
 
-ImgBuffer::ImgBuffer(unsigned xSize, unsigned ySize, unsigned pixDepth) :
-   pixels_(0), width_(xSize), height_(ySize), pixDepth_(pixDepth)
+ImgBuffer::ImgBuffer(unsigned xSize, unsigned ySize, unsigned pixDepth,
+      unsigned packedBits) :
+   pixels_(0), width_(xSize), height_(ySize), pixDepth_(pixDepth),
+   packedBits_(packedBits)
 {
-   pixels_ = new unsigned char[xSize * ySize * pixDepth];
-   memset(pixels_, 0, xSize * ySize * pixDepth);
+   pixels_ = new unsigned char[StorageSize()];
+   memset(pixels_, 0, StorageSize());
 }
 
 ImgBuffer::~ImgBuffer()
@@ -40,15 +44,24 @@ const unsigned char* ImgBuffer::GetPixels() const
    return pixels_;
 }
 
+std::size_t ImgBuffer::StorageSize() const
+{
+   const std::size_t pixelCount = static_cast<std::size_t>(width_) * height_;
+   if (packedBits_)
+      return PackedSize(pixelCount, packedBits_);
+   return pixelCount * pixDepth_;
+}
+
 void ImgBuffer::SetPixels(const void* pix)
 {
-   memcpy((void*)pixels_, pix, width_ * height_ * pixDepth_);
+   memcpy((void*)pixels_, pix, StorageSize());
 }
 
+// Resizing stores the pixels unpacked
 void ImgBuffer::Resize(unsigned xSize, unsigned ySize, unsigned pixDepth)
 {
    // re-allocate internal buffer if it is not big enough
-   if (width_ * height_ * pixDepth_ < xSize * ySize * pixDepth)
+   if (StorageSize() < xSize * ySize * pixDepth)
    {
       delete[] pixels_;
       pixels_ = new unsigned char [xSize * ySize * pixDepth];
@@ -57,20 +70,12 @@ void ImgBuffer::Resize(unsigned xSize, unsigned ySize, unsigned pixDepth)
    width_ = xSize;
    height_ = ySize;
    pixDepth_ = pixDepth;
+   packedBits_ = 0;
 }
 
 void ImgBuffer::Resize(unsigned xSize, unsigned ySize)
 {
-   // re-allocate internal buffer if it is not big enough
-   if (width_ * height_ < xSize * ySize)
-   {
-      delete[] pixels_;
-      pixels_ = new unsigned char[xSize * ySize * pixDepth_];
-   }
-
-   width_ = xSize;
-   height_ = ySize;
-
+   Resize(xSize, ySize, pixDepth_);
    memset(pixels_, 0, width_ * height_ * pixDepth_);
 }
 
@@ -93,6 +98,7 @@ FrameBuffer::FrameBuffer(unsigned xSize, unsigned ySize, unsigned byteDepth)
    width_ = xSize;
    height_ = ySize;
    depth_ = byteDepth;
+   packedBits_ = 0;
 }
 
 FrameBuffer::FrameBuffer()
@@ -100,6 +106,7 @@ FrameBuffer::FrameBuffer()
    width_ = 0;
    height_ = 0;
    depth_ = 0;
+   packedBits_ = 0;
 }
 
 FrameBuffer::~FrameBuffer()
@@ -127,12 +134,14 @@ void FrameBuffer::Preallocate(unsigned channels)
    }
 }
 
-void FrameBuffer::Resize(unsigned xSize, unsigned ySize, unsigned byteDepth)
+void FrameBuffer::Resize(unsigned xSize, unsigned ySize, unsigned byteDepth,
+      unsigned packedBits)
 {
    Clear();
    width_ = xSize;
    height_ = ySize;
    depth_ = byteDepth;
+   packedBits_ = packedBits;
 }
 
 bool FrameBuffer::SetPixels(unsigned channel, const unsigned char* pixels)
@@ -174,7 +183,7 @@ ImgBuffer* FrameBuffer::InsertNewImage(unsigned channel)
 {
    if (channel >= channels_.size())
       channels_.resize(channel + 1, 0);
-   ImgBuffer* img = new ImgBuffer(width_, height_, depth_);
+   ImgBuffer* img = new ImgBuffer(width_, height_, depth_, packedBits_);
    channels_[channel] = img;
    return img;
 }
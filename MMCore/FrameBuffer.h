@@ -20,6 +20,7 @@
 
 #include "../MMDevice/ImageMetadata.h"
 
+#include <cstddef>
 #include <string>
 #include <vector>
 #include <map>
@@ -32,17 +33,24 @@ class ImgBuffer
    unsigned int width_;
    unsigned int height_;
    unsigned int pixDepth_;
+   unsigned int packedBits_;
    Metadata metadata_;
 
 public:
-   ImgBuffer(unsigned xSize, unsigned ySize, unsigned pixDepth);
+   // If packedBits is nonzero, the 16-bit pixels are stored bit-packed (see
+   // PixelPacking.h); the pixel storage then holds StorageSize() bytes.
+   ImgBuffer(unsigned xSize, unsigned ySize, unsigned pixDepth,
+         unsigned packedBits = 0);
    ~ImgBuffer();
 
    unsigned int Width() const {return width_;}
    unsigned int Height() const {return height_;}
    unsigned int Depth() const {return pixDepth_;}
+   unsigned int PackedBits() const {return packedBits_;}
+   std::size_t StorageSize() const;
    void SetPixels(const void* pixArray);
    const unsigned char* GetPixels() const;
+   unsigned char* GetPixelsRW() {return pixels_;}
 
    void Resize(unsigned xSize, unsigned ySize, unsigned pixDepth);
    void Resize(unsigned xSize, unsigned ySize);
@@ -62,13 +70,15 @@ class FrameBuffer
    unsigned int width_;
    unsigned int height_;
    unsigned int depth_;
+   unsigned int packedBits_;
 
 public:
    FrameBuffer(unsigned xSize, unsigned ySize, unsigned byteDepth);
    FrameBuffer();
    ~FrameBuffer();
 
-   void Resize(unsigned xSize, unsigned ySize, unsigned pixDepth);
+   void Resize(unsigned xSize, unsigned ySize, unsigned pixDepth,
+         unsigned packedBits = 0);
    void Clear();
    void Preallocate(unsigned channels);
 
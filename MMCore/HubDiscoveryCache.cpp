@@ -0,0 +1,280 @@
+// PROJECT:       Micro-Manager
+// SUBSYSTEM:     MMCore
+//
+// DESCRIPTION:   Cache of the peripherals detected in hub devices
+//
+// LICENSE:       This file is distributed under the "Lesser GPL" (LGPL) license.
+//                License text is included with the source distribution.
+//
+//                This file is distributed in the hope that it will be useful,
+//                but WITHOUT ANY WARRANTY; without even the implied warranty
+//                of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+//
+//                IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+//                CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+//                INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES.
+
+#include "HubDiscoveryCache.h"
+
+#include "CoreUtils.h"
+
+#include <fstream>
+#include <sstream>
+#include <utility>
+
+// Cache file format: one line per hub, followed by one line per peripheral,
+// with tab-separated fields. Tabs and line breaks in values are replaced with
+// spaces.
+//
+//    # Micro-Manager hub discovery cache
+//    Hub<TAB>adapter<TAB>hub<TAB>port<TAB>identity
+//    Peripheral<TAB>name<TAB>description
+
+namespace mm
+{
+
+namespace
+{
+
+const char* const fileHeader = "# Micro-Manager hub discovery cache";
+
+std::string Sanitized(const std::string& value)
+{
+   std::string result(value);
+   for (char& ch : result)
+   {
+      if (ch == '\t' || ch == '\r' || ch == '\n')
+         ch = ' ';
+   }
+   return result;
+}
+
+std::vector<std::string> SplitFields(const std::string& line)
+{
+   std::vector<std::string> fields;
+   std::istringstream ss(line);
+   std::string field;
+   while (std::getline(ss, field, '\t'))
+      fields.push_back(field);
+   if (!line.empty() && line.back() == '\t')
+      fields.push_back(std::string());
+   return fields;
+}
+
+} // anonymous namespace
+
+
+HubDiscoveryCache::HubDiscoveryCache()
+{
+}
+
+
+HubDiscoveryCache::~HubDiscoveryCache()
+{
+   WaitForRevalidations();
+}
+
+
+void
+HubDiscoveryCache::SetFile(const std::string& filename)
+{
+   EntryMap entries;
+   if (!filename.empty())
+      entries = ReadFile(filename);
+
+   std::lock_guard<std::mutex> lock(mutex_);
+   filename_ = filename;
+   if (!filename.empty())
+      entries_.swap(entries);
+}
+
+
+std::string
+HubDiscoveryCache::GetFile() const
+{
+   std::lock_guard<std::mutex> lock(mutex_);
+   return filename_;
+}
+
+
+bool
+HubDiscoveryCache::Lookup(const Key& key, PeripheralList& peripherals) const
+{
+   std::lock_guard<std::mutex> lock(mutex_);
+   auto it = entries_.find(EntryKey(key));
+   if (it == entries_.end() || it->second.key.identity != Sanitized(key.identity))
+      return false;
+   peripherals = it->second.peripherals;
+   return true;
+}
+
+
+void
+HubDiscoveryCache::Store(const Key& key, const PeripheralList& peripherals)
+{
+   Entry entry;
+   entry.key.adapter = Sanitized(key.adapter);
+   entry.key.hub = Sanitized(key.hub);
+   entry.key.port = Sanitized(key.port);
+   entry.key.identity = Sanitized(key.identity);
+   for (const Peripheral& p : peripherals)
+   {
+      Peripheral sanitized;
+      sanitized.name = Sanitized(p.name);
+      sanitized.description = Sanitized(p.description);
+      entry.peripherals.push_back(sanitized);
+   }
+
+   std::lock_guard<std::mutex> lock(mutex_);
+   entries_[EntryKey(key)] = entry;
+   Save();
+}
+
+
+void
+HubDiscoveryCache::Clear()
+{
+   std::lock_guard<std::mutex> lock(mutex_);
+   entries_.clear();
+   Save();
+}
+
+
+bool
+HubDiscoveryCache::Revalidate(const Key& key, DetectFunction detect)
+{
+   std::lock_guard<std::mutex> lock(threadsMutex_);
+   JoinFinishedRevalidations();
+
+   const std::string entryKey = EntryKey(key);
+   if (revalidations_.count(entryKey))
+      return false;
+
+   Revalidation& revalidation = revalidations_[entryKey];
+   revalidation.finished = std::make_shared<std::atomic<bool>>(false);
+   std::shared_ptr<std::atomic<bool>> finished = revalidation.finished;
+   revalidation.thread = std::thread([this, key, detect, finished] {
+      try
+      {
+         Store(key, detect());
+      }
+      catch (...)
+      {
+         // Detection errors are reported by the detect function; a failure
+         // to save the cache file is not worth reporting from here.
+      }
+      *finished = true;
+   });
+   return true;
+}
+
+
+void
+HubDiscoveryCache::WaitForRevalidations()
+{
+   std::map<std::string, Revalidation> revalidations;
+   {
+      std::lock_guard<std::mutex> lock(threadsMutex_);
+      revalidations.swap(revalidations_);
+   }
+   for (auto& r : revalidations)
+      r.second.thread.join();
+}
+
+
+void
+HubDiscoveryCache::JoinFinishedRevalidations()
+{
+   for (auto it = revalidations_.begin(); it != revalidations_.end(); )
+   {
+      if (*it->second.finished)
+      {
+         it->second.thread.join(); // Returns as soon as the thread exits
+         it = revalidations_.erase(it);
+      }
+      else
+      {
+         ++it;
+      }
+   }
+}
+
+
+std::string
+HubDiscoveryCache::EntryKey(const Key& key)
+{
+   return Sanitized(key.adapter) + '\t' + Sanitized(key.hub) + '\t' +
+      Sanitized(key.port);
+}
+
+
+HubDiscoveryCache::EntryMap
+HubDiscoveryCache::ReadFile(const std::string& filename)
+{
+   EntryMap entries;
+
+   std::ifstream file(filename.c_str());
+   if (!file) // Missing file is fine; it is created on the first Store()
+      return entries;
+
+   Entry* current = nullptr;
+   std::string line;
+   int lineNumber = 0;
+   while (std::getline(file, line))
+   {
+      ++lineNumber;
+      if (!line.empty() && line.back() == '\r')
+         line.pop_back();
+      if (line.empty() || line[0] == '#')
+         continue;
+
+      std::vector<std::string> fields = SplitFields(line);
+      if (fields[0] == "Hub" && fields.size() == 5)
+      {
+         Entry entry;
+         entry.key.adapter = fields[1];
+         entry.key.hub = fields[2];
+         entry.key.port = fields[3];
+         entry.key.identity = fields[4];
+         current = &(entries[EntryKey(entry.key)] = entry);
+      }
+      else if (fields[0] == "Peripheral" && fields.size() == 3 && current)
+      {
+         Peripheral p;
+         p.name = fields[1];
+         p.description = fields[2];
+         current->peripherals.push_back(p);
+      }
+      else
+      {
+         throw CMMError("Invalid line " + ToString(lineNumber) +
+               " in hub discovery cache file " + ToQuotedString(filename));
+      }
+   }
+   return entries;
+}
+
+
+void
+HubDiscoveryCache::Save() const
+{
+   if (filename_.empty())
+      return;
+
+   std::ofstream file(filename_.c_str(), std::ios::trunc);
+   file << fileHeader << '\n';
+   for (const auto& e : entries_)
+   {
+      const Entry& entry = e.second;
+      file << "Hub\t" << entry.key.adapter << '\t' << entry.key.hub << '\t' <<
+         entry.key.port << '\t' << entry.key.identity << '\n';
+      for (const Peripheral& p : entry.peripherals)
+         file << "Peripheral\t" << p.name << '\t' << p.description << '\n';
+   }
+   file.close();
+   if (!file)
+      throw CMMError("Cannot write hub discovery cache file " +
+            ToQuotedString(filename_));
+}
+
+} // namespace mm
@@ -0,0 +1,157 @@
+// PROJECT:       Micro-Manager
+// SUBSYSTEM:     MMCore
+//
+// DESCRIPTION:   Cache of the peripherals detected in hub devices
+//
+// LICENSE:       This file is distributed under the "Lesser GPL" (LGPL) license.
+//                License text is included with the source distribution.
+//
+//                This file is distributed in the hope that it will be useful,
+//                but WITHOUT ANY WARRANTY; without even the implied warranty
+//                of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+//
+//                IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+//                CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+//                INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES.
+
+#pragma once
+
+#include "Error.h"
+
+#include <atomic>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace mm
+{
+
+/// Remembers the peripherals that hub devices reported as installed.
+/**
+ * Detecting the installed peripherals of a hub usually involves a number of
+ * round trips to the hardware. This cache allows the Core to skip detection
+ * when the same hub (same device adapter and device, on the same port, with
+ * the same firmware) has been seen before, optionally in an earlier session
+ * if a cache file is set.
+ *
+ * Entries are looked up by adapter, hub device name and port; an entry whose
+ * identity (firmware) string differs from the one looked up is a miss, and
+ * is replaced when the result of the full detection is stored.
+ *
+ * The cache does not know about devices: detection is performed by the
+ * function passed to Revalidate(), which is responsible for acquiring the
+ * module lock and for reporting errors.
+ */
+class HubDiscoveryCache /* final */
+{
+public:
+   struct Peripheral
+   {
+      std::string name;
+      std::string description;
+
+      bool operator==(const Peripheral& other) const
+      { return name == other.name && description == other.description; }
+      bool operator!=(const Peripheral& other) const
+      { return !(*this == other); }
+   };
+   typedef std::vector<Peripheral> PeripheralList;
+
+   struct Key
+   {
+      std::string adapter;
+      std::string hub;
+      std::string port; // Empty if the hub has no port
+      std::string identity; // Firmware identity; empty if unknown
+   };
+
+   /// Performs full detection; may throw CMMError.
+   typedef std::function<PeripheralList ()> DetectFunction;
+
+   HubDiscoveryCache();
+   ~HubDiscoveryCache();
+
+   HubDiscoveryCache(const HubDiscoveryCache&) = delete;
+   HubDiscoveryCache& operator=(const HubDiscoveryCache&) = delete;
+
+   /**
+    * \brief Set the file in which the cache persists across sessions.
+    *
+    * The entries are replaced with those read from the file (none if it does
+    * not exist or cannot be opened). An empty filename keeps the entries in
+    * memory only. Throws CMMError if the file is not a valid cache file.
+    */
+   void SetFile(const std::string& filename);
+   std::string GetFile() const;
+
+   /**
+    * \brief Look up the peripherals of a hub.
+    *
+    * \return false if there is no entry for the hub, or if its identity does
+    * not match.
+    */
+   bool Lookup(const Key& key, PeripheralList& peripherals) const;
+
+   /**
+    * \brief Record the result of a full detection.
+    *
+    * Throws CMMError if the cache file cannot be written (the entry is
+    * updated in memory regardless).
+    */
+   void Store(const Key& key, const PeripheralList& peripherals);
+
+   /**
+    * \brief Remove all entries (also from the cache file, if any).
+    */
+   void Clear();
+
+   /**
+    * \brief Run a full detection on a background thread and store its result.
+    *
+    * If the detect function throws, the entry is left unchanged. Only one
+    * detection runs at a time for each hub (adapter, hub device and port).
+    *
+    * \return false if a detection for the hub was already running, in which
+    * case no new one is started.
+    */
+   bool Revalidate(const Key& key, DetectFunction detect);
+
+   /**
+    * \brief Block until all background detections have finished.
+    *
+    * Must be called before unloading devices that the detect functions use.
+    */
+   void WaitForRevalidations();
+
+private:
+   struct Entry
+   {
+      Key key;
+      PeripheralList peripherals;
+   };
+   typedef std::map<std::string, Entry> EntryMap; // By adapter, hub and port
+
+   struct Revalidation
+   {
+      std::thread thread;
+      std::shared_ptr<std::atomic<bool>> finished;
+   };
+
+   static std::string EntryKey(const Key& key);
+   static EntryMap ReadFile(const std::string& filename);
+   void Save() const; // Called with mutex_ held
+   void JoinFinishedRevalidations(); // Called with threadsMutex_ held
+
+   mutable std::mutex mutex_;
+   std::string filename_;
+   EntryMap entries_;
+
+   std::mutex threadsMutex_;
+   std::map<std::string, Revalidation> revalidations_; // By entry key
+};
+
+} // namespace mm
@@ -0,0 +1,188 @@
+// PROJECT:       Micro-Manager
+// SUBSYSTEM:     MMCore
+//
+// DESCRIPTION:   Camera property changes applied between frames of a running
+//                sequence acquisition
+//
+// LICENSE:       This file is distributed under the "Lesser GPL" (LGPL) license.
+//                License text is included with the source distribution.
+//
+//                This file is distributed in the hope that it will be useful,
+//                but WITHOUT ANY WARRANTY; without even the implied warranty
+//                of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+//
+//                IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+//                CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+//                INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES.
+
+#include "LivePropertyChanges.h"
+
+namespace mm
+{
+
+LivePropertyChanges::LivePropertyChanges() :
+   stopRequested_(false)
+{
+}
+
+
+LivePropertyChanges::~LivePropertyChanges()
+{
+   Shutdown();
+}
+
+
+void
+LivePropertyChanges::Merge(Changes& into, const std::string& property,
+      const std::string& value)
+{
+   for (auto& change : into)
+   {
+      if (change.first == property)
+      {
+         change.second = value;
+         return;
+      }
+   }
+   into.emplace_back(property, value);
+}
+
+
+void
+LivePropertyChanges::Queue(const MM::Device* camera,
+      const std::string& property, const std::string& value)
+{
+   std::lock_guard<std::mutex> lock(mutex_);
+   Merge(pending_[camera], property, value);
+}
+
+
+LivePropertyChanges::Changes
+LivePropertyChanges::TakePending(const MM::Device* camera)
+{
+   std::lock_guard<std::mutex> lock(mutex_);
+   auto it = pending_.find(camera);
+   if (it == pending_.end())
+      return Changes();
+   Changes changes;
+   changes.swap(it->second);
+   pending_.erase(it);
+   return changes;
+}
+
+
+size_t
+LivePropertyChanges::GetPendingCount(const MM::Device* camera) const
+{
+   std::lock_guard<std::mutex> lock(mutex_);
+   auto it = pending_.find(camera);
+   return it == pending_.end() ? 0 : it->second.size();
+}
+
+
+void
+LivePropertyChanges::AddApplied(const MM::Device* camera,
+      const Changes& changes)
+{
+   if (changes.empty())
+      return;
+   std::lock_guard<std::mutex> lock(mutex_);
+   Changes& applied = applied_[camera];
+   for (const auto& change : changes)
+      Merge(applied, change.first, change.second);
+}
+
+
+LivePropertyChanges::Changes
+LivePropertyChanges::TakeApplied(const MM::Device* camera)
+{
+   std::lock_guard<std::mutex> lock(mutex_);
+   auto it = applied_.find(camera);
+   if (it == applied_.end())
+      return Changes();
+   Changes changes;
+   changes.swap(it->second);
+   applied_.erase(it);
+   return changes;
+}
+
+
+void
+LivePropertyChanges::SetApplyFunction(ApplyFunction apply)
+{
+   std::lock_guard<std::mutex> lock(mutex_);
+   apply_ = apply;
+}
+
+
+void
+LivePropertyChanges::FrameReceived(const MM::Device* camera)
+{
+   {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (stopRequested_ || !apply_ || !pending_.count(camera))
+         return;
+      requested_.insert(camera);
+      if (!thread_.joinable())
+         thread_ = std::thread(&LivePropertyChanges::ThreadFunc, this);
+   }
+   requestCondVar_.notify_one();
+}
+
+
+void
+LivePropertyChanges::Shutdown()
+{
+   {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stopRequested_ = true;
+      requested_.clear();
+   }
+   requestCondVar_.notify_one();
+   if (thread_.joinable())
+      thread_.join();
+}
+
+
+void
+LivePropertyChanges::ThreadFunc()
+{
+   std::unique_lock<std::mutex> lock(mutex_);
+   for (;;)
+   {
+      requestCondVar_.wait(lock,
+            [this] { return stopRequested_ || !requested_.empty(); });
+      if (stopRequested_)
+         return;
+
+      const MM::Device* camera = *requested_.begin();
+      requested_.erase(requested_.begin());
+      ApplyFunction apply = apply_;
+      lock.unlock();
+      if (apply)
+         apply(camera);
+      lock.lock();
+   }
+}
+
+
+void
+LivePropertyChanges::Clear(const MM::Device* camera)
+{
+   std::lock_guard<std::mutex> lock(mutex_);
+   pending_.erase(camera);
+   applied_.erase(camera);
+   requested_.erase(camera);
+}
+
+
+void
+LivePropertyChanges::ClearAll()
+{
+   std::lock_guard<std::mutex> lock(mutex_);
+   pending_.clear();
+   applied_.clear();
+   requested_.clear();
+}
+
+} // namespace mm
@@ -0,0 +1,113 @@
+// PROJECT:       Micro-Manager
+// SUBSYSTEM:     MMCore
+//
+// DESCRIPTION:   Camera property changes applied between frames of a running
+//                sequence acquisition
+//
+// LICENSE:       This file is distributed under the "Lesser GPL" (LGPL) license.
+//                License text is included with the source distribution.
+//
+//                This file is distributed in the hope that it will be useful,
+//                but WITHOUT ANY WARRANTY; without even the implied warranty
+//                of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+//
+//                IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+//                CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+//                INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES.
+
+#pragma once
+
+#include <condition_variable>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace MM
+{
+   class Device;
+}
+
+namespace mm
+{
+
+/// Per-camera queues of property changes to apply at a frame boundary.
+/**
+ * Changes are queued while a camera is capturing and taken by whoever
+ * applies them between two frames. Queueing a new value for a property that
+ * is still pending replaces the pending value, so only the latest request is
+ * applied.
+ *
+ * Changes that have been applied are kept until the next frame from the
+ * camera is received, so that the frame can be tagged with them.
+ *
+ * Pending changes are applied by the apply function, which is called from a
+ * thread owned by this object after FrameReceived(). The camera's inserting
+ * thread must not set the properties itself: device adapters commonly hold
+ * their own locks while inserting an image, and setting a property may need
+ * the same locks.
+ */
+class LivePropertyChanges /* final */
+{
+public:
+   typedef std::vector<std::pair<std::string, std::string>> Changes;
+   typedef std::function<void (const MM::Device* camera)> ApplyFunction;
+
+   LivePropertyChanges();
+   ~LivePropertyChanges();
+
+   LivePropertyChanges(const LivePropertyChanges&) = delete;
+   LivePropertyChanges& operator=(const LivePropertyChanges&) = delete;
+
+   void Queue(const MM::Device* camera, const std::string& property,
+         const std::string& value);
+
+   /// Take the pending changes, in the order they were first queued.
+   Changes TakePending(const MM::Device* camera);
+
+   size_t GetPendingCount(const MM::Device* camera) const;
+
+   /// Record changes as applied, to be reported with the next frame.
+   void AddApplied(const MM::Device* camera, const Changes& changes);
+
+   Changes TakeApplied(const MM::Device* camera);
+
+   /// Set the function that applies a camera's pending changes.
+   void SetApplyFunction(ApplyFunction apply);
+
+   /**
+    * \brief Request the pending changes of the camera to be applied.
+    *
+    * Called for each frame received from the camera. Returns without waiting
+    * for the changes to be applied.
+    */
+   void FrameReceived(const MM::Device* camera);
+
+   /// Stop the apply thread, waiting for any call in progress to return.
+   void Shutdown();
+
+   /// Forget pending and applied changes (e.g. when a camera is unloaded).
+   void Clear(const MM::Device* camera);
+   void ClearAll();
+
+private:
+   static void Merge(Changes& into, const std::string& property,
+         const std::string& value);
+   void ThreadFunc();
+
+   mutable std::mutex mutex_;
+   std::map<const MM::Device*, Changes> pending_;
+   std::map<const MM::Device*, Changes> applied_;
+
+   ApplyFunction apply_;
+   std::set<const MM::Device*> requested_; // Cameras to apply changes for
+   std::condition_variable requestCondVar_;
+   bool stopRequested_;
+   std::thread thread_;
+};
+
+} // namespace mm
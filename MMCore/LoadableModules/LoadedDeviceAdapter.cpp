@@ -31,6 +31,8 @@
 
 LoadedDeviceAdapter::LoadedDeviceAdapter(const std::string& name, const std::string& filename) :
    name_(name),
+   mock_(0),
+   lockProfiled_(false),
    InitializeModuleData_(0),
    CreateDevice_(0),
    DeleteDevice_(0),
@@ -66,6 +68,27 @@ LoadedDeviceAdapter::LoadedDeviceAdapter(const std::string& name, const std::str
 }
 
 
+LoadedDeviceAdapter::LoadedDeviceAdapter(const std::string& name,
+      MockDeviceAdapter* mock) :
+   name_(name),
+   mock_(mock),
+   lockProfiled_(false),
+   InitializeModuleData_(0),
+   CreateDevice_(0),
+   DeleteDevice_(0),
+   GetModuleVersion_(0),
+   GetDeviceInterfaceVersion_(0),
+   GetNumberOfDevices_(0),
+   GetDeviceName_(0),
+   GetDeviceType_(0),
+   GetDeviceDescription_(0)
+{
+   if (!mock_)
+      throw CMMError("Null mock device adapter");
+   InitializeModuleData();
+}
+
+
 MMThreadLock*
 LoadedDeviceAdapter::GetLock()
 {
@@ -73,6 +96,23 @@ LoadedDeviceAdapter::GetLock()
 }
 
 
+void
+LoadedDeviceAdapter::SetLockProfiler(std::shared_ptr<mm::ModuleLockProfiler> profiler)
+{
+   std::atomic_store(&lockProfiler_, profiler);
+   lockProfiled_ = (profiler != nullptr);
+}
+
+
+std::shared_ptr<mm::ModuleLockProfiler>
+LoadedDeviceAdapter::GetLockProfiler() const
+{
+   if (!lockProfiled_)
+      return std::shared_ptr<mm::ModuleLockProfiler>();
+   return std::atomic_load(&lockProfiler_);
+}
+
+
 std::vector<std::string>
 LoadedDeviceAdapter::GetAvailableDeviceNames() const
 {
@@ -233,6 +273,19 @@ LoadedDeviceAdapter::CheckInterfaceVersion() const
 void
 LoadedDeviceAdapter::InitializeModuleData()
 {
+   if (mock_)
+   {
+      mockDevices_.clear();
+      mock_->InitializeModuleData([this](const char* name,
+               MM::DeviceType type, const char* description) {
+         MockDeviceInfo info;
+         info.name = name;
+         info.type = type;
+         info.description = description;
+         mockDevices_.push_back(info);
+      });
+      return;
+   }
    if (!InitializeModuleData_)
       InitializeModuleData_ = reinterpret_cast<fnInitializeModuleData>
          (module_->GetFunction("InitializeModuleData"));
@@ -243,6 +296,8 @@ LoadedDeviceAdapter::InitializeModuleData()
 MM::Device*
 LoadedDeviceAdapter::CreateDevice(const char* deviceName)
 {
+   if (mock_)
+      return mock_->CreateDevice(deviceName);
    if (!CreateDevice_)
       CreateDevice_ = reinterpret_cast<fnCreateDevice>
          (module_->GetFunction("CreateDevice"));
@@ -253,6 +308,11 @@ LoadedDeviceAdapter::CreateDevice(const char* deviceName)
 void
 LoadedDeviceAdapter::DeleteDevice(MM::Device* device)
 {
+   if (mock_)
+   {
+      mock_->DeleteDevice(device);
+      return;
+   }
    if (!DeleteDevice_)
       DeleteDevice_ = reinterpret_cast<fnDeleteDevice>
          (module_->GetFunction("DeleteDevice"));
@@ -283,6 +343,8 @@ LoadedDeviceAdapter::GetDeviceInterfaceVersion() const
 unsigned
 LoadedDeviceAdapter::GetNumberOfDevices() const
 {
+   if (mock_)
+      return static_cast<unsigned>(mockDevices_.size());
    if (!GetNumberOfDevices_)
       GetNumberOfDevices_ = reinterpret_cast<fnGetNumberOfDevices>
          (module_->GetFunction("GetNumberOfDevices"));
@@ -293,6 +355,14 @@ LoadedDeviceAdapter::GetNumberOfDevices() const
 bool
 LoadedDeviceAdapter::GetDeviceName(unsigned index, char* buf, unsigned bufLen) const
 {
+   if (mock_)
+   {
+      if (index >= mockDevices_.size() ||
+            mockDevices_[index].name.size() >= bufLen)
+         return false;
+      std::strcpy(buf, mockDevices_[index].name.c_str());
+      return true;
+   }
    if (!GetDeviceName_)
       GetDeviceName_ = reinterpret_cast<fnGetDeviceName>
          (module_->GetFunction("GetDeviceName"));
@@ -303,6 +373,18 @@ LoadedDeviceAdapter::GetDeviceName(unsigned index, char* buf, unsigned bufLen) c
 bool
 LoadedDeviceAdapter::GetDeviceType(const char* deviceName, int* type) const
 {
+   if (mock_)
+   {
+      for (const auto& info : mockDevices_)
+      {
+         if (info.name == deviceName)
+         {
+            *type = info.type;
+            return true;
+         }
+      }
+      return false;
+   }
    if (!GetDeviceType_)
       GetDeviceType_ = reinterpret_cast<fnGetDeviceType>
          (module_->GetFunction("GetDeviceType"));
@@ -313,6 +395,18 @@ LoadedDeviceAdapter::GetDeviceType(const char* deviceName, int* type) const
 bool
 LoadedDeviceAdapter::GetDeviceDescription(const char* deviceName, char* buf, unsigned bufLen) const
 {
+   if (mock_)
+   {
+      for (const auto& info : mockDevices_)
+      {
+         if (info.name == deviceName && info.description.size() < bufLen)
+         {
+            std::strcpy(buf, info.description.c_str());
+            return true;
+         }
+      }
+      return false;
+   }
    if (!GetDeviceDescription_)
       GetDeviceDescription_ = reinterpret_cast<fnGetDeviceDescription>
          (module_->GetFunction("GetDeviceDescription"));
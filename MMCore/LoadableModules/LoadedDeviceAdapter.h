@@ -22,16 +22,25 @@
 
 #include "LoadedModule.h"
 
+#include "MockDeviceAdapter.h"
 #include "../../MMDevice/DeviceThreads.h"
 #include "../../MMDevice/MMDevice.h"
 #include "../../MMDevice/ModuleInterface.h"
 #include "../Logging/Logger.h"
 
+#include <atomic>
 #include <cstring>
 #include <memory>
+#include <string>
+#include <vector>
 
 class CMMCore;
 
+namespace mm
+{
+   class ModuleLockProfiler;
+}
+
 
 class DeviceInstance;
 
@@ -44,17 +53,24 @@ public:
    LoadedDeviceAdapter& operator=(const LoadedDeviceAdapter&) = delete;
 
    LoadedDeviceAdapter(const std::string& name, const std::string& filename);
+   // The mock is not owned and must outlive this object
+   LoadedDeviceAdapter(const std::string& name, MockDeviceAdapter* mock);
 
    // TODO Unload() should mark the instance invalid (or require instance
    // deletion to unload)
-   void Unload() { module_->Unload(); } // For developer use only
+   void Unload() { if (module_) module_->Unload(); } // For developer use only
 
    std::string GetName() const { return name_; }
+   MockDeviceAdapter* GetMock() const { return mock_; }
 
    // The "module lock", used to synchronize _most_ access to the device
    // adapter.
    MMThreadLock* GetLock();
 
+   // Profiler of the module lock; null unless profiling is enabled
+   void SetLockProfiler(std::shared_ptr<mm::ModuleLockProfiler> profiler);
+   std::shared_ptr<mm::ModuleLockProfiler> GetLockProfiler() const;
+
    std::vector<std::string> GetAvailableDeviceNames() const;
    std::string GetDeviceDescription(const std::string& deviceName) const;
    MM::DeviceType GetAdvertisedDeviceType(const std::string& deviceName) const;
@@ -111,8 +127,22 @@ private:
    const std::string name_;
    std::shared_ptr<LoadedModule> module_;
 
+   // Set instead of module_ for a mock adapter
+   struct MockDeviceInfo
+   {
+      std::string name;
+      MM::DeviceType type;
+      std::string description;
+   };
+   MockDeviceAdapter* mock_;
+   std::vector<MockDeviceInfo> mockDevices_;
+
    MMThreadLock lock_;
 
+   // Checked first, so that the profiler pointer is only read when set
+   std::atomic<bool> lockProfiled_;
+   std::shared_ptr<mm::ModuleLockProfiler> lockProfiler_;
+
    // Cached function pointers
    mutable fnInitializeModuleData InitializeModuleData_;
    mutable fnCreateDevice CreateDevice_;
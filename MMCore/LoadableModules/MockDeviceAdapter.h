@@ -0,0 +1,52 @@
+// PROJECT:       Micro-Manager
+// SUBSYSTEM:     MMCore
+//
+// DESCRIPTION:   Device adapter implemented by the program using the Core,
+//                for testing
+//
+// LICENSE:       This file is distributed under the "Lesser GPL" (LGPL) license.
+//                License text is included with the source distribution.
+//
+//                This file is distributed in the hope that it will be useful,
+//                but WITHOUT ANY WARRANTY; without even the implied warranty
+//                of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+//
+//                IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+//                CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+//                INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES.
+
+#pragma once
+
+#include "../../MMDevice/MMDeviceConstants.h"
+
+#include <functional>
+
+namespace MM
+{
+   class Device;
+}
+
+/// A device adapter that is not loaded from a module file.
+/**
+ * For unit tests only: not part of the Core's public API. Registered with
+ * CPluginManager::LoadMockAdapter(), which only the unit tests can reach
+ * (through the friend class mm::test::CoreTestAccess, defined in
+ * unittest/MockDeviceUtils.h). Its devices are then loaded like those of any
+ * other device adapter, so that tests can run the Core against devices
+ * defined in the test itself.
+ *
+ * The functions correspond to the exported functions of a device adapter
+ * module (see ModuleInterface.h).
+ */
+class MockDeviceAdapter
+{
+public:
+   typedef std::function<void (const char* name, MM::DeviceType type,
+         const char* description)> RegisterDeviceFunction;
+
+   virtual ~MockDeviceAdapter() {}
+
+   virtual void InitializeModuleData(RegisterDeviceFunction registerDevice) = 0;
+   virtual MM::Device* CreateDevice(const char* name) = 0;
+   virtual void DeleteDevice(MM::Device* device) = 0;
+};
@@ -5,6 +5,7 @@
 
 #include <memory>
 #include <mutex>
+#include <sstream>
 #include <utility>
 #include <vector>
 
@@ -38,7 +39,12 @@ LogManager::LogManager() :
    primaryLogLevel_(logging::LogLevelInfo),
    usingStdErr_(false),
    nextSecondaryHandle_(0)
-{}
+{
+   logging::EntryThrottleSettings settings;
+   settings.rateLimitFilter = [](const logging::EntryData& entryData)
+      { return entryData.GetLevel() < logging::LogLevelWarning; };
+   loggingCore_->SetThrottleSettings(settings);
+}
 
 
 void
@@ -271,6 +277,85 @@ LogManager::RemoveSecondaryLogFile(LogManager::LogFileHandle handle)
 }
 
 
+void
+LogManager::SetDeduplication(bool flag)
+{
+   std::lock_guard<std::mutex> lock(mutex_);
+
+   logging::EntryThrottleSettings settings =
+      loggingCore_->GetThrottleSettings();
+   if (flag == settings.deduplicate)
+      return;
+   settings.deduplicate = flag;
+   loggingCore_->SetThrottleSettings(settings);
+
+   LOG_INFO(internalLogger_) << (flag ? "Enabled" : "Disabled") <<
+      " log entry deduplication";
+}
+
+
+bool
+LogManager::IsDeduplicating() const
+{
+   std::lock_guard<std::mutex> lock(mutex_);
+   return loggingCore_->GetThrottleSettings().deduplicate;
+}
+
+
+void
+LogManager::SetRateLimit(double entriesPerSecond, double burst)
+{
+   std::lock_guard<std::mutex> lock(mutex_);
+
+   logging::EntryThrottleSettings settings =
+      loggingCore_->GetThrottleSettings();
+   settings.rateLimitPerS = entriesPerSecond;
+   settings.rateLimitBurst = burst;
+   loggingCore_->SetThrottleSettings(settings);
+
+   if (entriesPerSecond > 0.0)
+   {
+      LOG_INFO(internalLogger_) << "Set log rate limit to " <<
+         entriesPerSecond << " entries/s per logger (burst " << burst << ")";
+   }
+   else
+   {
+      LOG_INFO(internalLogger_) << "Disabled log rate limit";
+   }
+}
+
+
+double
+LogManager::GetRateLimit() const
+{
+   std::lock_guard<std::mutex> lock(mutex_);
+   return loggingCore_->GetThrottleSettings().rateLimitPerS;
+}
+
+
+std::string
+LogManager::GetSuppressionSummary()
+{
+   loggingCore_->FlushThrottledEntries();
+
+   std::ostringstream summary;
+   summary << "Suppressed log entries (logger, repeats, rate limited):";
+   for (const auto& counts : loggingCore_->GetThrottleCounts())
+   {
+      summary << "\n  " << counts.loggerData.GetComponentLabel() << ", " <<
+         counts.repeats << ", " << counts.rateLimited;
+   }
+   return summary.str();
+}
+
+
+void
+LogManager::ResetSuppressionCounts()
+{
+   loggingCore_->ResetThrottleCounts();
+}
+
+
 logging::Logger
 LogManager::NewLogger(const std::string& label)
 {
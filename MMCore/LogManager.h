@@ -70,6 +70,17 @@ public:
    // We could add an atomic SwapSecondaryLogFile(handle, filename, truncate),
    // nice for log rotation, but we don't need it now.
 
+   // Deduplication and rate limiting apply to each logger separately. Only
+   // entries below warning level are rate limited.
+   void SetDeduplication(bool flag);
+   bool IsDeduplicating() const;
+   void SetRateLimit(double entriesPerSecond, double burst);
+   double GetRateLimit() const;
+   // Report pending suppressed entries to the log and return the number of
+   // entries suppressed for each logger.
+   std::string GetSuppressionSummary();
+   void ResetSuppressionCounts();
+
    logging::Logger NewLogger(const std::string& label);
 };
 
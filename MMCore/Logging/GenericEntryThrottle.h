@@ -0,0 +1,257 @@
+// LICENSE:       This file is distributed under the "Lesser GPL" (LGPL) license.
+//                License text is included with the source distribution.
+//
+//                This file is distributed in the hope that it will be useful,
+//                but WITHOUT ANY WARRANTY; without even the implied warranty
+//                of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+//
+//                IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+//                CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+//                INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES.
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+
+namespace mm
+{
+namespace logging
+{
+namespace internal
+{
+
+
+template <typename TEntryData>
+struct GenericEntryThrottleSettings
+{
+   // Collapse runs of entries with identical text into a summary entry
+   bool deduplicate = false;
+   // While a run of repeats continues, emit a summary at most this often (0:
+   // only when the run ends)
+   double repeatSummaryIntervalS = 10.0;
+
+   // Token bucket refill rate (entries per second; 0: no rate limit) and size
+   double rateLimitPerS = 0.0;
+   double rateLimitBurst = 100.0;
+   // If set, only entries for which this returns true are rate limited
+   std::function<bool (const TEntryData&)> rateLimitFilter;
+
+   bool IsActive() const { return deduplicate || rateLimitPerS > 0.0; }
+};
+
+
+/**
+ * Deduplication and rate limiting state of a single logger.
+ *
+ * Suppressed entries are counted. The counts are reported by summary entries,
+ * which the caller emits in place of (or before) the entry being admitted:
+ * a run of identical entries is reported when it ends (and periodically while
+ * it continues), and entries dropped by the rate limit are reported with the
+ * next entry that gets through.
+ */
+template <class TMetadata>
+class GenericEntryThrottle
+{
+public:
+   typedef std::chrono::steady_clock Clock;
+   typedef typename TMetadata::LoggerDataType LoggerDataType;
+   typedef typename TMetadata::EntryDataType EntryDataType;
+   typedef GenericEntryThrottleSettings<EntryDataType> SettingsType;
+   typedef std::vector< std::pair<EntryDataType, std::string> > SummaryList;
+
+private:
+   const LoggerDataType loggerData_;
+
+   mutable std::mutex mutex_;
+   SettingsType settings_;
+   // Copy of settings_.IsActive(), so that Admit() need not lock when
+   // throttling is off (the default)
+   std::atomic<bool> active_;
+
+   // Last emitted entry and the run of repeats following it
+   bool hasLast_;
+   std::string lastText_;
+   std::unique_ptr<EntryDataType> lastEntryData_;
+   unsigned long long pendingRepeats_;
+   Clock::time_point repeatRunStart_;
+
+   double tokens_;
+   Clock::time_point lastRefill_;
+   unsigned long long pendingRateLimited_;
+   std::unique_ptr<EntryDataType> lastRateLimitedEntryData_;
+
+   unsigned long long totalRepeats_;
+   unsigned long long totalRateLimited_;
+
+public:
+   GenericEntryThrottle(LoggerDataType loggerData,
+         const SettingsType& settings) :
+      loggerData_(loggerData),
+      settings_(settings),
+      active_(settings.IsActive()),
+      hasLast_(false),
+      pendingRepeats_(0),
+      tokens_(settings.rateLimitBurst),
+      lastRefill_(Clock::now()),
+      pendingRateLimited_(0),
+      totalRepeats_(0),
+      totalRateLimited_(0)
+   {}
+
+   GenericEntryThrottle(const GenericEntryThrottle&) = delete;
+   GenericEntryThrottle& operator=(const GenericEntryThrottle&) = delete;
+
+   LoggerDataType GetLoggerData() const { return loggerData_; }
+
+   /**
+    * Change the settings, flushing pending summaries into summaries.
+    */
+   void SetSettings(const SettingsType& settings, SummaryList& summaries)
+   {
+      std::lock_guard<std::mutex> lock(mutex_);
+      FlushLocked(summaries);
+      settings_ = settings;
+      hasLast_ = false;
+      tokens_ = settings.rateLimitBurst;
+      lastRefill_ = Clock::now();
+      active_ = settings.IsActive();
+   }
+
+   /**
+    * Decide whether an entry should be emitted.
+    *
+    * Summary entries that should be emitted before the entry (whether or not
+    * it is admitted) are appended to summaries.
+    */
+   bool Admit(const EntryDataType& entryData, const char* entryText,
+         Clock::time_point now, SummaryList& summaries)
+   {
+      // Nothing can be pending when inactive (SetSettings() flushes)
+      if (!active_)
+         return true;
+
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (!settings_.IsActive())
+         return true;
+
+      if (settings_.deduplicate && hasLast_ && lastText_ == entryText)
+      {
+         if (pendingRepeats_ == 0)
+            repeatRunStart_ = now;
+         ++pendingRepeats_;
+         ++totalRepeats_;
+         if (settings_.repeatSummaryIntervalS > 0.0 &&
+               std::chrono::duration<double>(now - repeatRunStart_).count() >=
+               settings_.repeatSummaryIntervalS)
+         {
+            FlushRepeats(summaries);
+         }
+         return false;
+      }
+      FlushRepeats(summaries);
+
+      const bool limited = settings_.rateLimitPerS > 0.0 &&
+         (!settings_.rateLimitFilter || settings_.rateLimitFilter(entryData));
+      if (limited)
+      {
+         const double elapsedS =
+            std::chrono::duration<double>(now - lastRefill_).count();
+         if (elapsedS > 0.0)
+         {
+            tokens_ = std::min(settings_.rateLimitBurst,
+                  tokens_ + elapsedS * settings_.rateLimitPerS);
+            lastRefill_ = now;
+         }
+         if (tokens_ < 1.0)
+         {
+            ++pendingRateLimited_;
+            ++totalRateLimited_;
+            lastRateLimitedEntryData_.reset(new EntryDataType(entryData));
+            // Repeats of a dropped entry are rate limited, too
+            hasLast_ = false;
+            return false;
+         }
+         tokens_ -= 1.0;
+         FlushRateLimited(summaries);
+      }
+
+      hasLast_ = true;
+      lastText_ = entryText;
+      lastEntryData_.reset(new EntryDataType(entryData));
+      return true;
+   }
+
+   /**
+    * Report all suppressed entries not yet reported.
+    */
+   void Flush(SummaryList& summaries)
+   {
+      std::lock_guard<std::mutex> lock(mutex_);
+      FlushLocked(summaries);
+   }
+
+   bool HasPending() const
+   {
+      std::lock_guard<std::mutex> lock(mutex_);
+      return pendingRepeats_ > 0 || pendingRateLimited_ > 0;
+   }
+
+   unsigned long long GetRepeatCount() const
+   {
+      std::lock_guard<std::mutex> lock(mutex_);
+      return totalRepeats_;
+   }
+
+   unsigned long long GetRateLimitedCount() const
+   {
+      std::lock_guard<std::mutex> lock(mutex_);
+      return totalRateLimited_;
+   }
+
+   void ResetCounts()
+   {
+      std::lock_guard<std::mutex> lock(mutex_);
+      totalRepeats_ = 0;
+      totalRateLimited_ = 0;
+   }
+
+private:
+   void FlushLocked(SummaryList& summaries)
+   {
+      FlushRepeats(summaries);
+      FlushRateLimited(summaries);
+   }
+
+   void FlushRepeats(SummaryList& summaries)
+   {
+      if (pendingRepeats_ == 0)
+         return;
+      summaries.emplace_back(*lastEntryData_, "Last message repeated " +
+            std::to_string(pendingRepeats_) + " times");
+      pendingRepeats_ = 0;
+   }
+
+   void FlushRateLimited(SummaryList& summaries)
+   {
+      if (pendingRateLimited_ == 0)
+         return;
+      summaries.emplace_back(*lastRateLimitedEntryData_,
+            std::to_string(pendingRateLimited_) +
+            " entries suppressed by rate limit");
+      pendingRateLimited_ = 0;
+   }
+};
+
+
+} // namespace internal
+} // namespace logging
+} // namespace mm
@@ -16,6 +16,7 @@
 
 #pragma once
 
+#include "GenericEntryThrottle.h"
 #include "GenericLinePacket.h"
 #include "GenericLogger.h"
 #include "GenericMetadata.h"
@@ -56,8 +57,17 @@ public:
    typedef typename TMetadata::StampDataType StampDataType;
 
    typedef internal::GenericSink<TMetadata> SinkType;
+   typedef GenericEntryThrottleSettings<EntryDataType> ThrottleSettingsType;
+
+   struct ThrottleCounts
+   {
+      LoggerDataType loggerData;
+      unsigned long long repeats; // Suppressed as repeats
+      unsigned long long rateLimited; // Dropped by rate limit
+   };
 
 private:
+   typedef GenericEntryThrottle<TMetadata> ThrottleType;
    typedef internal::GenericLinePacket<TMetadata> LinePacketType;
    typedef GenericPacketArray<TMetadata> PacketArrayType;
 
@@ -73,9 +83,22 @@ private:
    // _and_ the queue receive loop stopped.
    std::vector< std::shared_ptr<SinkType> > asynchronousSinks_;
 
+   // When acquiring throttlesMutex_ and a sink mutex, acquire throttlesMutex_
+   // first.
+   std::mutex throttlesMutex_; // Protect throttle settings and counts
+   ThrottleSettingsType throttleSettings_;
+   // One per live logger; flushed and removed when the logger is gone, with
+   // its counts kept in retiredThrottleCounts_ if nonzero.
+   std::vector< std::shared_ptr<ThrottleType> > throttles_;
+   std::vector<ThrottleCounts> retiredThrottleCounts_;
+
 public:
    GenericLoggingCore() { StartAsyncReceiveLoop(); }
-   ~GenericLoggingCore() { StopAsyncReceiveLoop(); }
+   ~GenericLoggingCore()
+   {
+      FlushThrottledEntries();
+      StopAsyncReceiveLoop();
+   }
 
    /**
     * Create a new logger.
@@ -84,11 +107,89 @@ public:
     */
    internal::GenericLogger<EntryDataType> NewLogger(LoggerDataType metadata)
    {
+      std::shared_ptr<ThrottleType> throttle;
+      {
+         std::lock_guard<std::mutex> lock(throttlesMutex_);
+         throttle = std::make_shared<ThrottleType>(metadata,
+               throttleSettings_);
+         throttles_.push_back(throttle);
+      }
+
+      // The throttle is retired when the last copy of the logger is
+      // destroyed
+      std::shared_ptr<GenericLoggingCore> self = this->shared_from_this();
+      std::shared_ptr<ThrottleType> loggerThrottle(throttle.get(),
+            [self, throttle](ThrottleType*) { self->RetireThrottle(throttle); });
+
       // Loggers hold a shared pointer to the LoggingCore, so that they are
       // guaranteed to be safe to call at any time.
       return internal::GenericLogger<EntryDataType>(
             std::bind(&GenericLoggingCore::SendEntryToShared,
-               this->shared_from_this(), metadata, std::placeholders::_1, std::placeholders::_2));
+               self, metadata, loggerThrottle,
+               std::placeholders::_1, std::placeholders::_2));
+   }
+
+   /**
+    * Set the deduplication and rate limiting applied to each logger.
+    *
+    * Entries suppressed under the previous settings are reported before the
+    * change takes effect.
+    */
+   void SetThrottleSettings(const ThrottleSettingsType& settings)
+   {
+      std::lock_guard<std::mutex> lock(throttlesMutex_);
+      throttleSettings_ = settings;
+      for (const std::shared_ptr<ThrottleType>& throttle : throttles_)
+      {
+         typename ThrottleType::SummaryList summaries;
+         throttle->SetSettings(settings, summaries);
+         SendSummaries(throttle->GetLoggerData(), summaries);
+      }
+   }
+
+   ThrottleSettingsType GetThrottleSettings()
+   {
+      std::lock_guard<std::mutex> lock(throttlesMutex_);
+      return throttleSettings_;
+   }
+
+   /**
+    * Emit summaries for all suppressed entries not yet reported.
+    */
+   void FlushThrottledEntries()
+   {
+      std::lock_guard<std::mutex> lock(throttlesMutex_);
+      for (const std::shared_ptr<ThrottleType>& throttle : throttles_)
+      {
+         typename ThrottleType::SummaryList summaries;
+         throttle->Flush(summaries);
+         SendSummaries(throttle->GetLoggerData(), summaries);
+      }
+   }
+
+   /**
+    * Get the number of suppressed entries of each logger that has any.
+    */
+   std::vector<ThrottleCounts> GetThrottleCounts()
+   {
+      std::lock_guard<std::mutex> lock(throttlesMutex_);
+      std::vector<ThrottleCounts> result(retiredThrottleCounts_);
+      for (const std::shared_ptr<ThrottleType>& throttle : throttles_)
+      {
+         ThrottleCounts counts = { throttle->GetLoggerData(),
+            throttle->GetRepeatCount(), throttle->GetRateLimitedCount() };
+         if (counts.repeats > 0 || counts.rateLimited > 0)
+            result.push_back(counts);
+      }
+      return result;
+   }
+
+   void ResetThrottleCounts()
+   {
+      std::lock_guard<std::mutex> lock(throttlesMutex_);
+      retiredThrottleCounts_.clear();
+      for (const std::shared_ptr<ThrottleType>& throttle : throttles_)
+         throttle->ResetCounts();
    }
 
    /**
@@ -258,19 +359,71 @@ private:
    // Static wrapper allowing the use of a shared_ptr for the target instance
    static void
    SendEntryToShared(std::shared_ptr<GenericLoggingCore> self,
-         LoggerDataType loggerData, EntryDataType entryData,
-         const char* entryText)
-   { self->SendEntry(loggerData, entryData, entryText); }
+         LoggerDataType loggerData, std::shared_ptr<ThrottleType> throttle,
+         EntryDataType entryData, const char* entryText)
+   { self->SendEntry(loggerData, *throttle, entryData, entryText); }
+
+   // Report what the throttle of a destroyed logger has suppressed, and
+   // forget the throttle
+   void RetireThrottle(const std::shared_ptr<ThrottleType>& throttle)
+   {
+      std::lock_guard<std::mutex> lock(throttlesMutex_);
+      typename ThrottleType::SummaryList summaries;
+      throttle->Flush(summaries);
+      SendSummaries(throttle->GetLoggerData(), summaries);
+
+      ThrottleCounts counts = { throttle->GetLoggerData(),
+         throttle->GetRepeatCount(), throttle->GetRateLimitedCount() };
+      if (counts.repeats > 0 || counts.rateLimited > 0)
+         retiredThrottleCounts_.push_back(counts);
+
+      throttles_.erase(std::remove(throttles_.begin(), throttles_.end(),
+               throttle), throttles_.end());
+   }
+
+   void SendEntry(LoggerDataType loggerData, ThrottleType& throttle,
+         EntryDataType entryData, const char* entryText)
+   {
+      typename ThrottleType::SummaryList summaries;
+      const bool admitted = throttle.Admit(entryData, entryText,
+            ThrottleType::Clock::now(), summaries);
+      if (!admitted && summaries.empty())
+         return;
+
+      StampDataType stampData;
+      stampData.Stamp();
+
+      PacketArrayType packets;
+      for (const auto& summary : summaries)
+      {
+         packets.AppendEntry(loggerData, summary.first, stampData,
+               summary.second.c_str());
+      }
+      if (admitted)
+         packets.AppendEntry(loggerData, entryData, stampData, entryText);
+      SendPackets(packets);
+   }
 
-   void SendEntry(LoggerDataType loggerData, EntryDataType entryData,
-         const char* entryText)
+   void SendSummaries(LoggerDataType loggerData,
+         const typename ThrottleType::SummaryList& summaries)
    {
+      if (summaries.empty())
+         return;
+
       StampDataType stampData;
       stampData.Stamp();
 
       PacketArrayType packets;
-      packets.AppendEntry(loggerData, entryData, stampData, entryText);
+      for (const auto& summary : summaries)
+      {
+         packets.AppendEntry(loggerData, summary.first, stampData,
+               summary.second.c_str());
+      }
+      SendPackets(packets);
+   }
 
+   void SendPackets(PacketArrayType& packets)
+   {
       {
          std::lock_guard<std::mutex> lock(syncSinksMutex_);
 
@@ -33,6 +33,7 @@ namespace logging
 
 
 typedef internal::GenericLoggingCore<Metadata> LoggingCore;
+typedef LoggingCore::ThrottleSettingsType EntryThrottleSettings;
 
 typedef internal::GenericSink<Metadata> LogSink;
 typedef internal::GenericStdErrLogSink<Metadata, internal::MetadataFormatter>
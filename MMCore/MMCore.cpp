@@ -50,18 +50,31 @@
 #include "CoreUtils.h"
 #include "DeviceManager.h"
 #include "Devices/DeviceInstances.h"
+#include "DeviceTrace.h"
+#include "HubDiscoveryCache.h"
+#include "LivePropertyChanges.h"
 #include "LogManager.h"
+#include "ModuleLockProfiler.h"
 #include "MMCore.h"
 #include "MMEventCallback.h"
+#include "MoveScheduler.h"
 #include "PluginManager.h"
+#include "ProcessedImageTracker.h"
+#include "SnapBurstPipeline.h"
+#include "SoftwareBinning.h"
+#include "StateLog.h"
+#include "XYScan.h"
 
 #include <algorithm>
 #include <cassert>
+#include <cctype>
 #include <chrono>
 #include <cstring>
 #include <fstream>
+#include <map>
 #include <set>
 #include <sstream>
+#include <thread>
 #include <vector>
 
 #ifdef _MSC_VER
@@ -108,7 +121,7 @@
  * (Keep the 3 numbers on one line to make it easier to look at diffs when
  * merging/rebasing.)
  */
-const int MMCore_versionMajor = 11, MMCore_versionMinor = 1, MMCore_versionPatch = 1;
+const int MMCore_versionMajor = 11, MMCore_versionMinor = 19, MMCore_versionPatch = 0;
 
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -125,6 +138,8 @@ CMMCore::CMMCore() :
    appLogger_(logManager_->NewLogger("App")),
    coreLogger_(logManager_->NewLogger("Core")),
    everSnapped_(false),
+   processedImageTracker_(new mm::ProcessedImageTracker()),
+   softwareBinning_(new mm::SoftwareBinning()),
    pollingIntervalMs_(10),
    timeoutMs_(5000),
    autoShutter_(true),
@@ -136,6 +151,16 @@ CMMCore::CMMCore() :
    cbuf_(0),
    pluginManager_(new CPluginManager()),
    deviceManager_(new mm::DeviceManager()),
+   moveScheduler_(new mm::MoveScheduler()),
+   hubDiscoveryCache_(new mm::HubDiscoveryCache()),
+   hubDiscoveryCacheEnabled_(false),
+   hubDiscoveryRevalidationEnabled_(false),
+   livePropertyChanges_(new mm::LivePropertyChanges()),
+   moduleLockProfiler_(new mm::ModuleLockProfiler()),
+   moduleLockProfilingEnabled_(false),
+   moduleLockProfileLogIntervalS_(60.0),
+   armedBufferGeneration_(0),
+   stateLog_(new mm::StateLog()),
    pPostedErrorsLock_(NULL)
 {
    configGroups_ = new ConfigGroupCollection();
@@ -148,6 +173,15 @@ CMMCore::CMMCore() :
 
    const unsigned seqBufMegabytes = (sizeof(void*) > 4) ? 250 : 25;
    cbuf_ = new CircularBuffer(seqBufMegabytes);
+   cbuf_->SetBackpressureListener([this](bool active, double fillFraction) {
+      notifyCircularBufferBackpressure(active, fillFraction);
+   });
+   cbuf_->SetSaturationListener([this](std::size_t pixels, unsigned bitDepth) {
+      logCircularBufferSaturation(pixels, bitDepth);
+   });
+   livePropertyChanges_->SetApplyFunction([this](const MM::Device* camera) {
+      applyLivePropertyChangesBetweenFrames(camera);
+   });
 
    nullAffine_ = new std::vector<double>(6);
    for (int i = 0; i < 6; i++) {
@@ -163,6 +197,8 @@ CMMCore::CMMCore() :
  */
 CMMCore::~CMMCore()
 {
+   livePropertyChanges_->Shutdown();
+
    try
    {
       // TODO We should attempt to continue cleanup beyond the first device
@@ -354,6 +390,80 @@ void CMMCore::stopSecondaryLogFile(int handle) throw (CMMError)
    logManager_->RemoveSecondaryLogFile(h);
 }
 
+
+/**
+ * Enable or disable collapsing of repeated log entries.
+ *
+ * When enabled, a run of entries with identical text from the same device or
+ * component is written once, followed by an entry giving the number of
+ * repeats (written when the run ends, and every 10 seconds while it
+ * continues). This applies to all log outputs.
+ *
+ * @param enable Whether to collapse repeated entries.
+ */
+void CMMCore::enableLogDeduplication(bool enable)
+{
+   logManager_->SetDeduplication(enable);
+}
+
+/**
+ * Indicates whether repeated log entries are collapsed.
+ */
+bool CMMCore::logDeduplicationEnabled()
+{
+   return logManager_->IsDeduplicating();
+}
+
+/**
+ * Limit the rate of log entries from each device or component.
+ *
+ * Each device and component (e.g. the Core) may write up to burst entries at
+ * once, and on average no more than entriesPerSecond entries per second.
+ * Entries beyond that are dropped and counted; the count is written to the
+ * log with the next entry that is not dropped. Warnings and errors are never
+ * dropped.
+ *
+ * @param entriesPerSecond The average rate allowed; 0 to disable the limit.
+ * @param burst The number of entries allowed at once (at least 1).
+ */
+void CMMCore::setLogRateLimit(double entriesPerSecond, double burst)
+   throw (CMMError)
+{
+   if (entriesPerSecond < 0.0)
+      throw CMMError("Log rate limit must not be negative");
+   if (entriesPerSecond > 0.0 && burst < 1.0)
+      throw CMMError("Log rate limit burst must be at least 1");
+   logManager_->SetRateLimit(entriesPerSecond, burst);
+}
+
+/**
+ * Returns the log rate limit in entries per second (0 if disabled).
+ */
+double CMMCore::getLogRateLimit()
+{
+   return logManager_->GetRateLimit();
+}
+
+/**
+ * Returns the number of log entries suppressed for each device or component.
+ *
+ * Entries collapsed as repeats and entries dropped by the rate limit are
+ * counted separately. Suppressed entries that have not yet been reported in
+ * the log are reported when this function is called.
+ */
+std::string CMMCore::getLogSuppressionSummary()
+{
+   return logManager_->GetSuppressionSummary();
+}
+
+/**
+ * Reset the counts returned by getLogSuppressionSummary().
+ */
+void CMMCore::resetLogSuppressionCounts()
+{
+   logManager_->ResetSuppressionCounts();
+}
+
 /**
  * Displays core version.
  */
@@ -654,6 +764,49 @@ std::vector<std::string> CMMCore::getDeviceAdapterNames() throw (CMMError)
    return pluginManager_->GetAvailableDeviceAdapters();
 }
 
+// Called with the device's module lock held
+static void
+RecordDeviceTraceState(mm::DeviceTraceRecorder& recorder,
+      std::shared_ptr<DeviceInstance> pDevice)
+{
+   const std::string label = pDevice->GetLabel();
+   recorder.RecordDevice(label, pDevice->GetAdapterModule()->GetName(),
+         pDevice->GetName(), pDevice->GetType());
+
+   std::vector<std::string> propNames = pDevice->GetPropertyNames();
+   for (std::vector<std::string>::const_iterator it = propNames.begin(),
+         end = propNames.end(); it != end; ++it)
+   {
+      try
+      {
+         recorder.RecordProperty(label, *it, pDevice->GetProperty(*it),
+               pDevice->GetPropertyReadOnly(it->c_str()));
+      }
+      catch (const CMMError&)
+      {
+         // Unreadable properties are left out of the trace
+      }
+   }
+
+   if (pDevice->GetType() == MM::StateDevice && pDevice->IsInitialized())
+   {
+      std::shared_ptr<StateInstance> pState =
+         std::static_pointer_cast<StateInstance>(pDevice);
+      const long nrPositions = static_cast<long>(pState->GetNumberOfPositions());
+      for (long pos = 0; pos < nrPositions; ++pos)
+      {
+         try
+         {
+            recorder.RecordPositionLabel(label, pos,
+                  pState->GetPositionLabel(pos));
+         }
+         catch (const CMMError&)
+         {
+         }
+      }
+   }
+}
+
 /**
  * Loads a device from the plugin library.
  * @param label    assigned name for the device during the core session
@@ -687,6 +840,18 @@ void CMMCore::loadDevice(const char* label, const char* moduleName, const char*
          deviceManager_->LoadDevice(module, deviceName, label, this,
                deviceLogger, coreLogger);
       pDevice->SetCallback(callback_);
+
+      if (moduleLockProfilingEnabled_)
+         module->SetLockProfiler(moduleLockProfiler_);
+
+      std::shared_ptr<mm::DeviceTraceRecorder> recorder =
+         std::atomic_load(&deviceTraceRecorder_);
+      if (recorder)
+      {
+         mm::DeviceModuleLockGuard guard(pDevice);
+         RecordDeviceTraceState(*recorder, pDevice);
+         pDevice->SetTraceRecorder(recorder);
+      }
    }
    catch (const CMMError& e)
    {
@@ -759,6 +924,18 @@ void CMMCore::unloadDevice(const char* label///< the name of the device to unloa
 {
    std::shared_ptr<DeviceInstance> pDevice = deviceManager_->GetDevice(label);
 
+   moveScheduler_->Cancel(label);
+   hubDiscoveryCache_->WaitForRevalidations();
+
+   const unsigned long long suppressedWrites = pDevice->GetSuppressedWriteCount();
+   if (suppressedWrites > 0)
+   {
+      LOG_INFO(coreLogger_) << "Device " << label << ": " << suppressedWrites <<
+         " redundant property writes were suppressed";
+   }
+
+   livePropertyChanges_->Clear(pDevice->GetRawPtr());
+
    try {
       mm::DeviceModuleLockGuard guard(pDevice);
       LOG_DEBUG(coreLogger_) << "Will unload device " << label;
@@ -778,22 +955,26 @@ void CMMCore::unloadDevice(const char* label///< the name of the device to unloa
 void CMMCore::unloadAllDevices() throw (CMMError)
 {
    try {
-      configGroups_->Clear();
+      clearConfigurationData();
+      hubDiscoveryCache_->WaitForRevalidations();
 
-      //selected channel group is no longer valid
-      //channelGroup_ = "":
-
-      // clear pixel size configurations
-      if (!pixelSizeGroup_->IsEmpty())
+      std::vector<std::string> devices = deviceManager_->GetDeviceList();
+      for (std::vector<std::string>::const_iterator it = devices.begin(),
+            end = devices.end(); it != end; ++it)
       {
-         std::vector<std::string> pixelSizes = pixelSizeGroup_->GetAvailable();
-         for (std::vector<std::string>::iterator it = pixelSizes.begin();
-               it != pixelSizes.end(); it++)
+         moveScheduler_->Cancel(*it);
+
+         const unsigned long long suppressedWrites =
+            deviceManager_->GetDevice(*it)->GetSuppressedWriteCount();
+         if (suppressedWrites > 0)
          {
-            pixelSizeGroup_->Delete((*it).c_str());
+            LOG_INFO(coreLogger_) << "Device " << *it << ": " <<
+               suppressedWrites << " redundant property writes were suppressed";
          }
       }
 
+      livePropertyChanges_->ClearAll();
+
       LOG_DEBUG(coreLogger_) << "Will unload all devices";
       deviceManager_->UnloadAllDevices();
       LOG_INFO(coreLogger_) << "Did unload all devices";
@@ -806,6 +987,28 @@ void CMMCore::unloadAllDevices() throw (CMMError)
    }
 }
 
+/**
+ * Clears configuration groups and pixel size configurations.
+ */
+void CMMCore::clearConfigurationData()
+{
+   configGroups_->Clear();
+
+   //selected channel group is no longer valid
+   //channelGroup_ = "":
+
+   // clear pixel size configurations
+   if (!pixelSizeGroup_->IsEmpty())
+   {
+      std::vector<std::string> pixelSizes = pixelSizeGroup_->GetAvailable();
+      for (std::vector<std::string>::iterator it = pixelSizes.begin();
+            it != pixelSizes.end(); it++)
+      {
+         pixelSizeGroup_->Delete((*it).c_str());
+      }
+   }
+}
+
 /**
  * Unloads all devices from the core, clears all configuration data.
  */
@@ -959,6 +1162,12 @@ void CMMCore::updateSystemStateCache()
    {
       MMThreadGuard scg(stateCacheLock_);
       stateCache_ = wk;
+      for (size_t i = 0; i < wk.size(); ++i)
+      {
+         const PropertySetting& s = wk.getSetting(i);
+         stateLog_->Record(s.getDeviceLabel(), s.getPropertyName(),
+               s.getPropertyValue(), s.getReadOnly());
+      }
    }
    LOG_INFO(coreLogger_) << "Did update system state cache";
 }
@@ -1022,6 +1231,333 @@ void CMMCore::unloadLibrary(const char* moduleName) throw (CMMError)
    }
 }
 
+/**
+ * Reloads a device adapter module, recreating its devices.
+ *
+ * All devices from the module are unloaded, the module's library is unloaded
+ * and loaded again from disk (picking up a rebuilt adapter), and the devices
+ * are loaded again with the same labels, pre-initialization properties,
+ * parent hubs, delays, focus directions and state labels. Devices that were
+ * initialized are initialized again, and their properties are restored to
+ * the values in the system state cache. Core device roles (current camera,
+ * shutter, etc.) held by the reloaded devices are restored.
+ *
+ * Devices from other modules are not affected. This allows an adapter under
+ * development, or one that has stopped responding, to be replaced without
+ * reloading the whole system configuration.
+ *
+ * The reload is refused if a sequence acquisition is running on a camera from
+ * the module, or if a device from another module has a hub from this module
+ * as its parent. Failure to restore a property value is logged and does not
+ * cause an error. If a device cannot be shut down or the module cannot be
+ * reloaded, the devices that were already unloaded are recreated where
+ * possible, and an error is thrown.
+ *
+ * @param moduleName  the name of the device adapter module
+ */
+void CMMCore::reloadDeviceAdapter(const char* moduleName) throw (CMMError)
+{
+   if (moduleName == 0)
+      throw CMMError(errorText_[MMERR_NullPointerException],  MMERR_NullPointerException);
+
+   // What is needed to recreate a device
+   struct DeviceSnapshot
+   {
+      std::string label;
+      std::string deviceName;
+      std::string parentLabel;
+      bool initialized;
+      double delayMs;
+      bool isStage;
+      int focusDirection;
+      std::vector<std::pair<std::string, std::string> > preInitProperties;
+      std::vector<std::pair<long, std::string> > stateLabels;
+   };
+
+   std::vector<DeviceSnapshot> snapshots;
+   std::set<std::string> labels;
+   std::vector<std::string> devices = deviceManager_->GetDeviceList();
+   for (std::vector<std::string>::const_iterator it = devices.begin();
+         it != devices.end(); ++it)
+   {
+      std::shared_ptr<DeviceInstance> pDev = deviceManager_->GetDevice(*it);
+      mm::DeviceModuleLockGuard guard(pDev);
+      if (pDev->GetAdapterModule()->GetName() != moduleName)
+         continue;
+
+      DeviceSnapshot snapshot;
+      snapshot.label = *it;
+      snapshot.deviceName = pDev->GetName();
+      snapshot.parentLabel = pDev->GetParentID();
+      snapshot.initialized = pDev->IsInitialized();
+      snapshot.delayMs = pDev->GetDelayMs();
+      snapshot.isStage = (pDev->GetType() == MM::StageDevice);
+      snapshot.focusDirection = snapshot.isStage ? getFocusDirection(it->c_str()) : 0;
+
+      std::vector<std::string> propertyNames = pDev->GetPropertyNames();
+      for (std::vector<std::string>::const_iterator prop = propertyNames.begin();
+            prop != propertyNames.end(); ++prop)
+      {
+         if (pDev->GetPropertyInitStatus(prop->c_str()))
+            snapshot.preInitProperties.push_back(
+                  std::make_pair(*prop, pDev->GetProperty(*prop)));
+      }
+
+      if (pDev->GetType() == MM::StateDevice && snapshot.initialized)
+      {
+         std::shared_ptr<StateInstance> pSD =
+            deviceManager_->GetDeviceOfType<StateInstance>(*it);
+         unsigned numPos = pSD->GetNumberOfPositions();
+         for (unsigned long j = 0; j < numPos; ++j)
+         {
+            std::string stateLabel;
+            try
+            {
+               stateLabel = pSD->GetPositionLabel(j);
+            }
+            catch (const CMMError&)
+            {
+               continue;
+            }
+            if (!stateLabel.empty())
+               snapshot.stateLabels.push_back(std::make_pair(long(j), stateLabel));
+         }
+      }
+
+      snapshots.push_back(snapshot);
+      labels.insert(*it);
+   }
+
+   // Refuse to leave other modules' peripherals without their hub, or to pull
+   // a camera out from under a running acquisition
+   for (std::vector<std::string>::const_iterator it = devices.begin();
+         it != devices.end(); ++it)
+   {
+      if (labels.count(*it))
+         continue;
+      std::string parentLabel = getParentLabel(it->c_str());
+      if (labels.count(parentLabel))
+         throw CMMError("Cannot reload device adapter " + ToQuotedString(moduleName) +
+               ": device " + ToQuotedString(*it) + " from another adapter uses hub " +
+               ToQuotedString(parentLabel));
+   }
+   for (std::vector<DeviceSnapshot>::const_iterator it = snapshots.begin();
+         it != snapshots.end(); ++it)
+   {
+      if (it->initialized &&
+            deviceManager_->GetDevice(it->label)->GetType() == MM::CameraDevice &&
+            isSequenceRunning(it->label.c_str()))
+         throw CMMError("Cannot reload device adapter " + ToQuotedString(moduleName) +
+               " while camera " + ToQuotedString(it->label) +
+               " is running a sequence acquisition");
+   }
+
+   bool armedHere = false;
+   {
+      MMThreadGuard g(armedSequenceLock_);
+      std::shared_ptr<CameraInstance> armedCamera = armedCamera_.lock();
+      std::shared_ptr<ShutterInstance> armedShutter = armedShutter_.lock();
+      armedHere = (armedCamera && labels.count(armedCamera->GetLabel())) ||
+         (armedShutter && labels.count(armedShutter->GetLabel()));
+   }
+   if (armedHere)
+      disarmSequenceAcquisition();
+
+   // Core roles held by the devices, and their last known state
+   static const char* const roleProperties[] = {
+      MM::g_Keyword_CoreCamera, MM::g_Keyword_CoreShutter,
+      MM::g_Keyword_CoreFocus, MM::g_Keyword_CoreXYStage,
+      MM::g_Keyword_CoreAutoFocus, MM::g_Keyword_CoreImageProcessor,
+      MM::g_Keyword_CoreSLM, MM::g_Keyword_CoreGalvo,
+   };
+   std::vector<std::pair<std::string, std::string> > roles;
+   for (size_t i = 0; i < sizeof(roleProperties) / sizeof(roleProperties[0]); ++i)
+   {
+      std::string value = properties_->Get(roleProperties[i]);
+      if (labels.count(value))
+         roles.push_back(std::make_pair(std::string(roleProperties[i]), value));
+   }
+
+   std::vector<PropertySetting> cachedState;
+   {
+      MMThreadGuard scg(stateCacheLock_);
+      for (size_t i = 0; i < stateCache_.size(); ++i)
+      {
+         PropertySetting setting = stateCache_.getSetting(i);
+         if (labels.count(setting.getDeviceLabel()) && !setting.getReadOnly())
+            cachedState.push_back(setting);
+      }
+   }
+
+   // Load the devices again, from the reloaded module or, if reloading
+   // failed, from the module that is still loaded
+   auto recreateDevices = [&](const std::vector<DeviceSnapshot>& toRecreate)
+   {
+      std::set<std::string> recreatedLabels;
+      for (std::vector<DeviceSnapshot>::const_iterator it = toRecreate.begin();
+            it != toRecreate.end(); ++it)
+      {
+         recreatedLabels.insert(it->label);
+         try
+         {
+            loadDevice(it->label.c_str(), moduleName, it->deviceName.c_str());
+            for (std::vector<std::pair<std::string, std::string> >::const_iterator
+                  prop = it->preInitProperties.begin();
+                  prop != it->preInitProperties.end(); ++prop)
+            {
+               setProperty(it->label.c_str(), prop->first.c_str(), prop->second.c_str());
+            }
+            if (!it->parentLabel.empty())
+               setParentLabel(it->label.c_str(), it->parentLabel.c_str());
+         }
+         catch (const CMMError& e)
+         {
+            throw CMMError("Cannot recreate device " + ToQuotedString(it->label) +
+                  " after reloading device adapter " + ToQuotedString(moduleName), e);
+         }
+      }
+
+      for (std::vector<DeviceSnapshot>::const_iterator it = toRecreate.begin();
+            it != toRecreate.end(); ++it)
+      {
+         try
+         {
+            if (it->initialized)
+               initializeDevice(it->label.c_str());
+            if (it->delayMs > 0.0)
+               setDeviceDelayMs(it->label.c_str(), it->delayMs);
+            if (it->isStage)
+               setFocusDirection(it->label.c_str(), it->focusDirection);
+            for (std::vector<std::pair<long, std::string> >::const_iterator
+                  stateLabel = it->stateLabels.begin();
+                  stateLabel != it->stateLabels.end(); ++stateLabel)
+            {
+               defineStateLabel(it->label.c_str(), stateLabel->first,
+                     stateLabel->second.c_str());
+            }
+         }
+         catch (const CMMError& e)
+         {
+            throw CMMError("Cannot recreate device " + ToQuotedString(it->label) +
+                  " after reloading device adapter " + ToQuotedString(moduleName), e);
+         }
+      }
+
+      // Restore the last cached state, skipping values that are already current
+      for (std::vector<PropertySetting>::const_iterator it = cachedState.begin();
+            it != cachedState.end(); ++it)
+      {
+         const std::string label = it->getDeviceLabel();
+         const std::string propName = it->getPropertyName();
+         if (!recreatedLabels.count(label))
+            continue;
+         try
+         {
+            if (!hasProperty(label.c_str(), propName.c_str()) ||
+                  isPropertyPreInit(label.c_str(), propName.c_str()) ||
+                  isPropertyReadOnly(label.c_str(), propName.c_str()))
+               continue;
+            if (getProperty(label.c_str(), propName.c_str()) != it->getPropertyValue())
+               setProperty(label.c_str(), propName.c_str(), it->getPropertyValue().c_str());
+         }
+         catch (const CMMError& e)
+         {
+            LOG_WARNING(coreLogger_) << "Could not restore property " <<
+               ToQuotedString(propName) << " of device " << ToQuotedString(label) <<
+               " after reload: " << e.getFullMsg();
+         }
+      }
+
+      for (std::vector<std::pair<std::string, std::string> >::const_iterator it =
+            roles.begin(); it != roles.end(); ++it)
+      {
+         try
+         {
+            setProperty(MM::g_Keyword_CoreDevice, it->first.c_str(), it->second.c_str());
+         }
+         catch (const CMMError& e)
+         {
+            LOG_WARNING(coreLogger_) << "Could not restore Core property " <<
+               it->first << " after reload: " << e.getFullMsg();
+         }
+      }
+
+      // Bring the cache up to date for the recreated devices only
+      for (std::vector<DeviceSnapshot>::const_iterator it = toRecreate.begin();
+            it != toRecreate.end(); ++it)
+      {
+         std::shared_ptr<DeviceInstance> pDev = deviceManager_->GetDevice(it->label);
+         Configuration deviceState;
+         {
+            mm::DeviceModuleLockGuard guard(pDev);
+            std::vector<std::string> propertyNames = pDev->GetPropertyNames();
+            for (std::vector<std::string>::const_iterator prop = propertyNames.begin();
+                  prop != propertyNames.end(); ++prop)
+            {
+               try
+               {
+                  deviceState.addSetting(PropertySetting(it->label.c_str(), prop->c_str(),
+                           pDev->GetProperty(*prop).c_str(),
+                           pDev->GetPropertyReadOnly(prop->c_str())));
+               }
+               catch (const CMMError&)
+               {
+                  // Leave out of the cache, as for unreadable properties elsewhere
+               }
+            }
+         }
+         MMThreadGuard scg(stateCacheLock_);
+         for (size_t i = 0; i < deviceState.size(); ++i)
+            addStateCacheSetting(deviceState.getSetting(i));
+      }
+   };
+
+   LOG_INFO(coreLogger_) << "Will reload device adapter " << moduleName <<
+      " with " << snapshots.size() << " devices";
+
+   try
+   {
+      // Unload in reverse order, so that peripherals go before their hubs
+      for (std::vector<DeviceSnapshot>::reverse_iterator it = snapshots.rbegin();
+            it != snapshots.rend(); ++it)
+      {
+         unloadDevice(it->label.c_str());
+      }
+
+      pluginManager_->ReloadDeviceAdapter(moduleName);
+   }
+   catch (const CMMError& e)
+   {
+      // A device failed to shut down, or the module could not be reloaded
+      // (for example because something else still holds a reference to it).
+      // Do not leave the devices that were already unloaded missing.
+      std::vector<DeviceSnapshot> unloaded;
+      const std::vector<std::string> loaded = deviceManager_->GetDeviceList();
+      for (std::vector<DeviceSnapshot>::const_iterator it = snapshots.begin();
+            it != snapshots.end(); ++it)
+      {
+         if (std::find(loaded.begin(), loaded.end(), it->label) == loaded.end())
+            unloaded.push_back(*it);
+      }
+      try
+      {
+         recreateDevices(unloaded);
+      }
+      catch (const CMMError& restoreErr)
+      {
+         logError(moduleName, restoreErr.getFullMsg().c_str());
+      }
+      throw CMMError("Cannot reload device adapter " + ToQuotedString(moduleName), e);
+   }
+
+   recreateDevices(snapshots);
+
+   LOG_INFO(coreLogger_) << "Did reload device adapter " << moduleName;
+
+   if (externalCallback_)
+      externalCallback_->onPropertiesChanged();
+}
+
 /**
  * Returns device name for a given device label.
  * "Name" is determined by the library and is immutable, while "label" is
@@ -1222,6 +1758,24 @@ void CMMCore::waitForDevice(std::shared_ptr<DeviceInstance> pDev) throw (CMMErro
    LOG_DEBUG(coreLogger_) << "Finished waiting for device " << pDev->GetLabel();
 }
 
+/**
+ * Registers a move that has been started on the device with the move
+ * scheduler. The scheduler polls Busy() with the module lock held, using the
+ * Core's polling interval as the maximum interval and the Core's timeout.
+ */
+long CMMCore::trackMove(std::shared_ptr<DeviceInstance> pDev)
+{
+   mm::MoveScheduler::BusyFunction isBusy = [pDev]() {
+      mm::DeviceModuleLockGuard guard(pDev);
+      return pDev->Busy();
+   };
+   long handle = moveScheduler_->Add(pDev->GetLabel(), isBusy,
+         timeoutMs_, pollingIntervalMs_);
+   LOG_DEBUG(coreLogger_) << "Tracking move " << handle << " of device " <<
+      pDev->GetLabel();
+   return handle;
+}
+
 /**
  * Checks the busy status of the entire system. The system will report busy if any
  * of the devices is busy.
@@ -2068,6 +2622,88 @@ void CMMCore::loadExposureSequence(const char* cameraLabel, std::vector<double>
       throw CMMError(getDeviceErrorText(ret, pCamera));
 }
 
+/**
+ * Changes a camera property from the next frame on, without restarting a
+ * running sequence acquisition.
+ *
+ * If the camera is not capturing, the property is set immediately, as by
+ * setProperty(). If it is capturing and supports live property changes, the
+ * property is also set immediately, and the camera applies the new value
+ * from its next frame on. Otherwise the change is queued, and the Core sets
+ * the property as soon as the next frame from the camera has been received,
+ * between two frames. The property is set from a Core thread, not from the
+ * camera's thread that inserted the frame. If the camera's device adapter is in use by another
+ * thread at that moment, the change waits for the following frame. A queued
+ * change is replaced by a later change of the same property. Changes still
+ * queued when the sequence acquisition is stopped are applied then.
+ *
+ * The first image received after a change has been applied carries the tag
+ * "LivePropertyChange-<camera label>-<property>" with the new value, so the
+ * image number from which the change is in effect can be identified. (For
+ * cameras that apply changes themselves, this is the first image received
+ * after the camera accepted the change.) Changes that fail while the camera
+ * is capturing are logged.
+ *
+ * @param cameraLabel   the camera device label
+ * @param propName      the property name
+ * @param propValue     the new property value
+ */
+void CMMCore::setPropertyAtNextFrame(const char* cameraLabel,
+      const char* propName, const char* propValue) throw (CMMError)
+{
+   CheckPropertyName(propName);
+   CheckPropertyValue(propValue);
+
+   std::shared_ptr<CameraInstance> pCamera =
+      deviceManager_->GetDeviceOfType<CameraInstance>(cameraLabel);
+   const MM::Device* rawCamera = pCamera->GetRawPtr();
+
+   mm::DeviceModuleLockGuard guard(pCamera);
+   if (pCamera->GetPropertyReadOnly(propName))
+      throw CMMError("Property " + ToQuotedString(propName) + " of camera " +
+            ToQuotedString(cameraLabel) + " is read-only");
+
+   const bool capturing = pCamera->IsCapturing();
+   if (!capturing || pCamera->SupportsLivePropertyChanges())
+   {
+      applyLivePropertyChanges(pCamera); // Keep the requested order
+      pCamera->SetProperty(propName, propValue);
+      {
+         MMThreadGuard scg(stateCacheLock_);
+         addStateCacheSetting(PropertySetting(cameraLabel, propName, propValue));
+      }
+      if (capturing)
+      {
+         livePropertyChanges_->AddApplied(rawCamera,
+               mm::LivePropertyChanges::Changes(1,
+                  std::make_pair(std::string(propName), std::string(propValue))));
+      }
+      return;
+   }
+
+   livePropertyChanges_->Queue(rawCamera, propName, propValue);
+   LOG_DEBUG(coreLogger_) << "Queued live change of " << cameraLabel << "-" <<
+      propName << " to " << propValue;
+
+   // The sequence may have ended since we checked
+   if (!pCamera->IsCapturing())
+      applyLivePropertyChanges(pCamera);
+}
+
+/**
+ * Returns the number of property changes queued by setPropertyAtNextFrame()
+ * that have not yet been applied to the camera.
+ *
+ * @param cameraLabel   the camera device label
+ */
+long CMMCore::getPendingPropertyChangeCount(const char* cameraLabel) throw (CMMError)
+{
+   std::shared_ptr<CameraInstance> pCamera =
+      deviceManager_->GetDeviceOfType<CameraInstance>(cameraLabel);
+   return static_cast<long>(
+         livePropertyChanges_->GetPendingCount(pCamera->GetRawPtr()));
+}
+
 
 /**
  * Queries stage if it can be used in a sequence
@@ -2331,11 +2967,381 @@ void CMMCore::loadXYStageSequence(const char* label,
       throw CMMError(getDeviceErrorText(ret, pStage));
 }
 
-
 /**
- * Acquires a single image with current settings.
- * Snap is not allowed while the acquisition thread is run
- */
+ * Starts a continuous XY scan: a sequence acquisition from the current
+ * camera while the XY stage moves from its current position to the given end
+ * position in a straight line, without stopping.
+ *
+ * The first numImages images from the camera receive the metadata tags
+ * "ScanXPositionUm" and "ScanYPositionUm", giving the stage position at
+ * which each image was exposed.
+ *
+ * If the XY stage is sequenceable, positions along the line at the frame
+ * interval are loaded as a stage sequence, to be stepped through by camera
+ * triggers, and each image is tagged with its sequence position. Otherwise
+ * the stage is commanded to move to the end position, at the requested
+ * speed if it has a "Speed" property (in mm/s), and the position of each
+ * image is interpolated along the commanded trajectory from the time the
+ * image was received, less half the exposure. For stages without a "Speed"
+ * property, speedUmPerS must be the speed at which the stage actually moves.
+ *
+ * Call stopXYScanAcquisition() when done, to stop the camera and the stage
+ * and restore the stage speed.
+ *
+ * @param xyStageLabel   the XY stage device label
+ * @param xEndUm         the X position at the end of the scan
+ * @param yEndUm         the Y position at the end of the scan
+ * @param speedUmPerS    the stage speed, in micrometers per second
+ * @param numImages      the number of images to acquire
+ * @param intervalMs     the interval between images; if zero, images are
+ *                       assumed to follow each other at the exposure time
+ */
+void CMMCore::startXYScanAcquisition(const char* xyStageLabel,
+      double xEndUm, double yEndUm, double speedUmPerS,
+      long numImages, double intervalMs) throw (CMMError)
+{
+   if (speedUmPerS <= 0.0)
+      throw CMMError("XY scan speed must be positive");
+   if (numImages < 1)
+      throw CMMError("XY scan must acquire at least one image");
+
+   std::shared_ptr<XYStageInstance> pStage =
+      deviceManager_->GetDeviceOfType<XYStageInstance>(xyStageLabel);
+   std::shared_ptr<CameraInstance> camera = currentCameraDevice_.lock();
+   if (!camera)
+      throw CMMError(getCoreErrorText(MMERR_CameraNotAvailable).c_str(),
+            MMERR_CameraNotAvailable);
+   const std::string cameraLabel = camera->GetLabel();
+
+   std::shared_ptr<mm::XYScan> previous = std::atomic_load(&xyScan_);
+   if (previous)
+      finishXYScan(previous);
+
+   double exposureMs;
+   {
+      mm::DeviceModuleLockGuard guard(camera);
+      exposureMs = camera->GetExposure();
+   }
+   const double frameIntervalMs = (intervalMs > 0.0) ? intervalMs : exposureMs;
+
+   double xStartUm, yStartUm;
+   getXYPosition(xyStageLabel, xStartUm, yStartUm);
+
+   std::shared_ptr<mm::XYScan> scan = std::make_shared<mm::XYScan>(
+         camera->GetRawPtr(), xyStageLabel, numImages);
+
+   const bool sequenced = isXYStageSequenceable(xyStageLabel);
+   if (sequenced)
+   {
+      if (numImages > getXYStageSequenceMaxLength(xyStageLabel))
+         throw CMMError("XY scan has more images than the stage sequence "
+               "of " + ToQuotedString(xyStageLabel) + " can hold");
+      std::vector<double> xs, ys;
+      mm::XYScan::SampleLine(xStartUm, yStartUm, xEndUm, yEndUm,
+            speedUmPerS, frameIntervalMs, numImages, xs, ys);
+      loadXYStageSequence(xyStageLabel, xs, ys);
+      scan->SetSequencedPositions(xs, ys);
+   }
+   else
+   {
+      if (hasProperty(xyStageLabel, MM::g_Keyword_Speed))
+      {
+         scan->SetSavedSpeed(getProperty(xyStageLabel, MM::g_Keyword_Speed));
+         setProperty(xyStageLabel, MM::g_Keyword_Speed, speedUmPerS / 1000.0);
+      }
+      else
+      {
+         LOG_WARNING(coreLogger_) << "XY stage " << xyStageLabel <<
+            " has no " << MM::g_Keyword_Speed << " property; assuming it "
+            "moves at " << speedUmPerS << " um/s";
+      }
+      // Frames received before the move starts are assigned the start
+      // position; the start time is corrected once the move is commanded.
+      scan->SetLinearTrajectory(xStartUm, yStartUm, xEndUm, yEndUm,
+            speedUmPerS, mm::XYScan::Clock::time_point::max(),
+            exposureMs / 2.0);
+   }
+
+   LOG_INFO(coreLogger_) << "Will start XY scan of " << xyStageLabel <<
+      " from (" << xStartUm << ", " << yStartUm << ") to (" << xEndUm <<
+      ", " << yEndUm << ") um at " << speedUmPerS << " um/s with " <<
+      numImages << " images from camera " << cameraLabel;
+
+   try
+   {
+      if (sequenced)
+         startXYStageSequence(xyStageLabel);
+      std::atomic_store(&xyScan_, scan);
+      startSequenceAcquisition(cameraLabel.c_str(), numImages, intervalMs,
+            false);
+      if (!sequenced)
+      {
+         const mm::XYScan::Clock::time_point startTime =
+            mm::XYScan::Clock::now();
+         setXYPosition(xyStageLabel, xEndUm, yEndUm);
+         scan->SetLinearTrajectory(xStartUm, yStartUm, xEndUm, yEndUm,
+               speedUmPerS, startTime, exposureMs / 2.0);
+      }
+   }
+   catch (const CMMError&)
+   {
+      try
+      {
+         if (isSequenceRunning(cameraLabel.c_str()))
+            stopSequenceAcquisition(cameraLabel.c_str());
+         finishXYScan(scan);
+      }
+      catch (const CMMError& e)
+      {
+         LOG_ERROR(coreLogger_) << "Error cleaning up failed XY scan: " <<
+            e.getFullMsg();
+      }
+      throw;
+   }
+}
+
+/**
+ * Stops a continuous XY scan started with startXYScanAcquisition().
+ *
+ * Stops the camera sequence acquisition and the stage, and restores the
+ * stage speed. Does nothing if no scan was started.
+ */
+void CMMCore::stopXYScanAcquisition() throw (CMMError)
+{
+   std::shared_ptr<mm::XYScan> scan = std::atomic_load(&xyScan_);
+   if (!scan)
+      return;
+
+   std::shared_ptr<DeviceInstance> camera;
+   try
+   {
+      camera = deviceManager_->GetDevice(scan->GetCamera());
+   }
+   catch (const CMMError&)
+   {
+      // Camera has been unloaded
+   }
+   if (camera)
+   {
+      const std::string cameraLabel = camera->GetLabel();
+      if (isSequenceRunning(cameraLabel.c_str()))
+         stopSequenceAcquisition(cameraLabel.c_str());
+   }
+   finishXYScan(scan);
+}
+
+/**
+ * Sets the queued live property changes of a camera. The caller must hold
+ * the camera's module lock. Errors are logged, as the caller may be a camera
+ * thread.
+ */
+void CMMCore::applyLivePropertyChanges(std::shared_ptr<CameraInstance> camera)
+{
+   const MM::Device* rawCamera = camera->GetRawPtr();
+   mm::LivePropertyChanges::Changes pending =
+      livePropertyChanges_->TakePending(rawCamera);
+   if (pending.empty())
+      return;
+
+   const std::string label = camera->GetLabel();
+   mm::LivePropertyChanges::Changes applied;
+   for (const auto& change : pending)
+   {
+      try
+      {
+         camera->SetProperty(change.first, change.second);
+      }
+      catch (const CMMError& e)
+      {
+         LOG_ERROR(coreLogger_) << "Failed to apply live change of " <<
+            label << "-" << change.first << " to " << change.second <<
+            ": " << e.getFullMsg();
+         continue;
+      }
+      {
+         MMThreadGuard scg(stateCacheLock_);
+         addStateCacheSetting(PropertySetting(label.c_str(),
+                  change.first.c_str(), change.second.c_str()));
+      }
+      applied.push_back(change);
+      LOG_DEBUG(coreLogger_) << "Applied live change of " << label << "-" <<
+         change.first << " to " << change.second;
+   }
+   if (camera->IsCapturing())
+      livePropertyChanges_->AddApplied(rawCamera, applied);
+}
+
+/**
+ * Sets the queued live property changes of a camera after a frame has been
+ * received. Called on the thread of mm::LivePropertyChanges, never on the
+ * camera's inserting thread.
+ */
+void CMMCore::applyLivePropertyChangesBetweenFrames(const MM::Device* rawCamera)
+{
+   std::shared_ptr<CameraInstance> camera;
+   try
+   {
+      camera = std::static_pointer_cast<CameraInstance>(
+            deviceManager_->GetDevice(rawCamera));
+   }
+   catch (const CMMError&)
+   {
+      return; // Unloaded since the frame was received
+   }
+
+   // Waiting for the module lock could deadlock with a thread that holds it
+   // while stopping this camera; retry at the next frame instead.
+   mm::DeviceModuleTryLockGuard guard(camera);
+   if (guard.IsLocked())
+      applyLivePropertyChanges(camera);
+}
+
+void CMMCore::finishXYScan(std::shared_ptr<mm::XYScan> scan) throw (CMMError)
+{
+   scan->Finish();
+   std::shared_ptr<mm::XYScan> expected = scan;
+   std::atomic_compare_exchange_strong(&xyScan_, &expected,
+         std::shared_ptr<mm::XYScan>());
+
+   const std::string stageLabel = scan->GetStageLabel();
+   try
+   {
+      deviceManager_->GetDevice(stageLabel);
+   }
+   catch (const CMMError&)
+   {
+      return; // Stage has been unloaded
+   }
+
+   if (scan->IsSequenced())
+   {
+      stopXYStageSequence(stageLabel.c_str());
+   }
+   else
+   {
+      stop(stageLabel.c_str());
+      const std::string savedSpeed = scan->GetSavedSpeed();
+      if (!savedSpeed.empty())
+      {
+         setProperty(stageLabel.c_str(), MM::g_Keyword_Speed,
+               savedSpeed.c_str());
+         scan->SetSavedSpeed(std::string());
+      }
+   }
+   LOG_INFO(coreLogger_) << "Finished XY scan of " << stageLabel << " after " <<
+      scan->GetStampedFrameCount() << " images";
+}
+
+/**
+ * Starts moving the stage to the given position and returns immediately.
+ *
+ * Completion of the move is tracked by the Core in the background. Use
+ * isMoveDone(), waitForMove(), or waitForMoves() with the returned handle to
+ * find out when the stage has reached its target.
+ *
+ * @param stageLabel  the stage device label
+ * @param position    the desired stage position, in microns
+ * @return a handle identifying the move
+ */
+long CMMCore::setPositionAsync(const char* stageLabel, double position) throw (CMMError)
+{
+   setPosition(stageLabel, position);
+   return trackMove(deviceManager_->GetDevice(stageLabel));
+}
+
+/**
+ * Starts moving the XY stage to the given position and returns immediately.
+ *
+ * See setPositionAsync() for how to wait for the move to finish.
+ *
+ * @param xyStageLabel  the XY stage device label
+ * @param x             the X axis position in microns
+ * @param y             the Y axis position in microns
+ * @return a handle identifying the move
+ */
+long CMMCore::setXYPositionAsync(const char* xyStageLabel, double x, double y) throw (CMMError)
+{
+   setXYPosition(xyStageLabel, x, y);
+   return trackMove(deviceManager_->GetDevice(xyStageLabel));
+}
+
+/**
+ * Starts switching the state device (e.g. filter wheel) to the given state
+ * and returns immediately.
+ *
+ * See setPositionAsync() for how to wait for the move to finish.
+ *
+ * @param stateDeviceLabel  the state device label
+ * @param state             the new state
+ * @return a handle identifying the move
+ */
+long CMMCore::setStateAsync(const char* stateDeviceLabel, long state) throw (CMMError)
+{
+   setState(stateDeviceLabel, state);
+   return trackMove(deviceManager_->GetDevice(stateDeviceLabel));
+}
+
+/**
+ * Checks whether an asynchronous move has finished.
+ *
+ * A move is finished when the device is no longer busy, or when polling the
+ * device failed or timed out (in which case waitForMove() will throw).
+ *
+ * @param moveHandle  the handle returned by one of the asynchronous move
+ *                    functions
+ * @return true if the move has finished
+ */
+bool CMMCore::isMoveDone(long moveHandle) throw (CMMError)
+{
+   return moveScheduler_->IsDone(moveHandle);
+}
+
+/**
+ * Waits (blocks the calling thread) until an asynchronous move has finished.
+ *
+ * The handle is invalid after this function returns or throws.
+ *
+ * @param moveHandle  the handle returned by one of the asynchronous move
+ *                    functions
+ * @throws CMMError if the device reported an error or did not become ready
+ * within the Core timeout (see setTimeoutMs())
+ */
+void CMMCore::waitForMove(long moveHandle) throw (CMMError)
+{
+   waitForMoves(std::vector<long>(1, moveHandle));
+}
+
+/**
+ * Waits (blocks the calling thread) until all of the given asynchronous moves
+ * have finished.
+ *
+ * The handles are invalid after this function returns or throws. If more than
+ * one of the moves failed, the error for the first one (in the order given)
+ * is thrown, after all of the moves have finished.
+ *
+ * @param moveHandles  handles returned by the asynchronous move functions
+ */
+void CMMCore::waitForMoves(std::vector<long> moveHandles) throw (CMMError)
+{
+   LOG_DEBUG(coreLogger_) << "Waiting for " << moveHandles.size() << " move(s)...";
+   try
+   {
+      moveScheduler_->Wait(moveHandles);
+   }
+   catch (const CMMError& err)
+   {
+      logError("waitForMoves", err.getMsg().c_str());
+      throw;
+   }
+   LOG_DEBUG(coreLogger_) << "Finished waiting for " << moveHandles.size() <<
+      " move(s)";
+}
+
+
+/**
+ * Acquires a single image with current settings.
+ * Snap is not allowed while the acquisition thread is run
+ */
 void CMMCore::snapImage() throw (CMMError)
 {
    std::shared_ptr<CameraInstance> camera = currentCameraDevice_.lock();
@@ -2368,6 +3374,7 @@ void CMMCore::snapImage() throw (CMMError)
 
          LOG_DEBUG(coreLogger_) << "Will snap image from current camera";
          ret = camera->SnapImage();
+         processedImageTracker_->NewSnap();
          if (ret == DEVICE_OK)
          {
             LOG_DEBUG(coreLogger_) << "Did snap image from current camera";
@@ -2410,6 +3417,167 @@ void CMMCore::snapImage() throw (CMMError)
    }
 }
 
+/**
+ * Acquires a burst of images with repeated snaps, delivering them to the
+ * circular buffer.
+ *
+ * Unlike calling snapImage() numImages times, the auto-shutter is opened once
+ * for the whole burst, and is closed as soon as the last exposure has ended,
+ * while that image is being copied out of the camera.
+ *
+ * On machines with more than one CPU, the acquisition is pipelined: right
+ * after each exposure, the image is copied out of the camera into one of two
+ * Core-owned buffers, and the next exposure is started while a copy thread
+ * inserts the image into the circular buffer (with metadata, image
+ * processing and software binning). The two buffers are kept for the next
+ * burst. On a single CPU, each image is inserted before the next exposure. Another thread can retrieve
+ * and process the images (with popNextImage() or getRemainingImageCount())
+ * as they arrive. The circular buffer is initialized and cleared at the
+ * start, as for startSequenceAcquisition().
+ *
+ * This works with any camera, including ones that do not support sequence
+ * acquisition. Blocks until all images have been acquired.
+ *
+ * @param numImages  number of images to snap
+ */
+void CMMCore::snapImageBurst(long numImages) throw (CMMError)
+{
+   if (numImages < 1)
+      throw CMMError("Burst must contain at least one image",
+            MMERR_InvalidContents);
+
+   std::shared_ptr<CameraInstance> camera = currentCameraDevice_.lock();
+   if (!camera)
+      throw CMMError(getCoreErrorText(MMERR_CameraNotAvailable).c_str(), MMERR_CameraNotAvailable);
+
+   mm::DeviceModuleLockGuard guard(camera);
+   if (camera->IsCapturing())
+      throw CMMError(getCoreErrorText(MMERR_NotAllowedDuringSequenceAcquisition).c_str(),
+                     MMERR_NotAllowedDuringSequenceAcquisition);
+
+   const unsigned width = camera->GetImageWidth();
+   const unsigned height = camera->GetImageHeight();
+   const unsigned bytesPerPixel = camera->GetImageBytesPerPixel();
+   const unsigned numComponents = camera->GetNumberOfComponents();
+   const unsigned numChannels = camera->GetNumberOfChannels();
+
+   resetCircularBufferForCamera(camera);
+
+   std::shared_ptr<ShutterInstance> shutter;
+   if (autoShutter_)
+      shutter = currentShutterDevice_.lock();
+
+   const std::size_t channelBytes = static_cast<std::size_t>(width) *
+      height * bytesPerPixel;
+   const MM::Device* rawCamera = camera->GetRawPtr();
+   MM::Core* callback = callback_;
+   std::shared_ptr<mm::SnapBurstPipeline> pipeline;
+   {
+      MMThreadGuard g(snapBurstPipelineLock_);
+      pipeline.swap(idleSnapBurstPipeline_);
+   }
+   if (!pipeline)
+   {
+      // Without a second CPU, the copy thread only adds a copy
+      const bool overlap = std::thread::hardware_concurrency() != 1;
+      pipeline = std::make_shared<mm::SnapBurstPipeline>(overlap ? 2 : 0);
+   }
+   // On error the pipeline is dropped, discarding the images not inserted
+   pipeline->Start(
+         [=](long imageIndex, unsigned channel, unsigned char* pixels) {
+            Metadata md;
+            md.PutImageTag(MM::g_Keyword_CameraChannelIndex, channel);
+            md.PutImageTag("BurstImageIndex", imageIndex);
+            return callback->InsertImage(rawCamera, pixels, width, height,
+                  bytesPerPixel, numComponents, md.Serialize().c_str(), true);
+         });
+
+   bool shutterOpen = false;
+   try
+   {
+      if (shutter)
+      {
+         int sret = shutter->SetOpen(true);
+         if (sret != DEVICE_OK)
+         {
+            logError("CMMCore::snapImageBurst", getDeviceErrorText(sret, shutter).c_str());
+            throw CMMError(getDeviceErrorText(sret, shutter).c_str(), MMERR_DEVICE_GENERIC);
+         }
+         shutterOpen = true;
+         waitForDevice(shutter);
+      }
+
+      LOG_DEBUG(coreLogger_) << "Will snap burst of " << numImages <<
+         " images from current camera";
+      for (long i = 0; i < numImages; ++i)
+      {
+         int ret = camera->SnapImage();
+         processedImageTracker_->NewSnap();
+         everSnapped_ = true;
+         if (ret != DEVICE_OK)
+         {
+            logError("CMMCore::snapImageBurst", getDeviceErrorText(ret, camera).c_str());
+            throw CMMError(getDeviceErrorText(ret, camera).c_str(), MMERR_DEVICE_GENERIC);
+         }
+
+         // The exposure has ended; close the shutter before reading out the
+         // last image, and wait for it afterwards
+         if (shutterOpen && i == numImages - 1)
+         {
+            int sret = shutter->SetOpen(false);
+            shutterOpen = false;
+            if (sret != DEVICE_OK)
+            {
+               logError("CMMCore::snapImageBurst", getDeviceErrorText(sret, shutter).c_str());
+               throw CMMError(getDeviceErrorText(sret, shutter).c_str(), MMERR_DEVICE_GENERIC);
+            }
+         }
+
+         std::vector<const unsigned char*> channels(numChannels);
+         for (unsigned channel = 0; channel < numChannels; ++channel)
+         {
+            channels[channel] = camera->GetImageBuffer(channel);
+            if (!channels[channel])
+            {
+               logError("CMMCore::snapImageBurst", getCoreErrorText(MMERR_CameraBufferReadFailed).c_str());
+               throw CMMError(getCoreErrorText(MMERR_CameraBufferReadFailed).c_str(), MMERR_CameraBufferReadFailed);
+            }
+         }
+
+         // Inserted on the pipeline's thread while the next image is exposed
+         ret = pipeline->Push(i, channels, channelBytes);
+         if (ret != DEVICE_OK)
+         {
+            logError("CMMCore::snapImageBurst", getDeviceErrorText(ret, camera).c_str());
+            throw CMMError(getDeviceErrorText(ret, camera).c_str(), MMERR_DEVICE_GENERIC);
+         }
+      }
+
+      int ret = pipeline->Finish();
+      if (ret == DEVICE_OK)
+      {
+         MMThreadGuard g(snapBurstPipelineLock_);
+         idleSnapBurstPipeline_ = pipeline;
+      }
+      else
+      {
+         logError("CMMCore::snapImageBurst", getDeviceErrorText(ret, camera).c_str());
+         throw CMMError(getDeviceErrorText(ret, camera).c_str(), MMERR_DEVICE_GENERIC);
+      }
+      LOG_DEBUG(coreLogger_) << "Did snap burst of " << numImages <<
+         " images from current camera";
+
+      if (shutter)
+         waitForDevice(shutter);
+   }
+   catch (const CMMError&)
+   {
+      if (shutterOpen)
+         shutter->SetOpen(false);
+      throw;
+   }
+}
+
 /**
  * If this option is enabled Shutter automatically opens and closes when the image
  * is acquired.
@@ -2421,7 +3589,7 @@ void CMMCore::setAutoShutter(bool state)
    autoShutter_ = state;
    {
       MMThreadGuard scg(stateCacheLock_);
-      stateCache_.addSetting(PropertySetting(MM::g_Keyword_CoreDevice, MM::g_Keyword_CoreAutoShutter, state ? "1" : "0"));
+      addStateCacheSetting(PropertySetting(MM::g_Keyword_CoreDevice, MM::g_Keyword_CoreAutoShutter, state ? "1" : "0"));
    }
    LOG_DEBUG(coreLogger_) << "Autoshutter turned " << (state ? "on" : "off");
 }
@@ -2456,7 +3624,7 @@ void CMMCore::setShutterOpen(const char* shutterLabel, bool state) throw (CMMErr
       {
          {
             MMThreadGuard scg(stateCacheLock_);
-            stateCache_.addSetting(PropertySetting(shutterLabel, MM::g_Keyword_State, CDeviceUtils::ConvertToString(state)));
+            addStateCacheSetting(PropertySetting(shutterLabel, MM::g_Keyword_State, CDeviceUtils::ConvertToString(state)));
          }
       }
    }
@@ -2523,6 +3691,11 @@ bool CMMCore::getShutterOpen() throw (CMMError)
  * on little endian the format is BGRA888 
  * (see: https://en.wikipedia.org/wiki/RGBA_color_model).
  *
+ * If an image processor is set, it is applied once per snapped image: calling
+ * getImage() again before the next snap returns the same processed image
+ * without processing it again. See enableProcessedImageCopy() for where the
+ * processed image is stored.
+ *
  * @return a pointer to the internal image buffer.
  * @throws CMMError   when the camera returns no data
  */
@@ -2555,14 +3728,7 @@ void* CMMCore::getImage() throw (CMMError)
       void* pBuf(0);
       try {
          mm::DeviceModuleLockGuard guard(camera);
-         pBuf = const_cast<unsigned char*> (camera->GetImageBuffer());
-
-         std::shared_ptr<ImageProcessorInstance> imageProcessor =
-            currentImageProcessor_.lock();
-         if (imageProcessor)
-	      {
-            imageProcessor->Process((unsigned char*)pBuf, camera->GetImageWidth(),  camera->GetImageHeight(), camera->GetImageBytesPerPixel() );
-	      }
+         pBuf = getReducedImage(camera, 0);
 		} catch( CMMError& e){
 			throw e;
 		} catch (...) {
@@ -2589,6 +3755,9 @@ void* CMMCore::getImage() throw (CMMError)
  * irrespective of the channelNr argument
  * Designed specifically for the SWIG wrapping for Java and scripting languages.
  *
+ * As with getImage(), the image processor (if any) is applied once per
+ * snapped image and channel.
+ *
  * @param channelNr   Channel number for which the image buffer is requested
  * @return a pointer to the internal image buffer.
  */
@@ -2602,14 +3771,7 @@ void* CMMCore::getImage(unsigned channelNr) throw (CMMError)
       void* pBuf(0);
       try {
          mm::DeviceModuleLockGuard guard(camera);
-         pBuf = const_cast<unsigned char*> (camera->GetImageBuffer(channelNr));
-
-         std::shared_ptr<ImageProcessorInstance> imageProcessor =
-            currentImageProcessor_.lock();
-         if (imageProcessor)
-	      {
-            imageProcessor->Process((unsigned char*)pBuf, camera->GetImageWidth(),  camera->GetImageHeight(), camera->GetImageBytesPerPixel() );
-	      }
+         pBuf = getReducedImage(camera, channelNr);
 		} catch( CMMError& e){
 			throw e;
 		} catch (...) {
@@ -2628,29 +3790,175 @@ void* CMMCore::getImage(unsigned channelNr) throw (CMMError)
 }
 
 /**
-* Returns the size of the internal image buffer.
-*
-* @return buffer size
-*/
-long CMMCore::getImageBufferSize()
+ * Sets whether the image processor works on a copy of snapped images.
+ *
+ * By default, getImage() applies the image processor in place, in the
+ * camera's image buffer. When enabled, the image is instead copied to a
+ * buffer owned by the Core and processed there, leaving the camera's buffer
+ * unmodified. The pointer returned by getImage() then remains valid until
+ * getImage() processes the next snapped image of the same channel.
+ *
+ * The setting takes effect for images snapped after the call. It has no
+ * effect when no image processor is set.
+ *
+ * @param enable   true to process a copy of snapped images
+ */
+void CMMCore::enableProcessedImageCopy(bool enable)
 {
-   std::shared_ptr<CameraInstance> camera = currentCameraDevice_.lock();
-   if (camera) {
-      try
-      {
-         mm::DeviceModuleLockGuard guard(camera);
-         return camera->GetImageBufferSize();
-      }
-      catch (const CMMError&) // Possibly uninitialized camera
-      {
-         // Fall through
-      }
-   }
-   return 0;
+   processedImageTracker_->SetCopyEnabled(enable);
+   LOG_INFO(coreLogger_) << "Processing of snapped images " <<
+      (enable ? "in a copy" : "in place") << " enabled";
 }
 
 /**
- * Starts streaming camera sequence acquisition.
+ * Returns whether the image processor works on a copy of snapped images.
+ * @see enableProcessedImageCopy()
+ */
+bool CMMCore::isProcessedImageCopyEnabled()
+{
+   return processedImageTracker_->IsCopyEnabled();
+}
+
+/**
+ * Sets binning of camera images in software.
+ *
+ * Each binning x binning block of pixels is replaced by its sum or mean,
+ * before the image is stored in the circular buffer (sequence acquisition) or
+ * returned by getImage() (snaps), after the image processor (if any). This is
+ * intended for cameras that lack hardware binning; it reduces the amount of
+ * data handled downstream. Rows and columns left over when the image size is
+ * not a multiple of the binning factor are dropped. Sums that exceed the
+ * range of the pixel type are saturated.
+ *
+ * getImageWidth(), getImageHeight(), getImageBufferSize(), getPixelSizeUm()
+ * and getPixelSizeAffine() take the software binning into account. Images
+ * carry the SoftwareBinning tag while it is enabled. The binning applies to
+ * all cameras.
+ *
+ * Not allowed while a sequence acquisition is running.
+ *
+ * @param binning  the binning factor (1 to disable; at most 64)
+ * @param average  true to average, false to sum the binned pixels
+ */
+void CMMCore::setSoftwareBinning(unsigned binning, bool average)
+   throw (CMMError)
+{
+   if (binning < 1 || binning > mm::SoftwareBinning::MaxBinning)
+      throw CMMError("Software binning must be between 1 and " +
+            ToString(mm::SoftwareBinning::MaxBinning));
+   checkSoftwareBinningChangeAllowed();
+
+   softwareBinning_->SetBinning(binning, average);
+   LOG_INFO(coreLogger_) << "Software binning set to " << binning <<
+      (average ? " (mean)" : " (sum)");
+}
+
+/**
+ * Returns the software binning factor (1 if disabled).
+ * @see setSoftwareBinning()
+ */
+unsigned CMMCore::getSoftwareBinning()
+{
+   return softwareBinning_->GetSettings().binning;
+}
+
+/**
+ * Returns whether software binning averages (rather than sums) pixels.
+ * @see setSoftwareBinning()
+ */
+bool CMMCore::isSoftwareBinningAveraged()
+{
+   return softwareBinning_->GetSettings().average;
+}
+
+/**
+ * Sets a rectangle to which camera images are cropped in software.
+ *
+ * The rectangle is in pixels of the images delivered by the camera (after
+ * the camera's own binning and ROI), and is applied before software binning.
+ * Like software binning, it applies to images stored in the circular buffer
+ * and images returned by getImage(), and is reflected in getImageWidth() and
+ * getImageHeight(). Images carry the SoftwareCrop tag while it is set.
+ * Acquiring fails if the rectangle does not fit in the camera image.
+ *
+ * Not allowed while a sequence acquisition is running.
+ *
+ * @param x        the left edge
+ * @param y        the top edge
+ * @param xSize    the width
+ * @param ySize    the height
+ */
+void CMMCore::setSoftwareCrop(int x, int y, int xSize, int ySize)
+   throw (CMMError)
+{
+   if (x < 0 || y < 0 || xSize <= 0 || ySize <= 0)
+      throw CMMError("Invalid software crop rectangle");
+   checkSoftwareBinningChangeAllowed();
+
+   softwareBinning_->SetCrop(x, y, xSize, ySize);
+   LOG_INFO(coreLogger_) << "Software crop set to (" << x << ", " << y <<
+      ", " << xSize << ", " << ySize << ")";
+}
+
+/**
+ * Returns the software crop rectangle; all zero if none is set.
+ * @see setSoftwareCrop()
+ */
+void CMMCore::getSoftwareCrop(int& x, int& y, int& xSize, int& ySize)
+{
+   mm::SoftwareBinning::Settings settings = softwareBinning_->GetSettings();
+   x = settings.cropX;
+   y = settings.cropY;
+   xSize = settings.cropWidth;
+   ySize = settings.cropHeight;
+}
+
+/**
+ * Removes the software crop rectangle.
+ * @see setSoftwareCrop()
+ */
+void CMMCore::clearSoftwareCrop() throw (CMMError)
+{
+   checkSoftwareBinningChangeAllowed();
+   softwareBinning_->ClearCrop();
+   LOG_INFO(coreLogger_) << "Software crop cleared";
+}
+
+/**
+* Returns the size of the internal image buffer.
+*
+* @return buffer size
+*/
+long CMMCore::getImageBufferSize()
+{
+   std::shared_ptr<CameraInstance> camera = currentCameraDevice_.lock();
+   if (camera) {
+      try
+      {
+         mm::DeviceModuleLockGuard guard(camera);
+         const mm::SoftwareBinning::Settings settings =
+            softwareBinning_->GetSettings();
+         if (settings.IsActive())
+         {
+            unsigned width, height;
+            mm::SoftwareBinning::GetOutputSize(settings,
+                  camera->GetImageWidth(), camera->GetImageHeight(),
+                  width, height);
+            return static_cast<long>(width) * height *
+               camera->GetImageBytesPerPixel();
+         }
+         return camera->GetImageBufferSize();
+      }
+      catch (const CMMError&) // Possibly uninitialized camera
+      {
+         // Fall through
+      }
+   }
+   return 0;
+}
+
+/**
+ * Starts streaming camera sequence acquisition.
  * This command does not block the calling thread for the duration of the acquisition.
  *
  * @param numImages        Number of images requested from the camera
@@ -2666,43 +3974,13 @@ void CMMCore::startSequenceAcquisition(long numImages, double intervalMs, bool s
    }
 
    std::shared_ptr<CameraInstance> camera = currentCameraDevice_.lock();
-   if (camera)
-   {
-      if(camera->IsCapturing())
-      {
-         throw CMMError(getCoreErrorText(
-            MMERR_NotAllowedDuringSequenceAcquisition).c_str()
-            ,MMERR_NotAllowedDuringSequenceAcquisition);
-      }
-
-		try
-		{
-			if (!cbuf_->Initialize(camera->GetNumberOfChannels(), camera->GetImageWidth(), camera->GetImageHeight(), camera->GetImageBytesPerPixel()))
-			{
-				logError(getDeviceName(camera).c_str(), getCoreErrorText(MMERR_CircularBufferFailedToInitialize).c_str());
-				throw CMMError(getCoreErrorText(MMERR_CircularBufferFailedToInitialize).c_str(), MMERR_CircularBufferFailedToInitialize);
-			}
-			cbuf_->Clear();
-         mm::DeviceModuleLockGuard guard(camera);
-
-         LOG_DEBUG(coreLogger_) << "Will start sequence acquisition from default camera";
-			int nRet = camera->StartSequenceAcquisition(numImages, intervalMs, stopOnOverflow);
-			if (nRet != DEVICE_OK)
-				throw CMMError(getDeviceErrorText(nRet, camera).c_str(), MMERR_DEVICE_GENERIC);
-		}
-		catch (std::bad_alloc& ex)
-		{
-			std::ostringstream messs;
-			messs << getCoreErrorText(MMERR_OutOfMemory).c_str() << " " << ex.what() << '\n';
-			throw CMMError(messs.str().c_str() , MMERR_OutOfMemory);
-		}
-   }
-   else
+   if (!camera)
    {
       logError(getDeviceName(camera).c_str(), getCoreErrorText(MMERR_CameraNotAvailable).c_str());
       throw CMMError(getCoreErrorText(MMERR_CameraNotAvailable).c_str(), MMERR_CameraNotAvailable);
    }
-   LOG_DEBUG(coreLogger_) << "Did start sequence acquisition from default camera";
+   startSequenceAcquisitionOnCamera(camera, numImages, intervalMs,
+         stopOnOverflow, false);
 }
 
 /**
@@ -2715,27 +3993,8 @@ void CMMCore::startSequenceAcquisition(const char* label, long numImages, double
 {
    std::shared_ptr<CameraInstance> pCam =
       deviceManager_->GetDeviceOfType<CameraInstance>(label);
-
-   mm::DeviceModuleLockGuard guard(pCam);
-   if(pCam->IsCapturing())
-      throw CMMError(getCoreErrorText(MMERR_NotAllowedDuringSequenceAcquisition).c_str(),
-                     MMERR_NotAllowedDuringSequenceAcquisition);
-
-   if (!cbuf_->Initialize(pCam->GetNumberOfChannels(), pCam->GetImageWidth(), pCam->GetImageHeight(), pCam->GetImageBytesPerPixel()))
-   {
-      logError(getDeviceName(pCam).c_str(), getCoreErrorText(MMERR_CircularBufferFailedToInitialize).c_str());
-      throw CMMError(getCoreErrorText(MMERR_CircularBufferFailedToInitialize).c_str(), MMERR_CircularBufferFailedToInitialize);
-   }
-   cbuf_->Clear();
-	
-   LOG_DEBUG(coreLogger_) <<
-      "Will start sequence acquisition from camera " << label;
-   int nRet = pCam->StartSequenceAcquisition(numImages, intervalMs, stopOnOverflow);
-   if (nRet != DEVICE_OK)
-      throw CMMError(getDeviceErrorText(nRet, pCam).c_str(), MMERR_DEVICE_GENERIC);
-
-   LOG_DEBUG(coreLogger_) <<
-      "Did start sequence acquisition from camera " << label;
+   startSequenceAcquisitionOnCamera(pCam, numImages, intervalMs,
+         stopOnOverflow, false);
 }
 
 /**
@@ -2762,6 +4021,261 @@ void CMMCore::prepareSequenceAcquisition(const char* label) throw (CMMError)
       " for sequence acquisition";
 }
 
+/**
+ * Arm a camera for a series of short sequence acquisitions, so that each
+ * burst starts with little more than the camera's StartSequenceAcquisition().
+ *
+ * Arming does the preparation that startSequenceAcquisition() does for every
+ * sequence once, here: the circular buffer is initialized for the camera's
+ * current image format and cleared, and the camera's
+ * PrepareSequenceAcqusition() is called.
+ *
+ * Each burst is then started with startArmedSequenceAcquisition(), which
+ * differs from startSequenceAcquisition(cameraLabel, ...) in that:
+ * - The circular buffer is not cleared; the images of successive bursts
+ *   follow each other in the buffer. The buffer is only set up again if it
+ *   was reinitialized for a different image format in the meantime.
+ * - If auto-shutter is on, the current shutter is opened at the start of the
+ *   first burst and held open between bursts (instead of being opened and
+ *   closed for every burst) until disarmSequenceAcquisition() is called.
+ *   Note that this exposes the sample for the whole time the shutter is held
+ *   open. If the current shutter changes, the one held open is closed.
+ *
+ * Changing the armed camera's image size (ROI, binning, etc.) requires
+ * arming it again. The camera stays armed until disarmed, rearmed or
+ * unloaded.
+ *
+ * @param cameraLabel  the camera to arm
+ */
+void CMMCore::armSequenceAcquisition(const char* cameraLabel) throw (CMMError)
+{
+   std::shared_ptr<CameraInstance> camera =
+      deviceManager_->GetDeviceOfType<CameraInstance>(cameraLabel);
+
+   if (isSequenceAcquisitionArmed())
+      disarmSequenceAcquisition();
+
+   unsigned long bufferGeneration;
+   {
+      mm::DeviceModuleLockGuard guard(camera);
+      if (camera->IsCapturing())
+         throw CMMError(getCoreErrorText(MMERR_NotAllowedDuringSequenceAcquisition).c_str(),
+                        MMERR_NotAllowedDuringSequenceAcquisition);
+
+      resetCircularBufferForCamera(camera);
+      bufferGeneration = cbuf_->GetFormatGeneration();
+
+      int nRet = camera->PrepareSequenceAcqusition();
+      if (nRet != DEVICE_OK)
+         throw CMMError(getDeviceErrorText(nRet, camera).c_str(), MMERR_DEVICE_GENERIC);
+   }
+
+   {
+      MMThreadGuard g(armedSequenceLock_);
+      armedCamera_ = camera;
+      armedBufferGeneration_ = bufferGeneration;
+   }
+   LOG_DEBUG(coreLogger_) << "Armed camera " << cameraLabel <<
+      " for sequence acquisition";
+}
+
+/**
+ * Start a burst on the camera armed with armSequenceAcquisition().
+ *
+ * Like startSequenceAcquisition(cameraLabel, ...), but without setting up
+ * the circular buffer again, and with the auto-shutter held open after the
+ * burst ends.
+ *
+ * @param numImages  number of images to acquire
+ * @param intervalMs  interval between images, if supported by the camera
+ * @param stopOnOverflow  whether to stop when the circular buffer is full
+ */
+void CMMCore::startArmedSequenceAcquisition(long numImages, double intervalMs,
+      bool stopOnOverflow) throw (CMMError)
+{
+   std::shared_ptr<CameraInstance> camera;
+   {
+      MMThreadGuard g(armedSequenceLock_);
+      camera = armedCamera_.lock();
+   }
+   if (!camera)
+      throw CMMError("No camera is armed for sequence acquisition");
+
+   {
+      MMThreadGuard g(*pPostedErrorsLock_);
+      postedErrors_.clear();
+   }
+   startSequenceAcquisitionOnCamera(camera, numImages, intervalMs,
+         stopOnOverflow, true);
+}
+
+/**
+ * Disarm the camera armed with armSequenceAcquisition().
+ *
+ * Closes the shutter if it is being held open. Does not stop a burst in
+ * progress. Does nothing if no camera is armed.
+ */
+void CMMCore::disarmSequenceAcquisition() throw (CMMError)
+{
+   {
+      MMThreadGuard g(armedSequenceLock_);
+      armedCamera_.reset();
+   }
+   releaseArmedShutter();
+   LOG_DEBUG(coreLogger_) << "Disarmed sequence acquisition";
+}
+
+/**
+ * Returns whether a camera is armed for sequence acquisition.
+ */
+bool CMMCore::isSequenceAcquisitionArmed()
+{
+   MMThreadGuard g(armedSequenceLock_);
+   return !armedCamera_.expired();
+}
+
+/**
+ * Returns whether the auto-shutter is being held open because the given
+ * camera is armed, in which case it must not be opened and closed for each
+ * sequence acquisition.
+ */
+bool CMMCore::isShutterHeldForArmedSequence(const MM::Device* camera) const
+{
+   MMThreadGuard g(armedSequenceLock_);
+   std::shared_ptr<CameraInstance> armedCamera = armedCamera_.lock();
+   return armedCamera && armedCamera->GetRawPtr() == camera &&
+      !armedShutter_.expired();
+}
+
+/**
+ * Closes the shutter held open for the armed camera, if any.
+ */
+void CMMCore::releaseArmedShutter() throw (CMMError)
+{
+   std::shared_ptr<ShutterInstance> shutter;
+   {
+      MMThreadGuard g(armedSequenceLock_);
+      shutter = armedShutter_.lock();
+      armedShutter_.reset();
+   }
+   if (!shutter)
+      return;
+
+   mm::DeviceModuleLockGuard guard(shutter);
+   int nRet = shutter->SetOpen(false);
+   if (nRet != DEVICE_OK)
+      throw CMMError(getDeviceErrorText(nRet, shutter).c_str(), MMERR_DEVICE_GENERIC);
+   LOG_DEBUG(coreLogger_) << "Released shutter " << shutter->GetLabel();
+}
+
+/**
+ * Makes the current auto-shutter the one held open for the armed camera,
+ * opening it unless it is already held. A shutter held open before that is
+ * no longer the auto-shutter is closed.
+ */
+void CMMCore::holdShutterForArmedSequence(const std::string& cameraLabel)
+   throw (CMMError)
+{
+   std::shared_ptr<ShutterInstance> shutter;
+   if (autoShutter_)
+      shutter = currentShutterDevice_.lock();
+
+   {
+      MMThreadGuard g(armedSequenceLock_);
+      if (armedShutter_.lock() == shutter)
+         return;
+   }
+   releaseArmedShutter();
+   if (!shutter)
+      return;
+
+   {
+      mm::DeviceModuleLockGuard shutterGuard(shutter);
+      int nRet = shutter->SetOpen(true);
+      if (nRet != DEVICE_OK)
+         throw CMMError(getDeviceErrorText(nRet, shutter).c_str(), MMERR_DEVICE_GENERIC);
+   }
+   waitForDevice(shutter);
+   MMThreadGuard g(armedSequenceLock_);
+   armedShutter_ = shutter;
+   LOG_DEBUG(coreLogger_) << "Holding shutter " << shutter->GetLabel() <<
+      " open for armed camera " << cameraLabel;
+}
+
+/**
+ * Starts a sequence acquisition on the camera. If armed is true (for the
+ * armed camera), the circular buffer is kept unless its format changed since
+ * arming, and the auto-shutter is held open (see
+ * holdShutterForArmedSequence()).
+ */
+void CMMCore::startSequenceAcquisitionOnCamera(
+      std::shared_ptr<CameraInstance> camera, long numImages,
+      double intervalMs, bool stopOnOverflow, bool armed) throw (CMMError)
+{
+   const std::string label = camera->GetLabel();
+   mm::DeviceModuleLockGuard guard(camera);
+   if (camera->IsCapturing())
+      throw CMMError(getCoreErrorText(MMERR_NotAllowedDuringSequenceAcquisition).c_str(),
+                     MMERR_NotAllowedDuringSequenceAcquisition);
+
+   if (armed)
+   {
+      unsigned long armedGeneration;
+      {
+         MMThreadGuard g(armedSequenceLock_);
+         armedGeneration = armedBufferGeneration_;
+      }
+      if (cbuf_->GetFormatGeneration() != armedGeneration)
+      {
+         LOG_DEBUG(coreLogger_) << "Circular buffer was reinitialized since "
+            "arming camera " << label << "; setting it up again";
+         resetCircularBufferForCamera(camera);
+         MMThreadGuard g(armedSequenceLock_);
+         armedBufferGeneration_ = cbuf_->GetFormatGeneration();
+      }
+      holdShutterForArmedSequence(label);
+   }
+   else
+   {
+      resetCircularBufferForCamera(camera);
+   }
+
+   LOG_DEBUG(coreLogger_) <<
+      "Will start sequence acquisition from camera " << label;
+   processedImageTracker_->NewSnap(); // Camera buffer may change
+   int nRet = camera->StartSequenceAcquisition(numImages, intervalMs, stopOnOverflow);
+   if (nRet != DEVICE_OK)
+      throw CMMError(getDeviceErrorText(nRet, camera).c_str(), MMERR_DEVICE_GENERIC);
+
+   LOG_DEBUG(coreLogger_) <<
+      "Did start sequence acquisition from camera " << label;
+}
+
+/**
+ * Initializes the circular buffer for the camera and clears it, as at the
+ * start of a sequence acquisition.
+ * Must be called with the camera's module lock held.
+ */
+void CMMCore::resetCircularBufferForCamera(
+      std::shared_ptr<CameraInstance> camera) throw (CMMError)
+{
+   try
+   {
+      if (!initializeCircularBufferForCamera(camera))
+      {
+         logError(getDeviceName(camera).c_str(), getCoreErrorText(MMERR_CircularBufferFailedToInitialize).c_str());
+         throw CMMError(getCoreErrorText(MMERR_CircularBufferFailedToInitialize).c_str(), MMERR_CircularBufferFailedToInitialize);
+      }
+   }
+   catch (std::bad_alloc& ex)
+   {
+      std::ostringstream messs;
+      messs << getCoreErrorText(MMERR_OutOfMemory).c_str() << " " << ex.what() << '\n';
+      throw CMMError(messs.str().c_str() , MMERR_OutOfMemory);
+   }
+   cbuf_->Clear();
+}
+
 
 /**
  * Initialize circular buffer based on the current camera settings.
@@ -2772,7 +4286,7 @@ void CMMCore::initializeCircularBuffer() throw (CMMError)
    if (camera)
    {
       mm::DeviceModuleLockGuard guard(camera);
-      if (!cbuf_->Initialize(camera->GetNumberOfChannels(), camera->GetImageWidth(), camera->GetImageHeight(), camera->GetImageBytesPerPixel()))
+      if (!initializeCircularBufferForCamera(camera))
       {
          logError(getDeviceName(camera).c_str(), getCoreErrorText(MMERR_CircularBufferFailedToInitialize).c_str());
          throw CMMError(getCoreErrorText(MMERR_CircularBufferFailedToInitialize).c_str(), MMERR_CircularBufferFailedToInitialize);
@@ -2804,6 +4318,13 @@ void CMMCore::stopSequenceAcquisition(const char* label) throw (CMMError)
       throw CMMError(getDeviceErrorText(nRet, pCam).c_str(), MMERR_DEVICE_GENERIC);
    }
 
+   // Later sequences must not receive positions from an interrupted scan
+   std::shared_ptr<mm::XYScan> scan = std::atomic_load(&xyScan_);
+   if (scan && scan->GetCamera() == pCam->GetRawPtr())
+      scan->Finish();
+
+   applyLivePropertyChanges(pCam);
+
    LOG_DEBUG(coreLogger_) << "Did stop sequence acquisition from camera " << label;
 }
 
@@ -2824,13 +4345,14 @@ void CMMCore::startContinuousSequenceAcquisition(double intervalMs) throw (CMMEr
             ,MMERR_NotAllowedDuringSequenceAcquisition);
       }
 
-      if (!cbuf_->Initialize(camera->GetNumberOfChannels(), camera->GetImageWidth(), camera->GetImageHeight(), camera->GetImageBytesPerPixel()))
+      if (!initializeCircularBufferForCamera(camera))
       {
          logError(getDeviceName(camera).c_str(), getCoreErrorText(MMERR_CircularBufferFailedToInitialize).c_str());
          throw CMMError(getCoreErrorText(MMERR_CircularBufferFailedToInitialize).c_str(), MMERR_CircularBufferFailedToInitialize);
       }
       cbuf_->Clear();
       LOG_DEBUG(coreLogger_) << "Will start continuous sequence acquisition from current camera";
+      processedImageTracker_->NewSnap();
       int nRet = camera->StartSequenceAcquisition(intervalMs);
       if (nRet != DEVICE_OK)
          throw CMMError(getDeviceErrorText(nRet, camera).c_str(), MMERR_DEVICE_GENERIC);
@@ -2859,6 +4381,12 @@ void CMMCore::stopSequenceAcquisition() throw (CMMError)
          logError(getDeviceName(camera).c_str(), getDeviceErrorText(nRet, camera).c_str());
          throw CMMError(getDeviceErrorText(nRet, camera).c_str(), MMERR_DEVICE_GENERIC);
       }
+
+      std::shared_ptr<mm::XYScan> scan = std::atomic_load(&xyScan_);
+      if (scan && scan->GetCamera() == camera->GetRawPtr())
+         scan->Finish();
+
+      applyLivePropertyChanges(camera);
    }
    else
    {
@@ -2907,6 +4435,10 @@ bool CMMCore::isSequenceRunning(const char* label) throw (CMMError)
 /**
  * Gets the last image from the circular buffer.
  * Returns 0 if the buffer is empty.
+ *
+ * If circular buffer packing is enabled, the returned pixels stay valid only
+ * until the calling thread retrieves another image of the same channel (see
+ * enableCircularBufferPacking()); copy them before retrieving the next image.
  */
 void* CMMCore::getLastImage() throw (CMMError)
 {
@@ -2962,6 +4494,10 @@ void* CMMCore::getLastImageMD(unsigned channel, unsigned slice, Metadata& md) co
  * RGB buffers are expected to be in big endian ARGB format (ARGB8888), which means that
  * on little endian the format is BGRA888 
  * (see: https://en.wikipedia.org/wiki/RGBA_color_model).
+ *
+ * If circular buffer packing is enabled, the returned pixels stay valid only
+ * until the calling thread retrieves another image of the same channel (see
+ * enableCircularBufferPacking()); copy them before retrieving the next image.
  */
 void* CMMCore::getLastImageMD(Metadata& md) const throw (CMMError)
 {
@@ -2979,6 +4515,10 @@ void* CMMCore::getLastImageMD(Metadata& md) const throw (CMMError)
  * RGB buffers are expected to be in big endian ARGB format (ARGB8888), which means that
  * on little endian the format is BGRA888 
  * (see: https://en.wikipedia.org/wiki/RGBA_color_model).
+ *
+ * If circular buffer packing is enabled, the returned pixels stay valid only
+ * until the calling thread retrieves another image of the same channel (see
+ * enableCircularBufferPacking()); copy them before retrieving the next image.
  */
 void* CMMCore::getNBeforeLastImageMD(unsigned long n, Metadata& md) const throw (CMMError)
 {
@@ -3003,6 +4543,10 @@ void* CMMCore::getNBeforeLastImageMD(unsigned long n, Metadata& md) const throw
  * RGB buffers are expected to be in big endian ARGB format (ARGB8888), which means that
  * on little endian the format is BGRA888 
  * (see: https://en.wikipedia.org/wiki/RGBA_color_model).
+ *
+ * If circular buffer packing is enabled, the returned pixels stay valid only
+ * until the calling thread retrieves another image of the same channel (see
+ * enableCircularBufferPacking()); copy them before retrieving the next image.
  */
 void* CMMCore::popNextImage() throw (CMMError)
 {
@@ -3017,6 +4561,10 @@ void* CMMCore::popNextImage() throw (CMMError)
  * Gets and removes the next image (and metadata) from the circular buffer
  * channel indicates which cameraChannel image should be retrieved.
  * slice has not been implement and should always be 0
+ *
+ * If circular buffer packing is enabled, the returned pixels stay valid only
+ * until the calling thread retrieves another image of the same channel (see
+ * enableCircularBufferPacking()); copy them before retrieving the next image.
  */
 void* CMMCore::popNextImageMD(unsigned channel, unsigned slice, Metadata& md) throw (CMMError)
 {
@@ -3059,12 +4607,23 @@ void CMMCore::clearCircularBuffer() throw (CMMError)
 void CMMCore::setCircularBufferMemoryFootprint(unsigned sizeMB ///< n megabytes
                                                ) throw (CMMError)
 {
+   const CircularBuffer::BackpressureSettings backpressure =
+      cbuf_->GetBackpressureSettings();
+   const bool packing = cbuf_->IsPackingEnabled();
    delete cbuf_; // discard old buffer
    LOG_DEBUG(coreLogger_) << "Will set circular buffer size to " <<
       sizeMB << " MB";
 	try
 	{
 		cbuf_ = new CircularBuffer(sizeMB);
+      cbuf_->SetBackpressureSettings(backpressure);
+      cbuf_->SetPackingEnabled(packing);
+      cbuf_->SetBackpressureListener([this](bool active, double fillFraction) {
+         notifyCircularBufferBackpressure(active, fillFraction);
+      });
+      cbuf_->SetSaturationListener([this](std::size_t pixels, unsigned bitDepth) {
+         logCircularBufferSaturation(pixels, bitDepth);
+      });
 	}
 	catch (std::bad_alloc& ex)
 	{
@@ -3084,7 +4643,7 @@ void CMMCore::setCircularBufferMemoryFootprint(unsigned sizeMB ///< n megabytes
       if (camera)
 		{
          mm::DeviceModuleLockGuard guard(camera);
-         if (!cbuf_->Initialize(camera->GetNumberOfChannels(), camera->GetImageWidth(), camera->GetImageHeight(), camera->GetImageBytesPerPixel()))
+         if (!initializeCircularBufferForCamera(camera))
 				throw CMMError(getCoreErrorText(MMERR_CircularBufferFailedToInitialize).c_str(), MMERR_CircularBufferFailedToInitialize);
 		}
 
@@ -3159,31 +4718,228 @@ bool CMMCore::isBufferOverflowed() const
    return cbuf_->Overflow();
 }
 
+static const char* const backpressurePolicyNames[] = {
+   "None", "DropEveryNth", "Decimate", "Pause",
+};
+
 /**
- * Returns the label of the currently selected camera device.
- * @return camera name
+ * Sets the circular buffer fill levels at which backpressure starts and ends.
+ *
+ * Backpressure starts when the buffer is filled to the high watermark, and
+ * lasts until the consumer has drained it to the low watermark. While it
+ * lasts, the backpressure policy is applied to incoming images (see
+ * setCircularBufferBackpressurePolicy()), and cameras can query it through
+ * the device interface to reduce their frame rate. Changes are reported with
+ * MMEventCallback::onImageBufferBackpressureChanged().
+ *
+ * The defaults are 0.8 and 0.5.
+ *
+ * @param highFraction   fill level (fraction of the buffer size) at which
+ *                       backpressure starts
+ * @param lowFraction    fill level at which it ends; must be lower
  */
-std::string CMMCore::getCameraDevice()
+void CMMCore::setCircularBufferWatermarks(double highFraction,
+      double lowFraction) throw (CMMError)
 {
-   std::shared_ptr<CameraInstance> camera = currentCameraDevice_.lock();
-   if (camera)
-   {
-      return camera->GetLabel();
-   }
-   return std::string();
+   if (!(lowFraction >= 0.0 && lowFraction < highFraction &&
+            highFraction <= 1.0))
+      throw CMMError("Invalid circular buffer watermarks (must satisfy "
+            "0 <= low < high <= 1)", MMERR_InvalidContents);
+
+   CircularBuffer::BackpressureSettings settings =
+      cbuf_->GetBackpressureSettings();
+   settings.highWatermark = highFraction;
+   settings.lowWatermark = lowFraction;
+   cbuf_->SetBackpressureSettings(settings);
+   LOG_INFO(coreLogger_) << "Circular buffer watermarks set to " <<
+      highFraction << " (high), " << lowFraction << " (low)";
 }
 
 /**
- * Returns the label of the currently selected shutter device.
- * @return shutter name
+ * Returns the fill level at which circular buffer backpressure starts.
  */
-std::string CMMCore::getShutterDevice()
+double CMMCore::getCircularBufferHighWatermark()
 {
-   std::shared_ptr<ShutterInstance> shutter = currentShutterDevice_.lock();
-   if (shutter)
-   {
-      return shutter->GetLabel();
-   }
+   return cbuf_->GetBackpressureSettings().highWatermark;
+}
+
+/**
+ * Returns the fill level at which circular buffer backpressure ends.
+ */
+double CMMCore::getCircularBufferLowWatermark()
+{
+   return cbuf_->GetBackpressureSettings().lowWatermark;
+}
+
+/**
+ * Sets what happens to incoming images under circular buffer backpressure.
+ *
+ * The policies are:
+ * - "None" (default): store all images; the buffer overflows when full.
+ * - "DropEveryNth": drop every nth image (n >= 1).
+ * - "Decimate": store only every nth image (n >= 1).
+ * - "Pause": block the camera's inserting thread until the buffer has
+ *   drained to the low watermark, for at most n milliseconds per image. For
+ *   most cameras, this delays the acquisition of further images.
+ *
+ * Dropped images are not an overflow. They are recorded in the metadata of
+ * the next stored image: BackpressureDroppedImages (dropped since the
+ * previous stored image) and BackpressureDroppedImagesTotal, and their image
+ * numbers are skipped. The buffer can still overflow if the policy does not
+ * relieve the backpressure enough.
+ *
+ * @param policy   the policy name
+ * @param n        the policy parameter (ignored for "None")
+ */
+void CMMCore::setCircularBufferBackpressurePolicy(const char* policy, long n)
+   throw (CMMError)
+{
+   if (!policy)
+      throw CMMError(errorText_[MMERR_NullPointerException],
+            MMERR_NullPointerException);
+
+   const size_t numPolicies = sizeof(backpressurePolicyNames) /
+      sizeof(backpressurePolicyNames[0]);
+   size_t index = 0;
+   while (index < numPolicies &&
+         strcmp(policy, backpressurePolicyNames[index]) != 0)
+      ++index;
+   if (index == numPolicies)
+      throw CMMError("Unknown circular buffer backpressure policy " +
+            ToQuotedString(policy), MMERR_InvalidContents);
+
+   CircularBuffer::BackpressureSettings settings =
+      cbuf_->GetBackpressureSettings();
+   settings.policy = static_cast<CircularBuffer::BackpressurePolicy>(index);
+   if (settings.policy == CircularBuffer::BackpressurePause ? n < 0 :
+         (settings.policy != CircularBuffer::BackpressureNone && n < 1))
+      throw CMMError("Invalid parameter " + ToString(n) +
+            " for circular buffer backpressure policy " +
+            ToQuotedString(policy), MMERR_InvalidContents);
+   settings.parameter = n;
+   cbuf_->SetBackpressureSettings(settings);
+   LOG_INFO(coreLogger_) << "Circular buffer backpressure policy set to " <<
+      policy << " (" << n << ")";
+}
+
+/**
+ * Returns the circular buffer backpressure policy.
+ * @see setCircularBufferBackpressurePolicy()
+ */
+std::string CMMCore::getCircularBufferBackpressurePolicy()
+{
+   return backpressurePolicyNames[cbuf_->GetBackpressureSettings().policy];
+}
+
+/**
+ * Returns the parameter of the circular buffer backpressure policy.
+ * @see setCircularBufferBackpressurePolicy()
+ */
+long CMMCore::getCircularBufferBackpressureParameter()
+{
+   return cbuf_->GetBackpressureSettings().parameter;
+}
+
+/**
+ * Indicates whether the circular buffer is under backpressure.
+ * @see setCircularBufferWatermarks()
+ */
+bool CMMCore::isCircularBufferBackpressured()
+{
+   return cbuf_->IsBackpressureActive();
+}
+
+/**
+ * Returns the number of images dropped under backpressure since the circular
+ * buffer was last cleared.
+ */
+long CMMCore::getCircularBufferDroppedImageCount()
+{
+   return static_cast<long>(cbuf_->GetDroppedImageCount());
+}
+
+/**
+ * Enables or disables packed storage of 16-bit images in the circular buffer.
+ *
+ * When enabled, images from cameras whose bit depth is 10, 12 or 14 are
+ * stored bit-packed, so that the buffer holds 60%, 33% or 14% more images
+ * (see getBufferTotalCapacity()). Packing is lossless for pixel values within
+ * the bit depth reported by the camera; larger values are saturated. Images
+ * are unpacked when retrieved, so packing is transparent to the caller,
+ * except that a retrieved image stays valid only until the same thread
+ * retrieves another image of the same channel. Packing is not used while
+ * software binning sums pixels, since the sums may exceed the bit depth.
+ * Saturated pixels are reported with a warning in the log, once per
+ * buffer clearing or reinitialization.
+ *
+ * The circular buffer is reinitialized for the current camera. Not allowed
+ * during sequence acquisition.
+ *
+ * @param enable   whether to store images packed
+ */
+void CMMCore::enableCircularBufferPacking(bool enable) throw (CMMError)
+{
+   if (isSequenceRunning())
+      throw CMMError(getCoreErrorText(MMERR_NotAllowedDuringSequenceAcquisition).c_str(),
+                     MMERR_NotAllowedDuringSequenceAcquisition);
+
+   cbuf_->SetPackingEnabled(enable);
+   std::shared_ptr<CameraInstance> camera = currentCameraDevice_.lock();
+   if (camera)
+   {
+      mm::DeviceModuleLockGuard guard(camera);
+      if (!initializeCircularBufferForCamera(camera))
+         throw CMMError(getCoreErrorText(MMERR_CircularBufferFailedToInitialize).c_str(),
+                        MMERR_CircularBufferFailedToInitialize);
+   }
+   LOG_INFO(coreLogger_) << (enable ? "Enabled" : "Disabled") <<
+      " circular buffer packing";
+}
+
+/**
+ * Returns true if packed storage in the circular buffer is enabled.
+ * @see enableCircularBufferPacking()
+ */
+bool CMMCore::isCircularBufferPackingEnabled()
+{
+   return cbuf_->IsPackingEnabled();
+}
+
+/**
+ * Returns the bit depth at which images are currently stored packed in the
+ * circular buffer, or 0 if they are stored unpacked.
+ * @see enableCircularBufferPacking()
+ */
+unsigned CMMCore::getCircularBufferPackedBitDepth()
+{
+   return cbuf_->GetPackedBitDepth();
+}
+
+/**
+ * Returns the label of the currently selected camera device.
+ * @return camera name
+ */
+std::string CMMCore::getCameraDevice()
+{
+   std::shared_ptr<CameraInstance> camera = currentCameraDevice_.lock();
+   if (camera)
+   {
+      return camera->GetLabel();
+   }
+   return std::string();
+}
+
+/**
+ * Returns the label of the currently selected shutter device.
+ * @return shutter name
+ */
+std::string CMMCore::getShutterDevice()
+{
+   std::shared_ptr<ShutterInstance> shutter = currentShutterDevice_.lock();
+   if (shutter)
+   {
+      return shutter->GetLabel();
+   }
    return std::string();
 }
 
@@ -3248,7 +5004,7 @@ void CMMCore::setAutoFocusDevice(const char* autofocusLabel) throw (CMMError)
    std::string newAutofocusLabel = getAutoFocusDevice();
    {
       MMThreadGuard scg(stateCacheLock_);
-      stateCache_.addSetting(PropertySetting(MM::g_Keyword_CoreDevice, MM::g_Keyword_CoreAutoFocus, newAutofocusLabel.c_str()));
+      addStateCacheSetting(PropertySetting(MM::g_Keyword_CoreDevice, MM::g_Keyword_CoreAutoFocus, newAutofocusLabel.c_str()));
    }
 }
 
@@ -3315,7 +5071,7 @@ void CMMCore::setImageProcessorDevice(const char* procLabel) throw (CMMError)
    std::string newProcLabel = getImageProcessorDevice();
    {
       MMThreadGuard scg(stateCacheLock_);
-      stateCache_.addSetting(PropertySetting(MM::g_Keyword_CoreDevice, MM::g_Keyword_CoreImageProcessor, newProcLabel.c_str()));
+      addStateCacheSetting(PropertySetting(MM::g_Keyword_CoreDevice, MM::g_Keyword_CoreImageProcessor, newProcLabel.c_str()));
    }
 }
 
@@ -3339,7 +5095,7 @@ void CMMCore::setSLMDevice(const char* slmLabel) throw (CMMError)
    std::string newSLMLabel = getSLMDevice();
    {
       MMThreadGuard scg(stateCacheLock_);
-      stateCache_.addSetting(PropertySetting(MM::g_Keyword_CoreDevice, MM::g_Keyword_CoreSLM, newSLMLabel.c_str()));
+      addStateCacheSetting(PropertySetting(MM::g_Keyword_CoreDevice, MM::g_Keyword_CoreSLM, newSLMLabel.c_str()));
    }
 }
 
@@ -3364,7 +5120,7 @@ void CMMCore::setGalvoDevice(const char* galvoLabel) throw (CMMError)
    std::string newGalvoLabel = getGalvoDevice();
    {
       MMThreadGuard scg(stateCacheLock_);
-      stateCache_.addSetting(PropertySetting(MM::g_Keyword_CoreDevice, MM::g_Keyword_CoreGalvo, newGalvoLabel.c_str()));
+      addStateCacheSetting(PropertySetting(MM::g_Keyword_CoreDevice, MM::g_Keyword_CoreGalvo, newGalvoLabel.c_str()));
    }
 }
 
@@ -3391,7 +5147,7 @@ void CMMCore::setChannelGroup(const char* chGroup) throw (CMMError)
 
    {
       MMThreadGuard scg(stateCacheLock_);
-      stateCache_.addSetting(PropertySetting(MM::g_Keyword_CoreDevice, MM::g_Keyword_CoreChannelGroup, channelGroup_.c_str()));
+      addStateCacheSetting(PropertySetting(MM::g_Keyword_CoreDevice, MM::g_Keyword_CoreChannelGroup, channelGroup_.c_str()));
    }
    if (externalCallback_ != 0) 
    {
@@ -3453,7 +5209,7 @@ void CMMCore::setShutterDevice(const char* shutterLabel) throw (CMMError)
    std::string newShutterLabel = getShutterDevice();
    {
       MMThreadGuard scg(stateCacheLock_);
-      stateCache_.addSetting(PropertySetting(MM::g_Keyword_CoreDevice, MM::g_Keyword_CoreShutter, newShutterLabel.c_str()));
+      addStateCacheSetting(PropertySetting(MM::g_Keyword_CoreDevice, MM::g_Keyword_CoreShutter, newShutterLabel.c_str()));
    }
 }
 
@@ -3478,7 +5234,7 @@ void CMMCore::setFocusDevice(const char* focusLabel) throw (CMMError)
    std::string newFocusLabel = getFocusDevice();
    {
       MMThreadGuard scg(stateCacheLock_);
-      stateCache_.addSetting(PropertySetting(MM::g_Keyword_CoreDevice, MM::g_Keyword_CoreFocus, newFocusLabel.c_str()));
+      addStateCacheSetting(PropertySetting(MM::g_Keyword_CoreDevice, MM::g_Keyword_CoreFocus, newFocusLabel.c_str()));
    }
 }
 
@@ -3501,7 +5257,7 @@ void CMMCore::setXYStageDevice(const char* xyDeviceLabel) throw (CMMError)
    std::string newXYStageLabel = getXYStageDevice();
    {
       MMThreadGuard scg(stateCacheLock_);
-      stateCache_.addSetting(PropertySetting(MM::g_Keyword_CoreDevice, MM::g_Keyword_CoreXYStage, newXYStageLabel.c_str()));
+      addStateCacheSetting(PropertySetting(MM::g_Keyword_CoreDevice, MM::g_Keyword_CoreXYStage, newXYStageLabel.c_str()));
    }
 }
 
@@ -3540,7 +5296,7 @@ void CMMCore::setCameraDevice(const char* cameraLabel) throw (CMMError)
    std::string newCameraLabel = getCameraDevice();
    {
       MMThreadGuard scg(stateCacheLock_);
-      stateCache_.addSetting(PropertySetting(MM::g_Keyword_CoreDevice, MM::g_Keyword_CoreCamera, newCameraLabel.c_str()));
+      addStateCacheSetting(PropertySetting(MM::g_Keyword_CoreDevice, MM::g_Keyword_CoreCamera, newCameraLabel.c_str()));
    }
 }
 
@@ -3644,7 +5400,7 @@ std::string CMMCore::getProperty(const char* label, const char* propName) throw
    PropertySetting s(label, propName, value.c_str());
    {
       MMThreadGuard scg(stateCacheLock_);
-      stateCache_.addSetting(s);
+      addStateCacheSetting(s);
    }
 
    return value;
@@ -3697,7 +5453,7 @@ void CMMCore::setProperty(const char* label, const char* propName,
       properties_->Execute(propName, propValue);
       {
          MMThreadGuard scg(stateCacheLock_);
-         stateCache_.addSetting(PropertySetting(MM::g_Keyword_CoreDevice, propName, propValue));
+         addStateCacheSetting(PropertySetting(MM::g_Keyword_CoreDevice, propName, propValue));
       }
 
       LOG_DEBUG(coreLogger_) << "Did set Core property: " <<
@@ -3713,7 +5469,7 @@ void CMMCore::setProperty(const char* label, const char* propName,
 
       {
          MMThreadGuard scg(stateCacheLock_);
-         stateCache_.addSetting(PropertySetting(label, propName, propValue));
+         addStateCacheSetting(PropertySetting(label, propName, propValue));
       }
    }
 }
@@ -3771,6 +5527,81 @@ void CMMCore::setProperty(const char* label, const char* propName,
 }
 
 
+/**
+ * Enables or disables suppression of redundant property writes for all
+ * properties of a device.
+ *
+ * When enabled, setting a property (including through setConfig() and
+ * setSystemState()) does not call the device if the new value equals the
+ * last value confirmed by the device, i.e. the last value that was
+ * successfully set or read. The confirmed value is discarded whenever the
+ * device reports a property change or an error, so the next write always
+ * goes to the device.
+ *
+ * This is only safe for properties whose values are not changed by the
+ * device (or by setting other properties) without notifying the Core, so it
+ * is disabled by default. Calling this function resets any per-property
+ * settings for the device.
+ *
+ * @param label   the device label
+ * @param enable  whether to suppress redundant writes
+ */
+void CMMCore::enableRedundantPropertyWriteSuppression(const char* label,
+      bool enable) throw (CMMError)
+{
+   std::shared_ptr<DeviceInstance> pDevice = deviceManager_->GetDevice(label);
+   pDevice->SetRedundantWriteSuppression(enable);
+   LOG_DEBUG(coreLogger_) << (enable ? "Enabled" : "Disabled") <<
+      " redundant property write suppression for " << label;
+}
+
+/**
+ * Enables or disables suppression of redundant property writes for a single
+ * property, overriding the device-wide setting.
+ *
+ * See enableRedundantPropertyWriteSuppression(const char*, bool).
+ *
+ * @param label     the device label
+ * @param propName  the property name
+ * @param enable    whether to suppress redundant writes
+ */
+void CMMCore::enableRedundantPropertyWriteSuppression(const char* label,
+      const char* propName, bool enable) throw (CMMError)
+{
+   CheckPropertyName(propName);
+   std::shared_ptr<DeviceInstance> pDevice = deviceManager_->GetDevice(label);
+   pDevice->SetRedundantWriteSuppression(propName, enable);
+   LOG_DEBUG(coreLogger_) << (enable ? "Enabled" : "Disabled") <<
+      " redundant property write suppression for " << label << "-" <<
+      propName;
+}
+
+/**
+ * Returns whether redundant writes to the property are suppressed.
+ *
+ * @param label     the device label
+ * @param propName  the property name
+ */
+bool CMMCore::isRedundantPropertyWriteSuppressionEnabled(const char* label,
+      const char* propName) throw (CMMError)
+{
+   CheckPropertyName(propName);
+   std::shared_ptr<DeviceInstance> pDevice = deviceManager_->GetDevice(label);
+   return pDevice->IsRedundantWriteSuppressionEnabled(propName);
+}
+
+/**
+ * Returns the number of property writes to the device that have been skipped
+ * because the value was unchanged.
+ *
+ * @param label   the device label
+ */
+long CMMCore::getSuppressedPropertyWriteCount(const char* label) throw (CMMError)
+{
+   std::shared_ptr<DeviceInstance> pDevice = deviceManager_->GetDevice(label);
+   return static_cast<long>(pDevice->GetSuppressedWriteCount());
+}
+
 /**
  * Checks if device has a property with a specified name.
  * The exception will be thrown in case device label is not defined.
@@ -3993,7 +5824,16 @@ unsigned CMMCore::getImageWidth()
       try
       {
          mm::DeviceModuleLockGuard guard(camera);
-         return camera->GetImageWidth();
+         unsigned width = camera->GetImageWidth();
+         const mm::SoftwareBinning::Settings settings =
+            softwareBinning_->GetSettings();
+         if (settings.IsActive())
+         {
+            unsigned height = camera->GetImageHeight();
+            mm::SoftwareBinning::GetOutputSize(settings, width, height,
+                  width, height);
+         }
+         return width;
       }
       catch (const CMMError&) // Possibly uninitialized camera
       {
@@ -4015,7 +5855,16 @@ unsigned CMMCore::getImageHeight()
       try
       {
          mm::DeviceModuleLockGuard guard(camera);
-         return camera->GetImageHeight();
+         unsigned height = camera->GetImageHeight();
+         const mm::SoftwareBinning::Settings settings =
+            softwareBinning_->GetSettings();
+         if (settings.IsActive())
+         {
+            unsigned width = camera->GetImageWidth();
+            mm::SoftwareBinning::GetOutputSize(settings, width, height,
+                  width, height);
+         }
+         return height;
       }
       catch (const CMMError&) // Possibly uninitialized camera
       {
@@ -4180,7 +6029,7 @@ void CMMCore::setExposure(const char* label, double dExp) throw (CMMError)
       {
          {
             MMThreadGuard scg(stateCacheLock_);
-            stateCache_.addSetting(PropertySetting(label, MM::g_Keyword_Exposure, CDeviceUtils::ConvertToString(dExp)));
+            addStateCacheSetting(PropertySetting(label, MM::g_Keyword_Exposure, CDeviceUtils::ConvertToString(dExp)));
          }
       }
    }
@@ -4537,7 +6386,7 @@ void CMMCore::setState(const char* deviceLabel, long state) throw (CMMError)
    {
       {
          MMThreadGuard scg(stateCacheLock_);
-         stateCache_.addSetting(PropertySetting(deviceLabel, MM::g_Keyword_State, CDeviceUtils::ConvertToString(state)));
+         addStateCacheSetting(PropertySetting(deviceLabel, MM::g_Keyword_State, CDeviceUtils::ConvertToString(state)));
       }
    }
    if (pStateDev->HasProperty(MM::g_Keyword_Label))
@@ -4546,7 +6395,7 @@ void CMMCore::setState(const char* deviceLabel, long state) throw (CMMError)
 
       {
          MMThreadGuard scg(stateCacheLock_);
-         stateCache_.addSetting(PropertySetting(deviceLabel, MM::g_Keyword_Label, posLbl.c_str()));
+         addStateCacheSetting(PropertySetting(deviceLabel, MM::g_Keyword_Label, posLbl.c_str()));
       }
    }
 
@@ -4618,7 +6467,7 @@ void CMMCore::setStateLabel(const char* deviceLabel, const char* stateLabel) thr
    {
       {
          MMThreadGuard scg(stateCacheLock_);
-         stateCache_.addSetting(PropertySetting(deviceLabel, MM::g_Keyword_Label, stateLabel));
+         addStateCacheSetting(PropertySetting(deviceLabel, MM::g_Keyword_Label, stateLabel));
       }
    }
    if (pStateDev->HasProperty(MM::g_Keyword_State))
@@ -4626,7 +6475,7 @@ void CMMCore::setStateLabel(const char* deviceLabel, const char* stateLabel) thr
       long state = getStateFromLabel(deviceLabel, stateLabel);
       {
          MMThreadGuard scg(stateCacheLock_);
-         stateCache_.addSetting(PropertySetting(deviceLabel, MM::g_Keyword_State,
+         addStateCacheSetting(PropertySetting(deviceLabel, MM::g_Keyword_State,
                   CDeviceUtils::ConvertToString(state)));
       }
    }
@@ -5023,6 +6872,8 @@ void CMMCore::setConfig(const char* groupName, const char* configName) throw (CM
       throw;
    }
 
+   recordConfigGroupState(groupName, configName);
+
    LOG_DEBUG(coreLogger_) << "Config group " << groupName <<
       ": did apply preset " << configName;
 }
@@ -5410,6 +7261,7 @@ double CMMCore::getPixelSizeUm(bool cached)
             // Assume no binning
          }
       }
+      pixSize *= softwareBinning_->GetSettings().binning;
 
       pixSize /= getMagnificationFactor();
 
@@ -5466,7 +7318,8 @@ std::vector<double> CMMCore::getPixelSizeAffine(bool cached) throw (CMMError)
          binning = camera->GetBinning();
       }
 
-      double factor = binning / getMagnificationFactor();
+      double factor = binning * softwareBinning_->GetSettings().binning /
+         getMagnificationFactor();
 
       if (factor != 1.0)
       {
@@ -6330,6 +8183,33 @@ void CMMCore::loadSystemState(const char* fileName) throw (CMMError)
  * The file format is the same as for the system state.
  */
 void CMMCore::saveSystemConfiguration(const char* fileName) throw (CMMError)
+{
+   saveSystemConfigurationImpl(fileName, false, true);
+}
+
+/**
+ * Saves the current system configuration without querying device properties.
+ *
+ * Same as saveSystemConfiguration(), except that the values of
+ * pre-initialization properties are taken from the system state cache, so
+ * that saving does not cause any device communication and can be done during
+ * an acquisition. Other information (device list, hub references, delays,
+ * focus directions, state labels) is bookkeeping that does not require device
+ * communication in either case.
+ *
+ * @param fileName  the file to write
+ * @param readUncached  if true, properties that are not in the cache are read
+ *                      from the device; if false, they are omitted from the
+ *                      file (and a warning is logged)
+ */
+void CMMCore::saveSystemConfigurationFromCache(const char* fileName,
+      bool readUncached) throw (CMMError)
+{
+   saveSystemConfigurationImpl(fileName, true, readUncached);
+}
+
+void CMMCore::saveSystemConfigurationImpl(const char* fileName,
+      bool fromCache, bool readUncached) throw (CMMError)
 {
    if (!fileName)
       throw CMMError("Null filename");
@@ -6343,114 +8223,147 @@ void CMMCore::saveSystemConfiguration(const char* fileName) throw (CMMError)
             MMERR_FileOpenFailed);
    }
 
-   // insert the system reset command
-   // this will unload all current devices
-   os << "# Unload all devices\n";
-   os << "Property,Core,Initialize,0\n";
-
-   // save device list
-   os << "# Load devices\n";
+   // Collect the per-device sections in a single pass, so that each device's
+   // module is locked only once
+   std::ostringstream loadSection, preInitSection, hubSection, delaySection,
+      focusSection, labelSection;
    std::vector<std::string> devices = deviceManager_->GetDeviceList();
-   std::vector<std::string>::const_iterator it;
-   for (it=devices.begin(); it != devices.end(); it++)
+   for (std::vector<std::string>::const_iterator it = devices.begin();
+         it != devices.end(); ++it)
    {
       std::shared_ptr<DeviceInstance> pDev = deviceManager_->GetDevice(*it);
       mm::DeviceModuleLockGuard guard(pDev);
-      os << MM::g_CFGCommand_Device << "," << *it << "," << pDev->GetAdapterModule()->GetName() << "," << pDev->GetName() << '\n';
-   }
 
-   // save the pre-initialization properties
-   os << "# Pre-initialization properties\n";
-   Configuration config = getSystemState();
-   for (size_t i=0; i<config.size(); i++)
-   {
-      PropertySetting s = config.getSetting(i);
-      if (s.getDeviceLabel() == MM::g_Keyword_CoreDevice)
-         continue;
+      loadSection << MM::g_CFGCommand_Device << "," << *it << "," << pDev->GetAdapterModule()->GetName() << "," << pDev->GetName() << '\n';
 
-      // check if the property must be set before initialization
-      std::shared_ptr<DeviceInstance> pDevice = deviceManager_->GetDevice(s.getDeviceLabel());
-      if (pDevice)
+      std::vector<std::string> propertyNames = pDev->GetPropertyNames();
+      for (std::vector<std::string>::const_iterator prop = propertyNames.begin();
+            prop != propertyNames.end(); ++prop)
       {
-         mm::DeviceModuleLockGuard guard(pDevice);
-         bool isPreInit = pDevice->GetPropertyInitStatus(s.getPropertyName().c_str());
-         if (isPreInit)
+         // check if the property must be set before initialization
+         bool isPreInit = false;
+         try
+         {
+            isPreInit = pDev->GetPropertyInitStatus(prop->c_str());
+         }
+         catch (const CMMError&)
+         {
+            // Keep old behavior (getSystemState() ignored errors)
+         }
+         if (!isPreInit)
+            continue;
+
+         std::string value;
+         bool haveValue = false;
+         if (fromCache)
          {
-            os << MM::g_CFGCommand_Property << ',' << s.getDeviceLabel()
-               << ',' << s.getPropertyName() << ',' << s.getPropertyValue() << '\n';
+            MMThreadGuard scg(stateCacheLock_);
+            if (stateCache_.isPropertyIncluded(it->c_str(), prop->c_str()))
+            {
+               value = stateCache_.getSetting(it->c_str(), prop->c_str()).getPropertyValue();
+               haveValue = true;
+            }
+         }
+         if (!haveValue)
+         {
+            if (fromCache && !readUncached)
+            {
+               LOG_WARNING(coreLogger_) << "Pre-initialization property " <<
+                  ToQuotedString(*prop) << " of device " << ToQuotedString(*it) <<
+                  " is not in the cache; not saved";
+               continue;
+            }
+            try
+            {
+               value = pDev->GetProperty(*prop);
+            }
+            catch (const CMMError&)
+            {
+               // Keep old behavior (getSystemState() ignored errors)
+            }
          }
+         preInitSection << MM::g_CFGCommand_Property << ',' << *it
+            << ',' << *prop << ',' << value << '\n';
       }
-   }
 
-   // save the parent (hub) references
-   os << "# Hub references" << '\n';
-   for (it=devices.begin(); it != devices.end(); it++)
-   {
-      std::shared_ptr<DeviceInstance> device = deviceManager_->GetDevice(*it);
-      mm::DeviceModuleLockGuard guard(device);
-      std::string parentID = device->GetParentID();
+      std::string parentID = pDev->GetParentID();
       if (!parentID.empty())
       {
-         os << MM::g_CFGCommand_ParentID << ',' << device->GetLabel() << ',' << parentID << '\n';
+         hubSection << MM::g_CFGCommand_ParentID << ',' << pDev->GetLabel() << ',' << parentID << '\n';
+      }
+
+      if (pDev->GetDelayMs() > 0.0)
+         delaySection << MM::g_CFGCommand_Delay << "," << *it << "," << pDev->GetDelayMs() << '\n';
+
+      switch (pDev->GetType())
+      {
+         case MM::StageDevice:
+         {
+            int direction = getFocusDirection(it->c_str());
+            focusSection << MM::g_CFGCommand_FocusDirection << ','
+               << *it << ',' << direction << '\n';
+            break;
+         }
+         case MM::StateDevice:
+         {
+            std::shared_ptr<StateInstance> pSD =
+               deviceManager_->GetDeviceOfType<StateInstance>(*it);
+            unsigned numPos = pSD->GetNumberOfPositions();
+            for (unsigned long j=0; j<numPos; j++)
+            {
+               std::string stateLabel;
+               try
+               {
+                  stateLabel = pSD->GetPositionLabel(j);
+               }
+               catch (const CMMError&)
+               {
+                  // Label not defined, just skip
+                  continue;
+               }
+               if (!stateLabel.empty())
+               {
+                  labelSection << MM::g_CFGCommand_Label << ',' << *it << ',' << j << ',' << stateLabel << '\n';
+               }
+            }
+            break;
+         }
+         default:
+            break;
       }
    }
 
+   // insert the system reset command
+   // this will unload all current devices
+   os << "# Unload all devices\n";
+   os << "Property,Core,Initialize,0\n";
+
+   // save device list
+   os << "# Load devices\n";
+   os << loadSection.str();
+
+   // save the pre-initialization properties
+   os << "# Pre-initialization properties\n";
+   os << preInitSection.str();
+
+   // save the parent (hub) references
+   os << "# Hub references" << '\n';
+   os << hubSection.str();
 
    // insert the initialize command
    os << "Property,Core,Initialize,1\n";
 
    // save delays
    os << "# Delays\n";
-   for (it=devices.begin(); it != devices.end(); it++)
-   {
-      std::shared_ptr<DeviceInstance> pDev = deviceManager_->GetDevice(*it);
-      mm::DeviceModuleLockGuard guard(pDev);
-      if (pDev->GetDelayMs() > 0.0)
-         os << MM::g_CFGCommand_Delay << "," << *it << "," << pDev->GetDelayMs() << '\n';
-   }
+   os << delaySection.str();
 
    // save focus directions
    os << "# Stage focus directions\n";
-   std::vector<std::string> stageLabels =
-      deviceManager_->GetDeviceList(MM::StageDevice);
-   for (std::vector<std::string>::const_iterator stageIt = stageLabels.begin(),
-         end = stageLabels.end(); stageIt != end; ++stageIt)
-   {
-      std::shared_ptr<StageInstance> stage =
-         deviceManager_->GetDeviceOfType<StageInstance>(*stageIt);
-      mm::DeviceModuleLockGuard guard(stage);
-      int direction = getFocusDirection(stageIt->c_str());
-      os << MM::g_CFGCommand_FocusDirection << ','
-         << *stageIt << ',' << direction << '\n';
-   }
+   os << focusSection.str();
 
    // save labels
    os << "# Labels\n";
-   std::vector<std::string> deviceLabels = deviceManager_->GetDeviceList(MM::StateDevice);
-   for (size_t i=0; i<deviceLabels.size(); i++)
-   {
-      std::shared_ptr<StateInstance> pSD =
-         deviceManager_->GetDeviceOfType<StateInstance>(deviceLabels[i]);
-      mm::DeviceModuleLockGuard guard(pSD);
-      unsigned numPos = pSD->GetNumberOfPositions();
-      for (unsigned long j=0; j<numPos; j++)
-      {
-         std::string stateLabel;
-         try
-         {
-            stateLabel = pSD->GetPositionLabel(j);
-         }
-         catch (const CMMError&)
-         {
-            // Label not defined, just skip
-            continue;
-         }
-         if (!stateLabel.empty())
-         {
-            os << MM::g_CFGCommand_Label << ',' << deviceLabels[i] << ',' << j << ',' << stateLabel << '\n';
-         }
-      }
-   }
+   os << labelSection.str();
 
    // save configuration groups
    os << "# Group configurations\n";
@@ -6547,24 +8460,76 @@ void CMMCore::loadSystemConfiguration(const char* fileName) throw (CMMError)
 }
 
 
-void CMMCore::loadSystemConfigurationImpl(const char* fileName) throw (CMMError)
+/**
+ * Loads a system configuration, keeping devices that are already loaded.
+ *
+ * Devices that are currently loaded and initialized with the same label,
+ * adapter module, device name, parent hub and pre-initialization property
+ * values as given in the file are not unloaded and initialized again. A
+ * device that was given a pre-initialization property that the file does not
+ * set is reloaded, so that the property returns to its default. The
+ * remaining property settings in the file are applied to them only where they
+ * differ from the system state cache. All other devices are unloaded, and
+ * the new or changed ones are loaded and initialized as by
+ * loadSystemConfiguration(). Configuration groups, pixel size configurations
+ * and Core properties are always rebuilt from the file.
+ *
+ * This makes switching between configurations that share most of their
+ * hardware much faster, since device initialization usually dominates the
+ * time taken to load a configuration. A device is kept only if its parent hub
+ * is also kept.
+ *
+ * If loading fails, all devices are unloaded, as with
+ * loadSystemConfiguration().
+ *
+ * @param fileName  the configuration file to load
+ */
+void CMMCore::loadSystemConfigurationDifferential(const char* fileName) throw (CMMError)
 {
-   if (!fileName)
-      throw CMMError("Null filename");
-
-   std::ifstream is;
-   is.open(fileName, std::ios_base::in);
-   if (!is.is_open())
+   try
    {
-      logError(fileName, getCoreErrorText(MMERR_FileOpenFailed).c_str());
-      throw CMMError(ToQuotedString(fileName) + ": " + getCoreErrorText(MMERR_FileOpenFailed),
-            MMERR_FileOpenFailed);
+      loadSystemConfigurationDifferentialImpl(fileName);
    }
+   catch (const CMMError&)
+   {
+      LOG_INFO(coreLogger_) <<
+         "Unloading all devices after failure to load system configuration";
+
+      try
+      {
+         unloadAllDevices();
+      }
+      catch (const CMMError& err)
+      {
+         LOG_ERROR(coreLogger_) <<
+            "Error occurred while unloading all devices: " <<
+            err.getFullMsg();
+      }
+
+      LOG_INFO(coreLogger_) <<
+         "Now rethrowing original error from system configuration loading";
+      throw;
+   }
+}
+
+namespace {
+
+// A non-empty, non-comment line of a configuration file
+struct ConfigFileLine
+{
+   int number;
+   std::string text;
+   std::vector<std::string> tokens;
+};
+
+} // anonymous namespace
+
+static std::vector<ConfigFileLine> ReadConfigFileLines(std::istream& is)
+{
+   std::vector<ConfigFileLine> result;
 
-   // Process commands
    const int maxLineLength = 4 * MM::MaxStrLength + 4; // accommodate up to 4 strings and delimiters
    char line[maxLineLength+1];
-   std::vector<std::string> tokens;
 
    int lineCount = 0;
 
@@ -6583,183 +8548,216 @@ void CMMCore::loadSystemConfigurationImpl(const char* fileName) throw (CMMError)
             continue;
          }
 
-         // parse tokens
-         tokens.clear();
-         CDeviceUtils::Tokenize(line, tokens, MM::g_FieldDelimiters);
+         ConfigFileLine entry;
+         entry.number = lineCount;
+         entry.text = line;
+         CDeviceUtils::Tokenize(line, entry.tokens, MM::g_FieldDelimiters);
+         result.push_back(entry);
+      }
+   }
+   return result;
+}
 
-         try
+void CMMCore::applyConfigurationLine(const std::vector<std::string>& tokens,
+      const std::string& line) throw (CMMError)
+{
+   // non-empty and non-comment lines mush have at least one token
+   if (tokens.size() < 1)
+      throw CMMError(getCoreErrorText(MMERR_InvalidCFGEntry) + " (" +
+            ToQuotedString(line) + ")",
+            MMERR_InvalidCFGEntry);
+
+   if(tokens[0].compare(MM::g_CFGCommand_Device) == 0)
+   {
+      // load device command
+      // -------------------
+      if (tokens.size() != 4)
+         throw CMMError(getCoreErrorText(MMERR_InvalidCFGEntry) + " (" +
+               ToQuotedString(line) + ")",
+               MMERR_InvalidCFGEntry);
+      loadDevice(tokens[1].c_str(), tokens[2].c_str(), tokens[3].c_str());
+   }
+   else if(tokens[0].compare(MM::g_CFGCommand_Property) == 0)
+   {
+      // set property command
+      // --------------------
+      if (tokens.size() == 4)
+         setProperty(tokens[1].c_str(), tokens[2].c_str(), tokens[3].c_str());
+      else if (tokens.size() == 3)
+         // ...assuming here that the last missing toke represents an empty string
+         setProperty(tokens[1].c_str(), tokens[2].c_str(), "");
+      else
+         throw CMMError(getCoreErrorText(MMERR_InvalidCFGEntry) + " (" +
+               ToQuotedString(line) + ")",
+               MMERR_InvalidCFGEntry);
+   }
+   else if(tokens[0].compare(MM::g_CFGCommand_Delay) == 0)
+   {
+      // set delay command
+      // -----------------
+      if (tokens.size() != 3)
+         throw CMMError(getCoreErrorText(MMERR_InvalidCFGEntry) + " (" +
+               ToQuotedString(line) + ")",
+               MMERR_InvalidCFGEntry);
+      setDeviceDelayMs(tokens[1].c_str(), atof(tokens[2].c_str()));
+   }
+   else if(tokens[0].compare(MM::g_CFGCommand_FocusDirection) == 0)
+   {
+      // set focus direction command
+      // ---------------------------
+      if (tokens.size() != 3)
+         throw CMMError(getCoreErrorText(MMERR_InvalidCFGEntry) + " (" +
+               ToQuotedString(line) + ")",
+               MMERR_InvalidCFGEntry);
+      setFocusDirection(tokens[1].c_str(), atol(tokens[2].c_str()));
+   }
+   else if(tokens[0].compare(MM::g_CFGCommand_Label) == 0)
+   {
+      // define label command
+      // --------------------
+      if (tokens.size() != 4)
+         throw CMMError(getCoreErrorText(MMERR_InvalidCFGEntry) + " (" +
+               ToQuotedString(line) + ")",
+               MMERR_InvalidCFGEntry);
+      defineStateLabel(tokens[1].c_str(), atol(tokens[2].c_str()), tokens[3].c_str());
+   }
+   else if(tokens[0].compare(MM::g_CFGCommand_Configuration) == 0)
+   {
+      // define configuration command
+      // ----------------------------
+      if (tokens.size() != 5)
+         throw CMMError(getCoreErrorText(MMERR_InvalidCFGEntry) + " (" +
+               ToQuotedString(line) + ")",
+               MMERR_InvalidCFGEntry);
+      LOG_WARNING(coreLogger_) << "Obsolete command " << tokens[0] <<
+         " ignored in configuration file";
+   }
+   else if(tokens[0].compare(MM::g_CFGCommand_ConfigGroup) == 0)
+   {
+      // define grouped configuration command
+      // ------------------------------------
+      if (tokens.size() == 6)
+         defineConfig(tokens[1].c_str(), tokens[2].c_str(), tokens[3].c_str(), tokens[4].c_str(), tokens[5].c_str());
+      else if (tokens.size() == 5)
+      {
+         // we will assume here that the last (missing) token is representing an empty string
+         defineConfig(tokens[1].c_str(), tokens[2].c_str(), tokens[3].c_str(), tokens[4].c_str(), "");
+      }
+      else if (tokens.size() == 2)
+         defineConfigGroup(tokens[1].c_str());
+      else
+         throw CMMError(getCoreErrorText(MMERR_InvalidCFGEntry) + " (" +
+               ToQuotedString(line) + ")",
+               MMERR_InvalidCFGEntry);
+   }
+   else if(tokens[0].compare(MM::g_CFGCommand_ConfigPixelSize) == 0)
+   {
+      // define pixel size configuration command
+      // ---------------------------------------
+      if (tokens.size() == 5)
+         definePixelSizeConfig(tokens[1].c_str(), tokens[2].c_str(), tokens[3].c_str(), tokens[4].c_str());
+      else
+         throw CMMError(getCoreErrorText(MMERR_InvalidCFGEntry) + " (" +
+               ToQuotedString(line) + ")",
+               MMERR_InvalidCFGEntry);
+   }
+   else if(tokens[0].compare(MM::g_CFGCommand_PixelSize_um) == 0)
+   {
+      // set pixel size
+      // --------------
+      if (tokens.size() == 3)
+         setPixelSizeUm(tokens[1].c_str(), atof(tokens[2].c_str()));
+      else
+         throw CMMError(getCoreErrorText(MMERR_InvalidCFGEntry) + " (" +
+               ToQuotedString(line) + ")",
+               MMERR_InvalidCFGEntry);
+   }
+   else if(tokens[0].compare(MM::g_CFGCommand_PixelSizeAffine) == 0)
+   {
+      // set affine transform
+      // --------------
+      //
+      if (tokens.size() == 8)
+      {
+         std::vector<double> *affineT = new std::vector<double>(6);
+         for (int i = 0; i < 6; i++)
          {
+            affineT->at(i) = atof(tokens[i + 2].c_str());
+         }
+         setPixelSizeAffine(tokens[1].c_str(), *affineT);
+         delete affineT;
+      }
+      else
+         throw CMMError(getCoreErrorText(MMERR_InvalidCFGEntry) + " (" +
+               ToQuotedString(line) + ")",
+               MMERR_InvalidCFGEntry);
+   }
+   else if(tokens[0].compare(MM::g_CFGCommand_Equipment) == 0)
+   {
+     // Property blocks have been removed
+     throw CMMError(getCoreErrorText(MMERR_InvalidCFGEntry) + " (" +
+           ToQuotedString(line) + ")",
+           MMERR_InvalidCFGEntry);
+   }
+   else if(tokens[0].compare(MM::g_CFGCommand_ImageSynchro) == 0)
+   {
+      // ImageSynchro has been removed
+      throw CMMError(getCoreErrorText(MMERR_InvalidCFGEntry) + " (" +
+            ToQuotedString(line) + ")",
+            MMERR_InvalidCFGEntry);
+   }
+   else if(tokens[0].compare(MM::g_CFGCommand_ParentID) == 0)
+   {
+      // set parent ID
+      // -------------
+      if (tokens.size() != 3)
+         throw CMMError(getCoreErrorText(MMERR_InvalidCFGEntry) + " (" +
+               ToQuotedString(line) + ")",
+               MMERR_InvalidCFGEntry);
 
-            // non-empty and non-comment lines mush have at least one token
-            if (tokens.size() < 1)
-               throw CMMError(getCoreErrorText(MMERR_InvalidCFGEntry) + " (" +
-                     ToQuotedString(line) + ")",
-                     MMERR_InvalidCFGEntry);
+      setParentLabel(tokens[1].c_str(), tokens[2].c_str());
+   }
+}
 
-            if(tokens[0].compare(MM::g_CFGCommand_Device) == 0)
-            {
-               // load device command
-               // -------------------
-               if (tokens.size() != 4)
-                  throw CMMError(getCoreErrorText(MMERR_InvalidCFGEntry) + " (" +
-                        ToQuotedString(line) + ")",
-                        MMERR_InvalidCFGEntry);
-               loadDevice(tokens[1].c_str(), tokens[2].c_str(), tokens[3].c_str());
-            }
-            else if(tokens[0].compare(MM::g_CFGCommand_Property) == 0)
-            {
-               // set property command
-               // --------------------
-               if (tokens.size() == 4)
-                  setProperty(tokens[1].c_str(), tokens[2].c_str(), tokens[3].c_str());
-               else if (tokens.size() == 3)
-                  // ...assuming here that the last missing toke represents an empty string
-                  setProperty(tokens[1].c_str(), tokens[2].c_str(), "");
-               else
-                  throw CMMError(getCoreErrorText(MMERR_InvalidCFGEntry) + " (" +
-                        ToQuotedString(line) + ")",
-                        MMERR_InvalidCFGEntry);
-            }
-            else if(tokens[0].compare(MM::g_CFGCommand_Delay) == 0)
-            {
-               // set delay command
-               // -----------------
-               if (tokens.size() != 3)
-                  throw CMMError(getCoreErrorText(MMERR_InvalidCFGEntry) + " (" +
-                        ToQuotedString(line) + ")",
-                        MMERR_InvalidCFGEntry);
-               setDeviceDelayMs(tokens[1].c_str(), atof(tokens[2].c_str()));
-            }
-            else if(tokens[0].compare(MM::g_CFGCommand_FocusDirection) == 0)
-            {
-               // set focus direction command
-               // ---------------------------
-               if (tokens.size() != 3)
-                  throw CMMError(getCoreErrorText(MMERR_InvalidCFGEntry) + " (" +
-                        ToQuotedString(line) + ")",
-                        MMERR_InvalidCFGEntry);
-               setFocusDirection(tokens[1].c_str(), atol(tokens[2].c_str()));
-            }
-            else if(tokens[0].compare(MM::g_CFGCommand_Label) == 0)
-            {
-               // define label command
-               // --------------------
-               if (tokens.size() != 4)
-                  throw CMMError(getCoreErrorText(MMERR_InvalidCFGEntry) + " (" +
-                        ToQuotedString(line) + ")",
-                        MMERR_InvalidCFGEntry);
-               defineStateLabel(tokens[1].c_str(), atol(tokens[2].c_str()), tokens[3].c_str());
-            }
-            else if(tokens[0].compare(MM::g_CFGCommand_Configuration) == 0)
-            {
-               // define configuration command
-               // ----------------------------
-               if (tokens.size() != 5)
-                  throw CMMError(getCoreErrorText(MMERR_InvalidCFGEntry) + " (" +
-                        ToQuotedString(line) + ")",
-                        MMERR_InvalidCFGEntry);
-               LOG_WARNING(coreLogger_) << "Obsolete command " << tokens[0] <<
-                  " ignored in configuration file";
-            }
-            else if(tokens[0].compare(MM::g_CFGCommand_ConfigGroup) == 0)
-            {
-               // define grouped configuration command
-               // ------------------------------------
-               if (tokens.size() == 6)
-                  defineConfig(tokens[1].c_str(), tokens[2].c_str(), tokens[3].c_str(), tokens[4].c_str(), tokens[5].c_str());
-               else if (tokens.size() == 5)
-               {
-                  // we will assume here that the last (missing) token is representing an empty string
-                  defineConfig(tokens[1].c_str(), tokens[2].c_str(), tokens[3].c_str(), tokens[4].c_str(), "");
-               }
-               else if (tokens.size() == 2)
-                  defineConfigGroup(tokens[1].c_str());
-               else
-                  throw CMMError(getCoreErrorText(MMERR_InvalidCFGEntry) + " (" +
-                        ToQuotedString(line) + ")",
-                        MMERR_InvalidCFGEntry);
-            }
-            else if(tokens[0].compare(MM::g_CFGCommand_ConfigPixelSize) == 0)
-            {
-               // define pixel size configuration command
-               // ---------------------------------------
-               if (tokens.size() == 5)
-                  definePixelSizeConfig(tokens[1].c_str(), tokens[2].c_str(), tokens[3].c_str(), tokens[4].c_str());
-               else
-                  throw CMMError(getCoreErrorText(MMERR_InvalidCFGEntry) + " (" +
-                        ToQuotedString(line) + ")",
-                        MMERR_InvalidCFGEntry);
-            }
-            else if(tokens[0].compare(MM::g_CFGCommand_PixelSize_um) == 0)
-            {
-               // set pixel size
-               // --------------
-               if (tokens.size() == 3)
-                  setPixelSizeUm(tokens[1].c_str(), atof(tokens[2].c_str()));
-               else
-                  throw CMMError(getCoreErrorText(MMERR_InvalidCFGEntry) + " (" +
-                        ToQuotedString(line) + ")",
-                        MMERR_InvalidCFGEntry);
-            }
-            else if(tokens[0].compare(MM::g_CFGCommand_PixelSizeAffine) == 0)
-            {
-               // set affine transform
-               // --------------
-               //
-               if (tokens.size() == 8)
-               {
-                  std::vector<double> *affineT = new std::vector<double>(6);
-                  for (int i = 0; i < 6; i++)
-                  {
-                     affineT->at(i) = atof(tokens[i + 2].c_str());
-                  }
-                  setPixelSizeAffine(tokens[1].c_str(), *affineT);
-                  delete affineT;
-               }
-               else
-                  throw CMMError(getCoreErrorText(MMERR_InvalidCFGEntry) + " (" +
-                        ToQuotedString(line) + ")",
-                        MMERR_InvalidCFGEntry);
-            }
-            else if(tokens[0].compare(MM::g_CFGCommand_Equipment) == 0)
-            {
-              // Property blocks have been removed
-              throw CMMError(getCoreErrorText(MMERR_InvalidCFGEntry) + " (" +
-                    ToQuotedString(line) + ")",
-                    MMERR_InvalidCFGEntry);
-            }
-            else if(tokens[0].compare(MM::g_CFGCommand_ImageSynchro) == 0)
-            {
-               // ImageSynchro has been removed
-               throw CMMError(getCoreErrorText(MMERR_InvalidCFGEntry) + " (" +
-                     ToQuotedString(line) + ")",
-                     MMERR_InvalidCFGEntry);
-            }
-            else if(tokens[0].compare(MM::g_CFGCommand_ParentID) == 0)
-            {
-               // set parent ID
-               // -------------
-               if (tokens.size() != 3)
-                  throw CMMError(getCoreErrorText(MMERR_InvalidCFGEntry) + " (" +
-                        ToQuotedString(line) + ")",
-                        MMERR_InvalidCFGEntry);
-
-               setParentLabel(tokens[1].c_str(), tokens[2].c_str());
-            }
+void CMMCore::loadSystemConfigurationImpl(const char* fileName) throw (CMMError)
+{
+   if (!fileName)
+      throw CMMError("Null filename");
 
-         }
-         catch (CMMError& err)
-         {
-            if (externalCallback_)
-               externalCallback_->onSystemConfigurationLoaded();
-            std::ostringstream errorText;
-            errorText << "Line " << lineCount << ": " << line << '\n';
-            errorText << err.getFullMsg() << "\n\n";
-            throw CMMError(errorText.str().c_str(), MMERR_InvalidConfigurationFile);
-         }
+   std::ifstream is;
+   is.open(fileName, std::ios_base::in);
+   if (!is.is_open())
+   {
+      logError(fileName, getCoreErrorText(MMERR_FileOpenFailed).c_str());
+      throw CMMError(ToQuotedString(fileName) + ": " + getCoreErrorText(MMERR_FileOpenFailed),
+            MMERR_FileOpenFailed);
+   }
+
+   // Process commands
+   std::vector<ConfigFileLine> lines = ReadConfigFileLines(is);
+   for (std::vector<ConfigFileLine>::const_iterator it = lines.begin();
+         it != lines.end(); ++it)
+   {
+      try
+      {
+         applyConfigurationLine(it->tokens, it->text);
+      }
+      catch (CMMError& err)
+      {
+         if (externalCallback_)
+            externalCallback_->onSystemConfigurationLoaded();
+         std::ostringstream errorText;
+         errorText << "Line " << it->number << ": " << it->text << '\n';
+         errorText << err.getFullMsg() << "\n\n";
+         throw CMMError(errorText.str().c_str(), MMERR_InvalidConfigurationFile);
       }
    }
 
+   finishLoadingSystemConfiguration();
+}
+
+void CMMCore::finishLoadingSystemConfiguration() throw (CMMError)
+{
    updateAllowedChannelGroups();
 
    // file parsing finished, try to set startup configuration
@@ -6783,6 +8781,234 @@ void CMMCore::loadSystemConfigurationImpl(const char* fileName) throw (CMMError)
 }
 
 
+void CMMCore::loadSystemConfigurationDifferentialImpl(const char* fileName) throw (CMMError)
+{
+   if (!fileName)
+      throw CMMError("Null filename");
+
+   std::ifstream is;
+   is.open(fileName, std::ios_base::in);
+   if (!is.is_open())
+   {
+      logError(fileName, getCoreErrorText(MMERR_FileOpenFailed).c_str());
+      throw CMMError(ToQuotedString(fileName) + ": " + getCoreErrorText(MMERR_FileOpenFailed),
+            MMERR_FileOpenFailed);
+   }
+
+   std::vector<ConfigFileLine> lines = ReadConfigFileLines(is);
+
+   // Collect, for each device in the file, what determines whether the
+   // loaded instance (if any) can be kept
+   struct DeviceSpec
+   {
+      std::string moduleName;
+      std::string deviceName;
+      std::string parentLabel;
+      std::map<std::string, std::string> preInitProperties;
+   };
+   std::map<std::string, DeviceSpec> specs;
+   bool beforeInit = true;
+   for (std::vector<ConfigFileLine>::const_iterator it = lines.begin();
+         it != lines.end(); ++it)
+   {
+      const std::vector<std::string>& tokens = it->tokens;
+      if (tokens.empty())
+         continue;
+      if (tokens[0] == MM::g_CFGCommand_Device && tokens.size() == 4)
+      {
+         specs[tokens[1]].moduleName = tokens[2];
+         specs[tokens[1]].deviceName = tokens[3];
+      }
+      else if (tokens[0] == MM::g_CFGCommand_ParentID && tokens.size() == 3)
+      {
+         if (specs.count(tokens[1]))
+            specs[tokens[1]].parentLabel = tokens[2];
+      }
+      else if (tokens[0] == MM::g_CFGCommand_Property &&
+            (tokens.size() == 3 || tokens.size() == 4))
+      {
+         if (tokens[1] == MM::g_Keyword_CoreDevice &&
+               tokens[2] == MM::g_Keyword_CoreInitialize)
+         {
+            if (tokens.size() == 4 && tokens[3] == "1")
+               beforeInit = false;
+         }
+         else if (beforeInit && specs.count(tokens[1]))
+         {
+            specs[tokens[1]].preInitProperties[tokens[2]] =
+               tokens.size() == 4 ? tokens[3] : "";
+         }
+      }
+   }
+
+   std::vector<std::string> loadedDevices = deviceManager_->GetDeviceList();
+   std::set<std::string> loadedSet(loadedDevices.begin(), loadedDevices.end());
+
+   std::set<std::string> kept;
+   for (std::map<std::string, DeviceSpec>::const_iterator it = specs.begin();
+         it != specs.end(); ++it)
+   {
+      if (!loadedSet.count(it->first))
+         continue;
+      std::shared_ptr<DeviceInstance> pDevice = deviceManager_->GetDevice(it->first);
+      if (!pDevice->IsInitialized())
+         continue;
+
+      const DeviceSpec& spec = it->second;
+      mm::DeviceModuleLockGuard guard(pDevice);
+      if (pDevice->GetAdapterModule()->GetName() != spec.moduleName ||
+            pDevice->GetName() != spec.deviceName ||
+            pDevice->GetParentID() != spec.parentLabel)
+         continue;
+
+      bool same = true;
+      for (std::map<std::string, std::string>::const_iterator prop =
+            spec.preInitProperties.begin();
+            same && prop != spec.preInitProperties.end(); ++prop)
+      {
+         try
+         {
+            same = (pDevice->GetProperty(prop->first) == prop->second);
+         }
+         catch (const CMMError&)
+         {
+            same = false;
+         }
+      }
+      // A pre-init property that the device was given but that the file
+      // leaves out would be back at its default after reloading
+      const std::set<std::string> preInitSet = pDevice->GetPreInitPropertiesSet();
+      for (std::set<std::string>::const_iterator prop = preInitSet.begin();
+            same && prop != preInitSet.end(); ++prop)
+      {
+         if (!spec.preInitProperties.count(*prop))
+            same = false;
+      }
+
+      if (same)
+         kept.insert(it->first);
+   }
+
+   // A peripheral cannot outlive its hub
+   for (bool changed = true; changed; )
+   {
+      changed = false;
+      for (std::set<std::string>::iterator it = kept.begin(); it != kept.end(); )
+      {
+         const std::string& parent = specs[*it].parentLabel;
+         if (!parent.empty() && !kept.count(parent))
+         {
+            kept.erase(it++);
+            changed = true;
+         }
+         else
+            ++it;
+      }
+   }
+
+   LOG_INFO(coreLogger_) << "Differential configuration load: keeping " <<
+      kept.size() << " of " << loadedDevices.size() << " loaded devices";
+
+   // Unload the devices that are not kept, peripherals before hubs
+   std::vector<std::string> hubs = deviceManager_->GetDeviceList(MM::HubDevice);
+   std::set<std::string> hubSet(hubs.begin(), hubs.end());
+   for (int pass = 0; pass < 2; ++pass)
+   {
+      const bool unloadHubs = (pass == 1);
+      for (std::vector<std::string>::const_iterator it = loadedDevices.begin();
+            it != loadedDevices.end(); ++it)
+      {
+         if (kept.count(*it) || (hubSet.count(*it) > 0) != unloadHubs)
+            continue;
+         unloadDevice(it->c_str());
+      }
+   }
+
+   clearConfigurationData();
+   properties_->Refresh();
+
+   beforeInit = true;
+   for (std::vector<ConfigFileLine>::const_iterator it = lines.begin();
+         it != lines.end(); ++it)
+   {
+      const std::vector<std::string>& tokens = it->tokens;
+      try
+      {
+         if (tokens.size() >= 2 && kept.count(tokens[1]) &&
+               (tokens[0] == MM::g_CFGCommand_Device ||
+                tokens[0] == MM::g_CFGCommand_ParentID))
+            continue;
+
+         if (tokens.size() >= 3 && tokens[0] == MM::g_CFGCommand_Property)
+         {
+            const std::string value = tokens.size() == 4 ? tokens[3] : "";
+            if (tokens[1] == MM::g_Keyword_CoreDevice &&
+                  tokens[2] == MM::g_Keyword_CoreInitialize)
+            {
+               // Unloading has been done above; initialize only what is new
+               if (value == "1")
+               {
+                  initializeUninitializedDevices();
+                  properties_->Set(MM::g_Keyword_CoreInitialize, "1");
+                  beforeInit = false;
+               }
+               continue;
+            }
+
+            if (kept.count(tokens[1]))
+            {
+               // Pre-init values of kept devices are known to match
+               if (beforeInit)
+                  continue;
+
+               bool unchanged;
+               {
+                  MMThreadGuard scg(stateCacheLock_);
+                  unchanged = stateCache_.isPropertyIncluded(tokens[1].c_str(), tokens[2].c_str()) &&
+                     stateCache_.getSetting(tokens[1].c_str(), tokens[2].c_str()).getPropertyValue() == value;
+               }
+               if (unchanged)
+                  continue;
+            }
+         }
+
+         applyConfigurationLine(tokens, it->text);
+      }
+      catch (CMMError& err)
+      {
+         if (externalCallback_)
+            externalCallback_->onSystemConfigurationLoaded();
+         std::ostringstream errorText;
+         errorText << "Line " << it->number << ": " << it->text << '\n';
+         errorText << err.getFullMsg() << "\n\n";
+         throw CMMError(errorText.str().c_str(), MMERR_InvalidConfigurationFile);
+      }
+   }
+
+   finishLoadingSystemConfiguration();
+}
+
+void CMMCore::initializeUninitializedDevices() throw (CMMError)
+{
+   std::vector<std::string> devices = deviceManager_->GetDeviceList();
+   for (std::vector<std::string>::const_iterator it = devices.begin();
+         it != devices.end(); ++it)
+   {
+      std::shared_ptr<DeviceInstance> pDevice = deviceManager_->GetDevice(*it);
+      if (pDevice->HasInitializationBeenAttempted())
+         continue;
+
+      mm::DeviceModuleLockGuard guard(pDevice);
+      LOG_INFO(coreLogger_) << "Will initialize device " << *it;
+      pDevice->Initialize();
+      LOG_INFO(coreLogger_) << "Did initialize device " << *it;
+
+      assignDefaultRole(pDevice);
+   }
+
+   updateCoreProperties();
+}
+
 /**
  * Register a callback (listener class).
  * MMCore will send notifications on internal events using this interface
@@ -7247,7 +9473,7 @@ void CMMCore::applyConfiguration(const Configuration& config) throw (CMMError)
          properties_->Execute(setting.getPropertyName().c_str(), setting.getPropertyValue().c_str());
          {
             MMThreadGuard scg(stateCacheLock_);
-            stateCache_.addSetting(PropertySetting(MM::g_Keyword_CoreDevice, setting.getPropertyName().c_str(), setting.getPropertyValue().c_str()));
+            addStateCacheSetting(PropertySetting(MM::g_Keyword_CoreDevice, setting.getPropertyName().c_str(), setting.getPropertyValue().c_str()));
          }
       }
       else
@@ -7263,7 +9489,7 @@ void CMMCore::applyConfiguration(const Configuration& config) throw (CMMError)
 
             {
                MMThreadGuard scg(stateCacheLock_);
-               stateCache_.addSetting(setting);
+               addStateCacheSetting(setting);
             }
          }
          catch (const CMMError&)
@@ -7310,7 +9536,7 @@ int CMMCore::applyProperties(std::vector<PropertySetting>& props, std::string& l
 
          {
             MMThreadGuard scg(stateCacheLock_);
-            stateCache_.addSetting(props[i]);
+            addStateCacheSetting(props[i]);
          }
       }
       catch (const CMMError& e)
@@ -7355,6 +9581,156 @@ std::string CMMCore::getCoreErrorText(int code) const
    return txt;
 }
 
+/**
+ * Returns the image in the camera buffer, processed by the current image
+ * processor unless this has already been done for the current snap.
+ * Must be called with the camera's module lock held.
+ */
+void* CMMCore::getProcessedImage(std::shared_ptr<CameraInstance> camera,
+      unsigned channelNr) throw (CMMError)
+{
+   unsigned char* pixels =
+      const_cast<unsigned char*>(camera->GetImageBuffer(channelNr));
+   std::shared_ptr<ImageProcessorInstance> imageProcessor =
+      currentImageProcessor_.lock();
+   if (!pixels || !imageProcessor)
+      return pixels;
+
+   const unsigned width = camera->GetImageWidth();
+   const unsigned height = camera->GetImageHeight();
+   const unsigned bytesPerPixel = camera->GetImageBytesPerPixel();
+   return processedImageTracker_->Get(camera, imageProcessor, channelNr,
+         pixels, static_cast<std::size_t>(width) * height * bytesPerPixel,
+         [&](unsigned char* target) {
+            LOG_DEBUG(coreLogger_) << "Will process snapped image (channel " <<
+               channelNr << ")";
+            imageProcessor->Process(target, width, height, bytesPerPixel);
+         });
+}
+
+/**
+ * Returns the processed image (see getProcessedImage()), reduced by software
+ * binning and cropping if enabled.
+ * Must be called with the camera's module lock held.
+ */
+void* CMMCore::getReducedImage(std::shared_ptr<CameraInstance> camera,
+      unsigned channelNr) throw (CMMError)
+{
+   void* pixels = getProcessedImage(camera, channelNr);
+   if (!pixels || !softwareBinning_->IsActive())
+      return pixels;
+
+   return const_cast<unsigned char*>(softwareBinning_->ReduceSnapped(
+            processedImageTracker_->GetGeneration(), channelNr,
+            static_cast<const unsigned char*>(pixels),
+            camera->GetImageWidth(), camera->GetImageHeight(),
+            camera->GetImageBytesPerPixel(),
+            camera->GetNumberOfComponents()));
+}
+
+/**
+ * Initializes the circular buffer for images from the camera, as reduced by
+ * software binning and cropping.
+ * Must be called with the camera's module lock held.
+ */
+bool CMMCore::initializeCircularBufferForCamera(
+      std::shared_ptr<CameraInstance> camera) throw (CMMError)
+{
+   unsigned width = camera->GetImageWidth();
+   unsigned height = camera->GetImageHeight();
+   const unsigned bytesPerPixel = camera->GetImageBytesPerPixel();
+   const unsigned numComponents = camera->GetNumberOfComponents();
+   const mm::SoftwareBinning::Settings settings =
+      softwareBinning_->GetSettings();
+   if (settings.IsActive())
+   {
+      if (!mm::SoftwareBinning::IsSupportedFormat(bytesPerPixel,
+               numComponents))
+      {
+         throw CMMError("Software binning and cropping do not support the "
+               "pixel type of the camera");
+      }
+      mm::SoftwareBinning::GetOutputSize(settings, width, height,
+            width, height);
+   }
+   softwareBinning_->SetCameraComponents(numComponents);
+   return cbuf_->Initialize(camera->GetNumberOfChannels(), width, height,
+         bytesPerPixel, getCircularBufferBitDepth(camera));
+}
+
+/**
+ * Returns the number of significant bits of the pixels that the camera's
+ * images will have in the circular buffer, or 0 if not known. Binned sums
+ * may have more bits than the camera's pixels.
+ */
+unsigned CMMCore::getCircularBufferBitDepth(
+      std::shared_ptr<CameraInstance> camera)
+{
+   const mm::SoftwareBinning::Settings settings =
+      softwareBinning_->GetSettings();
+   if (settings.binning > 1 && !settings.average)
+      return 0;
+   return camera->GetBitDepth();
+}
+
+/**
+ * Throws if the software binning or crop may not be changed now, because the
+ * size of the images in the circular buffer would change.
+ */
+void CMMCore::checkSoftwareBinningChangeAllowed() throw (CMMError)
+{
+   if (isSequenceRunning())
+      throw CMMError(getCoreErrorText(MMERR_NotAllowedDuringSequenceAcquisition).c_str(),
+                     MMERR_NotAllowedDuringSequenceAcquisition);
+}
+
+/**
+ * Adds a setting to the state cache and records it in the state log. Must be
+ * called with stateCacheLock_ held.
+ */
+void CMMCore::addStateCacheSetting(const PropertySetting& setting) const
+{
+   stateCache_.addSetting(setting);
+   stateLog_->Record(setting.getDeviceLabel(), setting.getPropertyName(),
+         setting.getPropertyValue(), setting.getReadOnly());
+}
+
+/**
+ * Records the current preset of a configuration group in the state log,
+ * under the pseudo-device "ConfigGroup".
+ */
+void CMMCore::recordConfigGroupState(const char* groupName,
+      const char* configName) const
+{
+   stateLog_->Record("ConfigGroup", groupName, configName, true);
+}
+
+/**
+ * Reports a change of circular buffer backpressure. Called from the thread
+ * that inserted or retrieved the image.
+ */
+void CMMCore::notifyCircularBufferBackpressure(bool active,
+      double fillFraction)
+{
+   if (active)
+      LOG_WARNING(coreLogger_) << "Circular buffer backpressure started at " <<
+         static_cast<int>(fillFraction * 100.0 + 0.5) << "% full";
+   else
+      LOG_INFO(coreLogger_) << "Circular buffer backpressure ended";
+
+   if (externalCallback_)
+      externalCallback_->onImageBufferBackpressureChanged(active, fillFraction);
+}
+
+void CMMCore::logCircularBufferSaturation(std::size_t saturatedPixels,
+      unsigned bitDepth)
+{
+   LOG_WARNING(coreLogger_) << saturatedPixels << " pixel(s) of an image " <<
+      "exceeded the camera's bit depth of " << bitDepth << " and were " <<
+      "saturated by circular buffer packing (further such images are not " <<
+      "reported until the buffer is cleared)";
+}
+
 void CMMCore::logError(const char* device, const char* msg)
 {
    // TODO Fix various inconsistent usages of this function.
@@ -7527,10 +9903,22 @@ MM::DeviceDetectionStatus CMMCore::detectDevice(const char* label)
  * intended for use during initial configuration, not routine loading of
  * devices. These restrictions may be relaxed in the future if possible.
  *
+ * If the hub discovery cache is enabled, the result of an earlier detection
+ * for the same hub is returned without querying the hardware (see
+ * enableHubDiscoveryCache()).
+ *
  * @param hubDeviceLabel    the label for the device of type Hub
  */
 std::vector<std::string> CMMCore::getInstalledDevices(const char* hubDeviceLabel) throw (CMMError)
 {
+   if (hubDiscoveryCacheEnabled_)
+   {
+      std::vector<std::string> names;
+      std::vector<std::string> descriptions;
+      getHubPeripherals(hubDeviceLabel, names, descriptions);
+      return names;
+   }
+
    std::shared_ptr<HubInstance> pHub =
       deviceManager_->GetDeviceOfType<HubInstance>(hubDeviceLabel);
 
@@ -7551,9 +9939,484 @@ std::string CMMCore::getInstalledDeviceDescription(const char* hubLabel, const c
    CheckDeviceLabel(deviceLabel);
 
    std::string description;
+   if (hubDiscoveryCacheEnabled_)
+   {
+      std::vector<std::string> names;
+      std::vector<std::string> descriptions;
+      getHubPeripherals(hubLabel, names, descriptions);
+      std::vector<std::string>::const_iterator it =
+         std::find(names.begin(), names.end(), deviceLabel);
+      if (it == names.end())
+         throw CMMError("No peripheral with name " + ToQuotedString(deviceLabel) +
+               " installed in hub " + ToQuotedString(hubLabel));
+      description = descriptions[it - names.begin()];
+   }
+   else
    {
       mm::DeviceModuleLockGuard guard(pHub);
       description = pHub->GetInstalledPeripheralDescription(deviceLabel);
    }
    return description.empty() ? "N/A" : description;
 }
+
+/**
+ * Enable or disable the hub discovery cache.
+ *
+ * When enabled, getInstalledDevices() and getInstalledDeviceDescription()
+ * remember the peripherals detected in each hub, keyed by the hub's device
+ * adapter and device name, the value of its Port property, and its firmware
+ * identity (the values of any properties whose names contain "Firmware" or
+ * "Version"). The next time the same hub is queried, including after it is
+ * reloaded, the remembered list is returned without performing detection.
+ * If the port or firmware identity differs, full detection is performed and
+ * the entry is replaced.
+ *
+ * The cache is kept in memory unless a file is set with
+ * setHubDiscoveryCacheFile(). Disabled by default.
+ *
+ * @param enable    whether to use the cache
+ */
+void CMMCore::enableHubDiscoveryCache(bool enable)
+{
+   hubDiscoveryCacheEnabled_ = enable;
+   LOG_INFO(coreLogger_) << "Hub discovery cache " <<
+      (enable ? "enabled" : "disabled");
+}
+
+/**
+ * Return whether the hub discovery cache is enabled.
+ */
+bool CMMCore::isHubDiscoveryCacheEnabled()
+{
+   return hubDiscoveryCacheEnabled_;
+}
+
+/**
+ * Enable or disable background revalidation of cached hub peripherals.
+ *
+ * When enabled, each time the hub discovery cache returns a remembered list,
+ * full detection is also performed on a background thread, and the cache is
+ * updated if the result differs. The current call still returns the
+ * remembered list. Unloading devices waits for any background detection to
+ * finish. Disabled by default.
+ *
+ * @param enable    whether to revalidate cached lists in the background
+ */
+void CMMCore::enableHubDiscoveryRevalidation(bool enable)
+{
+   hubDiscoveryRevalidationEnabled_ = enable;
+}
+
+/**
+ * Return whether cached hub peripherals are revalidated in the background.
+ */
+bool CMMCore::isHubDiscoveryRevalidationEnabled()
+{
+   return hubDiscoveryRevalidationEnabled_;
+}
+
+/**
+ * Set the file in which the hub discovery cache persists across sessions.
+ *
+ * Entries are read from the file if it exists, replacing those in memory,
+ * and the file is rewritten whenever an entry changes. Pass an empty string
+ * to keep the cache in memory only.
+ *
+ * @param filename    the cache file, or an empty string
+ */
+void CMMCore::setHubDiscoveryCacheFile(const char* filename) throw (CMMError)
+{
+   if (!filename)
+      throw CMMError(errorText_[MMERR_NullPointerException], MMERR_NullPointerException);
+   hubDiscoveryCache_->SetFile(filename);
+   LOG_INFO(coreLogger_) << "Hub discovery cache file set to " <<
+      (filename[0] ? filename : "(none)");
+}
+
+/**
+ * Return the hub discovery cache file, or an empty string if none is set.
+ */
+std::string CMMCore::getHubDiscoveryCacheFile()
+{
+   return hubDiscoveryCache_->GetFile();
+}
+
+/**
+ * Forget all cached hub peripherals, including those in the cache file.
+ *
+ * Hubs that have already detected their peripherals during this session are
+ * not detected again until they are reloaded.
+ */
+void CMMCore::clearHubDiscoveryCache() throw (CMMError)
+{
+   hubDiscoveryCache_->Clear();
+}
+
+// Called with the hub's module lock held
+static mm::HubDiscoveryCache::Key
+GetHubDiscoveryKey(std::shared_ptr<HubInstance> pHub)
+{
+   mm::HubDiscoveryCache::Key key;
+   key.adapter = pHub->GetAdapterModule()->GetName();
+   key.hub = pHub->GetName();
+
+   std::vector<std::string> propNames = pHub->GetPropertyNames();
+   std::sort(propNames.begin(), propNames.end());
+   for (std::vector<std::string>::const_iterator it = propNames.begin(),
+         end = propNames.end(); it != end; ++it)
+   {
+      if (*it == MM::g_Keyword_Port)
+      {
+         key.port = pHub->GetProperty(*it);
+         continue;
+      }
+      std::string lowerName(*it);
+      std::transform(lowerName.begin(), lowerName.end(), lowerName.begin(),
+            [](unsigned char ch) { return static_cast<char>(std::tolower(ch)); });
+      if (lowerName.find("firmware") != std::string::npos ||
+            lowerName.find("version") != std::string::npos)
+      {
+         key.identity += *it + "=" + pHub->GetProperty(*it) + ";";
+      }
+   }
+   return key;
+}
+
+// Called with the hub's module lock held
+static mm::HubDiscoveryCache::PeripheralList
+DetectHubPeripherals(std::shared_ptr<HubInstance> pHub)
+{
+   mm::HubDiscoveryCache::PeripheralList peripherals;
+   std::vector<std::string> names = pHub->GetInstalledPeripheralNames();
+   for (std::vector<std::string>::const_iterator it = names.begin(),
+         end = names.end(); it != end; ++it)
+   {
+      mm::HubDiscoveryCache::Peripheral peripheral;
+      peripheral.name = *it;
+      peripheral.description = pHub->GetInstalledPeripheralDescription(*it);
+      peripherals.push_back(peripheral);
+   }
+   return peripherals;
+}
+
+/**
+ * Get the installed peripherals of a hub through the discovery cache.
+ */
+void CMMCore::getHubPeripherals(const char* hubLabel,
+      std::vector<std::string>& names, std::vector<std::string>& descriptions)
+   throw (CMMError)
+{
+   std::shared_ptr<HubInstance> pHub =
+      deviceManager_->GetDeviceOfType<HubInstance>(hubLabel);
+
+   mm::HubDiscoveryCache::Key key;
+   {
+      mm::DeviceModuleLockGuard guard(pHub);
+      key = GetHubDiscoveryKey(pHub);
+   }
+
+   mm::HubDiscoveryCache::PeripheralList peripherals;
+   if (hubDiscoveryCache_->Lookup(key, peripherals))
+   {
+      LOG_DEBUG(coreLogger_) << "Using cached peripherals of hub " << hubLabel;
+      if (hubDiscoveryRevalidationEnabled_)
+      {
+         std::weak_ptr<HubInstance> weakHub(pHub);
+         mm::logging::Logger logger = coreLogger_;
+         const std::string label(hubLabel);
+         const mm::HubDiscoveryCache::PeripheralList cached(peripherals);
+         hubDiscoveryCache_->Revalidate(key, [weakHub, logger, label, cached]() {
+            std::shared_ptr<HubInstance> hub = weakHub.lock();
+            if (!hub)
+               throw CMMError("Hub " + ToQuotedString(label) + " was unloaded");
+            mm::HubDiscoveryCache::PeripheralList detected;
+            try
+            {
+               mm::DeviceModuleLockGuard guard(hub);
+               detected = DetectHubPeripherals(hub);
+            }
+            catch (const CMMError& e)
+            {
+               LOG_WARNING(logger) << "Background detection of peripherals "
+                  "of hub " << label << " failed: " << e.getFullMsg();
+               throw;
+            }
+            if (detected != cached)
+            {
+               LOG_INFO(logger) << "Peripherals of hub " << label <<
+                  " differ from the cached list; cache updated";
+            }
+            return detected;
+         });
+      }
+   }
+   else
+   {
+      LOG_INFO(coreLogger_) << "Detecting peripherals of hub " << hubLabel;
+      {
+         mm::DeviceModuleLockGuard guard(pHub);
+         peripherals = DetectHubPeripherals(pHub);
+      }
+      try
+      {
+         hubDiscoveryCache_->Store(key, peripherals);
+      }
+      catch (const CMMError& e)
+      {
+         LOG_WARNING(coreLogger_) << e.getMsg();
+      }
+   }
+
+   names.clear();
+   descriptions.clear();
+   for (mm::HubDiscoveryCache::PeripheralList::const_iterator it =
+         peripherals.begin(), end = peripherals.end(); it != end; ++it)
+   {
+      names.push_back(it->name);
+      descriptions.push_back(it->description);
+   }
+}
+
+/**
+ * Start recording the calls made to all devices.
+ *
+ * Every call to the main device functions (properties, Busy(), stage and
+ * state positions, shutters, snapping, camera exposure and sequence
+ * acquisition), with its arguments, return value, result and timing, is
+ * written to the given trace file, together with the images returned by
+ * cameras, which go into a sidecar file with ".pixels" appended to the name.
+ * The trace starts with the current property values of all loaded devices.
+ *
+ * The trace can be replayed with the devices of the TraceReplay device
+ * adapter, which respond to the same calls with the recorded results and
+ * latencies.
+ *
+ * @param filename    the trace file to create (overwritten if it exists)
+ */
+void CMMCore::startDeviceTraceRecording(const char* filename) throw (CMMError)
+{
+   if (!filename)
+      throw CMMError(errorText_[MMERR_NullPointerException], MMERR_NullPointerException);
+   if (std::atomic_load(&deviceTraceRecorder_))
+      throw CMMError("Device trace recording is already in progress");
+
+   std::shared_ptr<mm::DeviceTraceRecorder> recorder =
+      std::make_shared<mm::DeviceTraceRecorder>(filename);
+
+   std::vector<std::string> labels = deviceManager_->GetDeviceList();
+   for (std::vector<std::string>::const_iterator it = labels.begin(),
+         end = labels.end(); it != end; ++it)
+   {
+      std::shared_ptr<DeviceInstance> pDevice = deviceManager_->GetDevice(*it);
+      mm::DeviceModuleLockGuard guard(pDevice);
+      RecordDeviceTraceState(*recorder, pDevice);
+      pDevice->SetTraceRecorder(recorder);
+   }
+   std::atomic_store(&deviceTraceRecorder_, recorder);
+
+   LOG_INFO(coreLogger_) << "Started recording device trace to " << filename;
+}
+
+/**
+ * Stop recording device calls and close the trace file.
+ *
+ * Does nothing if no recording is in progress. Throws if the trace could not
+ * be completely written.
+ */
+void CMMCore::stopDeviceTraceRecording() throw (CMMError)
+{
+   std::shared_ptr<mm::DeviceTraceRecorder> recorder =
+      std::atomic_exchange(&deviceTraceRecorder_,
+            std::shared_ptr<mm::DeviceTraceRecorder>());
+   if (!recorder)
+      return;
+
+   std::vector<std::string> labels = deviceManager_->GetDeviceList();
+   for (std::vector<std::string>::const_iterator it = labels.begin(),
+         end = labels.end(); it != end; ++it)
+   {
+      deviceManager_->GetDevice(*it)->SetTraceRecorder(
+            std::shared_ptr<mm::DeviceTraceRecorder>());
+   }
+
+   const unsigned long long count = recorder->GetRecordCount();
+   recorder->Close();
+   LOG_INFO(coreLogger_) << "Stopped recording device trace to " <<
+      recorder->GetFilename() << " (" << count << " records)";
+}
+
+/**
+ * Return true if device calls are being recorded.
+ */
+bool CMMCore::isDeviceTraceRecording()
+{
+   return std::atomic_load(&deviceTraceRecorder_) != nullptr;
+}
+
+/**
+ * Enables or disables profiling of device module locks.
+ *
+ * Each call into a device adapter holds the lock of the adapter's module,
+ * so devices of the same module (e.g. the peripherals of a hub) cannot be
+ * accessed concurrently. While profiling is enabled, the time threads wait
+ * for and hold each module lock is recorded per module and per calling Core
+ * function, together with the longest holds and their call context. Enabling
+ * profiling resets the statistics.
+ *
+ * While profiling is enabled, a summary is logged at the interval set with
+ * setModuleLockProfileLogInterval(). The statistics are available from
+ * getModuleLockProfile(), also after profiling has been disabled.
+ */
+void CMMCore::enableModuleLockProfiling(bool enable)
+{
+   if (enable == moduleLockProfilingEnabled_)
+      return;
+
+   if (enable)
+   {
+      moduleLockProfiler_->Reset();
+      setModuleLockProfileLogInterval(moduleLockProfileLogIntervalS_);
+   }
+
+   moduleLockProfilingEnabled_ = enable;
+   std::shared_ptr<mm::ModuleLockProfiler> profiler =
+      enable ? moduleLockProfiler_ : std::shared_ptr<mm::ModuleLockProfiler>();
+   std::vector<std::string> labels = deviceManager_->GetDeviceList();
+   for (std::vector<std::string>::const_iterator it = labels.begin(),
+         end = labels.end(); it != end; ++it)
+   {
+      deviceManager_->GetDevice(*it)->GetAdapterModule()->SetLockProfiler(profiler);
+   }
+
+   if (enable)
+   {
+      LOG_INFO(coreLogger_) << "Enabled module lock profiling";
+   }
+   else
+   {
+      LOG_INFO(coreLogger_) << "Disabled module lock profiling\n" <<
+         moduleLockProfiler_->FormatSummary();
+   }
+}
+
+/**
+ * Returns true if module lock profiling is enabled.
+ */
+bool CMMCore::isModuleLockProfilingEnabled()
+{
+   return moduleLockProfilingEnabled_;
+}
+
+/**
+ * Sets the interval at which a summary of the module lock profile is logged
+ * while profiling is enabled. The default is 60 seconds.
+ *
+ * @param intervalS   the interval in seconds, or 0 to log no summaries
+ */
+void CMMCore::setModuleLockProfileLogInterval(double intervalS) throw (CMMError)
+{
+   if (intervalS < 0.0)
+      throw CMMError("Module lock profile log interval must not be negative");
+   moduleLockProfileLogIntervalS_ = intervalS;
+
+   mm::logging::Logger logger = coreLogger_;
+   moduleLockProfiler_->SetSummaryInterval(1000.0 * intervalS,
+         [logger](const std::string& summary)
+         { LOG_INFO(logger) << summary; });
+}
+
+/**
+ * Returns a text report of the module lock profile.
+ *
+ * The report lists, for each module and calling Core function, the number
+ * of lock acquisitions and the total and maximum wait and hold times in
+ * milliseconds, by decreasing total wait time. It then lists the longest
+ * individual holds, with the calling thread and the callers of all module
+ * locks the thread held at the time (outermost first, with the module in
+ * brackets). Nested acquisitions by the same thread are counted separately,
+ * and the hold time of the outer one includes that of the inner ones.
+ */
+std::string CMMCore::getModuleLockProfile()
+{
+   return moduleLockProfiler_->FormatSummary();
+}
+
+/**
+ * Clears the module lock profile statistics.
+ */
+void CMMCore::resetModuleLockProfile()
+{
+   moduleLockProfiler_->Reset();
+}
+
+/**
+ * Enables or disables state delta metadata on camera images.
+ *
+ * The Core keeps a versioned log of the system state: property values set,
+ * read or reported by devices, stage positions reported by devices, and the
+ * presets applied to configuration groups (recorded as read-only properties of
+ * the pseudo-device "ConfigGroup"). Each change increments the state version.
+ *
+ * When enabled, each image from a camera is given the tag "StateVersion"
+ * (the state version when the image was inserted) and a tag
+ * "StateDelta-<device>-<property>" for each setting that changed since the
+ * previous image from the same camera. The first image after enabling carries
+ * the full state. The full state of any recent image can be obtained with
+ * getSystemStateAtVersion().
+ */
+void CMMCore::enableStateDeltaMetadata(bool enable)
+{
+   stateLog_->EnableFrameDeltas(enable);
+   LOG_INFO(coreLogger_) << (enable ? "Enabled" : "Disabled") <<
+      " state delta metadata";
+}
+
+/**
+ * Returns true if state delta metadata is enabled.
+ */
+bool CMMCore::isStateDeltaMetadataEnabled()
+{
+   return stateLog_->IsFrameDeltaEnabled();
+}
+
+/**
+ * Returns the current state version (0 if no state has been recorded).
+ * @see enableStateDeltaMetadata()
+ */
+long CMMCore::getStateVersion()
+{
+   return stateLog_->GetVersion();
+}
+
+/**
+ * Returns the oldest state version that can be passed to
+ * getSystemStateAtVersion(). Only the most recent 10000 changes are kept.
+ */
+long CMMCore::getOldestStateVersion()
+{
+   return stateLog_->GetOldestVersion();
+}
+
+/**
+ * Returns the system state at a state version, such as the "StateVersion"
+ * tag of an image.
+ *
+ * Settings that are not settable device properties (stage positions and
+ * configuration group presets) are marked read-only, so that the returned
+ * configuration can be passed to setSystemState().
+ *
+ * @param version   the state version
+ * @see enableStateDeltaMetadata()
+ */
+Configuration CMMCore::getSystemStateAtVersion(long version) throw (CMMError)
+{
+   Configuration config;
+   const std::vector<mm::StateLog::Setting> state =
+      stateLog_->GetStateAt(version);
+   for (const auto& s : state)
+   {
+      config.addSetting(PropertySetting(s.device.c_str(), s.property.c_str(),
+               s.value.c_str(), s.readOnly));
+   }
+   return config;
+}
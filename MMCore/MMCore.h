@@ -110,7 +110,20 @@ class CMMCore;
 
 namespace mm {
    class DeviceManager;
+   class DeviceTraceRecorder;
+   class HubDiscoveryCache;
+   class LivePropertyChanges;
    class LogManager;
+   class ModuleLockProfiler;
+   class MoveScheduler;
+   class ProcessedImageTracker;
+   class SnapBurstPipeline;
+   class SoftwareBinning;
+   class StateLog;
+   class XYScan;
+   namespace test {
+      class CoreTestAccess;
+   }
 } // namespace mm
 
 typedef unsigned int* imgRGB32;
@@ -135,6 +148,7 @@ class CMMCore
 {
    friend class CoreCallback;
    friend class CorePropertyCollection;
+   friend class mm::test::CoreTestAccess; // Unit tests only
 
 public:
    CMMCore();
@@ -166,6 +180,7 @@ public:
    void reset() throw (CMMError);
 
    void unloadLibrary(const char* moduleName) throw (CMMError);
+   void reloadDeviceAdapter(const char* moduleName) throw (CMMError);
 
    void updateCoreProperties() throw (CMMError);
 
@@ -180,7 +195,10 @@ public:
    void saveSystemState(const char* fileName) throw (CMMError);
    void loadSystemState(const char* fileName) throw (CMMError);
    void saveSystemConfiguration(const char* fileName) throw (CMMError);
+   void saveSystemConfigurationFromCache(const char* fileName,
+         bool readUncached) throw (CMMError);
    void loadSystemConfiguration(const char* fileName) throw (CMMError);
+   void loadSystemConfigurationDifferential(const char* fileName) throw (CMMError);
    void registerCallback(MMEventCallback* cb);
    ///@}
 
@@ -200,6 +218,13 @@ public:
          bool truncate = true, bool synchronous = false) throw (CMMError);
    void stopSecondaryLogFile(int handle) throw (CMMError);
 
+   void enableLogDeduplication(bool enable);
+   bool logDeduplicationEnabled();
+   void setLogRateLimit(double entriesPerSecond, double burst) throw (CMMError);
+   double getLogRateLimit();
+   std::string getLogSuppressionSummary();
+   void resetLogSuppressionCounts();
+
    ///@}
 
    /** \name Device listing. */
@@ -235,6 +260,14 @@ public:
    void setProperty(const char* label, const char* propName, const float propValue) throw (CMMError);
    void setProperty(const char* label, const char* propName, const double propValue) throw (CMMError);
 
+   void enableRedundantPropertyWriteSuppression(const char* label,
+         bool enable) throw (CMMError);
+   void enableRedundantPropertyWriteSuppression(const char* label,
+         const char* propName, bool enable) throw (CMMError);
+   bool isRedundantPropertyWriteSuppressionEnabled(const char* label,
+         const char* propName) throw (CMMError);
+   long getSuppressedPropertyWriteCount(const char* label) throw (CMMError);
+
    std::vector<std::string> getAllowedPropertyValues(const char* label, const char* propName) throw (CMMError);
    bool isPropertyReadOnly(const char* label, const char* propName) throw (CMMError);
    bool isPropertyPreInit(const char* label, const char* propName) throw (CMMError);
@@ -379,6 +412,15 @@ public:
    void snapImage() throw (CMMError);
    void* getImage() throw (CMMError);
    void* getImage(unsigned numChannel) throw (CMMError);
+   void enableProcessedImageCopy(bool enable);
+   bool isProcessedImageCopyEnabled();
+
+   void setSoftwareBinning(unsigned binning, bool average) throw (CMMError);
+   unsigned getSoftwareBinning();
+   bool isSoftwareBinningAveraged();
+   void setSoftwareCrop(int x, int y, int xSize, int ySize) throw (CMMError);
+   void getSoftwareCrop(int& x, int& y, int& xSize, int& ySize);
+   void clearSoftwareCrop() throw (CMMError);
 
    unsigned getImageWidth();
    unsigned getImageHeight();
@@ -401,6 +443,12 @@ public:
    void startSequenceAcquisition(const char* cameraLabel, long numImages,
          double intervalMs, bool stopOnOverflow) throw (CMMError);
    void prepareSequenceAcquisition(const char* cameraLabel) throw (CMMError);
+   void snapImageBurst(long numImages) throw (CMMError);
+   void armSequenceAcquisition(const char* cameraLabel) throw (CMMError);
+   void startArmedSequenceAcquisition(long numImages, double intervalMs,
+         bool stopOnOverflow) throw (CMMError);
+   void disarmSequenceAcquisition() throw (CMMError);
+   bool isSequenceAcquisitionArmed();
    void startContinuousSequenceAcquisition(double intervalMs) throw (CMMError);
    void stopSequenceAcquisition() throw (CMMError);
    void stopSequenceAcquisition(const char* cameraLabel) throw (CMMError);
@@ -422,6 +470,19 @@ public:
    long getBufferTotalCapacity();
    long getBufferFreeCapacity();
    bool isBufferOverflowed() const;
+   void setCircularBufferWatermarks(double highFraction, double lowFraction)
+      throw (CMMError);
+   double getCircularBufferHighWatermark();
+   double getCircularBufferLowWatermark();
+   void setCircularBufferBackpressurePolicy(const char* policy, long n)
+      throw (CMMError);
+   std::string getCircularBufferBackpressurePolicy();
+   long getCircularBufferBackpressureParameter();
+   bool isCircularBufferBackpressured();
+   long getCircularBufferDroppedImageCount();
+   void enableCircularBufferPacking(bool enable) throw (CMMError);
+   bool isCircularBufferPackingEnabled();
+   unsigned getCircularBufferPackedBitDepth();
    void setCircularBufferMemoryFootprint(unsigned sizeMB) throw (CMMError);
    unsigned getCircularBufferMemoryFootprint();
    void initializeCircularBuffer() throw (CMMError);
@@ -433,6 +494,10 @@ public:
    long getExposureSequenceMaxLength(const char* cameraLabel) throw (CMMError);
    void loadExposureSequence(const char* cameraLabel,
          std::vector<double> exposureSequence_ms) throw (CMMError);
+
+   void setPropertyAtNextFrame(const char* cameraLabel, const char* propName,
+         const char* propValue) throw (CMMError);
+   long getPendingPropertyChangeCount(const char* cameraLabel) throw (CMMError);
    ///@}
 
    /** \name Autofocus control. */
@@ -527,6 +592,29 @@ public:
          std::vector<double> ySequence) throw (CMMError);
    ///@}
 
+   /** \name Continuous XY scanning. */
+   ///@{
+   void startXYScanAcquisition(const char* xyStageLabel,
+         double xEndUm, double yEndUm, double speedUmPerS,
+         long numImages, double intervalMs) throw (CMMError);
+   void stopXYScanAcquisition() throw (CMMError);
+   ///@}
+
+   /** \name Asynchronous moves.
+    *
+    * Start moves without waiting for them, and wait for their completion
+    * later, possibly for several moves at once.
+    */
+   ///@{
+   long setPositionAsync(const char* stageLabel, double position) throw (CMMError);
+   long setXYPositionAsync(const char* xyStageLabel,
+         double x, double y) throw (CMMError);
+   long setStateAsync(const char* stateDeviceLabel, long state) throw (CMMError);
+   bool isMoveDone(long moveHandle) throw (CMMError);
+   void waitForMove(long moveHandle) throw (CMMError);
+   void waitForMoves(std::vector<long> moveHandles) throw (CMMError);
+   ///@}
+
    /** \name Serial port control. */
    ///@{
    void setSerialProperties(const char* portName,
@@ -623,6 +711,39 @@ public:
    std::string getInstalledDeviceDescription(const char* hubLabel,
          const char* peripheralLabel) throw (CMMError);
    std::vector<std::string> getLoadedPeripheralDevices(const char* hubLabel) throw (CMMError);
+
+   void enableHubDiscoveryCache(bool enable);
+   bool isHubDiscoveryCacheEnabled();
+   void enableHubDiscoveryRevalidation(bool enable);
+   bool isHubDiscoveryRevalidationEnabled();
+   void setHubDiscoveryCacheFile(const char* filename) throw (CMMError);
+   std::string getHubDiscoveryCacheFile();
+   void clearHubDiscoveryCache() throw (CMMError);
+   ///@}
+
+   /** \name Recording of device calls. */
+   ///@{
+   void startDeviceTraceRecording(const char* filename) throw (CMMError);
+   void stopDeviceTraceRecording() throw (CMMError);
+   bool isDeviceTraceRecording();
+   ///@}
+
+   /** \name Module lock profiling. */
+   ///@{
+   void enableModuleLockProfiling(bool enable);
+   bool isModuleLockProfilingEnabled();
+   void setModuleLockProfileLogInterval(double intervalS) throw (CMMError);
+   std::string getModuleLockProfile();
+   void resetModuleLockProfile();
+   ///@}
+
+   /** \name State versions and per-frame state deltas. */
+   ///@{
+   void enableStateDeltaMetadata(bool enable);
+   bool isStateDeltaMetadataEnabled();
+   long getStateVersion();
+   long getOldestStateVersion();
+   Configuration getSystemStateAtVersion(long version) throw (CMMError);
    ///@}
 
 private:
@@ -647,6 +768,8 @@ private:
    std::weak_ptr<SLMInstance> currentSLMDevice_;
    std::weak_ptr<GalvoInstance> currentGalvoDevice_;
    std::weak_ptr<ImageProcessorInstance> currentImageProcessor_;
+   std::shared_ptr<mm::ProcessedImageTracker> processedImageTracker_;
+   std::shared_ptr<mm::SoftwareBinning> softwareBinning_;
 
    std::string channelGroup_;
    long pollingIntervalMs_;
@@ -662,12 +785,39 @@ private:
 
    std::shared_ptr<CPluginManager> pluginManager_;
    std::shared_ptr<mm::DeviceManager> deviceManager_;
+   std::shared_ptr<mm::MoveScheduler> moveScheduler_;
+   std::shared_ptr<mm::HubDiscoveryCache> hubDiscoveryCache_;
+   bool hubDiscoveryCacheEnabled_;
+   bool hubDiscoveryRevalidationEnabled_;
+   std::shared_ptr<mm::LivePropertyChanges> livePropertyChanges_;
+   std::shared_ptr<mm::ModuleLockProfiler> moduleLockProfiler_;
+   bool moduleLockProfilingEnabled_;
+   double moduleLockProfileLogIntervalS_;
+   // Read from camera threads (via CoreCallback), so accessed with
+   // std::atomic_load/store
+   std::shared_ptr<mm::DeviceTraceRecorder> deviceTraceRecorder_;
+   // Read from camera threads (via CoreCallback), so accessed with
+   // std::atomic_load/store
+   std::shared_ptr<mm::XYScan> xyScan_;
    std::map<int, std::string> errorText_;
 
+   // Armed sequence acquisition; accessed from camera threads via
+   // CoreCallback, so synchronized by armedSequenceLock_
+   mutable MMThreadLock armedSequenceLock_;
+   std::weak_ptr<CameraInstance> armedCamera_;
+   std::weak_ptr<ShutterInstance> armedShutter_; // Held open once a burst starts
+   unsigned long armedBufferGeneration_; // Circular buffer format when armed
+
+   // Kept between snapImageBurst() calls for its image buffers; a burst takes
+   // it (or makes a new one) under snapBurstPipelineLock_ and puts it back
+   MMThreadLock snapBurstPipelineLock_;
+   std::shared_ptr<mm::SnapBurstPipeline> idleSnapBurstPipeline_;
+
    // Must be unlocked when calling MMEventCallback or calling device methods
    // or acquiring a module lock
    mutable MMThreadLock stateCacheLock_;
    mutable Configuration stateCache_; // Synchronized by stateCacheLock_
+   std::shared_ptr<mm::StateLog> stateLog_;
 
    MMThreadLock* pPostedErrorsLock_;
    mutable std::deque<std::pair< int, std::string> > postedErrors_;
@@ -688,14 +838,51 @@ private:
    void applyConfiguration(const Configuration& config) throw (CMMError);
    int applyProperties(std::vector<PropertySetting>& props, std::string& lastError);
    void waitForDevice(std::shared_ptr<DeviceInstance> pDev) throw (CMMError);
+   long trackMove(std::shared_ptr<DeviceInstance> pDev);
+   bool isShutterHeldForArmedSequence(const MM::Device* camera) const;
+   void startSequenceAcquisitionOnCamera(
+         std::shared_ptr<CameraInstance> camera, long numImages,
+         double intervalMs, bool stopOnOverflow, bool armed) throw (CMMError);
+   void holdShutterForArmedSequence(const std::string& cameraLabel)
+      throw (CMMError);
+   void releaseArmedShutter() throw (CMMError);
+   void finishXYScan(std::shared_ptr<mm::XYScan> scan) throw (CMMError);
+   void applyLivePropertyChanges(std::shared_ptr<CameraInstance> camera);
+   void applyLivePropertyChangesBetweenFrames(const MM::Device* rawCamera);
+   void saveSystemConfigurationImpl(const char* fileName, bool fromCache,
+         bool readUncached) throw (CMMError);
    Configuration getConfigGroupState(const char* group, bool fromCache) throw (CMMError);
    std::string getDeviceErrorText(int deviceCode, std::shared_ptr<DeviceInstance> pDevice);
    std::string getDeviceName(std::shared_ptr<DeviceInstance> pDev);
    void logError(const char* device, const char* msg);
+   void notifyCircularBufferBackpressure(bool active, double fillFraction);
+   void logCircularBufferSaturation(std::size_t saturatedPixels,
+         unsigned bitDepth);
+   void* getProcessedImage(std::shared_ptr<CameraInstance> camera,
+         unsigned channelNr) throw (CMMError);
+   void* getReducedImage(std::shared_ptr<CameraInstance> camera,
+         unsigned channelNr) throw (CMMError);
+   bool initializeCircularBufferForCamera(
+         std::shared_ptr<CameraInstance> camera) throw (CMMError);
+   void resetCircularBufferForCamera(
+         std::shared_ptr<CameraInstance> camera) throw (CMMError);
+   unsigned getCircularBufferBitDepth(std::shared_ptr<CameraInstance> camera);
+   void checkSoftwareBinningChangeAllowed() throw (CMMError);
+   void addStateCacheSetting(const PropertySetting& setting) const;
+   void recordConfigGroupState(const char* groupName,
+         const char* configName) const;
    void updateAllowedChannelGroups();
    void assignDefaultRole(std::shared_ptr<DeviceInstance> pDev);
    void updateCoreProperty(const char* propName, MM::DeviceType devType) throw (CMMError);
    void loadSystemConfigurationImpl(const char* fileName) throw (CMMError);
+   void loadSystemConfigurationDifferentialImpl(const char* fileName) throw (CMMError);
+   void applyConfigurationLine(const std::vector<std::string>& tokens,
+         const std::string& line) throw (CMMError);
+   void finishLoadingSystemConfiguration() throw (CMMError);
+   void initializeUninitializedDevices() throw (CMMError);
+   void clearConfigurationData();
+   void getHubPeripherals(const char* hubLabel, std::vector<std::string>& names,
+         std::vector<std::string>& descriptions) throw (CMMError);
 };
 
 #if defined(__GNUC__) && !defined(__clang__)
@@ -86,4 +86,9 @@ public:
       std::cout << "onSLMExposureChanged()" << name << " " << newExposure << '\n';
    }
 
+   virtual void onImageBufferBackpressureChanged(bool backpressured, double fillFraction)
+   {
+      std::cout << "onImageBufferBackpressureChanged()" << backpressured << " " << fillFraction << '\n';
+   }
+
 };
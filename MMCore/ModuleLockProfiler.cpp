@@ -0,0 +1,231 @@
+// PROJECT:       Micro-Manager
+// SUBSYSTEM:     MMCore
+//
+// DESCRIPTION:   Wait and hold time statistics for device module locks
+//
+// LICENSE:       This file is distributed under the "Lesser GPL" (LGPL) license.
+//                License text is included with the source distribution.
+//
+//                This file is distributed in the hope that it will be useful,
+//                but WITHOUT ANY WARRANTY; without even the implied warranty
+//                of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+//
+//                IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+//                CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+//                INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES.
+
+#include "ModuleLockProfiler.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+#include <thread>
+
+namespace mm
+{
+
+namespace
+{
+
+// Module locks held by this thread, outermost first
+thread_local std::vector<std::pair<std::string, const char*>> heldLocks;
+
+} // anonymous namespace
+
+
+ModuleLockProfiler::ModuleLockProfiler(size_t maxLongestHolds) :
+   maxLongestHolds_(maxLongestHolds),
+   startTime_(Clock::now()),
+   summaryIntervalMs_(0.0),
+   lastSummary_(startTime_)
+{
+}
+
+
+void
+ModuleLockProfiler::EnterContext(const std::string& module, const char* caller)
+{
+   heldLocks.emplace_back(module, caller);
+}
+
+
+void
+ModuleLockProfiler::LeaveContext()
+{
+   if (!heldLocks.empty())
+      heldLocks.pop_back();
+}
+
+
+std::string
+ModuleLockProfiler::CurrentContext()
+{
+   std::string context;
+   for (const auto& held : heldLocks)
+   {
+      if (!context.empty())
+         context += " > ";
+      context += held.second;
+      context += " [";
+      context += held.first;
+      context += "]";
+   }
+   return context;
+}
+
+
+bool
+ModuleLockProfiler::IsLongestHold(double holdMs) const
+{
+   std::lock_guard<std::mutex> lock(mutex_);
+   return longestHolds_.size() < maxLongestHolds_ ||
+      holdMs > longestHolds_.back().holdMs;
+}
+
+
+void
+ModuleLockProfiler::Record(const std::string& module, const char* caller,
+      double waitMs, double holdMs, const std::string& context)
+{
+   std::string summary;
+   std::function<void(const std::string&)> sink;
+   {
+      std::lock_guard<std::mutex> lock(mutex_);
+
+      Stats& s = stats_[std::make_pair(module, std::string(caller))];
+      if (s.count == 0)
+      {
+         s.module = module;
+         s.caller = caller;
+      }
+      ++s.count;
+      s.totalWaitMs += waitMs;
+      s.maxWaitMs = std::max(s.maxWaitMs, waitMs);
+      s.totalHoldMs += holdMs;
+      s.maxHoldMs = std::max(s.maxHoldMs, holdMs);
+
+      if (maxLongestHolds_ > 0 && (longestHolds_.size() < maxLongestHolds_ ||
+               holdMs > longestHolds_.back().holdMs))
+      {
+         Hold h;
+         h.module = module;
+         h.caller = caller;
+         h.context = context;
+         std::ostringstream thread;
+         thread << std::this_thread::get_id();
+         h.thread = thread.str();
+         h.waitMs = waitMs;
+         h.holdMs = holdMs;
+         auto pos = std::upper_bound(longestHolds_.begin(), longestHolds_.end(),
+               holdMs, [](double ms, const Hold& other)
+               { return ms > other.holdMs; });
+         longestHolds_.insert(pos, h);
+         if (longestHolds_.size() > maxLongestHolds_)
+            longestHolds_.pop_back();
+      }
+
+      if (summaryIntervalMs_ > 0.0 && summarySink_)
+      {
+         const Clock::time_point now = Clock::now();
+         if (std::chrono::duration<double, std::milli>(now - lastSummary_).count()
+               >= summaryIntervalMs_)
+         {
+            lastSummary_ = now;
+            summary = FormatSummaryLocked();
+            sink = summarySink_;
+         }
+      }
+   }
+   if (sink)
+      sink(summary);
+}
+
+
+std::vector<ModuleLockProfiler::Stats>
+ModuleLockProfiler::GetStats() const
+{
+   std::vector<Stats> result;
+   {
+      std::lock_guard<std::mutex> lock(mutex_);
+      for (const auto& entry : stats_)
+         result.push_back(entry.second);
+   }
+   std::stable_sort(result.begin(), result.end(),
+         [](const Stats& a, const Stats& b)
+         { return a.totalWaitMs > b.totalWaitMs; });
+   return result;
+}
+
+
+std::vector<ModuleLockProfiler::Hold>
+ModuleLockProfiler::GetLongestHolds() const
+{
+   std::lock_guard<std::mutex> lock(mutex_);
+   return longestHolds_;
+}
+
+
+std::string
+ModuleLockProfiler::FormatSummary() const
+{
+   std::lock_guard<std::mutex> lock(mutex_);
+   return FormatSummaryLocked();
+}
+
+
+std::string
+ModuleLockProfiler::FormatSummaryLocked() const
+{
+   std::vector<const Stats*> sorted;
+   for (const auto& entry : stats_)
+      sorted.push_back(&entry.second);
+   std::stable_sort(sorted.begin(), sorted.end(),
+         [](const Stats* a, const Stats* b)
+         { return a->totalWaitMs > b->totalWaitMs; });
+
+   std::ostringstream out;
+   out << std::fixed << std::setprecision(3);
+   out << "Module lock profile over " <<
+      std::chrono::duration<double>(Clock::now() - startTime_).count() <<
+      " s (module, caller, count, total/max wait ms, total/max hold ms):";
+   for (const Stats* s : sorted)
+   {
+      out << "\n  " << s->module << ", " << s->caller << ", " << s->count <<
+         ", " << s->totalWaitMs << "/" << s->maxWaitMs << ", " <<
+         s->totalHoldMs << "/" << s->maxHoldMs;
+   }
+   if (!longestHolds_.empty())
+   {
+      out << "\nLongest holds (hold ms, wait ms, thread, context):";
+      for (const Hold& h : longestHolds_)
+      {
+         out << "\n  " << h.holdMs << ", " << h.waitMs << ", " << h.thread <<
+            ", " << h.context;
+      }
+   }
+   return out.str();
+}
+
+
+void
+ModuleLockProfiler::Reset()
+{
+   std::lock_guard<std::mutex> lock(mutex_);
+   stats_.clear();
+   longestHolds_.clear();
+   startTime_ = Clock::now();
+   lastSummary_ = startTime_;
+}
+
+
+void
+ModuleLockProfiler::SetSummaryInterval(double intervalMs,
+      std::function<void(const std::string&)> sink)
+{
+   std::lock_guard<std::mutex> lock(mutex_);
+   summaryIntervalMs_ = intervalMs;
+   summarySink_ = sink;
+   lastSummary_ = Clock::now();
+}
+
+} // namespace mm
@@ -0,0 +1,118 @@
+// PROJECT:       Micro-Manager
+// SUBSYSTEM:     MMCore
+//
+// DESCRIPTION:   Wait and hold time statistics for device module locks
+//
+// LICENSE:       This file is distributed under the "Lesser GPL" (LGPL) license.
+//                License text is included with the source distribution.
+//
+//                This file is distributed in the hope that it will be useful,
+//                but WITHOUT ANY WARRANTY; without even the implied warranty
+//                of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+//
+//                IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+//                CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+//                INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES.
+
+#pragma once
+
+#include <chrono>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace mm
+{
+
+/// Collects how long threads wait for and hold device module locks.
+/**
+ * Statistics are kept per module and per calling function (the Core
+ * function that took the lock). The longest individual holds are also kept,
+ * together with the call context: the callers of all module locks held by
+ * the thread at the time, outermost first.
+ *
+ * All functions may be called from any thread.
+ */
+class ModuleLockProfiler /* final */
+{
+public:
+   typedef std::chrono::steady_clock Clock;
+
+   struct Stats
+   {
+      std::string module;
+      std::string caller;
+      unsigned long long count = 0;
+      double totalWaitMs = 0.0;
+      double maxWaitMs = 0.0;
+      double totalHoldMs = 0.0;
+      double maxHoldMs = 0.0;
+   };
+
+   struct Hold
+   {
+      std::string module;
+      std::string caller;
+      std::string context;
+      std::string thread;
+      double waitMs = 0.0;
+      double holdMs = 0.0;
+   };
+
+   explicit ModuleLockProfiler(size_t maxLongestHolds = 10);
+
+   ModuleLockProfiler(const ModuleLockProfiler&) = delete;
+   ModuleLockProfiler& operator=(const ModuleLockProfiler&) = delete;
+
+   /**
+    * \brief Maintain the calling thread's call context.
+    *
+    * Called when a module lock has been acquired and when it is about to be
+    * released. The caller must be a string with static storage duration.
+    */
+   static void EnterContext(const std::string& module, const char* caller);
+   static void LeaveContext();
+   static std::string CurrentContext();
+
+   /// True if a hold of this length would be among the longest holds.
+   bool IsLongestHold(double holdMs) const;
+
+   void Record(const std::string& module, const char* caller,
+         double waitMs, double holdMs, const std::string& context);
+
+   /// Statistics, by decreasing total wait time.
+   std::vector<Stats> GetStats() const;
+   /// The longest holds, longest first.
+   std::vector<Hold> GetLongestHolds() const;
+
+   std::string FormatSummary() const;
+   void Reset();
+
+   /**
+    * \brief Periodically pass a summary to a function.
+    *
+    * The summary is produced by the thread recording a lock use, once the
+    * interval has elapsed. An interval of zero disables the summaries.
+    */
+   void SetSummaryInterval(double intervalMs,
+         std::function<void(const std::string&)> sink);
+
+private:
+   std::string FormatSummaryLocked() const;
+
+   const size_t maxLongestHolds_;
+
+   mutable std::mutex mutex_;
+   std::map<std::pair<std::string, std::string>, Stats> stats_;
+   std::vector<Hold> longestHolds_; // Longest first
+   Clock::time_point startTime_;
+
+   double summaryIntervalMs_;
+   std::function<void(const std::string&)> summarySink_;
+   Clock::time_point lastSummary_;
+};
+
+} // namespace mm
@@ -0,0 +1,304 @@
+// PROJECT:       Micro-Manager
+// SUBSYSTEM:     MMCore
+//
+// DESCRIPTION:   Completion tracking for asynchronous device moves
+//
+// LICENSE:       This file is distributed under the "Lesser GPL" (LGPL) license.
+//                License text is included with the source distribution.
+//
+//                This file is distributed in the hope that it will be useful,
+//                but WITHOUT ANY WARRANTY; without even the implied warranty
+//                of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+//
+//                IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+//                CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+//                INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES.
+
+#include "MoveScheduler.h"
+
+#include "CoreUtils.h"
+
+#include <algorithm>
+#include <utility>
+
+namespace mm
+{
+
+MoveScheduler::MoveScheduler(long minIntervalMs, size_t maxFinishedMoves) :
+   minInterval_(std::chrono::milliseconds(std::max(1L, minIntervalMs))),
+   maxFinishedMoves_(maxFinishedMoves),
+   nextHandle_(1),
+   stopRequested_(false)
+{
+}
+
+
+MoveScheduler::~MoveScheduler()
+{
+   {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stopRequested_ = true;
+      FinishAll(nullptr, "Move scheduler shut down");
+   }
+   pollCondVar_.notify_all();
+   if (thread_.joinable())
+      thread_.join();
+}
+
+
+long
+MoveScheduler::Add(const std::string& deviceLabel, BusyFunction isBusy,
+      long timeoutMs, long maxIntervalMs)
+{
+   std::shared_ptr<Move> move = std::make_shared<Move>();
+   move->handle = 0;
+   move->label = deviceLabel;
+   move->isBusy = isBusy;
+   move->timeoutMs = timeoutMs;
+   move->polling = false;
+   move->notified = false;
+   move->done = false;
+
+   const Clock::time_point now = Clock::now();
+   move->deadline = now + std::chrono::milliseconds(timeoutMs);
+   move->interval = minInterval_;
+   move->maxInterval = std::max<Clock::duration>(minInterval_,
+         std::chrono::milliseconds(maxIntervalMs));
+   move->nextPoll = now + move->interval;
+
+   long handle;
+   {
+      std::lock_guard<std::mutex> lock(mutex_);
+      EnsureThreadStarted();
+      handle = nextHandle_++;
+      move->handle = handle;
+      moves_.insert(std::make_pair(handle, move));
+   }
+   pollCondVar_.notify_all();
+   return handle;
+}
+
+
+void
+MoveScheduler::Notify(const std::string& deviceLabel)
+{
+   bool found = false;
+   {
+      std::lock_guard<std::mutex> lock(mutex_);
+      const Clock::time_point now = Clock::now();
+      for (auto& entry : moves_)
+      {
+         Move& move = *entry.second;
+         if (move.done || move.label != deviceLabel)
+            continue;
+         // If a poll is in progress, its result may predate the event, so
+         // make sure we poll again right after it.
+         move.notified = true;
+         move.nextPoll = now;
+         move.interval = minInterval_;
+         found = true;
+      }
+   }
+   if (found)
+      pollCondVar_.notify_all();
+}
+
+
+void
+MoveScheduler::Cancel(const std::string& deviceLabel)
+{
+   std::lock_guard<std::mutex> lock(mutex_);
+   FinishAll(&deviceLabel, "Device " + ToQuotedString(deviceLabel) +
+         " was unloaded while moving");
+}
+
+
+bool
+MoveScheduler::IsDone(long handle)
+{
+   std::lock_guard<std::mutex> lock(mutex_);
+   if (moves_.count(handle))
+      return false;
+   if (finished_.count(handle))
+      return true;
+   throw CMMError("No such move handle: " + ToString(handle));
+}
+
+
+void
+MoveScheduler::Wait(const std::vector<long>& handles)
+{
+   std::unique_lock<std::mutex> lock(mutex_);
+   std::vector<std::shared_ptr<Move>> waited;
+   for (long handle : handles)
+   {
+      auto it = moves_.find(handle);
+      if (it != moves_.end())
+      {
+         waited.push_back(it->second);
+         continue;
+      }
+      it = finished_.find(handle);
+      if (it == finished_.end())
+         throw CMMError("No such move handle: " + ToString(handle));
+      waited.push_back(it->second);
+   }
+
+   doneCondVar_.wait(lock, [&] {
+      return std::all_of(waited.begin(), waited.end(),
+            [](const std::shared_ptr<Move>& m) { return m->done; });
+   });
+
+   for (long handle : handles)
+   {
+      moves_.erase(handle);
+      finished_.erase(handle);
+   }
+
+   for (const auto& move : waited)
+   {
+      if (move->error)
+         throw CMMError(*move->error);
+   }
+}
+
+
+size_t
+MoveScheduler::GetPendingCount() const
+{
+   std::lock_guard<std::mutex> lock(mutex_);
+   return moves_.size();
+}
+
+
+void
+MoveScheduler::EnsureThreadStarted()
+{
+   // Called with mutex_ held
+   if (!thread_.joinable())
+      thread_ = std::thread(&MoveScheduler::ThreadFunc, this);
+}
+
+
+void
+MoveScheduler::Finish(Move& move, std::unique_ptr<CMMError> error)
+{
+   // Called with mutex_ held
+   move.done = true;
+   move.error = std::move(error);
+   move.isBusy = BusyFunction(); // Release whatever the function holds
+   doneCondVar_.notify_all();
+
+   // The caller may never call IsDone() or Wait(), so stop tracking the move
+   // here and keep only a bounded number of results. Waiters hold their own
+   // references, so eviction does not affect a Wait() in progress.
+   auto it = moves_.find(move.handle);
+   if (it != moves_.end())
+   {
+      finished_.insert(*it);
+      moves_.erase(it);
+   }
+   while (finished_.size() > maxFinishedMoves_)
+      finished_.erase(finished_.begin());
+}
+
+
+void
+MoveScheduler::FinishAll(const std::string* deviceLabel,
+      const std::string& message)
+{
+   // Called with mutex_ held
+   std::vector<std::shared_ptr<Move>> toFinish;
+   for (auto& entry : moves_)
+   {
+      if (!deviceLabel || entry.second->label == *deviceLabel)
+         toFinish.push_back(entry.second);
+   }
+   for (const auto& move : toFinish)
+      Finish(*move, std::unique_ptr<CMMError>(new CMMError(message)));
+}
+
+
+void
+MoveScheduler::ThreadFunc()
+{
+   std::unique_lock<std::mutex> lock(mutex_);
+   while (!stopRequested_)
+   {
+      // Pick the pending move that is most overdue for polling
+      std::shared_ptr<Move> next;
+      for (auto& entry : moves_)
+      {
+         const std::shared_ptr<Move>& move = entry.second;
+         if (move->done || move->polling)
+            continue;
+         if (!next || move->nextPoll < next->nextPoll)
+            next = move;
+      }
+
+      if (!next)
+      {
+         pollCondVar_.wait(lock);
+         continue;
+      }
+      if (next->nextPoll > Clock::now())
+      {
+         pollCondVar_.wait_until(lock, next->nextPoll);
+         continue;
+      }
+
+      next->polling = true;
+      next->notified = false;
+      BusyFunction isBusy = next->isBusy;
+      lock.unlock();
+
+      bool busy = false;
+      std::unique_ptr<CMMError> error;
+      try
+      {
+         busy = isBusy();
+      }
+      catch (const CMMError& e)
+      {
+         error.reset(new CMMError(e));
+      }
+      catch (const std::exception& e)
+      {
+         error.reset(new CMMError(e.what()));
+      }
+
+      lock.lock();
+      Move& move = *next;
+      move.polling = false;
+      if (move.done) // Canceled while polling
+         continue;
+
+      const Clock::time_point now = Clock::now();
+      if (error)
+      {
+         Finish(move, std::move(error));
+      }
+      else if (!busy)
+      {
+         Finish(move, std::unique_ptr<CMMError>());
+      }
+      else if (now > move.deadline)
+      {
+         Finish(move, std::unique_ptr<CMMError>(new CMMError(
+                     "Wait for device " + ToQuotedString(move.label) +
+                     " timed out after " + ToString(move.timeoutMs) + "ms",
+                     MMERR_DevicePollingTimeout)));
+      }
+      else if (move.notified)
+      {
+         move.nextPoll = now;
+      }
+      else
+      {
+         move.interval = std::min(2 * move.interval, move.maxInterval);
+         move.nextPoll = now + move.interval;
+      }
+   }
+}
+
+} // namespace mm
@@ -0,0 +1,151 @@
+// PROJECT:       Micro-Manager
+// SUBSYSTEM:     MMCore
+//
+// DESCRIPTION:   Completion tracking for asynchronous device moves
+//
+// LICENSE:       This file is distributed under the "Lesser GPL" (LGPL) license.
+//                License text is included with the source distribution.
+//
+//                This file is distributed in the hope that it will be useful,
+//                but WITHOUT ANY WARRANTY; without even the implied warranty
+//                of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+//
+//                IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+//                CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+//                INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES.
+
+#pragma once
+
+#include "Error.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace mm
+{
+
+/// Tracks in-flight device moves and detects their completion.
+/**
+ * A single scheduler thread busy-polls all registered moves, so that callers
+ * can start several moves and then wait for all of them at once. Each move is
+ * first polled after minIntervalMs and then at exponentially increasing
+ * intervals up to its maximum polling interval, so that short moves are
+ * detected with low latency without increasing the polling load for long
+ * moves.
+ *
+ * Devices that report their position (or other state changes) through the
+ * Core callback can shortcut the wait: Notify() causes all moves of the given
+ * device to be polled immediately.
+ *
+ * The scheduler does not know about devices; the busy function passed to
+ * Add() is responsible for acquiring the module lock. It must not be called
+ * (and is not called) with the scheduler's internal mutex held, so it is safe
+ * for the device to call back into Notify() from Busy().
+ *
+ * Moves that are never passed to Wait() (including fire-and-forget moves that
+ * are never polled with IsDone() either) do not accumulate: a finished move is
+ * no longer tracked by the scheduler thread, and its result is kept only among
+ * the most recent maxFinishedMoves finished moves that have not been waited
+ * for.
+ */
+class MoveScheduler /* final */
+{
+public:
+   /// Returns true while the move is in progress; may throw CMMError.
+   typedef std::function<bool ()> BusyFunction;
+
+   explicit MoveScheduler(long minIntervalMs = 1,
+         size_t maxFinishedMoves = 1000);
+   ~MoveScheduler();
+
+   MoveScheduler(const MoveScheduler&) = delete;
+   MoveScheduler& operator=(const MoveScheduler&) = delete;
+
+   /**
+    * \brief Register a move that has been started on a device.
+    *
+    * \return a handle to be passed to IsDone() and Wait().
+    */
+   long Add(const std::string& deviceLabel, BusyFunction isBusy,
+         long timeoutMs, long maxIntervalMs);
+
+   /**
+    * \brief Poll all pending moves of the device as soon as possible.
+    */
+   void Notify(const std::string& deviceLabel);
+
+   /**
+    * \brief Complete all pending moves of the device with an error.
+    *
+    * Used when the device is about to be unloaded.
+    */
+   void Cancel(const std::string& deviceLabel);
+
+   /**
+    * \brief Return whether the move has finished (successfully or not).
+    *
+    * The handle of a finished move can still be passed to IsDone() or Wait()
+    * (to obtain any error) until it is evicted by later finished moves.
+    */
+   bool IsDone(long handle);
+
+   /**
+    * \brief Block until all the given moves have finished.
+    *
+    * The handles are released on return, whether or not an error is thrown.
+    * If any of the moves failed or timed out, the error of the first such
+    * move (in the order given) is thrown after all moves have finished.
+    */
+   void Wait(const std::vector<long>& handles);
+
+   /**
+    * \brief Return the number of moves that have not yet finished.
+    */
+   size_t GetPendingCount() const;
+
+private:
+   typedef std::chrono::steady_clock Clock;
+
+   struct Move
+   {
+      long handle;
+      std::string label;
+      BusyFunction isBusy;
+      Clock::time_point deadline;
+      Clock::time_point nextPoll;
+      Clock::duration interval;
+      Clock::duration maxInterval;
+      long timeoutMs;
+      bool polling; // Busy() currently being called by scheduler thread
+      bool notified; // Notify() called since last poll started
+      bool done;
+      std::unique_ptr<CMMError> error;
+   };
+
+   void ThreadFunc();
+   void Finish(Move& move, std::unique_ptr<CMMError> error);
+   void FinishAll(const std::string* deviceLabel, const std::string& message);
+   void EnsureThreadStarted();
+
+   const Clock::duration minInterval_;
+   const size_t maxFinishedMoves_;
+
+   mutable std::mutex mutex_;
+   std::condition_variable pollCondVar_; // Wakes scheduler thread
+   std::condition_variable doneCondVar_; // Wakes waiters
+   std::map<long, std::shared_ptr<Move>> moves_; // Not yet finished
+   // Finished moves not yet waited for; oldest handles evicted first
+   std::map<long, std::shared_ptr<Move>> finished_;
+   long nextHandle_;
+   bool stopRequested_;
+   std::thread thread_;
+};
+
+} // namespace mm
@@ -0,0 +1,204 @@
+// PROJECT:       Micro-Manager
+// SUBSYSTEM:     MMCore
+//
+// DESCRIPTION:   Bit packing of 16-bit pixels with fewer significant bits
+//
+// LICENSE:       This file is distributed under the "Lesser GPL" (LGPL) license.
+//                License text is included with the source distribution.
+//
+//                This file is distributed in the hope that it will be useful,
+//                but WITHOUT ANY WARRANTY; without even the implied warranty
+//                of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+//
+//                IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+//                CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+//                INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES.
+
+#include "PixelPacking.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace mm
+{
+
+namespace
+{
+
+const std::size_t GroupPixels = 4;
+
+bool IsLittleEndian()
+{
+   const std::uint16_t one = 1;
+   unsigned char first;
+   std::memcpy(&first, &one, 1);
+   return first == 1;
+}
+
+// Pack a group given as 4 16-bit lanes (pixel i in bits 16i to 16i + 15),
+// with bitwise operations on the whole word ("SIMD within a register"), so
+// that no vectorizing compiler is needed
+template <unsigned Bits>
+inline std::uint64_t PackLanes(std::uint64_t lanes, std::size_t& saturated)
+{
+   const std::uint64_t laneMask = (1u << Bits) - 1;
+   const std::uint64_t valueBits = laneMask * 0x0001000100010001ull;
+   const std::uint64_t laneLowBits = 0x7fff7fff7fff7fffull;
+
+   // Saturate: the top bit of each lane of nonzero is set if the lane has any
+   // bit set above the bit depth
+   const std::uint64_t excess = lanes & ~valueBits;
+   const std::uint64_t nonzero =
+      (excess | ((excess & laneLowBits) + laneLowBits)) & ~laneLowBits;
+   lanes = (lanes | ((nonzero >> 15) * 0xffff)) & valueBits;
+   // Sum the saturation flags of the 4 lanes into the top lane
+   saturated += static_cast<std::size_t>(
+         ((nonzero >> 15) * 0x0001000100010001ull) >> 48);
+
+   return (lanes & laneMask) |
+      ((lanes >> (16 - Bits)) & (laneMask << Bits)) |
+      ((lanes >> (32 - 2 * Bits)) & (laneMask << (2 * Bits))) |
+      ((lanes >> (48 - 3 * Bits)) & (laneMask << (3 * Bits)));
+}
+
+template <unsigned Bits>
+inline std::uint64_t PackGroup(const std::uint16_t* src, std::size_t& saturated)
+{
+   std::uint64_t lanes = 0;
+   for (unsigned i = 0; i < GroupPixels; ++i)
+      lanes |= static_cast<std::uint64_t>(src[i]) << (16 * i);
+   return PackLanes<Bits>(lanes, saturated);
+}
+
+template <unsigned Bits>
+inline std::uint64_t UnpackLanes(std::uint64_t word)
+{
+   const std::uint64_t laneMask = (1u << Bits) - 1;
+   return (word & laneMask) |
+      ((word << (16 - Bits)) & (laneMask << 16)) |
+      ((word << (32 - 2 * Bits)) & (laneMask << 32)) |
+      ((word << (48 - 3 * Bits)) & (laneMask << 48));
+}
+
+template <unsigned Bits>
+inline void UnpackGroup(std::uint64_t word, std::uint16_t* dst)
+{
+   const std::uint64_t mask = (1u << Bits) - 1;
+   for (unsigned i = 0; i < GroupPixels; ++i)
+      dst[i] = static_cast<std::uint16_t>((word >> (i * Bits)) & mask);
+}
+
+// Each group is packed into a 64-bit word. On little-endian hosts, all but
+// the last group are stored and loaded as whole words (the stores overlap, and
+// each writes past its group into the next one, which is written next); the
+// byte-wise path keeps the layout independent of the host byte order.
+template <unsigned Bits>
+std::size_t Pack(const std::uint16_t* src, std::size_t pixelCount,
+      unsigned char* dst)
+{
+   std::size_t saturated = 0;
+   const std::size_t groups = pixelCount / GroupPixels;
+   std::size_t g = 0;
+   if (IsLittleEndian())
+   {
+      for (; g + 1 < groups; ++g)
+      {
+         std::uint64_t lanes;
+         std::memcpy(&lanes, src + g * GroupPixels, sizeof(lanes));
+         const std::uint64_t word = PackLanes<Bits>(lanes, saturated);
+         std::memcpy(dst + g * (Bits / 2), &word, sizeof(word));
+      }
+   }
+
+   std::uint16_t last[GroupPixels] = {};
+   const std::size_t groupsWithTail = (pixelCount + GroupPixels - 1) / GroupPixels;
+   for (; g < groupsWithTail; ++g)
+   {
+      const std::uint16_t* pixels = src + g * GroupPixels;
+      if (g == groups)
+      {
+         std::copy(pixels, src + pixelCount, last);
+         pixels = last;
+      }
+      const std::uint64_t word = PackGroup<Bits>(pixels, saturated);
+      for (unsigned b = 0; b < Bits / 2; ++b)
+         dst[g * (Bits / 2) + b] = static_cast<unsigned char>(word >> (8 * b));
+   }
+   return saturated;
+}
+
+template <unsigned Bits>
+void Unpack(const unsigned char* src, std::size_t pixelCount,
+      std::uint16_t* dst)
+{
+   const std::size_t groups = pixelCount / GroupPixels;
+   std::size_t g = 0;
+   if (IsLittleEndian())
+   {
+      for (; g + 1 < groups; ++g)
+      {
+         std::uint64_t word;
+         std::memcpy(&word, src + g * (Bits / 2), sizeof(word));
+         const std::uint64_t lanes = UnpackLanes<Bits>(word);
+         std::memcpy(dst + g * GroupPixels, &lanes, sizeof(lanes));
+      }
+   }
+
+   const std::size_t groupsWithTail = (pixelCount + GroupPixels - 1) / GroupPixels;
+   for (; g < groupsWithTail; ++g)
+   {
+      std::uint64_t word = 0;
+      for (unsigned b = 0; b < Bits / 2; ++b)
+         word |= static_cast<std::uint64_t>(src[g * (Bits / 2) + b]) << (8 * b);
+      std::uint16_t pixels[GroupPixels];
+      UnpackGroup<Bits>(word, pixels);
+      const std::size_t n = std::min(GroupPixels, pixelCount - g * GroupPixels);
+      std::copy(pixels, pixels + n, dst + g * GroupPixels);
+   }
+}
+
+} // anonymous namespace
+
+
+bool
+IsPackableBitDepth(unsigned bitDepth)
+{
+   return bitDepth == 10 || bitDepth == 12 || bitDepth == 14;
+}
+
+
+std::size_t
+PackedSize(std::size_t pixelCount, unsigned bitDepth)
+{
+   const std::size_t groups = (pixelCount + GroupPixels - 1) / GroupPixels;
+   return groups * (bitDepth / 2);
+}
+
+
+std::size_t
+PackPixels(const std::uint16_t* src, std::size_t pixelCount,
+      unsigned bitDepth, unsigned char* dst)
+{
+   switch (bitDepth)
+   {
+      case 10: return Pack<10>(src, pixelCount, dst);
+      case 12: return Pack<12>(src, pixelCount, dst);
+      case 14: return Pack<14>(src, pixelCount, dst);
+   }
+   return 0;
+}
+
+
+void
+UnpackPixels(const unsigned char* src, std::size_t pixelCount,
+      unsigned bitDepth, std::uint16_t* dst)
+{
+   switch (bitDepth)
+   {
+      case 10: Unpack<10>(src, pixelCount, dst); break;
+      case 12: Unpack<12>(src, pixelCount, dst); break;
+      case 14: Unpack<14>(src, pixelCount, dst); break;
+   }
+}
+
+} // namespace mm
@@ -0,0 +1,44 @@
+// PROJECT:       Micro-Manager
+// SUBSYSTEM:     MMCore
+//
+// DESCRIPTION:   Bit packing of 16-bit pixels with fewer significant bits
+//
+// LICENSE:       This file is distributed under the "Lesser GPL" (LGPL) license.
+//                License text is included with the source distribution.
+//
+//                This file is distributed in the hope that it will be useful,
+//                but WITHOUT ANY WARRANTY; without even the implied warranty
+//                of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+//
+//                IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+//                CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+//                INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace mm
+{
+
+/*
+ * 16-bit pixels of 10, 12 or 14 significant bits are stored as a little-endian
+ * bit stream, in groups of 4 pixels (5, 6 or 7 bytes). The last group is
+ * padded with zero pixels. Pixel values that do not fit in the bit depth are
+ * saturated when packing.
+ */
+
+bool IsPackableBitDepth(unsigned bitDepth);
+
+/// Bytes needed to store pixelCount packed pixels.
+std::size_t PackedSize(std::size_t pixelCount, unsigned bitDepth);
+
+/// Returns the number of pixels that were saturated.
+std::size_t PackPixels(const std::uint16_t* src, std::size_t pixelCount,
+      unsigned bitDepth, unsigned char* dst);
+
+void UnpackPixels(const unsigned char* src, std::size_t pixelCount,
+      unsigned bitDepth, std::uint16_t* dst);
+
+} // namespace mm
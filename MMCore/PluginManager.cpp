@@ -176,6 +176,53 @@ CPluginManager::UnloadPluginLibrary(const char* moduleName)
 }
 
 
+std::shared_ptr<LoadedDeviceAdapter>
+CPluginManager::ReloadDeviceAdapter(const std::string& moduleName)
+{
+   std::map< std::string, std::shared_ptr<LoadedDeviceAdapter> >::iterator it =
+      moduleMap_.find(moduleName);
+   if (it == moduleMap_.end())
+      throw CMMError("No device adapter named " + ToQuotedString(moduleName));
+
+   // Device instances hold a reference to their module
+   if (it->second.use_count() > 1)
+      throw CMMError("Cannot reload device adapter " +
+            ToQuotedString(moduleName) + " while it is in use");
+
+   try
+   {
+      it->second->Unload();
+   }
+   catch (const CMMError& e)
+   {
+      throw CMMError("Cannot unload device adapter " + ToQuotedString(moduleName), e);
+   }
+   MockDeviceAdapter* mock = it->second->GetMock();
+   moduleMap_.erase(it);
+
+   if (mock)
+   {
+      LoadMockAdapter(moduleName, mock);
+      return moduleMap_[moduleName];
+   }
+   return GetDeviceAdapter(moduleName);
+}
+
+
+void
+CPluginManager::LoadMockAdapter(const std::string& moduleName,
+      MockDeviceAdapter* implementation)
+{
+   if (moduleName.empty())
+      throw CMMError("Empty device adapter module name");
+   if (moduleMap_.count(moduleName))
+      throw CMMError("Device adapter " + ToQuotedString(moduleName) +
+            " is already loaded");
+   moduleMap_[moduleName] =
+      std::make_shared<LoadedDeviceAdapter>(moduleName, implementation);
+}
+
+
 // TODO Use std::filesystem instead of this.
 // This stop-gap implementation makes the assumption that the argument is in
 // the format that could be returned from MMCorePrivate::GetPathOfThisModule()
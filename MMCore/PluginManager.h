@@ -30,6 +30,13 @@
 #include <vector>
 
 class LoadedDeviceAdapter;
+class MockDeviceAdapter;
+
+namespace mm {
+namespace test {
+   class CoreTestAccess;
+}
+}
 
 
 class CPluginManager /* final */
@@ -40,6 +47,13 @@ public:
 
    void UnloadPluginLibrary(const char* moduleName);
 
+   /**
+    * Unload a module and load it again from its file, which may have been
+    * replaced. No devices from the module may remain loaded.
+    */
+   std::shared_ptr<LoadedDeviceAdapter>
+   ReloadDeviceAdapter(const std::string& moduleName);
+
    // Device adapter search paths
    template <typename TStringIter>
    void SetSearchPaths(TStringIter begin, TStringIter end)
@@ -56,6 +70,15 @@ public:
    GetDeviceAdapter(const char* moduleName);
 
 private:
+   friend class mm::test::CoreTestAccess; // Unit tests only
+
+   /**
+    * Register a device adapter implemented by the caller under the given
+    * module name, which must not already be in use. For unit tests only.
+    */
+   void LoadMockAdapter(const std::string& moduleName,
+         MockDeviceAdapter* implementation);
+
    static std::vector<std::string> GetDefaultSearchPaths();
    static void GetModules(std::vector<std::string> &modules, const char *path);
    std::string FindInSearchPath(std::string filename);
@@ -0,0 +1,99 @@
+// PROJECT:       Micro-Manager
+// SUBSYSTEM:     MMCore
+//
+// DESCRIPTION:   Tracks image processing of snapped images
+//
+// LICENSE:       This file is distributed under the "Lesser GPL" (LGPL) license.
+//                License text is included with the source distribution.
+//
+//                This file is distributed in the hope that it will be useful,
+//                but WITHOUT ANY WARRANTY; without even the implied warranty
+//                of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+//
+//                IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+//                CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+//                INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES.
+
+#include "ProcessedImageTracker.h"
+
+namespace mm
+{
+
+ProcessedImageTracker::ProcessedImageTracker() :
+   generation_(1),
+   copyEnabled_(false)
+{
+}
+
+
+void
+ProcessedImageTracker::NewSnap()
+{
+   std::lock_guard<std::mutex> lock(mutex_);
+   ++generation_;
+   if (generation_ == 0) // Reserved for "not processed"
+      generation_ = 1;
+}
+
+
+unsigned long
+ProcessedImageTracker::GetGeneration() const
+{
+   std::lock_guard<std::mutex> lock(mutex_);
+   return generation_;
+}
+
+
+void
+ProcessedImageTracker::SetCopyEnabled(bool enable)
+{
+   std::lock_guard<std::mutex> lock(mutex_);
+   copyEnabled_ = enable;
+}
+
+
+bool
+ProcessedImageTracker::IsCopyEnabled() const
+{
+   std::lock_guard<std::mutex> lock(mutex_);
+   return copyEnabled_;
+}
+
+
+unsigned char*
+ProcessedImageTracker::Get(std::shared_ptr<const void> camera,
+      std::shared_ptr<const void> processor, unsigned channel,
+      unsigned char* pixels, std::size_t size, ProcessFunction process)
+{
+   std::lock_guard<std::mutex> lock(mutex_);
+
+   if (camera_.lock() != camera || processor_.lock() != processor)
+   {
+      camera_ = camera;
+      processor_ = processor;
+      channels_.clear();
+   }
+   if (channels_.size() <= channel)
+      channels_.resize(channel + 1);
+   Channel& ch = channels_[channel];
+
+   if (ch.generation == generation_ && ch.source == pixels && ch.size == size)
+      return ch.copied ? ch.copy.data() : pixels;
+
+   ch.generation = 0;
+   ch.copied = copyEnabled_ && size > 0;
+   ch.source = pixels;
+   ch.size = size;
+   unsigned char* target = pixels;
+   if (ch.copied)
+   {
+      ch.copy.assign(pixels, pixels + size);
+      target = ch.copy.data();
+   }
+
+   process(target);
+   ch.generation = generation_;
+   return target;
+}
+
+} // namespace mm
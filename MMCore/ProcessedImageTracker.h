@@ -0,0 +1,104 @@
+// PROJECT:       Micro-Manager
+// SUBSYSTEM:     MMCore
+//
+// DESCRIPTION:   Tracks image processing of snapped images
+//
+// LICENSE:       This file is distributed under the "Lesser GPL" (LGPL) license.
+//                License text is included with the source distribution.
+//
+//                This file is distributed in the hope that it will be useful,
+//                but WITHOUT ANY WARRANTY; without even the implied warranty
+//                of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+//
+//                IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+//                CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+//                INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES.
+
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace mm
+{
+
+/// Ensures that each snapped image is processed exactly once.
+/**
+ * The camera's image buffer is identified by a snap generation, which is
+ * incremented by NewSnap() whenever the camera may have written a new image:
+ * at each snap, and for each frame inserted by the camera during a sequence
+ * acquisition (the camera's buffer then typically holds the latest frame,
+ * at an unchanged address). Get() runs the image processor on each channel at most once per generation,
+ * so that retrieving the same snapped image repeatedly neither repeats the
+ * processing cost nor applies a non-idempotent processor twice.
+ *
+ * The image is processed either in place, in the camera's buffer, or (if copy
+ * is enabled) in a copy owned by the tracker, leaving the camera's buffer
+ * untouched. The mode in which an image was processed is kept until the next
+ * snap.
+ *
+ * A change of camera or processor discards the processing state, so that the
+ * image is processed again (in place, this means on top of the result of the
+ * previous processor).
+ */
+class ProcessedImageTracker /* final */
+{
+public:
+   /// Processes the pixels in place; may throw.
+   typedef std::function<void (unsigned char* pixels)> ProcessFunction;
+
+   ProcessedImageTracker();
+
+   ProcessedImageTracker(const ProcessedImageTracker&) = delete;
+   ProcessedImageTracker& operator=(const ProcessedImageTracker&) = delete;
+
+   /// Start a new generation: all channels need processing again. Called
+   /// for each snap and each inserted frame.
+   void NewSnap();
+   unsigned long GetGeneration() const;
+
+   void SetCopyEnabled(bool enable);
+   bool IsCopyEnabled() const;
+
+   /**
+    * \brief Return the processed image for a channel, processing it if this
+    * has not been done for the current generation.
+    *
+    * camera and processor identify the devices (they are only compared, and
+    * not kept alive). pixels and size describe the camera's image buffer; a
+    * change of either is treated like a new snap for that channel.
+    *
+    * Concurrent calls are serialized, so that a second caller waits for the
+    * processing to finish instead of repeating it. If the process function
+    * throws, the exception propagates and the image is processed again by the
+    * next call.
+    *
+    * \return pixels if the image was processed in place; otherwise the copy,
+    * which stays valid until the channel is processed again.
+    */
+   unsigned char* Get(std::shared_ptr<const void> camera,
+         std::shared_ptr<const void> processor, unsigned channel,
+         unsigned char* pixels, std::size_t size, ProcessFunction process);
+
+private:
+   struct Channel
+   {
+      unsigned long generation = 0; // 0 if not processed
+      bool copied = false;
+      const unsigned char* source = nullptr;
+      std::size_t size = 0;
+      std::vector<unsigned char> copy;
+   };
+
+   mutable std::mutex mutex_;
+   unsigned long generation_;
+   bool copyEnabled_;
+   std::weak_ptr<const void> camera_;
+   std::weak_ptr<const void> processor_;
+   std::vector<Channel> channels_;
+};
+
+} // namespace mm
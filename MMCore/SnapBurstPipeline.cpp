@@ -0,0 +1,163 @@
+// PROJECT:       Micro-Manager
+// SUBSYSTEM:     MMCore
+//
+// DESCRIPTION:   Overlapping the copying out of snapped images with the
+//                exposure of the next one
+//
+// LICENSE:       This file is distributed under the "Lesser GPL" (LGPL) license.
+//                License text is included with the source distribution.
+//
+//                This file is distributed in the hope that it will be useful,
+//                but WITHOUT ANY WARRANTY; without even the implied warranty
+//                of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+//
+//                IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+//                CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+//                INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES.
+
+#include "SnapBurstPipeline.h"
+
+#include "../MMDevice/MMDeviceConstants.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace mm
+{
+
+SnapBurstPipeline::SnapBurstPipeline(std::size_t numSlots) :
+   slots_(numSlots)
+{
+}
+
+SnapBurstPipeline::~SnapBurstPipeline()
+{
+   {
+      std::lock_guard<std::mutex> lock(mutex_);
+      finishing_ = true;
+      if (error_ == DEVICE_OK)
+         error_ = DEVICE_ERR; // Discard what is left
+   }
+   cv_.notify_all();
+   if (thread_.joinable())
+      thread_.join();
+}
+
+void SnapBurstPipeline::Start(InsertFunction insert)
+{
+   insert_ = insert;
+   for (Slot& slot : slots_)
+      slot.full = false;
+   nextPush_ = nextInsert_ = 0;
+   finishing_ = false;
+   error_ = DEVICE_OK;
+   if (!slots_.empty())
+      thread_ = std::thread([this] { ThreadFunc(); });
+}
+
+int SnapBurstPipeline::Push(long imageIndex,
+      const std::vector<const unsigned char*>& channels,
+      std::size_t channelBytes)
+{
+   if (slots_.empty())
+   {
+      // Insert in place, as the images would be without the pipeline
+      for (unsigned channel = 0;
+            error_ == DEVICE_OK && channel < channels.size(); ++channel)
+      {
+         error_ = CallInsert(imageIndex, channel,
+               const_cast<unsigned char*>(channels[channel]));
+      }
+      return error_;
+   }
+
+   Slot* slot;
+   {
+      std::unique_lock<std::mutex> lock(mutex_);
+      cv_.wait(lock, [this] {
+            return error_ != DEVICE_OK || !slots_[nextPush_].full; });
+      if (error_ != DEVICE_OK)
+         return error_;
+      slot = &slots_[nextPush_];
+   }
+
+   // The copy thread does not touch a slot that is not full, so it can be
+   // filled without holding the mutex. Buffers keep their capacity.
+   slot->imageIndex = imageIndex;
+   slot->channels.resize(channels.size());
+   for (std::size_t i = 0; i < channels.size(); ++i)
+   {
+      slot->channels[i].resize(channelBytes);
+      std::memcpy(slot->channels[i].data(), channels[i], channelBytes);
+   }
+
+   {
+      std::lock_guard<std::mutex> lock(mutex_);
+      slot->full = true;
+      nextPush_ = (nextPush_ + 1) % slots_.size();
+   }
+   cv_.notify_all();
+   return DEVICE_OK;
+}
+
+int SnapBurstPipeline::Finish()
+{
+   {
+      std::lock_guard<std::mutex> lock(mutex_);
+      finishing_ = true;
+   }
+   cv_.notify_all();
+   if (thread_.joinable())
+      thread_.join();
+   insert_ = nullptr;
+   return error_;
+}
+
+void SnapBurstPipeline::ThreadFunc()
+{
+   for (;;)
+   {
+      Slot* slot;
+      {
+         std::unique_lock<std::mutex> lock(mutex_);
+         cv_.wait(lock, [this] {
+               return slots_[nextInsert_].full || finishing_ ||
+                  error_ != DEVICE_OK; });
+         if (error_ != DEVICE_OK || !slots_[nextInsert_].full)
+            return; // Error, or finishing with nothing left
+         slot = &slots_[nextInsert_];
+      }
+
+      int ret = DEVICE_OK;
+      for (unsigned channel = 0;
+            ret == DEVICE_OK && channel < slot->channels.size(); ++channel)
+      {
+         ret = CallInsert(slot->imageIndex, channel,
+               slot->channels[channel].data());
+      }
+
+      {
+         std::lock_guard<std::mutex> lock(mutex_);
+         slot->full = false;
+         nextInsert_ = (nextInsert_ + 1) % slots_.size();
+         if (ret != DEVICE_OK && error_ == DEVICE_OK)
+            error_ = ret;
+      }
+      cv_.notify_all();
+   }
+}
+
+int SnapBurstPipeline::CallInsert(long imageIndex, unsigned channel,
+      unsigned char* pixels)
+{
+   try
+   {
+      return insert_(imageIndex, channel, pixels);
+   }
+   catch (...)
+   {
+      return DEVICE_ERR;
+   }
+}
+
+} // namespace mm
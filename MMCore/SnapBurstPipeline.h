@@ -0,0 +1,103 @@
+// PROJECT:       Micro-Manager
+// SUBSYSTEM:     MMCore
+//
+// DESCRIPTION:   Overlapping the copying out of snapped images with the
+//                exposure of the next one
+//
+// LICENSE:       This file is distributed under the "Lesser GPL" (LGPL) license.
+//                License text is included with the source distribution.
+//
+//                This file is distributed in the hope that it will be useful,
+//                but WITHOUT ANY WARRANTY; without even the implied warranty
+//                of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+//
+//                IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+//                CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+//                INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES.
+
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace mm
+{
+
+/// Double-buffered hand-off of snapped images to a copy thread.
+/**
+ * The snapping thread copies each image out of the camera into a free slot
+ * with Push(), which only costs a memcpy, and can then start the next
+ * exposure. A copy thread, started by Start() and stopped by Finish(),
+ * passes the slots, in order, to the insert function (which adds metadata,
+ * processes the image and copies it into the circular buffer), and frees
+ * them. Push() blocks while all slots are in use.
+ *
+ * The slots keep their memory when the pipeline is started again, so that a
+ * burst does not pay for allocating (and faulting in) image-sized buffers.
+ * With no slots, Push() calls the insert function itself, with the camera's
+ * pixels; this avoids the extra copy where there is no second CPU to overlap
+ * it with.
+ * Start(), Push() and Finish() must be called from a single thread.
+ *
+ * The insert function is called on the copy thread with the slot's pixels,
+ * which it may modify. Once it has returned an error (or thrown, which counts
+ * as DEVICE_ERR), the remaining images are discarded, and Push() and
+ * Finish() return that error.
+ */
+class SnapBurstPipeline /* final */
+{
+public:
+   /// Insert one channel of an image; return DEVICE_OK or an error code.
+   typedef std::function<int (long imageIndex, unsigned channel,
+         unsigned char* pixels)> InsertFunction;
+
+private:
+   struct Slot
+   {
+      bool full = false;
+      long imageIndex = 0;
+      std::vector< std::vector<unsigned char> > channels;
+   };
+
+   InsertFunction insert_;
+
+   std::mutex mutex_;
+   std::condition_variable cv_;
+   std::vector<Slot> slots_;
+   std::size_t nextPush_ = 0;
+   std::size_t nextInsert_ = 0;
+   bool finishing_ = false;
+   int error_ = 0;
+
+   std::thread thread_;
+
+public:
+   explicit SnapBurstPipeline(std::size_t numSlots = 2);
+   /// Discards images not yet inserted.
+   ~SnapBurstPipeline();
+
+   SnapBurstPipeline(const SnapBurstPipeline&) = delete;
+   SnapBurstPipeline& operator=(const SnapBurstPipeline&) = delete;
+
+   /// Start the copy thread for a burst; the pipeline must not be running.
+   void Start(InsertFunction insert);
+
+   /// Copy the channels of an image (each of channelBytes) into a free slot.
+   /** Returns DEVICE_OK, or the first error returned by the insert function. */
+   int Push(long imageIndex, const std::vector<const unsigned char*>& channels,
+         std::size_t channelBytes);
+
+   /// Wait until all pushed images are inserted and stop the copy thread.
+   /** Returns DEVICE_OK, or the first error returned by the insert function. */
+   int Finish();
+
+private:
+   void ThreadFunc();
+   int CallInsert(long imageIndex, unsigned channel, unsigned char* pixels);
+};
+
+} // namespace mm
@@ -0,0 +1,302 @@
+// PROJECT:       Micro-Manager
+// SUBSYSTEM:     MMCore
+//
+// DESCRIPTION:   Binning and cropping of camera images in software
+//
+// LICENSE:       This file is distributed under the "Lesser GPL" (LGPL) license.
+//                License text is included with the source distribution.
+//
+//                This file is distributed in the hope that it will be useful,
+//                but WITHOUT ANY WARRANTY; without even the implied warranty
+//                of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+//
+//                IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+//                CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+//                INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES.
+
+#include "SoftwareBinning.h"
+
+#include "Error.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <sstream>
+
+namespace mm
+{
+
+namespace
+{
+
+template <typename T, typename Acc>
+T ToPixel(Acc sum, Acc count, bool average)
+{
+   if (average)
+      return static_cast<T>((sum + count / 2) / count);
+   return static_cast<T>(std::min<Acc>(sum, std::numeric_limits<T>::max()));
+}
+
+template <>
+float ToPixel<float, double>(double sum, double count, bool average)
+{
+   return static_cast<float>(average ? sum / count : sum);
+}
+
+// The rows of each bin are first summed into a row of accumulators, a
+// contiguous loop that compilers vectorize; each bin is then reduced from the
+// accumulator row.
+template <typename T, typename Acc>
+void ReduceSamples(const T* src, unsigned width, unsigned components,
+      unsigned x0, unsigned y0, unsigned binning, bool average,
+      unsigned outWidth, unsigned outHeight, T* dst)
+{
+   const std::size_t outRowLen = static_cast<std::size_t>(outWidth) *
+      components;
+   if (binning == 1)
+   {
+      for (unsigned y = 0; y < outHeight; ++y)
+      {
+         std::memcpy(dst + y * outRowLen,
+               src + (static_cast<std::size_t>(y0 + y) * width + x0) *
+               components, outRowLen * sizeof(T));
+      }
+      return;
+   }
+
+   const std::size_t rowLen = outRowLen * binning;
+   const Acc count = static_cast<Acc>(binning) * binning;
+   std::vector<Acc> acc(rowLen);
+   for (unsigned oy = 0; oy < outHeight; ++oy)
+   {
+      std::fill(acc.begin(), acc.end(), Acc(0));
+      for (unsigned k = 0; k < binning; ++k)
+      {
+         const T* row = src + (static_cast<std::size_t>(y0 + oy * binning + k) *
+               width + x0) * components;
+         Acc* a = acc.data();
+         for (std::size_t i = 0; i < rowLen; ++i)
+            a[i] += row[i];
+      }
+
+      T* out = dst + oy * outRowLen;
+      for (unsigned ox = 0; ox < outWidth; ++ox)
+      {
+         const Acc* bin = acc.data() +
+            static_cast<std::size_t>(ox) * binning * components;
+         for (unsigned c = 0; c < components; ++c)
+         {
+            Acc sum = 0;
+            for (unsigned j = 0; j < binning; ++j)
+               sum += bin[j * components + c];
+            out[ox * components + c] = ToPixel<T, Acc>(sum, count, average);
+         }
+      }
+   }
+}
+
+void GetCropRect(const SoftwareBinning::Settings& settings, unsigned width,
+      unsigned height, unsigned& x, unsigned& y, unsigned& w, unsigned& h)
+{
+   if (!settings.cropped)
+   {
+      x = y = 0;
+      w = width;
+      h = height;
+      return;
+   }
+   if (settings.cropX >= width || settings.cropY >= height ||
+         settings.cropWidth > width - settings.cropX ||
+         settings.cropHeight > height - settings.cropY)
+   {
+      std::ostringstream msg;
+      msg << "Software crop rectangle (" << settings.cropX << ", " <<
+         settings.cropY << ", " << settings.cropWidth << ", " <<
+         settings.cropHeight << ") does not fit in the camera image (" <<
+         width << " x " << height << ")";
+      throw CMMError(msg.str());
+   }
+   x = settings.cropX;
+   y = settings.cropY;
+   w = settings.cropWidth;
+   h = settings.cropHeight;
+}
+
+} // anonymous namespace
+
+
+SoftwareBinning::SoftwareBinning() :
+   settingsVersion_(1),
+   cameraComponents_(1)
+{
+}
+
+
+void
+SoftwareBinning::SetBinning(unsigned binning, bool average)
+{
+   std::lock_guard<std::mutex> lock(mutex_);
+   settings_.binning = binning;
+   settings_.average = average;
+   ++settingsVersion_;
+}
+
+
+void
+SoftwareBinning::SetCrop(unsigned x, unsigned y, unsigned width,
+      unsigned height)
+{
+   std::lock_guard<std::mutex> lock(mutex_);
+   settings_.cropped = true;
+   settings_.cropX = x;
+   settings_.cropY = y;
+   settings_.cropWidth = width;
+   settings_.cropHeight = height;
+   ++settingsVersion_;
+}
+
+
+void
+SoftwareBinning::ClearCrop()
+{
+   std::lock_guard<std::mutex> lock(mutex_);
+   settings_.cropped = false;
+   settings_.cropX = settings_.cropY = 0;
+   settings_.cropWidth = settings_.cropHeight = 0;
+   ++settingsVersion_;
+}
+
+
+SoftwareBinning::Settings
+SoftwareBinning::GetSettings() const
+{
+   std::lock_guard<std::mutex> lock(mutex_);
+   return settings_;
+}
+
+
+bool
+SoftwareBinning::IsActive() const
+{
+   std::lock_guard<std::mutex> lock(mutex_);
+   return settings_.IsActive();
+}
+
+
+void
+SoftwareBinning::SetCameraComponents(unsigned components)
+{
+   std::lock_guard<std::mutex> lock(mutex_);
+   cameraComponents_ = components;
+}
+
+
+unsigned
+SoftwareBinning::GetCameraComponents() const
+{
+   std::lock_guard<std::mutex> lock(mutex_);
+   return cameraComponents_;
+}
+
+
+void
+SoftwareBinning::GetOutputSize(const Settings& settings, unsigned width,
+      unsigned height, unsigned& outWidth, unsigned& outHeight)
+{
+   unsigned x, y, w, h;
+   GetCropRect(settings, width, height, x, y, w, h);
+   const unsigned binning = std::max(1u, settings.binning);
+   outWidth = w / binning;
+   outHeight = h / binning;
+   if (outWidth == 0 || outHeight == 0)
+   {
+      std::ostringstream msg;
+      msg << "Image of " << w << " x " << h <<
+         " pixels is too small for software binning of " << binning;
+      throw CMMError(msg.str());
+   }
+}
+
+
+bool
+SoftwareBinning::IsSupportedFormat(unsigned bytesPerPixel,
+      unsigned components)
+{
+   if (components == 1)
+      return bytesPerPixel == 1 || bytesPerPixel == 2 || bytesPerPixel == 4;
+   if (components == 4)
+      return bytesPerPixel == 4 || bytesPerPixel == 8;
+   return false;
+}
+
+
+void
+SoftwareBinning::Reduce(const Settings& settings, const unsigned char* src,
+      unsigned width, unsigned height, unsigned bytesPerPixel,
+      unsigned components, unsigned char* dst)
+{
+   if (!IsSupportedFormat(bytesPerPixel, components))
+   {
+      std::ostringstream msg;
+      msg << "Software binning does not support images with " <<
+         bytesPerPixel << " bytes per pixel and " << components <<
+         " components";
+      throw CMMError(msg.str());
+   }
+
+   unsigned x, y, w, h;
+   GetCropRect(settings, width, height, x, y, w, h);
+   unsigned outWidth, outHeight;
+   GetOutputSize(settings, width, height, outWidth, outHeight);
+   const unsigned binning = std::max(1u, settings.binning);
+   const bool average = settings.average;
+
+   switch (bytesPerPixel / components)
+   {
+      case 1:
+         ReduceSamples<std::uint8_t, std::uint32_t>(src, width, components,
+               x, y, binning, average, outWidth, outHeight, dst);
+         break;
+      case 2:
+         ReduceSamples<std::uint16_t, std::uint32_t>(
+               reinterpret_cast<const std::uint16_t*>(src), width, components,
+               x, y, binning, average, outWidth, outHeight,
+               reinterpret_cast<std::uint16_t*>(dst));
+         break;
+      case 4:
+         ReduceSamples<float, double>(reinterpret_cast<const float*>(src),
+               width, components, x, y, binning, average, outWidth, outHeight,
+               reinterpret_cast<float*>(dst));
+         break;
+   }
+}
+
+
+const unsigned char*
+SoftwareBinning::ReduceSnapped(unsigned long generation, unsigned channel,
+      const unsigned char* pixels, unsigned width, unsigned height,
+      unsigned bytesPerPixel, unsigned components)
+{
+   std::lock_guard<std::mutex> lock(mutex_);
+   if (snapped_.size() <= channel)
+      snapped_.resize(channel + 1);
+   SnappedChannel& ch = snapped_[channel];
+   if (ch.generation == generation && ch.settingsVersion == settingsVersion_ &&
+         ch.source == pixels)
+      return ch.reduced.data();
+
+   unsigned outWidth, outHeight;
+   GetOutputSize(settings_, width, height, outWidth, outHeight);
+   ch.generation = 0;
+   ch.reduced.resize(static_cast<std::size_t>(outWidth) * outHeight *
+         bytesPerPixel);
+   Reduce(settings_, pixels, width, height, bytesPerPixel, components,
+         ch.reduced.data());
+   ch.generation = generation;
+   ch.settingsVersion = settingsVersion_;
+   ch.source = pixels;
+   return ch.reduced.data();
+}
+
+} // namespace mm
@@ -0,0 +1,119 @@
+// PROJECT:       Micro-Manager
+// SUBSYSTEM:     MMCore
+//
+// DESCRIPTION:   Binning and cropping of camera images in software
+//
+// LICENSE:       This file is distributed under the "Lesser GPL" (LGPL) license.
+//                License text is included with the source distribution.
+//
+//                This file is distributed in the hope that it will be useful,
+//                but WITHOUT ANY WARRANTY; without even the implied warranty
+//                of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+//
+//                IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+//                CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+//                INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES.
+
+#pragma once
+
+#include <mutex>
+#include <vector>
+
+namespace mm
+{
+
+/// Reduces camera images by cropping and NxN binning before they are stored.
+/**
+ * The crop rectangle is given in pixels of the image delivered by the camera
+ * (that is, after any hardware binning and ROI), and is applied before
+ * binning. Rows and columns left over when the (cropped) size is not a
+ * multiple of the binning factor are dropped.
+ *
+ * Binned pixels are either the sum or the mean of the NxN source pixels,
+ * computed with a wider accumulator; sums that exceed the range of the pixel
+ * type saturate. Supported pixel formats are 8- and 16-bit grayscale, 32-bit
+ * floating point grayscale, and 32- and 64-bit RGB (each component is binned
+ * separately).
+ *
+ * All functions may be called from any thread.
+ */
+class SoftwareBinning /* final */
+{
+public:
+   static const unsigned MaxBinning = 64;
+
+   struct Settings
+   {
+      unsigned binning = 1;
+      bool average = true;
+      bool cropped = false;
+      unsigned cropX = 0;
+      unsigned cropY = 0;
+      unsigned cropWidth = 0;
+      unsigned cropHeight = 0;
+
+      bool IsActive() const { return binning > 1 || cropped; }
+   };
+
+   SoftwareBinning();
+
+   SoftwareBinning(const SoftwareBinning&) = delete;
+   SoftwareBinning& operator=(const SoftwareBinning&) = delete;
+
+   void SetBinning(unsigned binning, bool average);
+   void SetCrop(unsigned x, unsigned y, unsigned width, unsigned height);
+   void ClearCrop();
+   Settings GetSettings() const;
+   bool IsActive() const;
+
+   /**
+    * \brief Set the number of components of images whose inserter does not
+    * give it (recorded from the camera when the buffer is initialized).
+    */
+   void SetCameraComponents(unsigned components);
+   unsigned GetCameraComponents() const;
+
+   /// Compute the reduced size; throws CMMError if the crop does not fit.
+   static void GetOutputSize(const Settings& settings, unsigned width,
+         unsigned height, unsigned& outWidth, unsigned& outHeight);
+
+   static bool IsSupportedFormat(unsigned bytesPerPixel, unsigned components);
+
+   /**
+    * \brief Reduce a single image into dst, which must hold the image of the
+    * size given by GetOutputSize().
+    *
+    * Throws CMMError if the crop does not fit or the format is not supported.
+    */
+   static void Reduce(const Settings& settings, const unsigned char* src,
+         unsigned width, unsigned height, unsigned bytesPerPixel,
+         unsigned components, unsigned char* dst);
+
+   /**
+    * \brief Reduce a snapped image, at most once per snap generation and
+    * channel.
+    *
+    * \return the reduced image, which stays valid until the channel is
+    * reduced again.
+    */
+   const unsigned char* ReduceSnapped(unsigned long generation,
+         unsigned channel, const unsigned char* pixels, unsigned width,
+         unsigned height, unsigned bytesPerPixel, unsigned components);
+
+private:
+   struct SnappedChannel
+   {
+      unsigned long generation = 0;
+      unsigned long settingsVersion = 0;
+      const unsigned char* source = nullptr;
+      std::vector<unsigned char> reduced;
+   };
+
+   mutable std::mutex mutex_;
+   Settings settings_;
+   unsigned long settingsVersion_;
+   unsigned cameraComponents_;
+   std::vector<SnappedChannel> snapped_;
+};
+
+} // namespace mm
@@ -0,0 +1,206 @@
+// PROJECT:       Micro-Manager
+// SUBSYSTEM:     MMCore
+//
+// DESCRIPTION:   Versioned log of system state changes
+//
+// LICENSE:       This file is distributed under the "Lesser GPL" (LGPL) license.
+//                License text is included with the source distribution.
+//
+//                This file is distributed in the hope that it will be useful,
+//                but WITHOUT ANY WARRANTY; without even the implied warranty
+//                of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+//
+//                IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+//                CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+//                INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES.
+
+#include "StateLog.h"
+
+#include "Error.h"
+
+#include <algorithm>
+
+namespace mm
+{
+
+StateLog::StateLog(std::size_t maxChanges, std::size_t snapshotInterval) :
+   maxChanges_(std::max<std::size_t>(1, maxChanges)),
+   snapshotInterval_(std::max<std::size_t>(1, snapshotInterval)),
+   version_(0),
+   baseVersion_(0),
+   frameDeltasEnabled_(false)
+{
+}
+
+
+long
+StateLog::Record(const std::string& device, const std::string& property,
+      const std::string& value, bool readOnly)
+{
+   std::lock_guard<std::mutex> lock(mutex_);
+   Key key(device, property);
+   auto it = current_.find(key);
+   if (it != current_.end() && it->second.first == value)
+      return version_;
+   current_[key] = Value(value, readOnly);
+
+   ++version_;
+   Change change;
+   change.key = key;
+   change.value = Value(value, readOnly);
+   changes_.push_back(change);
+   if (version_ % static_cast<long>(snapshotInterval_) == 0)
+      snapshots_[version_] = current_;
+
+   while (changes_.size() > maxChanges_)
+   {
+      const Change& oldest = changes_.front();
+      baseState_[oldest.key] = oldest.value;
+      changes_.pop_front();
+      ++baseVersion_;
+   }
+   snapshots_.erase(snapshots_.begin(), snapshots_.upper_bound(baseVersion_));
+   return version_;
+}
+
+
+long
+StateLog::GetVersion() const
+{
+   std::lock_guard<std::mutex> lock(mutex_);
+   return version_;
+}
+
+
+long
+StateLog::GetOldestVersion() const
+{
+   std::lock_guard<std::mutex> lock(mutex_);
+   return baseVersion_;
+}
+
+
+std::vector<StateLog::Setting>
+StateLog::GetStateAt(long version) const
+{
+   std::lock_guard<std::mutex> lock(mutex_);
+   if (version > version_)
+   {
+      throw CMMError("State version " + std::to_string(version) +
+            " does not exist (current version is " +
+            std::to_string(version_) + ")");
+   }
+   if (version < baseVersion_)
+   {
+      throw CMMError("State version " + std::to_string(version) +
+            " is no longer available (oldest available is " +
+            std::to_string(baseVersion_) + ")");
+   }
+   if (version == version_)
+      return ToSettings(current_);
+
+   long start = baseVersion_;
+   const StateMap* startState = &baseState_;
+   auto snapshot = snapshots_.upper_bound(version);
+   if (snapshot != snapshots_.begin())
+   {
+      --snapshot;
+      start = snapshot->first;
+      startState = &snapshot->second;
+   }
+
+   StateMap state = *startState;
+   for (long v = start + 1; v <= version; ++v)
+   {
+      const Change& change = changes_[v - baseVersion_ - 1];
+      state[change.key] = change.value;
+   }
+   return ToSettings(state);
+}
+
+
+long
+StateLog::GetChangesSince(long version, std::vector<Setting>& changes) const
+{
+   std::lock_guard<std::mutex> lock(mutex_);
+   return GetChangesSinceLocked(version, changes);
+}
+
+
+long
+StateLog::TakeFrameDelta(const std::string& camera,
+      std::vector<Setting>& changes)
+{
+   std::lock_guard<std::mutex> lock(mutex_);
+   auto it = lastFrameVersions_.find(camera);
+   const long since = (it == lastFrameVersions_.end()) ? -1 : it->second;
+   const long version = GetChangesSinceLocked(since, changes);
+   lastFrameVersions_[camera] = version;
+   return version;
+}
+
+
+void
+StateLog::ResetFrameDeltas()
+{
+   std::lock_guard<std::mutex> lock(mutex_);
+   lastFrameVersions_.clear();
+}
+
+
+void
+StateLog::EnableFrameDeltas(bool enable)
+{
+   std::lock_guard<std::mutex> lock(mutex_);
+   frameDeltasEnabled_ = enable;
+   lastFrameVersions_.clear();
+}
+
+
+bool
+StateLog::IsFrameDeltaEnabled() const
+{
+   std::lock_guard<std::mutex> lock(mutex_);
+   return frameDeltasEnabled_;
+}
+
+
+long
+StateLog::GetChangesSinceLocked(long version,
+      std::vector<Setting>& changes) const
+{
+   changes.clear();
+   if (version >= version_)
+      return version_;
+   if (version < baseVersion_)
+   {
+      changes = ToSettings(current_);
+      return version_;
+   }
+
+   StateMap changed;
+   for (std::size_t i = version - baseVersion_; i < changes_.size(); ++i)
+      changed[changes_[i].key] = changes_[i].value;
+   changes = ToSettings(changed);
+   return version_;
+}
+
+
+std::vector<StateLog::Setting>
+StateLog::ToSettings(const StateMap& state)
+{
+   std::vector<Setting> settings;
+   settings.reserve(state.size());
+   for (const auto& entry : state)
+   {
+      Setting s;
+      s.device = entry.first.first;
+      s.property = entry.first.second;
+      s.value = entry.second.first;
+      s.readOnly = entry.second.second;
+      settings.push_back(s);
+   }
+   return settings;
+}
+
+} // namespace mm
@@ -0,0 +1,132 @@
+// PROJECT:       Micro-Manager
+// SUBSYSTEM:     MMCore
+//
+// DESCRIPTION:   Versioned log of system state changes
+//
+// LICENSE:       This file is distributed under the "Lesser GPL" (LGPL) license.
+//                License text is included with the source distribution.
+//
+//                This file is distributed in the hope that it will be useful,
+//                but WITHOUT ANY WARRANTY; without even the implied warranty
+//                of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+//
+//                IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+//                CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+//                INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES.
+
+#pragma once
+
+#include <deque>
+#include <map>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace mm
+{
+
+/// Records changes of device property values (and similar settings) with a
+/// version number, so that the state at any recent version can be rebuilt.
+/**
+ * The version starts at 0 (nothing known) and is incremented by each
+ * recorded change; recording a value that is already current does not create
+ * a version. Only the most recent changes are kept; the state at older
+ * versions can no longer be rebuilt. Snapshots of the full state are taken at
+ * regular intervals, so that rebuilding the state only replays the changes
+ * since the nearest snapshot.
+ *
+ * The log also tracks, for each camera, the version at which its previous
+ * frame was taken, so that each frame can be given the changes since then.
+ *
+ * All functions may be called from any thread.
+ */
+class StateLog /* final */
+{
+public:
+   struct Setting
+   {
+      std::string device;
+      std::string property;
+      std::string value;
+      // Not a settable device property (e.g. a reported stage position)
+      bool readOnly = false;
+   };
+
+   explicit StateLog(std::size_t maxChanges = 10000,
+         std::size_t snapshotInterval = 500);
+
+   StateLog(const StateLog&) = delete;
+   StateLog& operator=(const StateLog&) = delete;
+
+   /// Record a value; returns the version after the change.
+   long Record(const std::string& device, const std::string& property,
+         const std::string& value, bool readOnly = false);
+
+   long GetVersion() const;
+   /// The oldest version whose state can be rebuilt.
+   long GetOldestVersion() const;
+
+   /**
+    * \brief Get the state at a version, sorted by device and property.
+    *
+    * Throws CMMError if the version is in the future or no longer kept.
+    */
+   std::vector<Setting> GetStateAt(long version) const;
+
+   /**
+    * \brief Get the current value of each setting changed after a version.
+    *
+    * If the changes since the version are no longer kept, the full current
+    * state is returned. Returns the current version.
+    */
+   long GetChangesSince(long version, std::vector<Setting>& changes) const;
+
+   /**
+    * \brief Get the changes since the previous call for the same camera (the
+    * full state on the first call). Returns the current version.
+    */
+   long TakeFrameDelta(const std::string& camera,
+         std::vector<Setting>& changes);
+
+   /// Forget the previous frame of every camera.
+   void ResetFrameDeltas();
+
+   /**
+    * \brief Enable or disable frame deltas (disabled by default); also
+    * forgets the previous frame of every camera.
+    */
+   void EnableFrameDeltas(bool enable);
+   bool IsFrameDeltaEnabled() const;
+
+private:
+   typedef std::pair<std::string, std::string> Key;
+   typedef std::pair<std::string, bool> Value; // Value and read-only flag
+   typedef std::map<Key, Value> StateMap;
+
+   struct Change
+   {
+      Key key;
+      Value value;
+   };
+
+   long GetChangesSinceLocked(long version,
+         std::vector<Setting>& changes) const;
+   static std::vector<Setting> ToSettings(const StateMap& state);
+
+   const std::size_t maxChanges_;
+   const std::size_t snapshotInterval_;
+
+   mutable std::mutex mutex_;
+   long version_;
+   StateMap current_;
+   // Changes of versions baseVersion_ + 1 to version_
+   std::deque<Change> changes_;
+   long baseVersion_;
+   StateMap baseState_;
+   std::map<long, StateMap> snapshots_;
+   bool frameDeltasEnabled_;
+   std::map<std::string, long> lastFrameVersions_;
+};
+
+} // namespace mm
@@ -0,0 +1,126 @@
+///////////////////////////////////////////////////////////////////////////////
+// FILE:          TaskSet_PackPixels.cpp
+// PROJECT:       Micro-Manager
+// SUBSYSTEM:     MMCore
+//-----------------------------------------------------------------------------
+// DESCRIPTION:   Task set for parallelized bit packing of 16-bit pixels.
+//
+// LICENSE:       This file is distributed under the "Lesser GPL" (LGPL) license.
+//                License text is included with the source distribution.
+//
+//                This file is distributed in the hope that it will be useful,
+//                but WITHOUT ANY WARRANTY; without even the implied warranty
+//                of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+//
+//                IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+//                CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+//                INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES.
+
+#include "TaskSet_PackPixels.h"
+
+#include "PixelPacking.h"
+
+#include <algorithm>
+#include <cassert>
+
+namespace {
+
+// Chunks are split at multiples of this many pixels, so that each chunk
+// starts at a byte boundary of the packed data
+const size_t chunkAlignment = 4;
+
+} // namespace
+
+TaskSet_PackPixels::ATask::ATask(std::shared_ptr<Semaphore> semDone, size_t taskIndex, size_t totalTaskCount)
+    : Task(semDone, taskIndex, totalTaskCount)
+{
+}
+
+void TaskSet_PackPixels::ATask::SetUp(unsigned char* dst, const std::uint16_t* src,
+    size_t pixelCount, unsigned bitDepth, size_t usedTaskCount)
+{
+    dst_ = dst;
+    src_ = src;
+    pixelCount_ = pixelCount;
+    bitDepth_ = bitDepth;
+    usedTaskCount_ = usedTaskCount;
+    saturated_ = 0;
+}
+
+void TaskSet_PackPixels::ATask::Execute()
+{
+    if (taskIndex_ >= usedTaskCount_)
+        return;
+
+    const size_t chunkPixels = pixelCount_ / usedTaskCount_ / chunkAlignment * chunkAlignment;
+    const size_t chunkOffset = taskIndex_ * chunkPixels;
+    size_t pixels = chunkPixels;
+    if (taskIndex_ == usedTaskCount_ - 1)
+        pixels = pixelCount_ - chunkOffset;
+
+    saturated_ = mm::PackPixels(src_ + chunkOffset, pixels, bitDepth_,
+        dst_ + mm::PackedSize(chunkOffset, bitDepth_));
+}
+
+TaskSet_PackPixels::TaskSet_PackPixels(std::shared_ptr<ThreadPool> pool)
+    : TaskSet(pool)
+{
+    CreateTasks<ATask>();
+}
+
+void TaskSet_PackPixels::SetUp(unsigned char* dst, const std::uint16_t* src,
+    size_t pixelCount, unsigned bitDepth)
+{
+    assert(dst);
+    assert(src);
+    assert(pixelCount > 0);
+
+    // Pack directly without threading for frames up to 1 MB, as for
+    // TaskSet_CopyMemory; otherwise add one thread for each 1 MB
+    usedTaskCount_ = std::min<size_t>(1 + pixelCount * 2 / 1000000, tasks_.size());
+    if (usedTaskCount_ <= 1)
+    {
+        usedTaskCount_ = 1;
+        directSaturated_ = mm::PackPixels(src, pixelCount, bitDepth, dst);
+        return;
+    }
+
+    for (Task* task : tasks_)
+        static_cast<ATask*>(task)->SetUp(dst, src, pixelCount, bitDepth, usedTaskCount_);
+}
+
+void TaskSet_PackPixels::Execute()
+{
+    if (usedTaskCount_ == 1)
+        return; // Already done in SetUp, nothing to execute
+
+    TaskSet::Execute();
+}
+
+void TaskSet_PackPixels::Wait()
+{
+    if (usedTaskCount_ == 1)
+        return; // Already done in SetUp, nothing to wait for
+
+    semaphore_->Wait(usedTaskCount_);
+}
+
+size_t TaskSet_PackPixels::SaturatedCount() const
+{
+    if (usedTaskCount_ == 1)
+        return directSaturated_;
+
+    size_t saturated = 0;
+    for (size_t i = 0; i < usedTaskCount_; ++i)
+        saturated += static_cast<const ATask*>(tasks_[i])->SaturatedCount();
+    return saturated;
+}
+
+size_t TaskSet_PackPixels::Pack(unsigned char* dst, const std::uint16_t* src,
+    size_t pixelCount, unsigned bitDepth)
+{
+    SetUp(dst, src, pixelCount, bitDepth);
+    Execute();
+    Wait();
+    return SaturatedCount();
+}
@@ -0,0 +1,67 @@
+///////////////////////////////////////////////////////////////////////////////
+// FILE:          TaskSet_PackPixels.h
+// PROJECT:       Micro-Manager
+// SUBSYSTEM:     MMCore
+//-----------------------------------------------------------------------------
+// DESCRIPTION:   Task set for parallelized bit packing of 16-bit pixels.
+//
+// LICENSE:       This file is distributed under the "Lesser GPL" (LGPL) license.
+//                License text is included with the source distribution.
+//
+//                This file is distributed in the hope that it will be useful,
+//                but WITHOUT ANY WARRANTY; without even the implied warranty
+//                of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+//
+//                IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+//                CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+//                INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES.
+
+#pragma once
+
+#include "TaskSet.h"
+
+#include <cstdint>
+
+class TaskSet_PackPixels : public TaskSet
+{
+private:
+    class ATask : public Task
+    {
+    public:
+        explicit ATask(std::shared_ptr<Semaphore> semDone, size_t taskIndex, size_t totalTaskCount);
+
+        void SetUp(unsigned char* dst, const std::uint16_t* src, size_t pixelCount,
+            unsigned bitDepth, size_t usedTaskCount);
+
+        virtual void Execute() override;
+
+        size_t SaturatedCount() const { return saturated_; }
+
+    private:
+        unsigned char* dst_{ nullptr };
+        const std::uint16_t* src_{ nullptr };
+        size_t pixelCount_{ 0 };
+        unsigned bitDepth_{ 0 };
+        size_t saturated_{ 0 };
+    };
+
+public:
+    explicit TaskSet_PackPixels(std::shared_ptr<ThreadPool> pool);
+
+    void SetUp(unsigned char* dst, const std::uint16_t* src, size_t pixelCount,
+        unsigned bitDepth);
+
+    virtual void Execute() override;
+    virtual void Wait() override;
+
+    // Number of pixels saturated by the last packing; valid after Wait
+    size_t SaturatedCount() const;
+
+    // Helper blocking method calling SetUp, Execute and Wait; returns the
+    // number of pixels that were saturated
+    size_t Pack(unsigned char* dst, const std::uint16_t* src, size_t pixelCount,
+        unsigned bitDepth);
+
+private:
+    size_t directSaturated_{ 0 }; // When packed without threading
+};
@@ -0,0 +1,158 @@
+// PROJECT:       Micro-Manager
+// SUBSYSTEM:     MMCore
+//
+// DESCRIPTION:   Stage positions of frames acquired during continuous XY
+//                scanning
+//
+// LICENSE:       This file is distributed under the "Lesser GPL" (LGPL) license.
+//                License text is included with the source distribution.
+//
+//                This file is distributed in the hope that it will be useful,
+//                but WITHOUT ANY WARRANTY; without even the implied warranty
+//                of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+//
+//                IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+//                CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+//                INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES.
+
+#include "XYScan.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace mm
+{
+
+XYScan::XYScan(const MM::Device* camera, const std::string& stageLabel,
+      long numImages) :
+   camera_(camera),
+   stageLabel_(stageLabel),
+   numImages_(numImages),
+   sequenced_(false),
+   xStart_(0.0),
+   yStart_(0.0),
+   xEnd_(0.0),
+   yEnd_(0.0),
+   speedUmPerS_(0.0),
+   frameTimeOffsetMs_(0.0),
+   frameCount_(0),
+   finished_(false)
+{
+}
+
+
+void
+XYScan::SetLinearTrajectory(double xStart, double yStart, double xEnd,
+      double yEnd, double speedUmPerS, Clock::time_point startTime,
+      double frameTimeOffsetMs)
+{
+   std::lock_guard<std::mutex> lock(mutex_);
+   sequenced_ = false;
+   xStart_ = xStart;
+   yStart_ = yStart;
+   xEnd_ = xEnd;
+   yEnd_ = yEnd;
+   speedUmPerS_ = speedUmPerS;
+   startTime_ = startTime;
+   frameTimeOffsetMs_ = frameTimeOffsetMs;
+}
+
+
+void
+XYScan::SetSequencedPositions(const std::vector<double>& xs,
+      const std::vector<double>& ys)
+{
+   std::lock_guard<std::mutex> lock(mutex_);
+   sequenced_ = true;
+   xs_ = xs;
+   ys_ = ys;
+}
+
+
+double
+XYScan::GetDurationMs() const
+{
+   if (speedUmPerS_ <= 0.0)
+      return 0.0;
+   const double distance = std::hypot(xEnd_ - xStart_, yEnd_ - yStart_);
+   return 1000.0 * distance / speedUmPerS_;
+}
+
+
+void
+XYScan::PositionAt(Clock::time_point t, double& x, double& y) const
+{
+   const double durationMs = GetDurationMs();
+   const double elapsedMs =
+      std::chrono::duration<double, std::milli>(t - startTime_).count();
+   double fraction = 1.0;
+   if (durationMs > 0.0)
+      fraction = std::min(1.0, std::max(0.0, elapsedMs / durationMs));
+   x = xStart_ + fraction * (xEnd_ - xStart_);
+   y = yStart_ + fraction * (yEnd_ - yStart_);
+}
+
+
+bool
+XYScan::StampFrame(const MM::Device* camera, Clock::time_point received,
+      double& x, double& y)
+{
+   if (camera != camera_)
+      return false;
+
+   std::lock_guard<std::mutex> lock(mutex_);
+   if (finished_ || frameCount_ >= numImages_)
+      return false;
+   const long index = frameCount_++;
+
+   if (sequenced_)
+   {
+      if (index >= static_cast<long>(xs_.size()))
+         return false;
+      x = xs_[index];
+      y = ys_[index];
+      return true;
+   }
+
+   PositionAt(received - std::chrono::duration_cast<Clock::duration>(
+            std::chrono::duration<double, std::milli>(frameTimeOffsetMs_)),
+         x, y);
+   return true;
+}
+
+
+long
+XYScan::GetStampedFrameCount() const
+{
+   std::lock_guard<std::mutex> lock(mutex_);
+   return frameCount_;
+}
+
+
+void
+XYScan::Finish()
+{
+   std::lock_guard<std::mutex> lock(mutex_);
+   finished_ = true;
+}
+
+
+void
+XYScan::SampleLine(double xStart, double yStart, double xEnd, double yEnd,
+      double speedUmPerS, double intervalMs, long count,
+      std::vector<double>& xs, std::vector<double>& ys)
+{
+   xs.clear();
+   ys.clear();
+   const double distance = std::hypot(xEnd - xStart, yEnd - yStart);
+   for (long i = 0; i < count; ++i)
+   {
+      const double travelled = speedUmPerS * intervalMs * i / 1000.0;
+      const double fraction = (distance > 0.0) ?
+         std::min(1.0, travelled / distance) : 1.0;
+      xs.push_back(xStart + fraction * (xEnd - xStart));
+      ys.push_back(yStart + fraction * (yEnd - yStart));
+   }
+}
+
+} // namespace mm
@@ -0,0 +1,133 @@
+// PROJECT:       Micro-Manager
+// SUBSYSTEM:     MMCore
+//
+// DESCRIPTION:   Stage positions of frames acquired during continuous XY
+//                scanning
+//
+// LICENSE:       This file is distributed under the "Lesser GPL" (LGPL) license.
+//                License text is included with the source distribution.
+//
+//                This file is distributed in the hope that it will be useful,
+//                but WITHOUT ANY WARRANTY; without even the implied warranty
+//                of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+//
+//                IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+//                CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+//                INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES.
+
+#pragma once
+
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace MM
+{
+   class Device;
+}
+
+namespace mm
+{
+
+/// Assigns stage positions to the frames of a continuous XY scan.
+/**
+ * In a continuous scan the camera runs a sequence acquisition while the XY
+ * stage moves from the start to the end position without stopping. The
+ * position of each frame is either taken from the trajectory commanded to
+ * the stage (a straight line at constant speed, starting at a known time),
+ * evaluated at the time the frame was exposed, or, if the stage steps
+ * through a position sequence triggered by the camera, the sequence entry
+ * for the frame.
+ *
+ * Only the first numImages frames from the scanning camera are assigned a
+ * position.
+ */
+class XYScan /* final */
+{
+public:
+   typedef std::chrono::steady_clock Clock;
+
+   XYScan(const MM::Device* camera, const std::string& stageLabel,
+         long numImages);
+
+   XYScan(const XYScan&) = delete;
+   XYScan& operator=(const XYScan&) = delete;
+
+   const MM::Device* GetCamera() const { return camera_; }
+   std::string GetStageLabel() const { return stageLabel_; }
+
+   /// Speed property value to restore when the scan is stopped, if any.
+   void SetSavedSpeed(const std::string& value) { savedSpeed_ = value; }
+   std::string GetSavedSpeed() const { return savedSpeed_; }
+
+   /**
+    * \brief Use a constant-speed trajectory.
+    *
+    * frameTimeOffsetMs is subtracted from the time a frame is received to
+    * obtain the time at which it was exposed.
+    */
+   void SetLinearTrajectory(double xStart, double yStart, double xEnd,
+         double yEnd, double speedUmPerS, Clock::time_point startTime,
+         double frameTimeOffsetMs);
+
+   /// Use one position per frame (stage sequencing).
+   void SetSequencedPositions(const std::vector<double>& xs,
+         const std::vector<double>& ys);
+
+   bool IsSequenced() const { return sequenced_; }
+
+   /// Duration of the linear move, in milliseconds.
+   double GetDurationMs() const;
+
+   /// Position on the linear trajectory at the given time.
+   void PositionAt(Clock::time_point t, double& x, double& y) const;
+
+   /**
+    * \brief Assign a position to a frame received from a camera.
+    *
+    * \return false if the frame is not from the scanning camera, or if all
+    * numImages frames have already been assigned.
+    */
+   bool StampFrame(const MM::Device* camera, Clock::time_point received,
+         double& x, double& y);
+
+   long GetStampedFrameCount() const;
+
+   /// Stop assigning positions (when the camera sequence is stopped).
+   void Finish();
+
+   /**
+    * \brief Sample a straight line at constant speed.
+    *
+    * Computes the positions reached after 0, 1, ..., count - 1 intervals,
+    * stopping at the end position.
+    */
+   static void SampleLine(double xStart, double yStart, double xEnd,
+         double yEnd, double speedUmPerS, double intervalMs, long count,
+         std::vector<double>& xs, std::vector<double>& ys);
+
+private:
+   const MM::Device* const camera_;
+   const std::string stageLabel_;
+   const long numImages_;
+   std::string savedSpeed_;
+
+   bool sequenced_;
+   std::vector<double> xs_;
+   std::vector<double> ys_;
+
+   double xStart_;
+   double yStart_;
+   double xEnd_;
+   double yEnd_;
+   double speedUmPerS_;
+   Clock::time_point startTime_;
+   double frameTimeOffsetMs_;
+
+   mutable std::mutex mutex_;
+   long frameCount_;
+   bool finished_;
+};
+
+} // namespace mm
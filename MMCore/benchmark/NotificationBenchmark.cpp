@@ -0,0 +1,270 @@
+// PROJECT:       Micro-Manager
+// SUBSYSTEM:     MMCore
+//
+// DESCRIPTION:   Benchmark of device notification latency and throughput,
+//                using the NotificationTester (and optionally DemoCamera)
+//                device adapters
+//
+// LICENSE:       This file is distributed under the "Lesser GPL" (LGPL) license.
+//                License text is included with the source distribution.
+//
+//                This file is distributed in the hope that it will be useful,
+//                but WITHOUT ANY WARRANTY; without even the implied warranty
+//                of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+//
+//                IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+//                CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+//                INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES.
+
+// The NTSyncProperty device fires StormStamp notifications whose values carry
+// a sequence number and the steady_clock time at which the adapter called
+// OnPropertyChanged(). The latency measured here is from that call to the
+// MMEventCallback::onPropertyChanged() call in the application.
+//
+// Usage: NotificationBenchmark [--adapter-path DIR] [--count N]
+//                              [--rates HZ,HZ,...] [--camera]
+
+#include "MMCore.h"
+#include "MMEventCallback.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+const char* const stormDevice = "NTProp";
+const char* const cameraDevice = "Camera";
+
+class StampCollector : public MMEventCallback
+{
+   std::mutex mutex_;
+   std::vector<double> latenciesUs_;
+   std::vector<long> sequence_;
+   Clock::time_point first_;
+   Clock::time_point last_;
+
+public:
+   void Reset()
+   {
+      std::lock_guard<std::mutex> lock(mutex_);
+      latenciesUs_.clear();
+      sequence_.clear();
+   }
+
+   void onPropertyChanged(const char* name, const char* propName,
+         const char* propValue) override
+   {
+      const Clock::time_point now = Clock::now();
+      if (std::strcmp(name, stormDevice) != 0 ||
+            std::strcmp(propName, "StormStamp") != 0)
+         return;
+
+      char* end = nullptr;
+      const long seq = std::strtol(propValue, &end, 10);
+      if (!end || *end != ';')
+         return;
+      const long long ns = std::strtoll(end + 1, nullptr, 10);
+      const Clock::time_point sent{std::chrono::duration_cast<Clock::duration>(
+            std::chrono::nanoseconds(ns))};
+
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (sequence_.empty())
+         first_ = now;
+      last_ = now;
+      sequence_.push_back(seq);
+      latenciesUs_.push_back(
+            std::chrono::duration<double, std::micro>(now - sent).count());
+   }
+
+   // Silence the default implementations, which print
+   void onPropertiesChanged() override {}
+   void onChannelGroupChanged(const char*) override {}
+   void onConfigGroupChanged(const char*, const char*) override {}
+   void onSystemConfigurationLoaded() override {}
+   void onPixelSizeChanged(double) override {}
+   void onPixelSizeAffineChanged(double, double, double, double, double,
+         double) override {}
+   void onStagePositionChanged(char*, double) override {}
+   void onXYStagePositionChanged(char*, double, double) override {}
+   void onExposureChanged(char*, double) override {}
+   void onSLMExposureChanged(char*, double) override {}
+
+   void Report(const std::string& title, long expected)
+   {
+      std::lock_guard<std::mutex> lock(mutex_);
+
+      // Received notifications are dropped if never seen, duplicated (or
+      // coalesced into a later value, which then repeats), or reordered
+      std::vector<long> seen(sequence_);
+      std::sort(seen.begin(), seen.end());
+      const long unique = static_cast<long>(
+            std::unique(seen.begin(), seen.end()) - seen.begin());
+      long reordered = 0;
+      for (size_t i = 1; i < sequence_.size(); ++i)
+      {
+         if (sequence_[i] < sequence_[i - 1])
+            ++reordered;
+      }
+
+      std::vector<double> lat(latenciesUs_);
+      std::sort(lat.begin(), lat.end());
+      auto percentile = [&lat](double p) {
+         if (lat.empty())
+            return 0.0;
+         size_t rank = static_cast<size_t>(p / 100.0 * lat.size());
+         return lat[std::min(rank, lat.size() - 1)];
+      };
+
+      const double seconds =
+         std::chrono::duration<double>(last_ - first_).count();
+      const double throughput = (sequence_.size() > 1 && seconds > 0.0) ?
+         (sequence_.size() - 1) / seconds : 0.0;
+
+      std::printf("%s\n", title.c_str());
+      const long received = static_cast<long>(sequence_.size());
+      std::printf("  sent %ld, received %ld, dropped %ld, duplicated %ld, "
+            "reordered %ld\n", expected, received, expected - unique,
+            received - unique, reordered);
+      std::printf("  throughput %.0f/s\n", throughput);
+      std::printf("  latency us: p50 %.1f  p90 %.1f  p99 %.1f  p99.9 %.1f  "
+            "max %.1f\n", percentile(50.0), percentile(90.0),
+            percentile(99.0), percentile(99.9),
+            lat.empty() ? 0.0 : lat.back());
+   }
+};
+
+void RunStorm(CMMCore& core, StampCollector& collector, long count,
+      double rateHz)
+{
+   collector.Reset();
+   core.setProperty(stormDevice, "StormRate_Hz", rateHz);
+   core.setProperty(stormDevice, "StormCount", count);
+   core.waitForDevice(stormDevice);
+   // Allow for notifications delivered after the storm thread finished
+   std::this_thread::sleep_for(std::chrono::milliseconds(100));
+}
+
+// Pop images for the given duration; return frames per second
+double PopImages(CMMCore& core, std::chrono::milliseconds duration)
+{
+   long frames = 0;
+   const Clock::time_point start = Clock::now();
+   while (Clock::now() - start < duration)
+   {
+      if (core.getRemainingImageCount() > 0)
+      {
+         core.popNextImage();
+         ++frames;
+      }
+      else
+         std::this_thread::sleep_for(std::chrono::microseconds(200));
+   }
+   return frames / std::chrono::duration<double>(duration).count();
+}
+
+} // anonymous namespace
+
+int main(int argc, char* argv[])
+{
+   std::vector<std::string> adapterPaths;
+   long count = 10000;
+   std::vector<double> rates = { 1000.0, 10000.0, 100000.0 };
+   bool withCamera = false;
+
+   for (int i = 1; i < argc; ++i)
+   {
+      const std::string arg(argv[i]);
+      if (arg == "--adapter-path" && i + 1 < argc)
+         adapterPaths.push_back(argv[++i]);
+      else if (arg == "--count" && i + 1 < argc)
+         count = std::atol(argv[++i]);
+      else if (arg == "--rates" && i + 1 < argc)
+      {
+         rates.clear();
+         std::istringstream ss(argv[++i]);
+         std::string rate;
+         while (std::getline(ss, rate, ','))
+            rates.push_back(std::atof(rate.c_str()));
+      }
+      else if (arg == "--camera")
+         withCamera = true;
+      else
+      {
+         std::fprintf(stderr, "Usage: %s [--adapter-path DIR] [--count N] "
+               "[--rates HZ,HZ,...] [--camera]\n", argv[0]);
+         return 2;
+      }
+   }
+
+   try
+   {
+      CMMCore core;
+      core.enableStderrLog(false);
+      if (!adapterPaths.empty())
+         core.setDeviceAdapterSearchPaths(adapterPaths);
+
+      StampCollector collector;
+      core.registerCallback(&collector);
+
+      core.loadDevice(stormDevice, "NotificationTester", "NTSyncProperty");
+      if (withCamera)
+         core.loadDevice(cameraDevice, "DemoCamera", "DCam");
+      core.initializeAllDevices();
+
+      RunStorm(core, collector, 1000, 10000.0); // Warm up
+
+      for (double rate : rates)
+      {
+         RunStorm(core, collector, count, rate);
+         collector.Report("Storm of " + std::to_string(count) + " at " +
+               std::to_string(static_cast<long>(rate)) + " Hz", count);
+      }
+
+      if (withCamera)
+      {
+         core.setCameraDevice(cameraDevice);
+         core.setExposure(1.0);
+         core.startContinuousSequenceAcquisition(0.0);
+
+         const std::chrono::milliseconds duration(2000);
+         const double idleFps = PopImages(core, duration);
+
+         const double rate = rates.empty() ? 10000.0 : rates.back();
+         const long stormCount = static_cast<long>(
+               rate * std::chrono::duration<double>(duration).count());
+         collector.Reset();
+         core.setProperty(stormDevice, "StormRate_Hz", rate);
+         core.setProperty(stormDevice, "StormCount", stormCount);
+         const double stormFps = PopImages(core, duration);
+         core.waitForDevice(stormDevice);
+         std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+         core.stopSequenceAcquisition();
+
+         collector.Report("Storm of " + std::to_string(stormCount) + " at " +
+               std::to_string(static_cast<long>(rate)) +
+               " Hz during sequence acquisition", stormCount);
+         std::printf("Camera frame rate: %.1f fps idle, %.1f fps during "
+               "storm\n", idleFps, stormFps);
+      }
+
+      core.registerCallback(nullptr);
+      core.unloadAllDevices();
+   }
+   catch (const CMMError& e)
+   {
+      std::fprintf(stderr, "%s\n", e.getFullMsg().c_str());
+      return 1;
+   }
+   return 0;
+}
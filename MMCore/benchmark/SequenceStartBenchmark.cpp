@@ -0,0 +1,168 @@
+// PROJECT:       Micro-Manager
+// SUBSYSTEM:     MMCore
+//
+// DESCRIPTION:   Benchmark of the start-to-first-frame latency of short
+//                sequence acquisitions, unarmed and armed, using the
+//                DemoCamera device adapter
+//
+// LICENSE:       This file is distributed under the "Lesser GPL" (LGPL) license.
+//                License text is included with the source distribution.
+//
+//                This file is distributed in the hope that it will be useful,
+//                but WITHOUT ANY WARRANTY; without even the implied warranty
+//                of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+//
+//                IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+//                CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+//                INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES.
+
+// Runs many short bursts with startSequenceAcquisition() and then with
+// startArmedSequenceAcquisition(), with the DemoCamera shutter as the
+// auto-shutter. The latency is from the start call to the first image of the
+// burst being in the circular buffer. The camera's FastImage mode is used so
+// that the time is not dominated by generating the demo images. The demo
+// shutter opens instantly unless given a delay with --shutter-delay.
+//
+// Usage: SequenceStartBenchmark [--adapter-path DIR] [--bursts N]
+//                               [--images N] [--exposure MS]
+//                               [--shutter-delay MS]
+
+#include "MMCore.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+const char* const cameraDevice = "Camera";
+const char* const shutterDevice = "Shutter";
+
+void WaitForSequenceEnd(CMMCore& core)
+{
+   while (core.isSequenceRunning(cameraDevice))
+      std::this_thread::sleep_for(std::chrono::microseconds(100));
+   core.stopSequenceAcquisition(cameraDevice);
+}
+
+// Return the latency in microseconds
+double RunBurst(CMMCore& core, bool armed, long numImages)
+{
+   const long before = core.getRemainingImageCount();
+   const Clock::time_point start = Clock::now();
+   if (armed)
+      core.startArmedSequenceAcquisition(numImages, 0.0, true);
+   else
+      core.startSequenceAcquisition(cameraDevice, numImages, 0.0, true);
+   // The unarmed start clears the buffer
+   const long already = armed ? before : 0;
+   // Sleep rather than yield, so as not to starve the camera thread
+   while (core.getRemainingImageCount() <= already)
+      std::this_thread::sleep_for(std::chrono::microseconds(20));
+   const Clock::time_point first = Clock::now();
+
+   WaitForSequenceEnd(core);
+   while (core.getRemainingImageCount() > 0)
+      core.popNextImage();
+   return std::chrono::duration<double, std::micro>(first - start).count();
+}
+
+void Report(const char* title, std::vector<double> lat)
+{
+   std::sort(lat.begin(), lat.end());
+   auto percentile = [&lat](double p) {
+      size_t rank = static_cast<size_t>(p / 100.0 * lat.size());
+      return lat[std::min(rank, lat.size() - 1)];
+   };
+   double sum = 0.0;
+   for (double l : lat)
+      sum += l;
+   std::printf("%s (%zu bursts)\n", title, lat.size());
+   std::printf("  start-to-first-frame us: mean %.1f  p50 %.1f  p90 %.1f  "
+         "p99 %.1f  max %.1f\n", sum / lat.size(), percentile(50.0),
+         percentile(90.0), percentile(99.0), lat.back());
+}
+
+} // anonymous namespace
+
+int main(int argc, char* argv[])
+{
+   std::vector<std::string> adapterPaths;
+   long bursts = 500;
+   long numImages = 3;
+   double exposureMs = 1.0;
+   double shutterDelayMs = 0.0;
+
+   for (int i = 1; i < argc; ++i)
+   {
+      const std::string arg(argv[i]);
+      if (arg == "--adapter-path" && i + 1 < argc)
+         adapterPaths.push_back(argv[++i]);
+      else if (arg == "--bursts" && i + 1 < argc)
+         bursts = std::max(1L, std::atol(argv[++i]));
+      else if (arg == "--images" && i + 1 < argc)
+         numImages = std::max(1L, std::atol(argv[++i]));
+      else if (arg == "--exposure" && i + 1 < argc)
+         exposureMs = std::atof(argv[++i]);
+      else if (arg == "--shutter-delay" && i + 1 < argc)
+         shutterDelayMs = std::atof(argv[++i]);
+      else
+      {
+         std::fprintf(stderr, "Usage: %s [--adapter-path DIR] [--bursts N] "
+               "[--images N] [--exposure MS] [--shutter-delay MS]\n",
+               argv[0]);
+         return 2;
+      }
+   }
+
+   try
+   {
+      CMMCore core;
+      core.enableStderrLog(false);
+      if (!adapterPaths.empty())
+         core.setDeviceAdapterSearchPaths(adapterPaths);
+
+      core.loadDevice(cameraDevice, "DemoCamera", "DCam");
+      core.loadDevice(shutterDevice, "DemoCamera", "DShutter");
+      core.initializeAllDevices();
+      core.setCameraDevice(cameraDevice);
+      core.setShutterDevice(shutterDevice);
+      core.setAutoShutter(true);
+      core.setDeviceDelayMs(shutterDevice, shutterDelayMs);
+      core.setExposure(exposureMs);
+      // Skip the synthetic image generation, which would dominate
+      core.setProperty(cameraDevice, "FastImage", 1L);
+
+      for (int i = 0; i < 10; ++i) // Warm up
+         RunBurst(core, false, numImages);
+
+      std::vector<double> unarmed;
+      for (long i = 0; i < bursts; ++i)
+         unarmed.push_back(RunBurst(core, false, numImages));
+
+      core.armSequenceAcquisition(cameraDevice);
+      std::vector<double> armed;
+      for (long i = 0; i < bursts; ++i)
+         armed.push_back(RunBurst(core, true, numImages));
+      core.disarmSequenceAcquisition();
+
+      std::printf("DemoCamera, %ld images per burst, %.1f ms exposure, "
+            "%.1f ms shutter delay\n", numImages, exposureMs, shutterDelayMs);
+      Report("startSequenceAcquisition", unarmed);
+      Report("startArmedSequenceAcquisition", armed);
+
+      core.unloadAllDevices();
+   }
+   catch (const CMMError& e)
+   {
+      std::fprintf(stderr, "%s\n", e.getFullMsg().c_str());
+      return 1;
+   }
+   return 0;
+}
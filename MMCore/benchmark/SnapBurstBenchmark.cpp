@@ -0,0 +1,172 @@
+// PROJECT:       Micro-Manager
+// SUBSYSTEM:     MMCore
+//
+// DESCRIPTION:   Benchmark of the frame rate of snapImageBurst() against
+//                repeated snapImage(), using the DemoCamera device adapter
+//
+// LICENSE:       This file is distributed under the "Lesser GPL" (LGPL) license.
+//                License text is included with the source distribution.
+//
+//                This file is distributed in the hope that it will be useful,
+//                but WITHOUT ANY WARRANTY; without even the implied warranty
+//                of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+//
+//                IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+//                CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+//                INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES.
+
+// Snaps bursts of images with DemoCamera, with the DemoCamera shutter as the
+// auto-shutter, in two ways:
+// - snapImage() and getImage() for each image, copying the image out, as an
+//   application does today;
+// - snapImageBurst(), retrieving the images from the circular buffer.
+// The camera's FastImage mode is used, so that each snap takes the exposure
+// time. The shutter has the delay given with --shutter-delay.
+//
+// Usage: SnapBurstBenchmark [--adapter-path DIR] [--bursts N] [--images N]
+//                           [--exposure MS] [--size PIXELS]
+//                           [--shutter-delay MS]
+
+#include "MMCore.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+const char* const cameraDevice = "Camera";
+const char* const shutterDevice = "Shutter";
+
+// Return the time taken in seconds
+double SnapRepeatedly(CMMCore& core, long numImages,
+      std::vector<unsigned char>& dest)
+{
+   const Clock::time_point start = Clock::now();
+   for (long i = 0; i < numImages; ++i)
+   {
+      core.snapImage();
+      const unsigned char* pixels =
+         static_cast<const unsigned char*>(core.getImage());
+      std::memcpy(dest.data(), pixels, dest.size());
+   }
+   return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+double SnapBurst(CMMCore& core, long numImages,
+      std::vector<unsigned char>& dest)
+{
+   const Clock::time_point start = Clock::now();
+   core.snapImageBurst(numImages);
+   while (core.getRemainingImageCount() > 0)
+   {
+      const unsigned char* pixels =
+         static_cast<const unsigned char*>(core.popNextImage());
+      std::memcpy(dest.data(), pixels, dest.size());
+   }
+   return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+void Report(const char* title, long images, std::vector<double> seconds)
+{
+   std::sort(seconds.begin(), seconds.end());
+   double sum = 0.0;
+   for (double s : seconds)
+      sum += s;
+   const double median = seconds[seconds.size() / 2];
+   std::printf("%s\n", title);
+   std::printf("  %.1f fps (median burst %.2f ms, mean %.2f ms)\n",
+         images / median, 1000.0 * median, 1000.0 * sum / seconds.size());
+}
+
+} // anonymous namespace
+
+int main(int argc, char* argv[])
+{
+   std::vector<std::string> adapterPaths;
+   long bursts = 20;
+   long numImages = 50;
+   double exposureMs = 5.0;
+   long size = 2048;
+   double shutterDelayMs = 0.0;
+
+   for (int i = 1; i < argc; ++i)
+   {
+      const std::string arg(argv[i]);
+      if (arg == "--adapter-path" && i + 1 < argc)
+         adapterPaths.push_back(argv[++i]);
+      else if (arg == "--bursts" && i + 1 < argc)
+         bursts = std::max(1L, std::atol(argv[++i]));
+      else if (arg == "--images" && i + 1 < argc)
+         numImages = std::max(1L, std::atol(argv[++i]));
+      else if (arg == "--exposure" && i + 1 < argc)
+         exposureMs = std::atof(argv[++i]);
+      else if (arg == "--size" && i + 1 < argc)
+         size = std::max(1L, std::atol(argv[++i]));
+      else if (arg == "--shutter-delay" && i + 1 < argc)
+         shutterDelayMs = std::atof(argv[++i]);
+      else
+      {
+         std::fprintf(stderr, "Usage: %s [--adapter-path DIR] [--bursts N] "
+               "[--images N] [--exposure MS] [--size PIXELS] "
+               "[--shutter-delay MS]\n", argv[0]);
+         return 2;
+      }
+   }
+
+   try
+   {
+      CMMCore core;
+      core.enableStderrLog(false);
+      if (!adapterPaths.empty())
+         core.setDeviceAdapterSearchPaths(adapterPaths);
+
+      core.loadDevice(cameraDevice, "DemoCamera", "DCam");
+      core.loadDevice(shutterDevice, "DemoCamera", "DShutter");
+      core.initializeAllDevices();
+      core.setCameraDevice(cameraDevice);
+      core.setShutterDevice(shutterDevice);
+      core.setAutoShutter(true);
+      core.setDeviceDelayMs(shutterDevice, shutterDelayMs);
+      core.setProperty(cameraDevice, "OnCameraCCDXSize", size);
+      core.setProperty(cameraDevice, "OnCameraCCDYSize", size);
+      core.setProperty(cameraDevice, MM::g_Keyword_PixelType, "16bit");
+      core.setProperty(cameraDevice, "FastImage", 1L);
+      core.setExposure(exposureMs);
+
+      std::vector<unsigned char> dest(core.getImageBufferSize());
+      // Room for a whole burst
+      core.setCircularBufferMemoryFootprint(static_cast<unsigned>(
+            (numImages + 1) * dest.size() / (1 << 20) + 1));
+
+      SnapRepeatedly(core, numImages, dest); // Warm up
+      SnapBurst(core, numImages, dest);
+
+      std::vector<double> repeated, burst;
+      for (long i = 0; i < bursts; ++i)
+      {
+         repeated.push_back(SnapRepeatedly(core, numImages, dest));
+         burst.push_back(SnapBurst(core, numImages, dest));
+      }
+
+      std::printf("DemoCamera, %ldx%ld 16-bit, %ld images per burst, "
+            "%.1f ms exposure, %.1f ms shutter delay\n", size, size,
+            numImages, exposureMs, shutterDelayMs);
+      Report("snapImage() + getImage()", numImages, repeated);
+      Report("snapImageBurst()", numImages, burst);
+
+      core.unloadAllDevices();
+   }
+   catch (const CMMError& e)
+   {
+      std::fprintf(stderr, "%s\n", e.getFullMsg().c_str());
+      return 1;
+   }
+   return 0;
+}
@@ -84,4 +84,43 @@ TEST_CASE("detectDevice with invalid device", "[APIError]")
    CHECK(c.detectDevice("") == MM::Unimplemented);
    CHECK(c.detectDevice("Blah") == MM::Unimplemented);
    CHECK(c.detectDevice("Core") == MM::Unimplemented);
-}
\ No newline at end of file
+}
+
+TEST_CASE("armed sequence acquisition with no camera", "[APIError]")
+{
+   CMMCore c;
+   CHECK_FALSE(c.isSequenceAcquisitionArmed());
+   CHECK_THROWS_AS(c.armSequenceAcquisition("Blah"), CMMError);
+   CHECK_THROWS_AS(c.startArmedSequenceAcquisition(1, 0.0, true), CMMError);
+   CHECK_FALSE(c.isSequenceAcquisitionArmed());
+   // Must not throw when nothing is armed
+   c.disarmSequenceAcquisition();
+}
+
+TEST_CASE("snapImageBurst with no camera", "[APIError]")
+{
+   CMMCore c;
+   CHECK_THROWS_AS(c.snapImageBurst(0), CMMError);
+   CHECK_THROWS_AS(c.snapImageBurst(3), CMMError);
+}
+
+TEST_CASE("saveSystemConfigurationFromCache with null filename", "[APIError]")
+{
+   CMMCore c;
+   CHECK_THROWS_AS(c.saveSystemConfigurationFromCache(nullptr, false), CMMError);
+   CHECK_THROWS_AS(c.saveSystemConfigurationFromCache(nullptr, true), CMMError);
+}
+
+TEST_CASE("loadSystemConfigurationDifferential with null filename", "[APIError]")
+{
+   CMMCore c;
+   CHECK_THROWS_AS(c.loadSystemConfigurationDifferential(nullptr), CMMError);
+}
+
+TEST_CASE("reloadDeviceAdapter with invalid module", "[APIError]")
+{
+   CMMCore c;
+   CHECK_THROWS_AS(c.reloadDeviceAdapter(nullptr), CMMError);
+   CHECK_THROWS_AS(c.reloadDeviceAdapter(""), CMMError);
+   CHECK_THROWS_AS(c.reloadDeviceAdapter("NoSuchAdapter"), CMMError);
+}
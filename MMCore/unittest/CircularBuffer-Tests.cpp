@@ -0,0 +1,243 @@
+#include <catch2/catch_all.hpp>
+
+#include "CircularBuffer.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace {
+
+// 4 images of this size fit in 1 MB
+const unsigned width = 512;
+const unsigned height = 512;
+
+Metadata CameraMetadata()
+{
+   Metadata md;
+   md.PutImageTag("Camera", "Cam");
+   return md;
+}
+
+bool Insert(CircularBuffer& cb)
+{
+   static const std::vector<unsigned char> pixels(width * height);
+   Metadata md = CameraMetadata();
+   return cb.InsertImage(pixels.data(), width, height, 1, &md);
+}
+
+std::string Tag(const mm::ImgBuffer* img, const char* key)
+{
+   Metadata md = img->GetMetadata();
+   if (!md.HasTag(key))
+      return std::string();
+   return md.GetSingleTag(key).GetValue();
+}
+
+} // anonymous namespace
+
+TEST_CASE("backpressure is signaled at the watermarks", "[CircularBuffer]")
+{
+   CircularBuffer cb(1);
+   REQUIRE(cb.Initialize(1, width, height, 1));
+   REQUIRE(cb.GetSize() == 4);
+
+   std::vector<std::pair<bool, double>> events;
+   cb.SetBackpressureListener([&](bool active, double fill) {
+      events.emplace_back(active, fill);
+   });
+   CircularBuffer::BackpressureSettings settings;
+   settings.highWatermark = 0.5;
+   settings.lowWatermark = 0.25;
+   cb.SetBackpressureSettings(settings);
+
+   CHECK(Insert(cb));
+   CHECK(Insert(cb));
+   CHECK_FALSE(cb.IsBackpressureActive());
+   CHECK(Insert(cb));
+   CHECK(cb.IsBackpressureActive());
+   REQUIRE(events.size() == 1);
+   CHECK(events[0].first);
+   CHECK(events[0].second == 0.5);
+
+   // No policy: fills up and overflows
+   CHECK(Insert(cb));
+   CHECK_FALSE(Insert(cb));
+   CHECK(cb.Overflow());
+
+   // Hysteresis: still active above the low watermark
+   CHECK(cb.GetNextImageBuffer(0));
+   CHECK(cb.GetNextImageBuffer(0));
+   CHECK(cb.IsBackpressureActive());
+   CHECK(cb.GetNextImageBuffer(0));
+   CHECK_FALSE(cb.IsBackpressureActive());
+   REQUIRE(events.size() == 2);
+   CHECK_FALSE(events[1].first);
+
+   CHECK(Insert(cb));
+   cb.Clear();
+   CHECK(events.size() == 2);
+}
+
+TEST_CASE("drop every Nth image under backpressure", "[CircularBuffer]")
+{
+   CircularBuffer cb(1);
+   REQUIRE(cb.Initialize(1, width, height, 1));
+   CircularBuffer::BackpressureSettings settings;
+   settings.highWatermark = 0.5;
+   settings.lowWatermark = 0.25;
+   settings.policy = CircularBuffer::BackpressureDropEveryNth;
+   settings.parameter = 2;
+   cb.SetBackpressureSettings(settings);
+
+   for (int i = 0; i < 6; ++i)
+      CHECK(Insert(cb)); // Stores 0, 1, 2, 4; drops 3, 5
+   CHECK(cb.GetDroppedImageCount() == 2);
+   CHECK(cb.GetRemainingImageCount() == 4);
+   CHECK_FALSE(cb.Overflow());
+
+   const mm::ImgBuffer* img = cb.GetNextImageBuffer(0);
+   CHECK(Tag(img, "BackpressureDroppedImages").empty());
+   cb.GetNextImageBuffer(0);
+   img = cb.GetNextImageBuffer(0);
+   CHECK(Tag(img, "ImageNumber") == "2");
+   img = cb.GetNextImageBuffer(0);
+   CHECK(Tag(img, "ImageNumber") == "4");
+   CHECK(Tag(img, "BackpressureDroppedImages") == "1");
+   CHECK(Tag(img, "BackpressureDroppedImagesTotal") == "1");
+
+   cb.Clear();
+   CHECK(cb.GetDroppedImageCount() == 0);
+}
+
+TEST_CASE("decimate under backpressure", "[CircularBuffer]")
+{
+   CircularBuffer cb(1);
+   REQUIRE(cb.Initialize(1, width, height, 1));
+   CircularBuffer::BackpressureSettings settings;
+   settings.highWatermark = 0.5;
+   settings.lowWatermark = 0.25;
+   settings.policy = CircularBuffer::BackpressureDecimate;
+   settings.parameter = 3;
+   cb.SetBackpressureSettings(settings);
+
+   for (int i = 0; i < 8; ++i)
+      CHECK(Insert(cb)); // Stores 0, 1, 2, 5; drops 3, 4, 6, 7
+   CHECK(cb.GetDroppedImageCount() == 4);
+   CHECK(cb.GetRemainingImageCount() == 4);
+
+   for (int i = 0; i < 3; ++i)
+      cb.GetNextImageBuffer(0);
+   const mm::ImgBuffer* img = cb.GetNextImageBuffer(0);
+   CHECK(Tag(img, "ImageNumber") == "5");
+   CHECK(Tag(img, "BackpressureDroppedImages") == "2");
+}
+
+TEST_CASE("pause times out under backpressure", "[CircularBuffer]")
+{
+   CircularBuffer cb(1);
+   REQUIRE(cb.Initialize(1, width, height, 1));
+   CircularBuffer::BackpressureSettings settings;
+   settings.highWatermark = 0.5;
+   settings.lowWatermark = 0.25;
+   settings.policy = CircularBuffer::BackpressurePause;
+   settings.parameter = 20;
+   cb.SetBackpressureSettings(settings);
+
+   CHECK(Insert(cb));
+   CHECK(Insert(cb));
+   const auto start = std::chrono::steady_clock::now();
+   CHECK(Insert(cb)); // Nobody consumes: waits, then stores
+   CHECK(std::chrono::steady_clock::now() - start >=
+         std::chrono::milliseconds(20));
+   CHECK(cb.GetRemainingImageCount() == 3);
+   CHECK(cb.GetDroppedImageCount() == 0);
+}
+
+TEST_CASE("12-bit images are stored packed", "[CircularBuffer]")
+{
+   CircularBuffer cb(1);
+   REQUIRE(cb.Initialize(1, width, height / 2, 2, 12));
+   CHECK(cb.GetPackedBitDepth() == 0); // Packing not enabled
+   CHECK(cb.GetSize() == 4);
+
+   cb.SetPackingEnabled(true);
+   REQUIRE(cb.Initialize(1, width, height / 2, 2, 12));
+   CHECK(cb.GetPackedBitDepth() == 12);
+   CHECK(cb.GetSize() == 5);
+
+   std::vector<std::uint16_t> pixels(width * height / 2);
+   for (std::size_t i = 0; i < pixels.size(); ++i)
+      pixels[i] = static_cast<std::uint16_t>(i % 4096);
+   Metadata md = CameraMetadata();
+   REQUIRE(cb.InsertImage(reinterpret_cast<const unsigned char*>(pixels.data()),
+            width, height / 2, 2, &md));
+
+   const mm::ImgBuffer* img = cb.GetNextImageBuffer(0);
+   REQUIRE(img);
+   CHECK(img->Depth() == 2);
+   CHECK(Tag(img, "PixelType") == "GRAY16");
+   const std::uint16_t* out =
+      reinterpret_cast<const std::uint16_t*>(img->GetPixels());
+   CHECK(std::vector<std::uint16_t>(out, out + pixels.size()) == pixels);
+
+   // Bit depths that cannot be packed are stored as is
+   REQUIRE(cb.Initialize(1, width, height / 2, 2, 16));
+   CHECK(cb.GetPackedBitDepth() == 0);
+}
+
+TEST_CASE("saturation by packing is reported once per clearing",
+   "[CircularBuffer]")
+{
+   CircularBuffer cb(1);
+   cb.SetPackingEnabled(true);
+   REQUIRE(cb.Initialize(1, width, height / 2, 2, 12));
+   std::vector<std::pair<std::size_t, unsigned>> reports;
+   cb.SetSaturationListener([&](std::size_t pixels, unsigned bitDepth) {
+      reports.emplace_back(pixels, bitDepth);
+   });
+
+   std::vector<std::uint16_t> pixels(width * height / 2, 100);
+   Metadata md = CameraMetadata();
+   const unsigned char* raw =
+      reinterpret_cast<const unsigned char*>(pixels.data());
+   REQUIRE(cb.InsertImage(raw, width, height / 2, 2, &md));
+   CHECK(reports.empty());
+
+   pixels[0] = pixels[1] = 4096;
+   REQUIRE(cb.InsertImage(raw, width, height / 2, 2, &md));
+   REQUIRE(cb.InsertImage(raw, width, height / 2, 2, &md));
+   REQUIRE(reports.size() == 1);
+   CHECK(reports[0].first == 2);
+   CHECK(reports[0].second == 12);
+
+   cb.Clear();
+   REQUIRE(cb.InsertImage(raw, width, height / 2, 2, &md));
+   CHECK(reports.size() == 2);
+}
+
+TEST_CASE("unpacked images of different channels are kept apart",
+   "[CircularBuffer]")
+{
+   CircularBuffer cb(1);
+   cb.SetPackingEnabled(true);
+   REQUIRE(cb.Initialize(2, width, height / 2, 2, 12));
+
+   std::vector<std::uint16_t> pixels(2 * width * height / 2);
+   std::fill(pixels.begin(), pixels.begin() + pixels.size() / 2, 1);
+   std::fill(pixels.begin() + pixels.size() / 2, pixels.end(), 2);
+   Metadata md = CameraMetadata();
+   REQUIRE(cb.InsertMultiChannel(
+            reinterpret_cast<const unsigned char*>(pixels.data()), 2,
+            width, height / 2, 2, &md));
+
+   // Each retrieval is valid until the next one of the same channel
+   const mm::ImgBuffer* ch0 = cb.GetTopImageBuffer(0);
+   const mm::ImgBuffer* ch1 = cb.GetTopImageBuffer(1);
+   REQUIRE(ch0);
+   REQUIRE(ch1);
+   CHECK(reinterpret_cast<const std::uint16_t*>(ch0->GetPixels())[0] == 1);
+   CHECK(reinterpret_cast<const std::uint16_t*>(ch1->GetPixels())[0] == 2);
+}
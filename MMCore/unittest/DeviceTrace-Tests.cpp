@@ -0,0 +1,182 @@
+#include <catch2/catch_all.hpp>
+
+#include "DeviceTrace.h"
+#include "MMCore.h"
+#include "MockDeviceUtils.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+namespace mm {
+
+namespace {
+
+const char* const traceFile = "DeviceTrace-Tests.tmp";
+const std::string pixelFile = std::string(traceFile) + ".pixels";
+
+std::vector<std::string> ReadLines(const std::string& filename)
+{
+   std::vector<std::string> lines;
+   std::ifstream file(filename.c_str());
+   std::string line;
+   while (std::getline(file, line))
+      lines.push_back(line);
+   return lines;
+}
+
+std::string ReadAll(const std::string& filename)
+{
+   std::ifstream file(filename.c_str(), std::ios::binary);
+   return std::string(std::istreambuf_iterator<char>(file),
+         std::istreambuf_iterator<char>());
+}
+
+void RemoveTrace()
+{
+   std::remove(traceFile);
+   std::remove(pixelFile.c_str());
+}
+
+} // anonymous namespace
+
+TEST_CASE("calls are recorded with timing", "[DeviceTrace]")
+{
+   RemoveTrace();
+   {
+      DeviceTraceRecorder r(traceFile);
+      CHECK(r.GetFilename() == traceFile);
+      r.RecordDevice("Z", "Adapter", "Stage", MM::StageDevice);
+      r.RecordProperty("Z", "Speed", "Fast\tand\nsmooth", false);
+      r.RecordPositionLabel("Filter", 2, "GFP");
+
+      const DeviceTraceRecorder::Clock::time_point t0 =
+         DeviceTraceRecorder::Clock::now();
+      r.RecordCall("Z", "SetPositionUm", "10.5", 0, "",
+            t0, t0 + std::chrono::milliseconds(3));
+      CHECK(r.GetRecordCount() == 1);
+      r.Close();
+      r.RecordCall("Z", "SetPositionUm", "11.5", 0, "", t0, t0);
+      CHECK(r.GetRecordCount() == 1);
+   }
+
+   std::vector<std::string> lines = ReadLines(traceFile);
+   REQUIRE(lines.size() == 5);
+   CHECK(lines[0] == "# Micro-Manager device trace 1");
+   CHECK(lines[1] == "Device\tZ\tAdapter\tStage\t" +
+         std::to_string(static_cast<int>(MM::StageDevice)));
+   CHECK(lines[2] == "Property\tZ\tSpeed\tFast and smooth\t0");
+   CHECK(lines[3] == "PositionLabel\tFilter\t2\tGFP");
+   CHECK(lines[4].substr(0, 5) == "Call\t");
+   CHECK(lines[4].find("\t3000\tZ\tSetPositionUm\t0\t10.5\t") !=
+         std::string::npos);
+   RemoveTrace();
+}
+
+TEST_CASE("repeated busy polls are not recorded", "[DeviceTrace]")
+{
+   RemoveTrace();
+   {
+      DeviceTraceRecorder r(traceFile);
+      const DeviceTraceRecorder::Clock::time_point t =
+         DeviceTraceRecorder::Clock::now();
+      r.RecordCall("Z", "SetPositionUm", "1", 0, "", t, t);
+      r.RecordCall("Z", "Busy", "", 0, "1", t, t);
+      r.RecordCall("Z", "Busy", "", 0, "1", t, t);
+      r.RecordCall("Z", "GetPositionUm", "", 0, "0.5", t, t);
+      r.RecordCall("Z", "Busy", "", 0, "1", t, t);
+      r.RecordCall("XY", "Busy", "", 0, "1", t, t);
+      r.RecordCall("Z", "Busy", "", 0, "0", t, t);
+      r.RecordCall("Z", "Busy", "", 0, "0", t, t);
+      r.RecordCall("Z", "SetPositionUm", "2", 0, "", t, t);
+      r.RecordCall("Z", "Busy", "", 0, "0", t, t);
+      CHECK(r.GetRecordCount() == 7);
+   }
+   RemoveTrace();
+}
+
+TEST_CASE("identical consecutive images share pixels", "[DeviceTrace]")
+{
+   RemoveTrace();
+   {
+      DeviceTraceRecorder r(traceFile);
+      DeviceTraceRecorder::ImageInfo info;
+      info.width = 2;
+      info.height = 2;
+      info.bytesPerPixel = 1;
+      info.components = 1;
+      const unsigned char a[] = { 1, 2, 3, 4 };
+      const unsigned char b[] = { 5, 6, 7, 8 };
+      const DeviceTraceRecorder::Clock::time_point t =
+         DeviceTraceRecorder::Clock::now();
+      r.RecordImage("Cam", "GetImageBuffer", "", 0, info, a, t, t);
+      r.RecordFrame("Cam", info, a, t);
+      r.RecordFrame("Cam", info, b, t);
+      r.RecordImage("Cam", "GetImageBuffer", "", 1, info, nullptr, t, t);
+   }
+
+   std::vector<std::string> lines = ReadLines(traceFile);
+   REQUIRE(lines.size() == 5);
+   CHECK(lines[1].find("\t2\t2\t1\t1\t0\t4") != std::string::npos);
+   CHECK(lines[2].find("Frame\t") == 0);
+   CHECK(lines[2].find("\tCam\t2\t2\t1\t1\t0\t4") != std::string::npos);
+   CHECK(lines[3].find("\tCam\t2\t2\t1\t1\t4\t4") != std::string::npos);
+   CHECK(lines[4].find("\t2\t2\t1\t1\t-1\t0") != std::string::npos);
+   CHECK(ReadAll(pixelFile) == std::string("\x01\x02\x03\x04\x05\x06\x07\x08"));
+   RemoveTrace();
+}
+
+TEST_CASE("trace file that cannot be created is an error", "[DeviceTrace]")
+{
+   CHECK_THROWS_AS(DeviceTraceRecorder("no-such-dir/trace.txt"), CMMError);
+}
+
+TEST_CASE("inactive trace call records nothing", "[DeviceTrace]")
+{
+   const std::string label = "Z";
+   DeviceTraceCall inactive(nullptr, label);
+   CHECK_FALSE(inactive.IsActive());
+   inactive.Record("Busy", "", 0, "1");
+
+   RemoveTrace();
+   auto recorder = std::make_shared<DeviceTraceRecorder>(traceFile);
+   DeviceTraceCall active(recorder, label);
+   CHECK(active.IsActive());
+   active.Record("SetOpen", "1", 0);
+   CHECK(recorder->GetRecordCount() == 1);
+   recorder->Close();
+   RemoveTrace();
+}
+
+TEST_CASE("device calls are recorded only while recording", "[DeviceTrace]")
+{
+   RemoveTrace();
+   test::MockShutter shutter;
+   test::MockAdapterWithDevices adapter{ {"Shutter", &shutter} };
+   CMMCore core;
+   adapter.LoadIntoCore(core);
+
+   core.setShutterOpen("Shutter", true);
+   core.startDeviceTraceRecording(traceFile);
+   CHECK(core.isDeviceTraceRecording());
+   core.setShutterOpen("Shutter", false);
+   core.stopDeviceTraceRecording();
+   CHECK_FALSE(core.isDeviceTraceRecording());
+   core.setShutterOpen("Shutter", true);
+
+   std::vector<std::string> lines = ReadLines(traceFile);
+   CHECK(std::count_if(lines.begin(), lines.end(),
+         [](const std::string& line) {
+            return line.find("\tShutter\tSetOpen\t") != std::string::npos;
+         }) == 1);
+   CHECK(std::find_if(lines.begin(), lines.end(),
+         [](const std::string& line) {
+            return line.find("\tShutter\tSetOpen\t0\t0\t") != std::string::npos;
+         }) != lines.end());
+   RemoveTrace();
+}
+
+} // namespace mm
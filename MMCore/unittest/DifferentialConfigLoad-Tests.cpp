@@ -0,0 +1,114 @@
+#include <catch2/catch_all.hpp>
+
+#include "DeviceBase.h"
+#include "MMCore.h"
+#include "MockDeviceUtils.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+
+namespace mm {
+
+namespace {
+
+// Generic device with a pre-init property. Since the test owns the device,
+// unloading does not delete it; shutting down resets the property instead, as
+// a newly created device would have it.
+class PreInitDevice : public CGenericBase<PreInitDevice>
+{
+   std::string mode_;
+
+public:
+   int initializeCount = 0;
+
+   PreInitDevice() : mode_("A")
+   {
+      CreateStringProperty("Mode", "A", false,
+         new MM::ActionLambda([this](MM::PropertyBase* pProp,
+               MM::ActionType eAct) {
+            if (eAct == MM::BeforeGet)
+               pProp->Set(mode_.c_str());
+            else if (eAct == MM::AfterSet)
+               pProp->Get(mode_);
+            return DEVICE_OK;
+         }), true);
+   }
+
+   int Initialize() override
+   {
+      ++initializeCount;
+      return DEVICE_OK;
+   }
+
+   int Shutdown() override
+   {
+      mode_ = "A";
+      return DEVICE_OK;
+   }
+
+   void GetName(char* name) const override
+   { CDeviceUtils::CopyLimitedString(name, "PreInitDevice"); }
+   bool Busy() override { return false; }
+};
+
+// Configuration file in the temporary directory, removed when the test ends
+class TempConfigFile
+{
+   std::string path_;
+
+public:
+   TempConfigFile(const std::string& name, const std::string& contents)
+   {
+#ifdef _WIN32
+      const char* dir = std::getenv("TEMP");
+#else
+      const char* dir = std::getenv("TMPDIR");
+#endif
+      path_ = std::string(dir && *dir ? dir : ".") + "/" + name;
+      std::ofstream f(path_.c_str());
+      f << contents;
+   }
+
+   ~TempConfigFile() { std::remove(path_.c_str()); }
+
+   const char* Path() const { return path_.c_str(); }
+};
+
+} // anonymous namespace
+
+TEST_CASE("pre-init property dropped from the new file reloads the device",
+   "[DifferentialConfigLoad]")
+{
+   PreInitDevice dev;
+   test::MockAdapterWithDevices adapter{ {"Dev", &dev} };
+   CMMCore core;
+   test::CoreTestAccess::LoadMockDeviceAdapter(core, "MockAdapter", &adapter);
+
+   TempConfigFile withMode("DifferentialConfigLoad-WithMode.cfg",
+      "Device,Dev,MockAdapter,PreInitDevice\n"
+      "Property,Dev,Mode,B\n"
+      "Property,Core,Initialize,1\n");
+   TempConfigFile withoutMode("DifferentialConfigLoad-WithoutMode.cfg",
+      "Device,Dev,MockAdapter,PreInitDevice\n"
+      "Property,Core,Initialize,1\n");
+
+   core.loadSystemConfiguration(withMode.Path());
+   REQUIRE(dev.initializeCount == 1);
+   CHECK(core.getProperty("Dev", "Mode") == "B");
+
+   // Same pre-init properties: the device is kept
+   core.loadSystemConfigurationDifferential(withMode.Path());
+   CHECK(dev.initializeCount == 1);
+
+   core.loadSystemConfigurationDifferential(withoutMode.Path());
+   CHECK(dev.initializeCount == 2);
+   CHECK(core.getProperty("Dev", "Mode") == "A");
+
+   // Left at its default this time, so the device is kept
+   core.loadSystemConfigurationDifferential(withoutMode.Path());
+   CHECK(dev.initializeCount == 2);
+}
+
+} // namespace mm
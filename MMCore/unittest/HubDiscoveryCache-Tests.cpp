@@ -0,0 +1,222 @@
+#include <catch2/catch_all.hpp>
+
+#include "HubDiscoveryCache.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <future>
+#include <string>
+#include <thread>
+
+namespace mm {
+
+namespace {
+
+HubDiscoveryCache::Key MakeKey(const std::string& port,
+      const std::string& identity)
+{
+   HubDiscoveryCache::Key key;
+   key.adapter = "Adapter";
+   key.hub = "Hub";
+   key.port = port;
+   key.identity = identity;
+   return key;
+}
+
+HubDiscoveryCache::PeripheralList MakePeripherals(int count)
+{
+   HubDiscoveryCache::PeripheralList peripherals;
+   for (int i = 0; i < count; ++i)
+   {
+      HubDiscoveryCache::Peripheral p;
+      p.name = "Device" + std::to_string(i);
+      p.description = "Peripheral number " + std::to_string(i);
+      peripherals.push_back(p);
+   }
+   return peripherals;
+}
+
+// Cache file in the temporary directory, removed when the test ends
+class TempCacheFile
+{
+   std::string path_;
+
+public:
+   TempCacheFile()
+   {
+#ifdef _WIN32
+      const char* dir = std::getenv("TEMP");
+      const char* defaultDir = ".";
+#else
+      const char* dir = std::getenv("TMPDIR");
+      const char* defaultDir = "/tmp";
+#endif
+      path_ = std::string(dir && *dir ? dir : defaultDir) +
+         "/HubDiscoveryCache-Tests.tmp";
+      std::remove(path_.c_str());
+   }
+
+   ~TempCacheFile() { std::remove(path_.c_str()); }
+
+   TempCacheFile(const TempCacheFile&) = delete;
+   TempCacheFile& operator=(const TempCacheFile&) = delete;
+
+   const std::string& Path() const { return path_; }
+};
+
+} // anonymous namespace
+
+TEST_CASE("lookup hits only after store", "[HubDiscoveryCache]")
+{
+   HubDiscoveryCache c;
+   HubDiscoveryCache::PeripheralList result;
+   CHECK_FALSE(c.Lookup(MakeKey("COM1", "v1"), result));
+
+   c.Store(MakeKey("COM1", "v1"), MakePeripherals(3));
+   REQUIRE(c.Lookup(MakeKey("COM1", "v1"), result));
+   CHECK(result == MakePeripherals(3));
+
+   // Different port is a different hub
+   CHECK_FALSE(c.Lookup(MakeKey("COM2", "v1"), result));
+}
+
+TEST_CASE("firmware mismatch is a miss and store replaces entry", "[HubDiscoveryCache]")
+{
+   HubDiscoveryCache c;
+   c.Store(MakeKey("COM1", "v1"), MakePeripherals(3));
+
+   HubDiscoveryCache::PeripheralList result;
+   CHECK_FALSE(c.Lookup(MakeKey("COM1", "v2"), result));
+
+   c.Store(MakeKey("COM1", "v2"), MakePeripherals(1));
+   CHECK_FALSE(c.Lookup(MakeKey("COM1", "v1"), result));
+   REQUIRE(c.Lookup(MakeKey("COM1", "v2"), result));
+   CHECK(result == MakePeripherals(1));
+}
+
+TEST_CASE("cache persists in file", "[HubDiscoveryCache]")
+{
+   TempCacheFile cacheFile;
+   {
+      HubDiscoveryCache c;
+      c.SetFile(cacheFile.Path());
+      c.Store(MakeKey("COM1", "v1"), MakePeripherals(2));
+      c.Store(MakeKey("", ""), MakePeripherals(0));
+
+      HubDiscoveryCache::PeripheralList p = MakePeripherals(1);
+      p[0].description = "Tab\tand\nnewline";
+      c.Store(MakeKey("COM3", "a\tb"), p);
+   }
+
+   HubDiscoveryCache c;
+   c.SetFile(cacheFile.Path());
+   CHECK(c.GetFile() == cacheFile.Path());
+   HubDiscoveryCache::PeripheralList result;
+   REQUIRE(c.Lookup(MakeKey("COM1", "v1"), result));
+   CHECK(result == MakePeripherals(2));
+   REQUIRE(c.Lookup(MakeKey("", ""), result));
+   CHECK(result.empty());
+   REQUIRE(c.Lookup(MakeKey("COM3", "a\tb"), result));
+   REQUIRE(result.size() == 1);
+   CHECK(result[0].description == "Tab and newline");
+
+   c.Clear();
+   HubDiscoveryCache c2;
+   c2.SetFile(cacheFile.Path());
+   CHECK_FALSE(c2.Lookup(MakeKey("COM1", "v1"), result));
+}
+
+TEST_CASE("invalid cache file is rejected", "[HubDiscoveryCache]")
+{
+   TempCacheFile cacheFile;
+   {
+      std::ofstream f(cacheFile.Path());
+      f << "Peripheral\tOrphan\tNo hub line before this\n";
+   }
+   HubDiscoveryCache c;
+   CHECK_THROWS_AS(c.SetFile(cacheFile.Path()), CMMError);
+   CHECK(c.GetFile().empty());
+}
+
+TEST_CASE("revalidation stores detected peripherals", "[HubDiscoveryCache]")
+{
+   HubDiscoveryCache c;
+   c.Store(MakeKey("COM1", "v1"), MakePeripherals(3));
+
+   c.Revalidate(MakeKey("COM1", "v1"), [] { return MakePeripherals(4); });
+   c.WaitForRevalidations();
+   HubDiscoveryCache::PeripheralList result;
+   REQUIRE(c.Lookup(MakeKey("COM1", "v1"), result));
+   CHECK(result == MakePeripherals(4));
+
+   c.Revalidate(MakeKey("COM1", "v1"), []() -> HubDiscoveryCache::PeripheralList {
+      throw CMMError("Detection failed");
+   });
+   c.WaitForRevalidations();
+   REQUIRE(c.Lookup(MakeKey("COM1", "v1"), result));
+   CHECK(result == MakePeripherals(4));
+}
+
+TEST_CASE("only one revalidation runs per hub", "[HubDiscoveryCache]")
+{
+   HubDiscoveryCache c;
+   std::promise<void> release;
+   std::shared_future<void> released = release.get_future().share();
+
+   CHECK(c.Revalidate(MakeKey("COM1", "v1"), [released] {
+      released.wait();
+      return MakePeripherals(2);
+   }));
+
+   // Same hub (the identity does not matter); not started
+   CHECK_FALSE(c.Revalidate(MakeKey("COM1", "v1"), [] {
+      return MakePeripherals(5);
+   }));
+   CHECK_FALSE(c.Revalidate(MakeKey("COM1", "v2"), [] {
+      return MakePeripherals(5);
+   }));
+
+   // Another hub
+   CHECK(c.Revalidate(MakeKey("COM2", "v1"), [] { return MakePeripherals(1); }));
+
+   release.set_value();
+   c.WaitForRevalidations();
+   HubDiscoveryCache::PeripheralList result;
+   REQUIRE(c.Lookup(MakeKey("COM1", "v1"), result));
+   CHECK(result == MakePeripherals(2));
+   REQUIRE(c.Lookup(MakeKey("COM2", "v1"), result));
+   CHECK(result == MakePeripherals(1));
+}
+
+TEST_CASE("finished revalidation allows a new one", "[HubDiscoveryCache]")
+{
+   HubDiscoveryCache c;
+   std::promise<void> done;
+   std::future<void> doneFuture = done.get_future();
+   REQUIRE(c.Revalidate(MakeKey("COM1", "v1"), [&done] {
+      done.set_value();
+      return MakePeripherals(1);
+   }));
+   doneFuture.wait();
+
+   // The first thread is reaped without calling WaitForRevalidations()
+   bool started = false;
+   for (int i = 0; i < 500 && !started; ++i)
+   {
+      started = c.Revalidate(MakeKey("COM1", "v1"), [] {
+         return MakePeripherals(3);
+      });
+      if (!started)
+         std::this_thread::sleep_for(std::chrono::milliseconds(10));
+   }
+   CHECK(started);
+
+   c.WaitForRevalidations();
+   HubDiscoveryCache::PeripheralList result;
+   REQUIRE(c.Lookup(MakeKey("COM1", "v1"), result));
+   CHECK(result == MakePeripherals(3));
+}
+
+} // namespace mm
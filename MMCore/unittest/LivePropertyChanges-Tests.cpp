@@ -0,0 +1,175 @@
+#include <catch2/catch_all.hpp>
+
+#include "LivePropertyChanges.h"
+#include "MockDeviceUtils.h"
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+
+namespace mm {
+
+namespace {
+
+const MM::Device* const camera = reinterpret_cast<const MM::Device*>(1);
+const MM::Device* const otherCamera = reinterpret_cast<const MM::Device*>(2);
+
+typedef std::pair<std::string, std::string> Change;
+
+} // anonymous namespace
+
+TEST_CASE("pending changes are taken in queued order", "[LivePropertyChanges]")
+{
+   LivePropertyChanges c;
+   c.Queue(camera, "Exposure", "10");
+   c.Queue(camera, "Gain", "2");
+   c.Queue(otherCamera, "Exposure", "50");
+   CHECK(c.GetPendingCount(camera) == 2);
+
+   LivePropertyChanges::Changes pending = c.TakePending(camera);
+   REQUIRE(pending.size() == 2);
+   CHECK(pending[0] == Change("Exposure", "10"));
+   CHECK(pending[1] == Change("Gain", "2"));
+   CHECK(c.GetPendingCount(camera) == 0);
+   CHECK(c.TakePending(camera).empty());
+   CHECK(c.GetPendingCount(otherCamera) == 1);
+}
+
+TEST_CASE("later value replaces pending value", "[LivePropertyChanges]")
+{
+   LivePropertyChanges c;
+   c.Queue(camera, "Exposure", "10");
+   c.Queue(camera, "Gain", "2");
+   c.Queue(camera, "Exposure", "20");
+
+   LivePropertyChanges::Changes pending = c.TakePending(camera);
+   REQUIRE(pending.size() == 2);
+   CHECK(pending[0] == Change("Exposure", "20"));
+   CHECK(pending[1] == Change("Gain", "2"));
+}
+
+TEST_CASE("applied changes are reported once", "[LivePropertyChanges]")
+{
+   LivePropertyChanges c;
+   c.AddApplied(camera, LivePropertyChanges::Changes{ Change("Exposure", "10") });
+   c.AddApplied(camera, LivePropertyChanges::Changes{ Change("Exposure", "20") });
+
+   LivePropertyChanges::Changes applied = c.TakeApplied(camera);
+   REQUIRE(applied.size() == 1);
+   CHECK(applied[0] == Change("Exposure", "20"));
+   CHECK(c.TakeApplied(camera).empty());
+   CHECK(c.TakeApplied(otherCamera).empty());
+}
+
+TEST_CASE("clear forgets a camera's changes", "[LivePropertyChanges]")
+{
+   LivePropertyChanges c;
+   c.Queue(camera, "Exposure", "10");
+   c.AddApplied(camera, LivePropertyChanges::Changes{ Change("Gain", "2") });
+   c.Queue(otherCamera, "Exposure", "10");
+   c.Clear(camera);
+   CHECK(c.GetPendingCount(camera) == 0);
+   CHECK(c.TakeApplied(camera).empty());
+   CHECK(c.GetPendingCount(otherCamera) == 1);
+   c.ClearAll();
+   CHECK(c.GetPendingCount(otherCamera) == 0);
+}
+
+TEST_CASE("changes are applied from another thread after a frame",
+      "[LivePropertyChanges]")
+{
+   LivePropertyChanges c;
+   std::mutex frameLock;
+   std::atomic<bool> applied(false);
+   c.SetApplyFunction([&](const MM::Device* cam) {
+      std::lock_guard<std::mutex> lock(frameLock);
+      c.TakePending(cam);
+      applied = true;
+   });
+
+   c.FrameReceived(camera); // Nothing pending
+   c.Queue(camera, "Exposure", "10");
+   {
+      // Must return although the apply function cannot run yet
+      std::lock_guard<std::mutex> lock(frameLock);
+      c.FrameReceived(camera);
+      std::this_thread::sleep_for(std::chrono::milliseconds(20));
+      CHECK_FALSE(applied);
+   }
+   for (int i = 0; i < 500 && !applied; ++i)
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+   CHECK(applied);
+   CHECK(c.GetPendingCount(camera) == 0);
+   c.Shutdown();
+}
+
+namespace {
+
+// Holds its own lock across InsertImage() and needs the same lock to set a
+// property, as many camera adapters do
+class LockingCamera : public test::MockCamera
+{
+   std::mutex sequenceLock_;
+   std::atomic<bool> inserting_;
+   std::thread::id insertingThread_;
+
+public:
+   std::atomic<bool> setOnInsertingThread;
+
+   LockingCamera() : inserting_(false), setOnInsertingThread(false) {}
+
+   int Initialize() override
+   {
+      return CreateIntegerProperty("Gain", 1, false, new MM::ActionLambda(
+               [this](MM::PropertyBase*, MM::ActionType act) {
+                  if (act != MM::AfterSet)
+                     return DEVICE_OK;
+                  if (inserting_ &&
+                        insertingThread_ == std::this_thread::get_id())
+                  {
+                     setOnInsertingThread = true; // Would deadlock
+                     return DEVICE_ERR;
+                  }
+                  std::lock_guard<std::mutex> lock(sequenceLock_);
+                  return DEVICE_OK;
+               }));
+   }
+
+protected:
+   int InsertImage() override
+   {
+      std::lock_guard<std::mutex> lock(sequenceLock_);
+      insertingThread_ = std::this_thread::get_id();
+      inserting_ = true;
+      int ret = test::MockCamera::InsertImage();
+      inserting_ = false;
+      return ret;
+   }
+};
+
+} // anonymous namespace
+
+TEST_CASE("camera holding a lock across InsertImage can receive changes",
+      "[LivePropertyChanges]")
+{
+   LockingCamera cam;
+   test::MockAdapterWithDevices adapter{ {"Cam", &cam} };
+   CMMCore core;
+   adapter.LoadIntoCore(core);
+   core.setCameraDevice("Cam");
+
+   core.startContinuousSequenceAcquisition(0.0);
+   core.setPropertyAtNextFrame("Cam", "Gain", "2");
+   for (int i = 0; i < 500 && core.getPendingPropertyChangeCount("Cam") > 0; ++i)
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+   CHECK(core.getPendingPropertyChangeCount("Cam") == 0);
+   core.stopSequenceAcquisition();
+
+   CHECK_FALSE(cam.setOnInsertingThread);
+   CHECK(core.getProperty("Cam", "Gain") == "2");
+}
+
+} // namespace mm
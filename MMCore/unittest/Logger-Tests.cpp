@@ -2,8 +2,10 @@
 
 #include "Logging/Logging.h"
 
+#include <chrono>
 #include <functional>
 #include <memory>
+#include <mutex>
 #include <string>
 #include <thread>
 #include <vector>
@@ -119,5 +121,216 @@ TEST_CASE("async logger on thread", "[Logger]")
       threads[i]->join();
 }
 
+
+// Collects the first line of each entry
+class CollectingSink : public LogSink
+{
+   std::mutex mutex_;
+   std::vector<std::string> entries_;
+
+public:
+   virtual void Consume(const PacketArrayType& packets)
+   {
+      std::lock_guard<std::mutex> lock(mutex_);
+      for (auto it = packets.Begin(); it != packets.End(); ++it)
+      {
+         if (it->GetPacketState() == internal::PacketStateEntryFirstLine)
+            entries_.push_back(it->GetText());
+      }
+   }
+
+   std::vector<std::string> GetEntries()
+   {
+      std::lock_guard<std::mutex> lock(mutex_);
+      return entries_;
+   }
+};
+
+
+TEST_CASE("entry throttle collapses repeats", "[Logger]")
+{
+   typedef internal::GenericEntryThrottle<Metadata> Throttle;
+   EntryThrottleSettings settings;
+   settings.deduplicate = true;
+   settings.repeatSummaryIntervalS = 10.0;
+   Throttle throttle("mylabel", settings);
+   const Throttle::Clock::time_point t0 = Throttle::Clock::now();
+   Throttle::SummaryList summaries;
+
+   CHECK(throttle.Admit(LogLevelDebug, "A", t0, summaries));
+   CHECK_FALSE(throttle.Admit(LogLevelDebug, "A", t0, summaries));
+   CHECK_FALSE(throttle.Admit(LogLevelDebug, "A", t0, summaries));
+   CHECK(summaries.empty());
+
+   // A run reaching the interval is reported without waiting for its end
+   CHECK_FALSE(throttle.Admit(LogLevelDebug, "A",
+            t0 + std::chrono::seconds(5), summaries));
+   CHECK(summaries.empty());
+   CHECK_FALSE(throttle.Admit(LogLevelDebug, "A",
+            t0 + std::chrono::seconds(11), summaries));
+   REQUIRE(summaries.size() == 1);
+   CHECK(summaries[0].second == "Last message repeated 4 times");
+   CHECK(summaries[0].first.GetLevel() == LogLevelDebug);
+   summaries.clear();
+
+   CHECK_FALSE(throttle.Admit(LogLevelDebug, "A",
+            t0 + std::chrono::seconds(12), summaries));
+   CHECK(throttle.Admit(LogLevelInfo, "B",
+            t0 + std::chrono::seconds(12), summaries));
+   REQUIRE(summaries.size() == 1);
+   CHECK(summaries[0].second == "Last message repeated 1 times");
+   summaries.clear();
+
+   CHECK(throttle.GetRepeatCount() == 5);
+   CHECK_FALSE(throttle.HasPending());
+   CHECK_FALSE(throttle.Admit(LogLevelInfo, "B", t0, summaries));
+   CHECK(throttle.HasPending());
+   throttle.Flush(summaries);
+   REQUIRE(summaries.size() == 1);
+   CHECK(summaries[0].second == "Last message repeated 1 times");
+}
+
+
+TEST_CASE("entry throttle rate limit", "[Logger]")
+{
+   typedef internal::GenericEntryThrottle<Metadata> Throttle;
+   EntryThrottleSettings settings;
+   settings.rateLimitPerS = 10.0;
+   settings.rateLimitBurst = 3.0;
+   settings.rateLimitFilter = [](const EntryData& entryData)
+      { return entryData.GetLevel() < LogLevelWarning; };
+   Throttle throttle("mylabel", settings);
+   const Throttle::Clock::time_point t0 = Throttle::Clock::now();
+   Throttle::SummaryList summaries;
+
+   for (int i = 0; i < 3; ++i)
+      CHECK(throttle.Admit(LogLevelDebug, "x", t0, summaries));
+   CHECK_FALSE(throttle.Admit(LogLevelDebug, "x", t0, summaries));
+   CHECK_FALSE(throttle.Admit(LogLevelDebug, "y", t0, summaries));
+   // Warnings are exempt
+   CHECK(throttle.Admit(LogLevelWarning, "w", t0, summaries));
+   CHECK(summaries.empty());
+   CHECK(throttle.GetRateLimitedCount() == 2);
+
+   // 100 ms refills one token
+   CHECK(throttle.Admit(LogLevelDebug, "z",
+            t0 + std::chrono::milliseconds(100), summaries));
+   REQUIRE(summaries.size() == 1);
+   CHECK(summaries[0].second == "2 entries suppressed by rate limit");
+   CHECK_FALSE(throttle.Admit(LogLevelDebug, "z",
+            t0 + std::chrono::milliseconds(100), summaries));
+
+   throttle.ResetCounts();
+   CHECK(throttle.GetRateLimitedCount() == 0);
+}
+
+
+TEST_CASE("logging core reports suppressed entries", "[Logger]")
+{
+   std::shared_ptr<LoggingCore> c =
+      std::make_shared<LoggingCore>();
+   std::shared_ptr<CollectingSink> sink = std::make_shared<CollectingSink>();
+   c->AddSink(sink, SinkModeSynchronous);
+
+   EntryThrottleSettings settings;
+   settings.deduplicate = true;
+   c->SetThrottleSettings(settings);
+
+   Logger lgr1 = c->NewLogger("label1");
+   Logger lgr2 = c->NewLogger("label2");
+   for (int i = 0; i < 100; ++i)
+   {
+      lgr1(LogLevelDebug, "Same");
+      lgr2(LogLevelDebug, "Entry " + std::to_string(i));
+   }
+   lgr1(LogLevelDebug, "Different");
+
+   std::vector<std::string> entries = sink->GetEntries();
+   REQUIRE(entries.size() == 103);
+   CHECK(entries[0] == "Same");
+   CHECK(entries[101] == "Last message repeated 99 times");
+   CHECK(entries[102] == "Different");
+
+   lgr1(LogLevelDebug, "Different");
+   c->FlushThrottledEntries();
+   entries = sink->GetEntries();
+   REQUIRE(entries.size() == 104);
+   CHECK(entries[103] == "Last message repeated 1 times");
+
+   std::vector<LoggingCore::ThrottleCounts> counts = c->GetThrottleCounts();
+   REQUIRE(counts.size() == 1);
+   CHECK(std::string(counts[0].loggerData.GetComponentLabel()) == "label1");
+   CHECK(counts[0].repeats == 100);
+   CHECK(counts[0].rateLimited == 0);
+
+   // Disabling reports nothing further and lets repeats through
+   c->SetThrottleSettings(EntryThrottleSettings());
+   lgr1(LogLevelDebug, "Different");
+   CHECK(sink->GetEntries().size() == 105);
+}
+
+
+TEST_CASE("destroying a logger reports its suppressed entries", "[Logger]")
+{
+   std::shared_ptr<LoggingCore> c =
+      std::make_shared<LoggingCore>();
+   std::shared_ptr<CollectingSink> sink = std::make_shared<CollectingSink>();
+   c->AddSink(sink, SinkModeSynchronous);
+
+   EntryThrottleSettings settings;
+   settings.deduplicate = true;
+   c->SetThrottleSettings(settings);
+
+   {
+      Logger lgr = c->NewLogger("label");
+      Logger copy = lgr;
+      for (int i = 0; i < 3; ++i)
+         lgr(LogLevelDebug, "Same");
+      CHECK(sink->GetEntries().size() == 1);
+   }
+
+   // Summarized without an explicit flush
+   std::vector<std::string> entries = sink->GetEntries();
+   REQUIRE(entries.size() == 2);
+   CHECK(entries[1] == "Last message repeated 2 times");
+
+   std::vector<LoggingCore::ThrottleCounts> counts = c->GetThrottleCounts();
+   REQUIRE(counts.size() == 1);
+   CHECK(std::string(counts[0].loggerData.GetComponentLabel()) == "label");
+   CHECK(counts[0].repeats == 2);
+
+   c->ResetThrottleCounts();
+   CHECK(c->GetThrottleCounts().empty());
+
+   // Loggers that suppressed nothing leave no trace
+   for (int i = 0; i < 10; ++i)
+      c->NewLogger("other")(LogLevelDebug, "Entry");
+   CHECK(c->GetThrottleCounts().empty());
+   CHECK(sink->GetEntries().size() == 12);
+}
+
+
+TEST_CASE("inactive entry throttle admits everything", "[Logger]")
+{
+   typedef internal::GenericEntryThrottle<Metadata> Throttle;
+   Throttle throttle("mylabel", EntryThrottleSettings());
+   const Throttle::Clock::time_point t0 = Throttle::Clock::now();
+   Throttle::SummaryList summaries;
+
+   CHECK(throttle.Admit(LogLevelDebug, "A", t0, summaries));
+   CHECK(throttle.Admit(LogLevelDebug, "A", t0, summaries));
+
+   EntryThrottleSettings settings;
+   settings.deduplicate = true;
+   throttle.SetSettings(settings, summaries);
+   CHECK(throttle.Admit(LogLevelDebug, "A", t0, summaries));
+   CHECK_FALSE(throttle.Admit(LogLevelDebug, "A", t0, summaries));
+
+   throttle.SetSettings(EntryThrottleSettings(), summaries);
+   REQUIRE(summaries.size() == 1);
+   CHECK(throttle.Admit(LogLevelDebug, "A", t0, summaries));
+   CHECK(throttle.GetRepeatCount() == 1);
+}
+
 } // namespace logging
 } // namespace mm
\ No newline at end of file
@@ -0,0 +1,197 @@
+#pragma once
+
+#include "DeviceBase.h"
+#include "LoadableModules/MockDeviceAdapter.h"
+#include "MMCore.h"
+#include "PluginManager.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <initializer_list>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace mm {
+namespace test {
+
+// The test-only entry points of the Core (a friend of CMMCore and
+// CPluginManager)
+class CoreTestAccess
+{
+public:
+   // Register a device adapter implemented by the test under the given
+   // module name. The adapter must outlive the Core.
+   static void LoadMockDeviceAdapter(CMMCore& core, const char* name,
+         MockDeviceAdapter* implementation)
+   {
+      core.pluginManager_->LoadMockAdapter(name, implementation);
+   }
+};
+
+// Device adapter providing devices owned by the test, keyed by the label to
+// load them with. As in a real adapter, each device is registered under the
+// name it reports, so each must have a distinct name. The devices must
+// outlive the CMMCore they are loaded into.
+class MockAdapterWithDevices : public MockDeviceAdapter
+{
+   std::vector<std::pair<std::string, MM::Device*>> devices_;
+
+   static std::string NameOf(MM::Device* device)
+   {
+      char name[MM::MaxStrLength];
+      device->GetName(name);
+      return name;
+   }
+
+public:
+   MockAdapterWithDevices(
+         std::initializer_list<std::pair<std::string, MM::Device*>> devices) :
+      devices_(devices)
+   {}
+
+   void InitializeModuleData(RegisterDeviceFunction registerDevice) override
+   {
+      for (const auto& device : devices_)
+         registerDevice(NameOf(device.second).c_str(),
+               device.second->GetType(), "");
+   }
+
+   MM::Device* CreateDevice(const char* name) override
+   {
+      for (const auto& device : devices_)
+      {
+         if (NameOf(device.second) == name)
+            return device.second;
+      }
+      return nullptr;
+   }
+
+   void DeleteDevice(MM::Device*) override {}
+
+   // Load and initialize all the devices
+   void LoadIntoCore(CMMCore& core, const char* moduleName = "MockAdapter")
+   {
+      CoreTestAccess::LoadMockDeviceAdapter(core, moduleName, this);
+      for (const auto& device : devices_)
+         core.loadDevice(device.first.c_str(), moduleName,
+               NameOf(device.second).c_str());
+      for (const auto& device : devices_)
+         core.initializeDevice(device.first.c_str());
+   }
+};
+
+// 16x16 8-bit camera using the CCameraBase sequence thread. Each snap fills
+// the image with pixelValue.
+class MockCamera : public CCameraBase<MockCamera>
+{
+   std::vector<unsigned char> image_;
+   double exposure_;
+
+public:
+   std::atomic<long> snapCount;
+   std::atomic<unsigned char> pixelValue;
+
+   MockCamera() : image_(16 * 16), exposure_(10.0), snapCount(0),
+      pixelValue(0) {}
+
+   int Initialize() override { return DEVICE_OK; }
+   int Shutdown() override { return DEVICE_OK; }
+   void GetName(char* name) const override
+   { CDeviceUtils::CopyLimitedString(name, "MockCamera"); }
+
+   int SnapImage() override
+   {
+      ++snapCount;
+      std::fill(image_.begin(), image_.end(), pixelValue.load());
+      return DEVICE_OK;
+   }
+   const unsigned char* GetImageBuffer() override { return image_.data(); }
+   unsigned GetImageWidth() const override { return 16; }
+   unsigned GetImageHeight() const override { return 16; }
+   unsigned GetImageBytesPerPixel() const override { return 1; }
+   unsigned GetBitDepth() const override { return 8; }
+   long GetImageBufferSize() const override
+   { return static_cast<long>(image_.size()); }
+
+   double GetExposure() const override { return exposure_; }
+   void SetExposure(double exposureMs) override { exposure_ = exposureMs; }
+   int SetROI(unsigned, unsigned, unsigned, unsigned) override
+   { return DEVICE_OK; }
+   int GetROI(unsigned& x, unsigned& y, unsigned& w, unsigned& h) override
+   {
+      x = y = 0;
+      w = h = 16;
+      return DEVICE_OK;
+   }
+   int ClearROI() override { return DEVICE_OK; }
+   int GetBinning() const override { return 1; }
+   int SetBinning(int binning) override
+   { return binning == 1 ? DEVICE_OK : DEVICE_INVALID_PROPERTY_VALUE; }
+   int IsExposureSequenceable(bool& sequenceable) const override
+   {
+      sequenceable = false;
+      return DEVICE_OK;
+   }
+};
+
+// Image processor that increments every pixel (and so is not idempotent)
+class MockImageProcessor : public CImageProcessorBase<MockImageProcessor>
+{
+public:
+   std::atomic<long> processCount;
+
+   MockImageProcessor() : processCount(0) {}
+
+   int Initialize() override { return DEVICE_OK; }
+   int Shutdown() override { return DEVICE_OK; }
+   void GetName(char* name) const override
+   { CDeviceUtils::CopyLimitedString(name, "MockImageProcessor"); }
+   bool Busy() override { return false; }
+
+   int Process(unsigned char* buffer, unsigned width, unsigned height,
+         unsigned byteDepth) override
+   {
+      ++processCount;
+      const std::size_t size =
+         static_cast<std::size_t>(width) * height * byteDepth;
+      for (std::size_t i = 0; i < size; ++i)
+         ++buffer[i];
+      return DEVICE_OK;
+   }
+};
+
+// Shutter that counts how often it is opened
+class MockShutter : public CShutterBase<MockShutter>
+{
+   std::atomic<bool> open_;
+
+public:
+   std::atomic<long> openCount;
+
+   MockShutter() : open_(false), openCount(0) {}
+
+   int Initialize() override { return DEVICE_OK; }
+   int Shutdown() override { return DEVICE_OK; }
+   void GetName(char* name) const override
+   { CDeviceUtils::CopyLimitedString(name, "MockShutter"); }
+   bool Busy() override { return false; }
+
+   int SetOpen(bool open) override
+   {
+      if (open && !open_)
+         ++openCount;
+      open_ = open;
+      return DEVICE_OK;
+   }
+   int GetOpen(bool& open) override
+   {
+      open = open_;
+      return DEVICE_OK;
+   }
+   int Fire(double) override { return DEVICE_UNSUPPORTED_COMMAND; }
+};
+
+} // namespace test
+} // namespace mm
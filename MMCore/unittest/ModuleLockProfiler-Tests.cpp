@@ -0,0 +1,90 @@
+#include <catch2/catch_all.hpp>
+
+#include "ModuleLockProfiler.h"
+
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace mm {
+
+TEST_CASE("stats are kept per module and caller", "[ModuleLockProfiler]")
+{
+   ModuleLockProfiler p;
+   p.Record("Demo", "setProperty", 1.0, 2.0, "");
+   p.Record("Demo", "setProperty", 3.0, 1.0, "");
+   p.Record("Demo", "snapImage", 0.0, 10.0, "");
+   p.Record("Hub", "setProperty", 0.5, 0.5, "");
+
+   std::vector<ModuleLockProfiler::Stats> stats = p.GetStats();
+   REQUIRE(stats.size() == 3);
+   // By decreasing total wait
+   CHECK(stats[0].module == "Demo");
+   CHECK(stats[0].caller == "setProperty");
+   CHECK(stats[0].count == 2);
+   CHECK(stats[0].totalWaitMs == 4.0);
+   CHECK(stats[0].maxWaitMs == 3.0);
+   CHECK(stats[0].totalHoldMs == 3.0);
+   CHECK(stats[0].maxHoldMs == 2.0);
+   CHECK(stats[1].module == "Hub");
+   CHECK(stats[2].caller == "snapImage");
+
+   p.Reset();
+   CHECK(p.GetStats().empty());
+   CHECK(p.GetLongestHolds().empty());
+}
+
+TEST_CASE("only the longest holds are kept", "[ModuleLockProfiler]")
+{
+   ModuleLockProfiler p(2);
+   p.Record("Demo", "a", 0.0, 5.0, "a [Demo]");
+   p.Record("Demo", "b", 0.0, 1.0, "b [Demo]");
+   CHECK_FALSE(p.IsLongestHold(0.5));
+   CHECK(p.IsLongestHold(7.0));
+   p.Record("Demo", "c", 0.0, 7.0, "c [Demo]");
+
+   std::vector<ModuleLockProfiler::Hold> holds = p.GetLongestHolds();
+   REQUIRE(holds.size() == 2);
+   CHECK(holds[0].caller == "c");
+   CHECK(holds[0].holdMs == 7.0);
+   CHECK(holds[1].caller == "a");
+   CHECK(holds[1].context == "a [Demo]");
+}
+
+TEST_CASE("context lists the locks held by the thread", "[ModuleLockProfiler]")
+{
+   CHECK(ModuleLockProfiler::CurrentContext().empty());
+   ModuleLockProfiler::EnterContext("Utilities", "setConfig");
+   ModuleLockProfiler::EnterContext("Demo", "setProperty");
+   CHECK(ModuleLockProfiler::CurrentContext() ==
+         "setConfig [Utilities] > setProperty [Demo]");
+
+   std::string otherThreadContext = "x";
+   std::thread t([&] {
+      otherThreadContext = ModuleLockProfiler::CurrentContext();
+   });
+   t.join();
+   CHECK(otherThreadContext.empty());
+
+   ModuleLockProfiler::LeaveContext();
+   CHECK(ModuleLockProfiler::CurrentContext() == "setConfig [Utilities]");
+   ModuleLockProfiler::LeaveContext();
+   CHECK(ModuleLockProfiler::CurrentContext().empty());
+}
+
+TEST_CASE("summary is passed to the sink after the interval", "[ModuleLockProfiler]")
+{
+   ModuleLockProfiler p;
+   std::vector<std::string> summaries;
+   p.SetSummaryInterval(1e6, [&](const std::string& s) { summaries.push_back(s); });
+   p.Record("Demo", "snapImage", 0.0, 1.0, "");
+   CHECK(summaries.empty());
+
+   p.SetSummaryInterval(1e-9, [&](const std::string& s) { summaries.push_back(s); });
+   std::this_thread::sleep_for(std::chrono::milliseconds(1));
+   p.Record("Demo", "snapImage", 0.0, 1.0, "");
+   REQUIRE(summaries.size() == 1);
+   CHECK(summaries[0].find("Demo, snapImage, 2,") != std::string::npos);
+}
+
+} // namespace mm
@@ -0,0 +1,139 @@
+#include <catch2/catch_all.hpp>
+
+#include "MoveScheduler.h"
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+namespace mm {
+
+TEST_CASE("move completes when device becomes non-busy", "[MoveScheduler]")
+{
+   MoveScheduler s;
+   std::atomic<int> polls(0);
+   long h = s.Add("Z", [&] { return ++polls < 3; }, 5000, 10);
+   s.Wait(std::vector<long>(1, h));
+   CHECK(polls == 3);
+   CHECK(s.GetPendingCount() == 0);
+   CHECK_THROWS_AS(s.IsDone(h), CMMError);
+}
+
+TEST_CASE("wait for several moves at once", "[MoveScheduler]")
+{
+   MoveScheduler s;
+   auto start = std::chrono::steady_clock::now();
+   auto busyFor = [start](int ms) {
+      return [start, ms] {
+         return std::chrono::steady_clock::now() - start <
+            std::chrono::milliseconds(ms);
+      };
+   };
+   std::vector<long> handles;
+   handles.push_back(s.Add("XY", busyFor(30), 5000, 10));
+   handles.push_back(s.Add("Z", busyFor(10), 5000, 10));
+   handles.push_back(s.Add("Filter", busyFor(20), 5000, 10));
+   s.Wait(handles);
+   CHECK(std::chrono::steady_clock::now() - start >=
+         std::chrono::milliseconds(30));
+   CHECK(s.GetPendingCount() == 0);
+}
+
+TEST_CASE("move times out", "[MoveScheduler]")
+{
+   MoveScheduler s;
+   long h = s.Add("Z", [] { return true; }, 20, 5);
+   try
+   {
+      s.Wait(std::vector<long>(1, h));
+      FAIL("Wait() did not throw");
+   }
+   catch (const CMMError& e)
+   {
+      CHECK(e.getCode() == MMERR_DevicePollingTimeout);
+   }
+}
+
+TEST_CASE("errors from busy function are reported", "[MoveScheduler]")
+{
+   MoveScheduler s;
+   long bad = s.Add("Z", []() -> bool { throw CMMError("oops"); }, 5000, 10);
+   long good = s.Add("XY", [] { return false; }, 5000, 10);
+   std::vector<long> handles;
+   handles.push_back(good);
+   handles.push_back(bad);
+   CHECK_THROWS_AS(s.Wait(handles), CMMError);
+   CHECK(s.GetPendingCount() == 0);
+}
+
+TEST_CASE("notify triggers immediate poll", "[MoveScheduler]")
+{
+   MoveScheduler s;
+   std::atomic<bool> arrived(false);
+   // Long maximum interval: without Notify(), completion would be detected
+   // late.
+   long h = s.Add("Z", [&] { return !arrived.load(); }, 10000, 5000);
+   std::this_thread::sleep_for(std::chrono::milliseconds(100));
+   arrived = true;
+   auto notified = std::chrono::steady_clock::now();
+   s.Notify("Z");
+   s.Wait(std::vector<long>(1, h));
+   CHECK(std::chrono::steady_clock::now() - notified <
+         std::chrono::milliseconds(1000));
+}
+
+TEST_CASE("cancel finishes moves with error", "[MoveScheduler]")
+{
+   MoveScheduler s;
+   long h = s.Add("Z", [] { return true; }, 10000, 10);
+   s.Cancel("Z");
+   CHECK(s.IsDone(h));
+   CHECK_THROWS_AS(s.Wait(std::vector<long>(1, h)), CMMError);
+}
+
+TEST_CASE("moves polled with IsDone are not retained", "[MoveScheduler]")
+{
+   MoveScheduler s(1, 2);
+   std::vector<long> handles;
+   for (int i = 0; i < 4; ++i)
+   {
+      long h = s.Add("Z", [] { return false; }, 5000, 10);
+      while (!s.IsDone(h))
+         std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      handles.push_back(h);
+   }
+   CHECK(s.GetPendingCount() == 0);
+   // Only the two most recently reported moves are remembered
+   CHECK_THROWS_AS(s.IsDone(handles[0]), CMMError);
+   CHECK_THROWS_AS(s.IsDone(handles[1]), CMMError);
+   CHECK(s.IsDone(handles[2]));
+   s.Wait(std::vector<long>(1, handles[3]));
+   CHECK_THROWS_AS(s.IsDone(handles[3]), CMMError);
+}
+
+TEST_CASE("moves that are never waited on are not retained",
+   "[MoveScheduler]")
+{
+   MoveScheduler s(1, 10);
+   std::vector<long> handles;
+   for (int i = 0; i < 1000; ++i)
+      handles.push_back(s.Add("Z", [] { return false; }, 5000, 10));
+   for (int i = 0; i < 5000 && s.GetPendingCount() > 0; ++i)
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+   CHECK(s.GetPendingCount() == 0);
+   // Only the ten most recently finished moves are remembered
+   CHECK_THROWS_AS(s.IsDone(handles.front()), CMMError);
+   CHECK_THROWS_AS(s.Wait(std::vector<long>(1, handles[500])), CMMError);
+   CHECK(s.IsDone(handles.back()));
+   s.Wait(std::vector<long>(1, handles.back()));
+}
+
+TEST_CASE("unknown handle", "[MoveScheduler]")
+{
+   MoveScheduler s;
+   CHECK_THROWS_AS(s.IsDone(42), CMMError);
+   CHECK_THROWS_AS(s.Wait(std::vector<long>(1, 42)), CMMError);
+}
+
+} // namespace mm
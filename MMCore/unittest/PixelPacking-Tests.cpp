@@ -0,0 +1,77 @@
+#include <catch2/catch_all.hpp>
+
+#include "PixelPacking.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace mm {
+
+TEST_CASE("packed size rounds up to whole groups", "[PixelPacking]")
+{
+   CHECK(PackedSize(8, 12) == 12);
+   CHECK(PackedSize(9, 12) == 18);
+   CHECK(PackedSize(4, 10) == 5);
+   CHECK(PackedSize(1, 14) == 7);
+   CHECK(PackedSize(0, 12) == 0);
+   CHECK(IsPackableBitDepth(12));
+   CHECK_FALSE(IsPackableBitDepth(16));
+   CHECK_FALSE(IsPackableBitDepth(11));
+}
+
+TEST_CASE("pixels survive packing at each bit depth", "[PixelPacking]")
+{
+   for (unsigned bits : {10u, 12u, 14u})
+   {
+      // Not a multiple of the group size
+      std::vector<std::uint16_t> src(1001);
+      for (std::size_t i = 0; i < src.size(); ++i)
+         src[i] = static_cast<std::uint16_t>((i * 2654435761u) % (1u << bits));
+      src[0] = 0;
+      src[1] = static_cast<std::uint16_t>((1u << bits) - 1);
+
+      std::vector<unsigned char> packed(PackedSize(src.size(), bits));
+      PackPixels(src.data(), src.size(), bits, packed.data());
+      std::vector<std::uint16_t> dst(src.size());
+      UnpackPixels(packed.data(), dst.size(), bits, dst.data());
+      CHECK(dst == src);
+   }
+}
+
+TEST_CASE("packed layout is a little-endian bit stream", "[PixelPacking]")
+{
+   const std::uint16_t src[] = { 0x123, 0x456, 0x789, 0xabc };
+   unsigned char packed[6];
+   PackPixels(src, 4, 12, packed);
+   const unsigned char expected[] = { 0x23, 0x61, 0x45, 0x89, 0xc7, 0xab };
+   CHECK(std::vector<unsigned char>(packed, packed + 6) ==
+         std::vector<unsigned char>(expected, expected + 6));
+}
+
+TEST_CASE("values beyond the bit depth are saturated", "[PixelPacking]")
+{
+   const std::uint16_t src[] = { 5000, 1023, 65535, 7 };
+   unsigned char packed[5];
+   CHECK(PackPixels(src, 4, 10, packed) == 2);
+   std::uint16_t dst[4];
+   UnpackPixels(packed, 4, 10, dst);
+   CHECK(dst[0] == 1023);
+   CHECK(dst[1] == 1023);
+   CHECK(dst[2] == 1023);
+   CHECK(dst[3] == 7);
+}
+
+TEST_CASE("saturated pixels are counted", "[PixelPacking]")
+{
+   for (unsigned bits : { 10u, 12u, 14u })
+   {
+      // Covers both the whole-word groups and the padded last group
+      std::vector<std::uint16_t> src(1001, 1);
+      src[0] = src[17] = src[18] = src[1000] =
+         static_cast<std::uint16_t>(1u << bits);
+      std::vector<unsigned char> packed(PackedSize(src.size(), bits));
+      CHECK(PackPixels(src.data(), src.size(), bits, packed.data()) == 4);
+   }
+}
+
+} // namespace mm
@@ -0,0 +1,192 @@
+#include <catch2/catch_all.hpp>
+
+#include "ProcessedImageTracker.h"
+#include "MockDeviceUtils.h"
+
+#include <chrono>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+namespace mm {
+
+namespace {
+
+// Non-idempotent processor: increments every pixel
+struct Counter
+{
+   int calls = 0;
+   void operator()(unsigned char* pixels, std::size_t size)
+   {
+      ++calls;
+      for (std::size_t i = 0; i < size; ++i)
+         ++pixels[i];
+   }
+};
+
+} // anonymous namespace
+
+TEST_CASE("image is processed once per snap", "[ProcessedImageTracker]")
+{
+   ProcessedImageTracker t;
+   auto camera = std::make_shared<int>(0);
+   auto processor = std::make_shared<int>(0);
+   std::vector<unsigned char> buffer(4, 10);
+   Counter counter;
+   auto process = [&](unsigned char* p) { counter(p, buffer.size()); };
+
+   unsigned char* result = t.Get(camera, processor, 0, buffer.data(),
+         buffer.size(), process);
+   CHECK(result == buffer.data());
+   result = t.Get(camera, processor, 0, buffer.data(), buffer.size(), process);
+   CHECK(result == buffer.data());
+   CHECK(counter.calls == 1);
+   CHECK(buffer[0] == 11);
+
+   // Each channel is processed separately
+   t.Get(camera, processor, 1, buffer.data(), buffer.size(), process);
+   CHECK(counter.calls == 2);
+
+   t.NewSnap();
+   t.Get(camera, processor, 0, buffer.data(), buffer.size(), process);
+   t.Get(camera, processor, 0, buffer.data(), buffer.size(), process);
+   CHECK(counter.calls == 3);
+}
+
+TEST_CASE("copy leaves the camera buffer untouched", "[ProcessedImageTracker]")
+{
+   ProcessedImageTracker t;
+   auto camera = std::make_shared<int>(0);
+   auto processor = std::make_shared<int>(0);
+   std::vector<unsigned char> buffer(4, 10);
+   Counter counter;
+   auto process = [&](unsigned char* p) { counter(p, buffer.size()); };
+
+   t.SetCopyEnabled(true);
+   CHECK(t.IsCopyEnabled());
+   unsigned char* result = t.Get(camera, processor, 0, buffer.data(),
+         buffer.size(), process);
+   REQUIRE(result != buffer.data());
+   CHECK(result[0] == 11);
+   CHECK(buffer[0] == 10);
+   CHECK(t.Get(camera, processor, 0, buffer.data(), buffer.size(), process) ==
+         result);
+   CHECK(counter.calls == 1);
+
+   // A different processor starts again from the raw image
+   auto processor2 = std::make_shared<int>(0);
+   result = t.Get(camera, processor2, 0, buffer.data(), buffer.size(), process);
+   CHECK(result[0] == 11);
+   CHECK(counter.calls == 2);
+
+   // Mode changes apply from the next snap
+   t.SetCopyEnabled(false);
+   CHECK(t.Get(camera, processor2, 0, buffer.data(), buffer.size(), process) ==
+         result);
+   t.NewSnap();
+   CHECK(t.Get(camera, processor2, 0, buffer.data(), buffer.size(), process) ==
+         buffer.data());
+   CHECK(buffer[0] == 11);
+   CHECK(counter.calls == 3);
+}
+
+TEST_CASE("changed camera buffer is processed again", "[ProcessedImageTracker]")
+{
+   ProcessedImageTracker t;
+   auto camera = std::make_shared<int>(0);
+   auto processor = std::make_shared<int>(0);
+   std::vector<unsigned char> buffer(4, 10);
+   Counter counter;
+   auto process = [&](unsigned char* p) { counter(p, 1); };
+
+   t.Get(camera, processor, 0, buffer.data(), 4, process);
+   t.Get(camera, processor, 0, buffer.data(), 2, process);
+   CHECK(counter.calls == 2);
+   t.Get(camera, processor, 0, buffer.data() + 1, 2, process);
+   CHECK(counter.calls == 3);
+   auto camera2 = std::make_shared<int>(0);
+   t.Get(camera2, processor, 0, buffer.data() + 1, 2, process);
+   CHECK(counter.calls == 4);
+}
+
+TEST_CASE("failed processing is retried", "[ProcessedImageTracker]")
+{
+   ProcessedImageTracker t;
+   auto camera = std::make_shared<int>(0);
+   auto processor = std::make_shared<int>(0);
+   std::vector<unsigned char> buffer(4, 10);
+   int calls = 0;
+   auto failing = [&](unsigned char*) {
+      ++calls;
+      throw std::runtime_error("processing failed");
+   };
+
+   CHECK_THROWS_AS(t.Get(camera, processor, 0, buffer.data(), buffer.size(),
+         failing), std::runtime_error);
+   CHECK_THROWS_AS(t.Get(camera, processor, 0, buffer.data(), buffer.size(),
+         failing), std::runtime_error);
+   CHECK(calls == 2);
+}
+
+TEST_CASE("each snapped image is processed", "[ProcessedImageTracker]")
+{
+   test::MockCamera cam;
+   test::MockImageProcessor proc;
+   test::MockAdapterWithDevices adapter{ {"Cam", &cam}, {"Proc", &proc} };
+   CMMCore core;
+   adapter.LoadIntoCore(core);
+   core.setCameraDevice("Cam");
+   core.setImageProcessorDevice("Proc");
+
+   cam.pixelValue = 10;
+   core.snapImage();
+   CHECK(static_cast<unsigned char*>(core.getImage())[0] == 11);
+   CHECK(static_cast<unsigned char*>(core.getImage())[0] == 11);
+
+   // Same buffer address and size, different pixels
+   cam.pixelValue = 20;
+   core.snapImage();
+   CHECK(static_cast<unsigned char*>(core.getImage())[0] == 21);
+   CHECK(proc.processCount == 2);
+}
+
+TEST_CASE("image during live mode is the latest frame",
+   "[ProcessedImageTracker]")
+{
+   test::MockCamera cam;
+   test::MockImageProcessor proc;
+   test::MockAdapterWithDevices adapter{ {"Cam", &cam}, {"Proc", &proc} };
+   CMMCore core;
+   adapter.LoadIntoCore(core);
+   core.setCameraDevice("Cam");
+   core.setImageProcessorDevice("Proc");
+   core.enableProcessedImageCopy(true);
+   core.snapImage();
+
+   // Frames are processed when inserted, in the camera's buffer
+   auto waitForFrameOf = [&](unsigned char value) {
+      for (int i = 0; i < 500; ++i)
+      {
+         if (core.getRemainingImageCount() > 0 &&
+               static_cast<unsigned char*>(core.getLastImage())[0] == value + 1)
+            return true;
+         std::this_thread::sleep_for(std::chrono::milliseconds(2));
+      }
+      return false;
+   };
+
+   cam.pixelValue = 30;
+   core.startContinuousSequenceAcquisition(0.0);
+   REQUIRE(waitForFrameOf(30));
+   const unsigned char first = static_cast<unsigned char*>(core.getImage())[0];
+   CHECK(first >= 31);
+
+   cam.pixelValue = 40;
+   REQUIRE(waitForFrameOf(40));
+   const unsigned char latest = static_cast<unsigned char*>(core.getImage())[0];
+   core.stopSequenceAcquisition();
+   CHECK(latest >= 41);
+}
+
+} // namespace mm
@@ -0,0 +1,162 @@
+#include <catch2/catch_all.hpp>
+
+#include "DeviceBase.h"
+#include "MMCore.h"
+#include "MockDeviceUtils.h"
+
+#include <string>
+
+namespace mm {
+
+namespace {
+
+// Generic device with a property that counts the writes reaching the device,
+// a property without an action, and a read-only property
+class WriteCountingDevice : public CGenericBase<WriteCountingDevice>
+{
+   std::string value_ = "A";
+
+public:
+   long writeCount = 0;
+
+   int Initialize() override
+   {
+      CreateStringProperty("Value", value_.c_str(), false,
+         new MM::ActionLambda([this](MM::PropertyBase* pProp,
+               MM::ActionType eAct) {
+            if (eAct == MM::BeforeGet)
+            {
+               pProp->Set(value_.c_str());
+            }
+            else if (eAct == MM::AfterSet)
+            {
+               pProp->Get(value_);
+               ++writeCount;
+            }
+            return DEVICE_OK;
+         }));
+      CreateStringProperty("Plain", "A", false);
+      CreateStringProperty("ReadOnly", "A", true);
+      return DEVICE_OK;
+   }
+
+   int Shutdown() override { return DEVICE_OK; }
+   void GetName(char* name) const override
+   { CDeviceUtils::CopyLimitedString(name, "WriteCountingDevice"); }
+   bool Busy() override { return false; }
+
+   // Change the value on the device side and notify the Core
+   void ChangeValue(const std::string& value, bool notifyAll)
+   {
+      value_ = value;
+      if (notifyAll)
+         OnPropertiesChanged();
+      else
+         OnPropertyChanged("Value", value_.c_str());
+   }
+};
+
+} // anonymous namespace
+
+TEST_CASE("identical property value is not written again",
+   "[PropertyWriteSuppression]")
+{
+   WriteCountingDevice dev;
+   test::MockAdapterWithDevices adapter{ {"Dev", &dev} };
+   CMMCore core;
+   adapter.LoadIntoCore(core);
+   core.enableRedundantPropertyWriteSuppression("Dev", true);
+
+   core.setProperty("Dev", "Value", "B");
+   CHECK(dev.writeCount == 1);
+   core.setProperty("Dev", "Value", "B");
+   CHECK(dev.writeCount == 1);
+   CHECK(core.getSuppressedPropertyWriteCount("Dev") == 1);
+
+   core.setProperty("Dev", "Value", "C");
+   CHECK(dev.writeCount == 2);
+   CHECK(core.getProperty("Dev", "Value") == "C");
+   CHECK(core.getSuppressedPropertyWriteCount("Dev") == 1);
+}
+
+TEST_CASE("property writes are not suppressed unless enabled",
+   "[PropertyWriteSuppression]")
+{
+   WriteCountingDevice dev;
+   test::MockAdapterWithDevices adapter{ {"Dev", &dev} };
+   CMMCore core;
+   adapter.LoadIntoCore(core);
+
+   core.setProperty("Dev", "Value", "B");
+   core.setProperty("Dev", "Value", "B");
+   CHECK(dev.writeCount == 2);
+   CHECK(core.getSuppressedPropertyWriteCount("Dev") == 0);
+
+   core.enableRedundantPropertyWriteSuppression("Dev", true);
+   core.enableRedundantPropertyWriteSuppression("Dev", "Value", false);
+   core.setProperty("Dev", "Value", "B");
+   core.setProperty("Dev", "Value", "B");
+   CHECK(dev.writeCount == 4);
+   CHECK(core.getSuppressedPropertyWriteCount("Dev") == 0);
+}
+
+TEST_CASE("property value is written again after the device reports a change",
+   "[PropertyWriteSuppression]")
+{
+   const bool notifyAll = GENERATE(false, true);
+   WriteCountingDevice dev;
+   test::MockAdapterWithDevices adapter{ {"Dev", &dev} };
+   CMMCore core;
+   adapter.LoadIntoCore(core);
+   core.enableRedundantPropertyWriteSuppression("Dev", true);
+
+   core.setProperty("Dev", "Value", "B");
+   CHECK(dev.writeCount == 1);
+
+   dev.ChangeValue("X", notifyAll);
+   core.setProperty("Dev", "Value", "B");
+   CHECK(dev.writeCount == 2);
+   CHECK(core.getProperty("Dev", "Value") == "B");
+   CHECK(core.getSuppressedPropertyWriteCount("Dev") == 0);
+}
+
+TEST_CASE("writes to read-only properties are never suppressed",
+   "[PropertyWriteSuppression]")
+{
+   WriteCountingDevice dev;
+   test::MockAdapterWithDevices adapter{ {"Dev", &dev} };
+   CMMCore core;
+   adapter.LoadIntoCore(core);
+   core.enableRedundantPropertyWriteSuppression("Dev", true);
+
+   // The device ignores these, so the written value is never confirmed
+   core.setProperty("Dev", "ReadOnly", "B");
+   core.setProperty("Dev", "ReadOnly", "B");
+   CHECK(core.getSuppressedPropertyWriteCount("Dev") == 0);
+   CHECK(core.getProperty("Dev", "ReadOnly") == "A");
+
+   core.setProperty("Dev", "ReadOnly", "A");
+   core.setProperty("Dev", "ReadOnly", "A");
+   CHECK(core.getSuppressedPropertyWriteCount("Dev") == 0);
+}
+
+TEST_CASE("writes to properties without an action are suppressed",
+   "[PropertyWriteSuppression]")
+{
+   WriteCountingDevice dev;
+   test::MockAdapterWithDevices adapter{ {"Dev", &dev} };
+   CMMCore core;
+   adapter.LoadIntoCore(core);
+   core.enableRedundantPropertyWriteSuppression("Dev", true);
+
+   core.setProperty("Dev", "Plain", "B");
+   core.setProperty("Dev", "Plain", "B");
+   CHECK(core.getSuppressedPropertyWriteCount("Dev") == 1);
+   CHECK(core.getProperty("Dev", "Plain") == "B");
+
+   core.setProperty("Dev", "Plain", "C");
+   CHECK(core.getSuppressedPropertyWriteCount("Dev") == 1);
+   CHECK(core.getProperty("Dev", "Plain") == "C");
+}
+
+} // namespace mm
@@ -0,0 +1,107 @@
+#include <catch2/catch_all.hpp>
+
+#include "DeviceBase.h"
+#include "MMCore.h"
+#include "MockDeviceUtils.h"
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+namespace mm {
+
+namespace {
+
+// Generic device whose property returns to its default on initialization,
+// and whose shutdown can be made to fail
+class ResettingDevice : public CGenericBase<ResettingDevice>
+{
+   std::string value_;
+
+public:
+   bool failShutdown = false;
+   int initializeCount = 0;
+
+   ResettingDevice()
+   {
+      CreateStringProperty("Value", "", false,
+         new MM::ActionLambda([this](MM::PropertyBase* pProp,
+               MM::ActionType eAct) {
+            if (eAct == MM::BeforeGet)
+               pProp->Set(value_.c_str());
+            else if (eAct == MM::AfterSet)
+               pProp->Get(value_);
+            return DEVICE_OK;
+         }));
+   }
+
+   int Initialize() override
+   {
+      value_ = "Default";
+      ++initializeCount;
+      return DEVICE_OK;
+   }
+
+   int Shutdown() override { return failShutdown ? DEVICE_ERR : DEVICE_OK; }
+   void GetName(char* name) const override
+   { CDeviceUtils::CopyLimitedString(name, "ResettingDevice"); }
+   bool Busy() override { return false; }
+};
+
+bool IsLoaded(CMMCore& core, const std::string& label)
+{
+   const std::vector<std::string> devices = core.getLoadedDevices();
+   return std::find(devices.begin(), devices.end(), label) != devices.end();
+}
+
+} // anonymous namespace
+
+TEST_CASE("reloading a device adapter recreates its devices",
+   "[ReloadDeviceAdapter]")
+{
+   ResettingDevice dev;
+   test::MockCamera cam;
+   test::MockAdapterWithDevices adapter{ {"Dev", &dev}, {"Cam", &cam} };
+   CMMCore core;
+   adapter.LoadIntoCore(core);
+   core.setCameraDevice("Cam");
+   core.setProperty("Dev", "Value", "B");
+
+   core.reloadDeviceAdapter("MockAdapter");
+
+   CHECK(dev.initializeCount == 2);
+   CHECK(core.getDeviceInitializationState("Dev") == InitializedSuccessfully);
+   CHECK(core.getDeviceInitializationState("Cam") == InitializedSuccessfully);
+   CHECK(core.getProperty("Dev", "Value") == "B");
+   CHECK(core.getCameraDevice() == "Cam");
+}
+
+TEST_CASE("failed device adapter reload does not leave devices unloaded",
+   "[ReloadDeviceAdapter]")
+{
+   ResettingDevice dev;
+   test::MockCamera cam;
+   test::MockAdapterWithDevices adapter{ {"Dev", &dev}, {"Cam", &cam} };
+   CMMCore core;
+   adapter.LoadIntoCore(core);
+   core.setCameraDevice("Cam");
+   core.setExposure("Cam", 25.0);
+
+   // Devices are unloaded in reverse order, so Cam is gone by the time Dev
+   // fails to shut down
+   dev.failShutdown = true;
+   CHECK_THROWS_AS(core.reloadDeviceAdapter("MockAdapter"), CMMError);
+   dev.failShutdown = false;
+
+   CHECK(IsLoaded(core, "Dev"));
+   REQUIRE(IsLoaded(core, "Cam"));
+   CHECK(core.getDeviceInitializationState("Cam") == InitializedSuccessfully);
+   CHECK(core.getCameraDevice() == "Cam");
+   CHECK(core.getExposure("Cam") == 25.0);
+
+   // The camera is usable again
+   core.snapImage();
+   CHECK(cam.snapCount == 1);
+}
+
+} // namespace mm
@@ -0,0 +1,199 @@
+#include <catch2/catch_all.hpp>
+
+#include "MMCore.h"
+#include "MockDeviceUtils.h"
+
+#include <chrono>
+#include <string>
+#include <thread>
+
+namespace mm {
+
+namespace {
+
+// Wait for the camera's sequence thread to exit (after AcqFinished())
+void FinishSequence(CMMCore& core, const char* camera)
+{
+   for (int i = 0; i < 500 && core.isSequenceRunning(camera); ++i)
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+   CHECK_FALSE(core.isSequenceRunning(camera));
+   core.stopSequenceAcquisition(camera);
+}
+
+// A 16-bit camera with 12 significant bits, which sets up the image buffer
+// itself, as some cameras do when starting a sequence
+class Mock12BitCamera : public test::MockCamera
+{
+public:
+   void GetName(char* name) const override
+   { CDeviceUtils::CopyLimitedString(name, "Mock12BitCamera"); }
+   unsigned GetImageBytesPerPixel() const override { return 2; }
+   unsigned GetBitDepth() const override { return 12; }
+
+   bool InitializeBuffer()
+   { return GetCoreCallback()->InitializeImageBuffer(this, 1, 1, 16, 16, 2); }
+   bool InitializeBufferWithoutCaller()
+   { return GetCoreCallback()->InitializeImageBuffer(1, 1, 16, 16, 2); }
+};
+
+} // anonymous namespace
+
+TEST_CASE("armed bursts hold the shutter open", "[SequenceAcquisition]")
+{
+   test::MockCamera cam;
+   test::MockShutter shutter;
+   test::MockAdapterWithDevices adapter{ {"Cam", &cam}, {"Shutter", &shutter} };
+   CMMCore core;
+   adapter.LoadIntoCore(core);
+   core.setCameraDevice("Cam");
+   core.setShutterDevice("Shutter");
+   core.setAutoShutter(true);
+
+   core.armSequenceAcquisition("Cam");
+   CHECK(core.isSequenceAcquisitionArmed());
+
+   // The buffer is kept between bursts
+   for (int burst = 1; burst <= 2; ++burst)
+   {
+      core.startArmedSequenceAcquisition(5, 0.0, true);
+      FinishSequence(core, "Cam");
+      CHECK(core.getRemainingImageCount() == 5 * burst);
+      CHECK(core.getShutterOpen("Shutter"));
+   }
+   CHECK(shutter.openCount == 1);
+   CHECK(cam.snapCount == 10);
+
+   core.disarmSequenceAcquisition();
+   CHECK_FALSE(core.isSequenceAcquisitionArmed());
+   CHECK_FALSE(core.getShutterOpen("Shutter"));
+
+   // Without arming, the shutter is opened and closed for each sequence
+   core.startSequenceAcquisition("Cam", 3, 0.0, true);
+   FinishSequence(core, "Cam");
+   CHECK(core.getRemainingImageCount() == 3);
+   CHECK(shutter.openCount == 2);
+   CHECK_FALSE(core.getShutterOpen("Shutter"));
+}
+
+TEST_CASE("camera-initialized buffer is packed for the caller's bit depth",
+   "[SequenceAcquisition]")
+{
+   test::MockCamera cam8;
+   Mock12BitCamera cam12;
+   test::MockAdapterWithDevices adapter{ {"Cam8", &cam8}, {"Cam12", &cam12} };
+   CMMCore core;
+   adapter.LoadIntoCore(core);
+   core.setCameraDevice("Cam8");
+   core.enableCircularBufferPacking(true);
+   CHECK(core.getCircularBufferPackedBitDepth() == 0);
+
+   // Not the current camera's 8 bits
+   REQUIRE(cam12.InitializeBuffer());
+   CHECK(core.getCircularBufferPackedBitDepth() == 12);
+
+   // Without the caller, the bit depth is unknown
+   REQUIRE(cam12.InitializeBufferWithoutCaller());
+   CHECK(core.getCircularBufferPackedBitDepth() == 0);
+}
+
+TEST_CASE("armed bursts release a shutter that is no longer current",
+   "[SequenceAcquisition]")
+{
+   test::MockCamera cam;
+   test::MockShutter shutter1;
+   test::MockShutter shutter2;
+   test::MockAdapterWithDevices adapter{ {"Cam", &cam}, {"Shutter1", &shutter1} };
+   test::MockAdapterWithDevices adapter2{ {"Shutter2", &shutter2} };
+   CMMCore core;
+   adapter.LoadIntoCore(core);
+   adapter2.LoadIntoCore(core, "MockAdapter2");
+   core.setCameraDevice("Cam");
+   core.setShutterDevice("Shutter1");
+   core.setAutoShutter(true);
+
+   core.armSequenceAcquisition("Cam");
+   core.startArmedSequenceAcquisition(2, 0.0, true);
+   FinishSequence(core, "Cam");
+   CHECK(core.getShutterOpen("Shutter1"));
+
+   core.setShutterDevice("Shutter2");
+   core.startArmedSequenceAcquisition(2, 0.0, true);
+   FinishSequence(core, "Cam");
+   CHECK_FALSE(core.getShutterOpen("Shutter1"));
+   CHECK(core.getShutterOpen("Shutter2"));
+
+   // Rearming releases the shutter too
+   core.armSequenceAcquisition("Cam");
+   CHECK_FALSE(core.getShutterOpen("Shutter2"));
+   CHECK(core.getRemainingImageCount() == 0);
+   core.disarmSequenceAcquisition();
+   CHECK(shutter1.openCount == 1);
+   CHECK(shutter2.openCount == 1);
+}
+
+TEST_CASE("armed bursts set up the buffer again after it was reinitialized",
+   "[SequenceAcquisition]")
+{
+   test::MockCamera cam;
+   test::MockAdapterWithDevices adapter{ {"Cam", &cam} };
+   CMMCore core;
+   adapter.LoadIntoCore(core);
+   core.setCameraDevice("Cam");
+
+   core.armSequenceAcquisition("Cam");
+   core.startArmedSequenceAcquisition(3, 0.0, true);
+   FinishSequence(core, "Cam");
+   CHECK(core.getRemainingImageCount() == 3);
+
+   // Changing the footprint replaces the buffer, which must be set up again
+   core.setCircularBufferMemoryFootprint(
+         core.getCircularBufferMemoryFootprint() + 1);
+   core.startArmedSequenceAcquisition(3, 0.0, true);
+   FinishSequence(core, "Cam");
+   CHECK(core.getRemainingImageCount() == 3);
+   core.disarmSequenceAcquisition();
+}
+
+TEST_CASE("image burst fills the buffer and restores the shutter",
+   "[SequenceAcquisition]")
+{
+   test::MockCamera cam;
+   test::MockShutter shutter;
+   test::MockAdapterWithDevices adapter{ {"Cam", &cam}, {"Shutter", &shutter} };
+   CMMCore core;
+   adapter.LoadIntoCore(core);
+   core.setCameraDevice("Cam");
+   core.setShutterDevice("Shutter");
+   core.setAutoShutter(true);
+
+   const long numImages = 4;
+   core.snapImageBurst(numImages);
+   CHECK(cam.snapCount == numImages);
+   CHECK(shutter.openCount == 1);
+   CHECK_FALSE(core.getShutterOpen("Shutter"));
+
+   REQUIRE(core.getRemainingImageCount() == numImages);
+   long lastImageNumber = -1;
+   for (long i = 0; i < numImages; ++i)
+   {
+      Metadata md;
+      CHECK(core.popNextImageMD(md) != nullptr);
+      const long imageNumber = std::stol(
+         md.GetSingleTag(MM::g_Keyword_Metadata_ImageNumber).GetValue());
+      CHECK(imageNumber > lastImageNumber);
+      lastImageNumber = imageNumber;
+      CHECK(md.GetSingleTag("BurstImageIndex").GetValue() ==
+         std::to_string(i));
+   }
+   CHECK(core.getRemainingImageCount() == 0);
+
+   // Without auto-shutter, a shutter that was open is left open
+   core.setAutoShutter(false);
+   core.setShutterOpen("Shutter", true);
+   core.snapImageBurst(2);
+   CHECK(core.getRemainingImageCount() == 2);
+   CHECK(core.getShutterOpen("Shutter"));
+   CHECK(shutter.openCount == 2);
+}
+
+} // namespace mm
@@ -0,0 +1,164 @@
+#include <catch2/catch_all.hpp>
+
+#include "SnapBurstPipeline.h"
+
+#include "MMDeviceConstants.h"
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace mm {
+
+TEST_CASE("burst pipeline inserts copies of the images in order",
+   "[SnapBurstPipeline]")
+{
+   std::mutex mutex;
+   std::vector<std::pair<long, unsigned>> inserted;
+   std::vector<unsigned char> values;
+   SnapBurstPipeline pipeline;
+   pipeline.Start([&](long index, unsigned channel,
+            unsigned char* pixels) {
+         std::lock_guard<std::mutex> lock(mutex);
+         inserted.emplace_back(index, channel);
+         values.push_back(pixels[0]);
+         return DEVICE_OK;
+      });
+
+   // The camera's buffers are reused for every image
+   std::vector<unsigned char> ch0(16), ch1(16);
+   const std::vector<const unsigned char*> channels{ ch0.data(), ch1.data() };
+   for (long i = 0; i < 10; ++i)
+   {
+      ch0.assign(16, static_cast<unsigned char>(2 * i));
+      ch1.assign(16, static_cast<unsigned char>(2 * i + 1));
+      REQUIRE(pipeline.Push(i, channels, ch0.size()) == DEVICE_OK);
+   }
+   CHECK(pipeline.Finish() == DEVICE_OK);
+
+   REQUIRE(inserted.size() == 20);
+   for (long i = 0; i < 20; ++i)
+   {
+      CHECK(inserted[i].first == i / 2);
+      CHECK(inserted[i].second == static_cast<unsigned>(i % 2));
+      CHECK(values[i] == i);
+   }
+}
+
+TEST_CASE("burst pipeline inserts while the next image is pushed",
+   "[SnapBurstPipeline]")
+{
+   std::atomic<bool> inserting(false);
+   std::atomic<long> inserts(0);
+   SnapBurstPipeline pipeline;
+   pipeline.Start([&](long, unsigned, unsigned char*) {
+         inserting = true;
+         std::this_thread::sleep_for(std::chrono::milliseconds(20));
+         inserting = false;
+         ++inserts;
+         return DEVICE_OK;
+      });
+
+   unsigned char pixels[4] = {};
+   const std::vector<const unsigned char*> channels{ pixels };
+   REQUIRE(pipeline.Push(0, channels, sizeof(pixels)) == DEVICE_OK);
+
+   // Push does not wait for the insertion while a slot is free
+   const auto start = std::chrono::steady_clock::now();
+   REQUIRE(pipeline.Push(1, channels, sizeof(pixels)) == DEVICE_OK);
+   CHECK(std::chrono::steady_clock::now() - start <
+         std::chrono::milliseconds(15));
+   for (int i = 0; i < 100 && !inserting; ++i)
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+   CHECK(inserting);
+
+   CHECK(pipeline.Finish() == DEVICE_OK);
+   CHECK(inserts == 2);
+}
+
+TEST_CASE("burst pipeline stops at the first insert error",
+   "[SnapBurstPipeline]")
+{
+   std::atomic<long> inserts(0);
+   SnapBurstPipeline pipeline;
+   pipeline.Start([&](long index, unsigned, unsigned char*) {
+         ++inserts;
+         return index == 1 ? DEVICE_BUFFER_OVERFLOW : DEVICE_OK;
+      });
+
+   unsigned char pixels[4] = {};
+   const std::vector<const unsigned char*> channels{ pixels };
+   int ret = DEVICE_OK;
+   for (long i = 0; i < 100 && ret == DEVICE_OK; ++i)
+      ret = pipeline.Push(i, channels, sizeof(pixels));
+   CHECK(pipeline.Finish() == DEVICE_BUFFER_OVERFLOW);
+   CHECK(ret == DEVICE_BUFFER_OVERFLOW);
+   CHECK(inserts == 2);
+}
+
+TEST_CASE("burst pipeline can be destroyed with images pending",
+   "[SnapBurstPipeline]")
+{
+   std::atomic<long> inserts(0);
+   {
+      SnapBurstPipeline pipeline;
+      pipeline.Start([&](long, unsigned, unsigned char*) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            ++inserts;
+            return DEVICE_OK;
+         });
+      unsigned char pixels[4] = {};
+      const std::vector<const unsigned char*> channels{ pixels };
+      pipeline.Push(0, channels, sizeof(pixels));
+      pipeline.Push(1, channels, sizeof(pixels));
+   }
+   CHECK(inserts <= 2);
+}
+
+TEST_CASE("burst pipeline without slots inserts the caller's pixels",
+   "[SnapBurstPipeline]")
+{
+   const std::thread::id caller = std::this_thread::get_id();
+   std::vector<const unsigned char*> inserted;
+   SnapBurstPipeline pipeline(0);
+   pipeline.Start([&](long, unsigned, unsigned char* pixels) {
+         CHECK(std::this_thread::get_id() == caller);
+         inserted.push_back(pixels);
+         return DEVICE_OK;
+      });
+
+   unsigned char ch0[4] = {}, ch1[4] = {};
+   const std::vector<const unsigned char*> channels{ ch0, ch1 };
+   REQUIRE(pipeline.Push(0, channels, sizeof(ch0)) == DEVICE_OK);
+   CHECK(inserted == channels);
+   CHECK(pipeline.Finish() == DEVICE_OK);
+}
+
+TEST_CASE("burst pipeline can be started again after an error",
+   "[SnapBurstPipeline]")
+{
+   SnapBurstPipeline pipeline;
+   unsigned char pixels[4] = {};
+   const std::vector<const unsigned char*> channels{ pixels };
+
+   pipeline.Start([](long, unsigned, unsigned char*) {
+         return DEVICE_BUFFER_OVERFLOW;
+      });
+   pipeline.Push(0, channels, sizeof(pixels));
+   CHECK(pipeline.Finish() == DEVICE_BUFFER_OVERFLOW);
+
+   std::vector<long> inserted;
+   pipeline.Start([&](long index, unsigned, unsigned char*) {
+         inserted.push_back(index);
+         return DEVICE_OK;
+      });
+   for (long i = 0; i < 5; ++i)
+      REQUIRE(pipeline.Push(i, channels, sizeof(pixels)) == DEVICE_OK);
+   CHECK(pipeline.Finish() == DEVICE_OK);
+   CHECK(inserted == std::vector<long>{ 0, 1, 2, 3, 4 });
+}
+
+} // namespace mm
@@ -0,0 +1,139 @@
+#include <catch2/catch_all.hpp>
+
+#include "Error.h"
+#include "SoftwareBinning.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace mm {
+
+namespace {
+
+SoftwareBinning::Settings Binned(unsigned binning, bool average)
+{
+   SoftwareBinning::Settings s;
+   s.binning = binning;
+   s.average = average;
+   return s;
+}
+
+} // anonymous namespace
+
+TEST_CASE("output size drops leftover rows and columns", "[SoftwareBinning]")
+{
+   unsigned w, h;
+   SoftwareBinning::GetOutputSize(Binned(2, true), 7, 5, w, h);
+   CHECK(w == 3);
+   CHECK(h == 2);
+
+   SoftwareBinning::Settings s = Binned(3, true);
+   s.cropped = true;
+   s.cropX = 1;
+   s.cropY = 2;
+   s.cropWidth = 6;
+   s.cropHeight = 3;
+   SoftwareBinning::GetOutputSize(s, 10, 10, w, h);
+   CHECK(w == 2);
+   CHECK(h == 1);
+
+   s.cropX = 5;
+   CHECK_THROWS_AS(SoftwareBinning::GetOutputSize(s, 10, 10, w, h), CMMError);
+   CHECK_THROWS_AS(SoftwareBinning::GetOutputSize(Binned(4, true), 3, 8, w, h),
+         CMMError);
+}
+
+TEST_CASE("8-bit sum saturates and mean rounds", "[SoftwareBinning]")
+{
+   // 4 x 2 image, binned 2x2 into 2 x 1
+   const std::vector<std::uint8_t> src = {
+      100, 101, 1, 2,
+      100, 100, 3, 4,
+   };
+   std::vector<std::uint8_t> dst(2);
+
+   SoftwareBinning::Reduce(Binned(2, false), src.data(), 4, 2, 1, 1,
+         dst.data());
+   CHECK(dst[0] == 255);
+   CHECK(dst[1] == 10);
+
+   SoftwareBinning::Reduce(Binned(2, true), src.data(), 4, 2, 1, 1,
+         dst.data());
+   CHECK(dst[0] == 100); // 401 / 4 = 100.25
+   CHECK(dst[1] == 3); // 10 / 4 = 2.5, rounded up
+}
+
+TEST_CASE("16-bit sums are widened", "[SoftwareBinning]")
+{
+   std::vector<std::uint16_t> src(16 * 16, 4000);
+   std::vector<std::uint16_t> sums(16);
+   SoftwareBinning::Reduce(Binned(4, false),
+         reinterpret_cast<const unsigned char*>(src.data()), 16, 16, 2, 1,
+         reinterpret_cast<unsigned char*>(sums.data()));
+   for (std::uint16_t v : sums)
+      CHECK(v == 64000);
+
+   std::vector<std::uint16_t> means(16);
+   SoftwareBinning::Reduce(Binned(4, true),
+         reinterpret_cast<const unsigned char*>(src.data()), 16, 16, 2, 1,
+         reinterpret_cast<unsigned char*>(means.data()));
+   for (std::uint16_t v : means)
+      CHECK(v == 4000);
+}
+
+TEST_CASE("crop without binning copies the rectangle", "[SoftwareBinning]")
+{
+   std::vector<float> src(5 * 4);
+   for (size_t i = 0; i < src.size(); ++i)
+      src[i] = static_cast<float>(i);
+   SoftwareBinning::Settings s;
+   s.cropped = true;
+   s.cropX = 1;
+   s.cropY = 2;
+   s.cropWidth = 3;
+   s.cropHeight = 2;
+   std::vector<float> dst(6);
+   SoftwareBinning::Reduce(s, reinterpret_cast<const unsigned char*>(src.data()),
+         5, 4, 4, 1, reinterpret_cast<unsigned char*>(dst.data()));
+   const std::vector<float> expected = { 11, 12, 13, 16, 17, 18 };
+   CHECK(dst == expected);
+}
+
+TEST_CASE("RGB components are binned separately", "[SoftwareBinning]")
+{
+   // 2 x 2 BGRA pixels into one
+   const std::vector<std::uint8_t> src = {
+      10, 20, 30, 255,  12, 22, 32, 255,
+      14, 24, 34, 255,  16, 26, 36, 255,
+   };
+   std::vector<std::uint8_t> dst(4);
+   SoftwareBinning::Reduce(Binned(2, true), src.data(), 2, 2, 4, 4,
+         dst.data());
+   const std::vector<std::uint8_t> expected = { 13, 23, 33, 255 };
+   CHECK(dst == expected);
+
+   CHECK_FALSE(SoftwareBinning::IsSupportedFormat(3, 3));
+   CHECK_THROWS_AS(SoftwareBinning::Reduce(Binned(2, true), src.data(), 2, 2,
+            3, 3, dst.data()), CMMError);
+}
+
+TEST_CASE("snapped images are reduced once per generation", "[SoftwareBinning]")
+{
+   SoftwareBinning sb;
+   sb.SetBinning(2, false);
+   std::vector<std::uint8_t> src(4 * 4, 1);
+
+   const unsigned char* out = sb.ReduceSnapped(1, 0, src.data(), 4, 4, 1, 1);
+   CHECK(out[0] == 4);
+
+   // Same generation: not reduced again
+   src.assign(src.size(), 2);
+   CHECK(sb.ReduceSnapped(1, 0, src.data(), 4, 4, 1, 1)[0] == 4);
+   CHECK(sb.ReduceSnapped(2, 0, src.data(), 4, 4, 1, 1)[0] == 8);
+
+   // Changed settings: reduced again
+   sb.SetBinning(2, true);
+   CHECK(sb.ReduceSnapped(2, 0, src.data(), 4, 4, 1, 1)[0] == 2);
+}
+
+} // namespace mm
@@ -0,0 +1,177 @@
+#include <catch2/catch_all.hpp>
+
+#include "Error.h"
+#include "MMCore.h"
+#include "MMEventCallback.h"
+#include "MockDeviceUtils.h"
+#include "StateLog.h"
+
+#include <string>
+#include <vector>
+
+namespace mm {
+
+namespace {
+
+std::string ValueOf(const std::vector<StateLog::Setting>& settings,
+      const std::string& device, const std::string& property)
+{
+   for (const auto& s : settings)
+   {
+      if (s.device == device && s.property == property)
+         return s.value;
+   }
+   return "(none)";
+}
+
+class NotifyingCamera : public test::MockCamera
+{
+public:
+   void GetName(char* name) const override
+   { CDeviceUtils::CopyLimitedString(name, "NotifyingCamera"); }
+
+   void Notify(const char* propName, const std::string& value)
+   { OnPropertyChanged(propName, value.c_str()); }
+};
+
+class CountingCallback : public MMEventCallback
+{
+public:
+   int propertyChanges = 0;
+
+   void onPropertyChanged(const char*, const char*, const char*) override
+   { ++propertyChanges; }
+};
+
+} // anonymous namespace
+
+TEST_CASE("unchanged values do not create versions", "[StateLog]")
+{
+   StateLog log;
+   CHECK(log.GetVersion() == 0);
+   CHECK(log.Record("Cam", "Exposure", "10") == 1);
+   CHECK(log.Record("Cam", "Exposure", "10") == 1);
+   CHECK(log.Record("Cam", "Exposure", "20") == 2);
+   CHECK(log.Record("Stage", "PositionUm", "5", true) == 3);
+   CHECK(log.GetVersion() == 3);
+
+   std::vector<StateLog::Setting> state = log.GetStateAt(3);
+   REQUIRE(state.size() == 2);
+   CHECK(state[0].value == "20");
+   CHECK(!state[0].readOnly);
+   CHECK(state[1].readOnly);
+}
+
+TEST_CASE("state is rebuilt at any kept version", "[StateLog]")
+{
+   StateLog log(1000, 7);
+   for (int i = 1; i <= 100; ++i)
+      log.Record("Dev" + std::to_string(i % 3), "Prop", std::to_string(i));
+
+   CHECK(log.GetStateAt(0).empty());
+   for (long v : { 1L, 6L, 7L, 8L, 50L, 99L, 100L })
+   {
+      const std::vector<StateLog::Setting> state = log.GetStateAt(v);
+      // The last value of each device up to v
+      for (int d = 0; d < 3; ++d)
+      {
+         long last = 0;
+         for (long i = 1; i <= v; ++i)
+         {
+            if (i % 3 == d)
+               last = i;
+         }
+         const std::string expected =
+            last ? std::to_string(last) : std::string("(none)");
+         CHECK(ValueOf(state, "Dev" + std::to_string(d), "Prop") == expected);
+      }
+   }
+   CHECK_THROWS_AS(log.GetStateAt(101), CMMError);
+}
+
+TEST_CASE("old versions are dropped", "[StateLog]")
+{
+   StateLog log(10, 4);
+   for (int i = 1; i <= 25; ++i)
+      log.Record("Dev", "P" + std::to_string(i % 5), std::to_string(i));
+   CHECK(log.GetOldestVersion() == 15);
+   CHECK_THROWS_AS(log.GetStateAt(14), CMMError);
+
+   const std::vector<StateLog::Setting> state = log.GetStateAt(15);
+   REQUIRE(state.size() == 5);
+   CHECK(ValueOf(state, "Dev", "P0") == "15");
+   CHECK(ValueOf(state, "Dev", "P1") == "11");
+   CHECK(ValueOf(log.GetStateAt(22), "Dev", "P1") == "21");
+}
+
+TEST_CASE("frame deltas contain changes since the previous frame", "[StateLog]")
+{
+   StateLog log;
+   log.Record("Cam", "Exposure", "10");
+   log.Record("Stage", "PositionUm", "0");
+
+   std::vector<StateLog::Setting> delta;
+   CHECK(log.TakeFrameDelta("Cam", delta) == 2);
+   CHECK(delta.size() == 2); // Full state for the first frame
+
+   CHECK(log.TakeFrameDelta("Cam", delta) == 2);
+   CHECK(delta.empty());
+
+   log.Record("Stage", "PositionUm", "1");
+   log.Record("Stage", "PositionUm", "2");
+   CHECK(log.TakeFrameDelta("Cam", delta) == 4);
+   REQUIRE(delta.size() == 1);
+   CHECK(delta[0].value == "2");
+
+   // Cameras are tracked separately
+   CHECK(log.TakeFrameDelta("Cam2", delta) == 4);
+   CHECK(delta.size() == 2);
+
+   log.ResetFrameDeltas();
+   CHECK(log.TakeFrameDelta("Cam", delta) == 4);
+   CHECK(delta.size() == 2);
+
+   CHECK(!log.IsFrameDeltaEnabled());
+   log.EnableFrameDeltas(true);
+   CHECK(log.IsFrameDeltaEnabled());
+   CHECK(log.TakeFrameDelta("Cam", delta) == 4);
+   CHECK(delta.size() == 2);
+}
+
+TEST_CASE("changes since a dropped version give the full state", "[StateLog]")
+{
+   StateLog log(3, 2);
+   for (int i = 1; i <= 10; ++i)
+      log.Record("Dev", "P" + std::to_string(i), "x");
+   std::vector<StateLog::Setting> changes;
+   CHECK(log.GetChangesSince(2, changes) == 10);
+   CHECK(changes.size() == 10);
+   CHECK(log.GetChangesSince(8, changes) == 10);
+   CHECK(changes.size() == 2);
+}
+
+TEST_CASE("each property notification is recorded once, with the cache",
+   "[StateLog]")
+{
+   NotifyingCamera cam;
+   CountingCallback callback;
+   test::MockAdapterWithDevices adapter{ {"Cam", &cam} };
+   CMMCore core;
+   adapter.LoadIntoCore(core);
+   const long version = core.getStateVersion();
+
+   // Without a callback the state cache is not updated, and neither is the
+   // log
+   cam.Notify("Binning", "2");
+   CHECK(core.getStateVersion() == version);
+
+   core.registerCallback(&callback);
+   for (int i = 1; i <= 5; ++i)
+      cam.Notify("Binning", std::to_string(10 * i));
+   CHECK(callback.propertyChanges == 5);
+   CHECK(core.getStateVersion() == version + 5);
+   CHECK(core.getPropertyFromCache("Cam", "Binning") == "50");
+   core.registerCallback(nullptr);
+}
+
+} // namespace mm
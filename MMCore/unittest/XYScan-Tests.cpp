@@ -0,0 +1,107 @@
+#include <catch2/catch_all.hpp>
+
+#include "XYScan.h"
+
+#include <chrono>
+#include <vector>
+
+namespace mm {
+
+namespace {
+
+using Catch::Matchers::WithinAbs;
+
+const double tolerance = 1e-6;
+
+const MM::Device* const camera = reinterpret_cast<const MM::Device*>(1);
+const MM::Device* const otherCamera = reinterpret_cast<const MM::Device*>(2);
+
+XYScan::Clock::time_point At(XYScan::Clock::time_point t0, int ms)
+{
+   return t0 + std::chrono::milliseconds(ms);
+}
+
+} // anonymous namespace
+
+TEST_CASE("linear trajectory is interpolated and clamped", "[XYScan]")
+{
+   XYScan scan(camera, "XY", 10);
+   const auto t0 = XYScan::Clock::now();
+   // 300 um at 1000 um/s takes 300 ms
+   scan.SetLinearTrajectory(100.0, 50.0, 400.0, 50.0, 1000.0, t0, 0.0);
+   CHECK_THAT(scan.GetDurationMs(), WithinAbs(300.0, tolerance));
+
+   double x, y;
+   scan.PositionAt(At(t0, 150), x, y);
+   CHECK_THAT(x, WithinAbs(250.0, tolerance));
+   CHECK_THAT(y, WithinAbs(50.0, tolerance));
+
+   scan.PositionAt(At(t0, -20), x, y);
+   CHECK_THAT(x, WithinAbs(100.0, tolerance));
+
+   scan.PositionAt(At(t0, 1000), x, y);
+   CHECK_THAT(x, WithinAbs(400.0, tolerance));
+}
+
+TEST_CASE("frame position is taken at mid-exposure", "[XYScan]")
+{
+   XYScan scan(camera, "XY", 10);
+   const auto t0 = XYScan::Clock::now();
+   scan.SetLinearTrajectory(0.0, 0.0, 0.0, 1000.0, 1000.0, t0, 20.0);
+
+   double x, y;
+   REQUIRE(scan.StampFrame(camera, At(t0, 120), x, y));
+   CHECK_THAT(x, WithinAbs(0.0, tolerance));
+   CHECK_THAT(y, WithinAbs(100.0, tolerance));
+}
+
+TEST_CASE("only frames from the scan camera are stamped", "[XYScan]")
+{
+   XYScan scan(camera, "XY", 2);
+   const auto t0 = XYScan::Clock::now();
+   scan.SetLinearTrajectory(0.0, 0.0, 10.0, 0.0, 100.0, t0, 0.0);
+
+   double x, y;
+   CHECK_FALSE(scan.StampFrame(otherCamera, t0, x, y));
+   CHECK(scan.StampFrame(camera, t0, x, y));
+   CHECK(scan.StampFrame(camera, t0, x, y));
+   CHECK_FALSE(scan.StampFrame(camera, t0, x, y));
+   CHECK(scan.GetStampedFrameCount() == 2);
+}
+
+TEST_CASE("finished scan stamps no more frames", "[XYScan]")
+{
+   XYScan scan(camera, "XY", 10);
+   scan.SetLinearTrajectory(0.0, 0.0, 10.0, 0.0, 100.0,
+         XYScan::Clock::now(), 0.0);
+   scan.Finish();
+
+   double x, y;
+   CHECK_FALSE(scan.StampFrame(camera, XYScan::Clock::now(), x, y));
+}
+
+TEST_CASE("sequenced positions are assigned in frame order", "[XYScan]")
+{
+   std::vector<double> xs, ys;
+   // 100 um/s at 250 ms per frame: 25 um per frame, stopping at 60 um
+   XYScan::SampleLine(0.0, 10.0, 60.0, 10.0, 100.0, 250.0, 4, xs, ys);
+   REQUIRE(xs.size() == 4);
+   CHECK_THAT(xs[0], WithinAbs(0.0, tolerance));
+   CHECK_THAT(xs[1], WithinAbs(25.0, tolerance));
+   CHECK_THAT(xs[2], WithinAbs(50.0, tolerance));
+   CHECK_THAT(xs[3], WithinAbs(60.0, tolerance));
+   CHECK_THAT(ys[3], WithinAbs(10.0, tolerance));
+
+   XYScan scan(camera, "XY", 4);
+   scan.SetSequencedPositions(xs, ys);
+   CHECK(scan.IsSequenced());
+
+   double x, y;
+   const auto t = XYScan::Clock::now();
+   REQUIRE(scan.StampFrame(camera, t, x, y));
+   CHECK_THAT(x, WithinAbs(0.0, tolerance));
+   REQUIRE(scan.StampFrame(camera, t, x, y));
+   CHECK_THAT(x, WithinAbs(25.0, tolerance));
+}
+
+} // namespace mm
@@ -924,7 +924,99 @@
 %}
 
 
+// Bulk conversion of vectors to Java arrays
+//
+// The vector proxies below only provide size() and get(i), so converting a
+// vector of n elements element by element takes about 2n JNI calls (and as
+// many boxed objects). Functions returning the following types instead
+// return a Java array, converted in a single JNI call.
+
+%inline %{
+namespace mmcorej {
+   typedef std::vector<std::string> StringArray;
+   typedef std::vector<double> DoubleArray;
+   typedef std::vector<long> IntArray;
+   typedef std::vector<unsigned> UnsignedArray;
+   typedef std::vector<char> CharArray;
+   typedef std::vector<bool> BooleanArray;
+}
+%}
+
+%typemap(jni) mmcorej::StringArray      "jobjectArray"
+%typemap(jtype) mmcorej::StringArray    "String[]"
+%typemap(jstype) mmcorej::StringArray   "String[]"
+%typemap(javaout) mmcorej::StringArray {
+   return $jnicall;
+}
+%typemap(out) mmcorej::StringArray
+{
+   jclass stringClass = JCALL1(FindClass, jenv, "java/lang/String");
+   if (!stringClass)
+      return $null;
+   jobjectArray array = JCALL3(NewObjectArray, jenv, (jsize) $1.size(), stringClass, 0);
+   if (!array)
+      return $null;
+   for (size_t i = 0; i < $1.size(); ++i)
+   {
+      jstring str = JCALL1(NewStringUTF, jenv, $1[i].c_str());
+      if (!str)
+         return $null;
+      JCALL3(SetObjectArrayElement, jenv, array, (jsize) i, str);
+      JCALL1(DeleteLocalRef, jenv, str);
+   }
+   $result = array;
+}
+
+%typemap(jni) mmcorej::DoubleArray      "jdoubleArray"
+%typemap(jtype) mmcorej::DoubleArray    "double[]"
+%typemap(jstype) mmcorej::DoubleArray   "double[]"
+%typemap(javaout) mmcorej::DoubleArray {
+   return $jnicall;
+}
+%typemap(out) mmcorej::DoubleArray
+{
+   jdoubleArray array = JCALL1(NewDoubleArray, jenv, (jsize) $1.size());
+   if (!array)
+      return $null;
+   if (!$1.empty())
+      JCALL4(SetDoubleArrayRegion, jenv, array, 0, (jsize) $1.size(), (const jdouble*) &$1[0]);
+   $result = array;
+}
+
+// Element types that differ from the Java ones are converted in a native
+// buffer first
+%define MMCOREJ_BULK_ARRAY(ARRAYTYPE, JNITYPE, JAVATYPE, JELEMTYPE, NEWFUNC, SETFUNC)
+%typemap(jni) ARRAYTYPE      #JNITYPE
+%typemap(jtype) ARRAYTYPE    #JAVATYPE
+%typemap(jstype) ARRAYTYPE   #JAVATYPE
+%typemap(javaout) ARRAYTYPE {
+   return $jnicall;
+}
+%typemap(out) ARRAYTYPE
+{
+   JNITYPE array = JCALL1(NEWFUNC, jenv, (jsize) $1.size());
+   if (!array)
+      return $null;
+   if (!$1.empty())
+   {
+      std::vector<JELEMTYPE> elements($1.begin(), $1.end());
+      JCALL4(SETFUNC, jenv, array, 0, (jsize) elements.size(), &elements[0]);
+   }
+   $result = array;
+}
+%enddef
+
+MMCOREJ_BULK_ARRAY(mmcorej::IntArray, jintArray, int[], jint, NewIntArray, SetIntArrayRegion)
+MMCOREJ_BULK_ARRAY(mmcorej::UnsignedArray, jlongArray, long[], jlong, NewLongArray, SetLongArrayRegion)
+MMCOREJ_BULK_ARRAY(mmcorej::CharArray, jcharArray, char[], jchar, NewCharArray, SetCharArrayRegion)
+MMCOREJ_BULK_ARRAY(mmcorej::BooleanArray, jbooleanArray, boolean[], jboolean, NewBooleanArray, SetBooleanArrayRegion)
+
+
 // instantiate STL mappings
+//
+// The vector iterators and toArray() fetch all elements with a single bulk
+// conversion (see above); iterators therefore see the elements as they were
+// when the iterator was created.
 
 namespace std {
 	%typemap(javaimports) vector<char> %{
@@ -936,20 +1028,26 @@ namespace std {
 
    %typemap(javainterfaces) vector<char> %{ Iterable<Character>%}
 
+   %extend vector<char> {
+      mmcorej::CharArray toCharArray() const {
+         return *$self;
+      }
+   }
+
    %typemap(javacode) vector<char> %{
       public Iterator<Character> iterator() {
+         final char[] values = toCharArray();
          return new Iterator<Character>() {
 
             private int i_=0;
 
             public boolean hasNext() {
-               return (i_<size());
+               return (i_<values.length);
             }
 
             public Character next() throws NoSuchElementException {
                if (hasNext()) {
-                  ++i_;
-                  return get(i_-1);
+                  return values[i_++];
                } else {
                   throw new NoSuchElementException();
                }
@@ -962,14 +1060,12 @@ namespace std {
       }
 
       public Character[] toArray() {
-         if (0==size())
-            return new Character[0];
-
-         Character ints[] = new Character[(int) size()];
-         for (int i=0; i<size(); ++i) {
-            ints[i] = get(i);
+         char[] values = toCharArray();
+         Character boxed[] = new Character[values.length];
+         for (int i=0; i<values.length; ++i) {
+            boxed[i] = values[i];
          }
-         return ints;
+         return boxed;
       }
    %}
    
@@ -987,20 +1083,26 @@ namespace std {
 
    %typemap(javainterfaces) vector<long> %{ Iterable<Integer>%}
 
+   %extend vector<long> {
+      mmcorej::IntArray toIntArray() const {
+         return *$self;
+      }
+   }
+
    %typemap(javacode) vector<long> %{
       public Iterator<Integer> iterator() {
+         final int[] values = toIntArray();
          return new Iterator<Integer>() {
 
             private int i_=0;
 
             public boolean hasNext() {
-               return (i_<size());
+               return (i_<values.length);
             }
 
             public Integer next() throws NoSuchElementException {
                if (hasNext()) {
-                  ++i_;
-                  return get(i_-1); 
+                  return values[i_++];
                } else {
                   throw new NoSuchElementException();
                }
@@ -1013,14 +1115,12 @@ namespace std {
       }
 
       public Integer[] toArray() {
-         if (0==size())
-            return new Integer[0];
-
-         Integer ints[] = new Integer[(int) size()];
-         for (int i=0; i<size(); ++i) {
-            ints[i] = get(i);
+         int[] values = toIntArray();
+         Integer boxed[] = new Integer[values.length];
+         for (int i=0; i<values.length; ++i) {
+            boxed[i] = values[i];
          }
-         return ints;
+         return boxed;
       }
    %}
    
@@ -1033,20 +1133,26 @@ namespace std {
 
    %typemap(javainterfaces) vector<double> %{ Iterable<Double>%}
 
+   %extend vector<double> {
+      mmcorej::DoubleArray toDoubleArray() const {
+         return *$self;
+      }
+   }
+
    %typemap(javacode) vector<double> %{
       public Iterator<Double> iterator() {
+         final double[] values = toDoubleArray();
          return new Iterator<Double>() {
 
             private int i_=0;
 
             public boolean hasNext() {
-               return (i_<size());
+               return (i_<values.length);
             }
 
             public Double next() throws NoSuchElementException {
                if (hasNext()) {
-                  ++i_;
-                  return get(i_-1);
+                  return values[i_++];
                } else {
                   throw new NoSuchElementException();
                }
@@ -1059,14 +1165,12 @@ namespace std {
       }
 
       public Double[] toArray() {
-         if (0==size())
-            return new Double[0];
-
-         Double ints[] = new Double[(int) size()];
-         for (int i=0; i<size(); ++i) {
-            ints[i] = get(i);
+         double[] values = toDoubleArray();
+         Double boxed[] = new Double[values.length];
+         for (int i=0; i<values.length; ++i) {
+            boxed[i] = values[i];
          }
-         return ints;
+         return boxed;
       }
    %}
 
@@ -1080,21 +1184,27 @@ namespace std {
 	
 	%typemap(javainterfaces) vector<string> %{ Iterable<String>%}
 	
+	%extend vector<string> {
+		mmcorej::StringArray toStringArray() const {
+			return *$self;
+		}
+	}
+	
 	%typemap(javacode) vector<string> %{
 	
 		public Iterator<String> iterator() {
+			final String[] values = toStringArray();
 			return new Iterator<String>() {
 			
 				private int i_=0;
 			
 				public boolean hasNext() {
-					return (i_<size());
+					return (i_<values.length);
 				}
 				
 				public String next() throws NoSuchElementException {
 					if (hasNext()) {
-						++i_;
-						return get(i_-1);
+						return values[i_++];
 					} else {
 					throw new NoSuchElementException();
 					}
@@ -1107,14 +1217,7 @@ namespace std {
 		}
 		
 		public String[] toArray() {
-			if (0==size())
-				return new String[0];
-			
-			String strs[] = new String[(int) size()];
-			for (int i=0; i<size(); ++i) {
-				strs[i] = get(i);
-			}
-			return strs;
+			return toStringArray();
 		}
 		
 	%}
@@ -1130,21 +1233,27 @@ namespace std {
 	
 	%typemap(javainterfaces) vector<bool> %{ Iterable<Boolean>%}
 	
+	%extend vector<bool> {
+		mmcorej::BooleanArray toBooleanArray() const {
+			return *$self;
+		}
+	}
+	
 	%typemap(javacode) vector<bool> %{
 	
 		public Iterator<Boolean> iterator() {
+			final boolean[] values = toBooleanArray();
 			return new Iterator<Boolean>() {
 			
 				private int i_=0;
 			
 				public boolean hasNext() {
-					return (i_<size());
+					return (i_<values.length);
 				}
 				
 				public Boolean next() throws NoSuchElementException {
 					if (hasNext()) {
-						++i_;
-						return get(i_-1);
+						return values[i_++];
 					} else {
 					throw new NoSuchElementException();
 					}
@@ -1157,14 +1266,12 @@ namespace std {
 		}
 		
 		public Boolean[] toArray() {
-			if (0==size())
-				return new Boolean[0];
-			
-			Boolean strs[] = new Boolean[(int) size()];
-			for (int i=0; i<size(); ++i) {
-				strs[i] = get(i);
+			boolean[] values = toBooleanArray();
+			Boolean boxed[] = new Boolean[values.length];
+			for (int i=0; i<values.length; ++i) {
+				boxed[i] = values[i];
 			}
-			return strs;
+			return boxed;
 		}
 		
 	%}
@@ -1179,20 +1286,26 @@ namespace std {
 
    %typemap(javainterfaces) vector<unsigned> %{ Iterable<Long>%}
 
+   %extend vector<unsigned> {
+      mmcorej::UnsignedArray toLongArray() const {
+         return *$self;
+      }
+   }
+
    %typemap(javacode) vector<unsigned> %{
       public Iterator<Long> iterator() {
+         final long[] values = toLongArray();
          return new Iterator<Long>() {
 
             private int i_=0;
 
             public boolean hasNext() {
-               return (i_<size());
+               return (i_<values.length);
             }
 
             public Long next() throws NoSuchElementException {
                if (hasNext()) {
-                  ++i_;
-                  return get(i_-1);
+                  return values[i_++];
                } else {
                   throw new NoSuchElementException();
                }
@@ -1205,14 +1318,12 @@ namespace std {
       }
 
       public Long[] toArray() {
-         if (0==size())
-            return new Long[0];
-
-         Long ints[] = new Long[(int) size()];
-         for (int i=0; i<size(); ++i) {
-            ints[i] = get(i);
+         long[] values = toLongArray();
+         Long boxed[] = new Long[values.length];
+         for (int i=0; i<values.length; ++i) {
+            boxed[i] = values[i];
          }
-         return ints;
+         return boxed;
       }
    %}
 
@@ -1240,3 +1351,35 @@ namespace std {
 %include "../MMDevice/ImageMetadata.h"
 %include "../MMCore/MMEventCallback.h"
 
+
+// Bulk versions of the enumeration functions most used by the GUI, returning
+// String[] instead of a StrVector. These come after MMCore.h (and
+// MMDeviceConstants.h) so that SWIG knows CMMCore and MM::DeviceType.
+
+%extend CMMCore {
+   mmcorej::StringArray getLoadedDevicesArray() {
+      return $self->getLoadedDevices();
+   }
+   mmcorej::StringArray getLoadedDevicesOfTypeArray(MM::DeviceType devType) {
+      return $self->getLoadedDevicesOfType(devType);
+   }
+   mmcorej::StringArray getDevicePropertyNamesArray(const char* label) throw (CMMError) {
+      return $self->getDevicePropertyNames(label);
+   }
+   mmcorej::StringArray getAllowedPropertyValuesArray(const char* label, const char* propName) throw (CMMError) {
+      return $self->getAllowedPropertyValues(label, propName);
+   }
+   mmcorej::StringArray getStateLabelsArray(const char* stateDeviceLabel) throw (CMMError) {
+      return $self->getStateLabels(stateDeviceLabel);
+   }
+   mmcorej::StringArray getAvailableConfigGroupsArray() {
+      return $self->getAvailableConfigGroups();
+   }
+   mmcorej::StringArray getAvailableConfigsArray(const char* configGroup) {
+      return $self->getAvailableConfigs(configGroup);
+   }
+   mmcorej::StringArray getAvailablePixelSizeConfigsArray() {
+      return $self->getAvailablePixelSizeConfigs();
+   }
+}
+
@@ -1465,6 +1465,11 @@ public:
 
    virtual bool IsCapturing(){return !thd_->IsStopped();}
 
+   virtual bool SupportsLivePropertyChanges()
+   {
+      return false;
+   }
+
    virtual void AddTag(const char* key, const char* deviceLabel, const char* value)
    {
       metadata_.PutTag(key, deviceLabel, value);
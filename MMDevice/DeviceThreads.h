@@ -141,6 +141,16 @@ public:
 #endif
    }
 
+   /// Lock if not held by another thread; return true if locked.
+   bool TryLock()
+   {
+#ifdef _WIN32
+      return TryEnterCriticalSection(&lock_) != 0;
+#else
+      return pthread_mutex_trylock(&lock_) == 0;
+#endif
+   }
+
 private:
    // Forbid copying
    MMThreadLock(const MMThreadLock&);
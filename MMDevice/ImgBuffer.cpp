@@ -20,37 +20,113 @@
 ///////////////////////////////////////////////////////////////////////////////
 #include "ImgBuffer.h"
 
-#include <cassert>
+#include <cstdlib>
 #include <cstring>
+#include <new>
+
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+
+namespace {
+
+#ifdef __linux__
+const std::size_t hugePageSize = 2 * 1024 * 1024;
+#endif
+
+unsigned char* AllocatePixels(std::size_t& bytes, bool hugePages)
+{
+   std::size_t alignment = ImgBuffer::PixelAlignment;
+#ifdef __linux__
+   if (hugePages && bytes >= hugePageSize)
+      alignment = hugePageSize;
+#else
+   (void)hugePages;
+#endif
+   // Round up, so that whole-vector loads at the end stay in bounds
+   bytes = (bytes + alignment - 1) / alignment * alignment;
+   if (bytes == 0)
+      bytes = alignment;
+
+   void* p = 0;
+#ifdef _WIN32
+   p = _aligned_malloc(bytes, alignment);
+#else
+   if (posix_memalign(&p, alignment, bytes) != 0)
+      p = 0;
+#endif
+   if (!p)
+      throw std::bad_alloc();
+
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+   if (alignment == hugePageSize)
+      madvise(p, bytes, MADV_HUGEPAGE); // Advisory; failure is harmless
+#endif
+   return static_cast<unsigned char*>(p);
+}
+
+void FreePixels(unsigned char* p)
+{
+#ifdef _WIN32
+   _aligned_free(p);
+#else
+   std::free(p);
+#endif
+}
+
+} // anonymous namespace
 
 ///////////////////////////////////////////////////////////////////////////////
 // ImgBuffer class
 //
 ImgBuffer::ImgBuffer(unsigned xSize, unsigned ySize, unsigned pixDepth) :
-   pixels_(0), width_(xSize), height_(ySize), pixDepth_(pixDepth)
+   pixels_(0), width_(xSize), height_(ySize), pixDepth_(pixDepth),
+   capacity_(0), hugePages_(false)
 {
-   pixels_ = new unsigned char[xSize * ySize * pixDepth];
-   assert(pixels_);
-   std::memset(pixels_, 0, xSize * ySize * pixDepth);
+   Reserve(static_cast<std::size_t>(xSize) * ySize * pixDepth);
 }
 
 ImgBuffer::ImgBuffer() :
    pixels_(0),
    width_(0),
    height_(0),
-   pixDepth_(0)
+   pixDepth_(0),
+   capacity_(0),
+   hugePages_(false)
 {
 }
 
-ImgBuffer::ImgBuffer(const ImgBuffer& right)                
+ImgBuffer::ImgBuffer(const ImgBuffer& right) :
+   pixels_(0),
+   width_(0),
+   height_(0),
+   pixDepth_(0),
+   capacity_(0),
+   hugePages_(right.hugePages_)
 {
-   pixels_ = 0;
    *this = right;
 }
 
 ImgBuffer::~ImgBuffer()
 {
-   delete[] pixels_;
+   FreePixels(pixels_);
+}
+
+// Make sure the storage holds at least the given number of bytes. Existing
+// pixel values are not preserved when the storage grows.
+void ImgBuffer::Reserve(std::size_t bytes)
+{
+   if (pixels_ && bytes <= capacity_)
+      return;
+
+   FreePixels(pixels_);
+   pixels_ = 0;
+   capacity_ = 0;
+   pixels_ = AllocatePixels(bytes, hugePages_);
+   capacity_ = bytes;
 }
 
 const unsigned char* ImgBuffer::GetPixels() const
@@ -103,12 +179,7 @@ bool ImgBuffer::Compatible(const ImgBuffer& img) const
 void ImgBuffer::Resize(unsigned xSize, unsigned ySize, unsigned pixDepth)
 {
    // re-allocate internal buffer if it is not big enough
-   if (width_ * height_ * pixDepth_ < xSize * ySize * pixDepth)
-   {
-      delete[] pixels_;
-      pixels_ = new unsigned char [xSize * ySize * pixDepth];
-      assert(pixels_);
-   }
+   Reserve(static_cast<std::size_t>(xSize) * ySize * pixDepth);
 
    width_ = xSize;
    height_ = ySize;
@@ -117,17 +188,7 @@ void ImgBuffer::Resize(unsigned xSize, unsigned ySize, unsigned pixDepth)
 
 void ImgBuffer::Resize(unsigned xSize, unsigned ySize)
 {
-   // re-allocate internal buffer if it is not big enough
-   if (width_ * height_ < xSize * ySize)
-   {
-      delete[] pixels_;
-      pixels_ = new unsigned char[xSize * ySize * pixDepth_];
-   }
-
-   width_ = xSize;
-   height_ = ySize;
-
-   std::memset(pixels_, 0, width_ * height_ * pixDepth_);
+   Resize(xSize, ySize, pixDepth_);
 }
 
 void ImgBuffer::Copy(const ImgBuffer& right)
@@ -143,14 +204,8 @@ ImgBuffer& ImgBuffer::operator=(const ImgBuffer& img)
    if(this == &img)
       return *this;
 
-   if (pixels_)
-      delete[] pixels_;
-
-   width_ = img.Width();
-   height_ = img.Height();
-   pixDepth_ = img.Depth();
-   pixels_ = new unsigned char[width_ * height_ * pixDepth_];
-
+   // Reuses the existing storage if it is large enough
+   Resize(img.Width(), img.Height(), img.Depth());
    Copy(img);
 
    return *this;
@@ -21,6 +21,7 @@
 
 #pragma once
 
+#include <cstddef>
 #include <string>
 
 #include "ImageMetadata.h"
@@ -31,6 +32,11 @@
 // ~~~~~~~~~~~~~~~~~~
 // Variable pixel depth image buffer
 //
+// Pixel storage is aligned to PixelAlignment bytes, and is kept when the
+// buffer is resized to a smaller size, so that changing the ROI or binning
+// back and forth does not reallocate. Pixel values are undefined after
+// construction or Resize(); call ResetPixels() to clear them.
+//
 
 class ImgBuffer
 {
@@ -40,6 +46,8 @@ public:
    ImgBuffer();
    ~ImgBuffer();
 
+   static const std::size_t PixelAlignment = 64;
+
    unsigned int Width() const {return width_;}
    unsigned int Height() const {return height_;}
    unsigned int Depth() const {return pixDepth_;}
@@ -53,6 +61,12 @@ public:
    void Resize(unsigned xSize, unsigned ySize);
    bool Compatible(const ImgBuffer& img) const;
 
+   // Size in bytes of the allocated pixel storage
+   std::size_t Capacity() const {return capacity_;}
+   // Request transparent huge pages for subsequent large allocations (Linux
+   // only; ignored elsewhere). Can reduce TLB misses for very large frames.
+   void SetHugePagesEnabled(bool enable) {hugePages_ = enable;}
+
    void SetName(const char* name) {name_ = name;}
    const std::string& GetName() {return name_;}
    void SetMetadata(const Metadata& md);
@@ -62,10 +76,16 @@ public:
    ImgBuffer& operator=(const ImgBuffer& rhs);
 
 private:
+   void Reserve(std::size_t bytes);
+
    unsigned char* pixels_;
    unsigned int width_;
    unsigned int height_;
    unsigned int pixDepth_;
    std::string name_;
    Metadata metadata_;
+   // New members go at the end: the Core reads this object (through the
+   // inline accessors above) when an adapter calls InsertImage().
+   std::size_t capacity_;
+   bool hugePages_;
 };
@@ -28,7 +28,7 @@
 // Header version
 // If any of the class definitions changes, the interface version
 // must be incremented
-#define DEVICE_INTERFACE_VERSION 71
+#define DEVICE_INTERFACE_VERSION 74
 ///////////////////////////////////////////////////////////////////////////////
 
 // N.B.
@@ -558,6 +558,29 @@ namespace MM {
       virtual int AddToExposureSequence(double exposureTime_ms) = 0;
       // Signal that we are done sending sequence values so that the adapter can send the whole sequence to the device
       virtual int SendExposureSequence() const = 0;
+
+      /**
+       * \brief Return true if properties can be changed during sequence
+       * acquisition without restarting it.
+       *
+       * If true, the Core sets live property changes as soon as they are
+       * requested, while the camera is capturing, from the application
+       * thread that requested them; the camera applies them from its next
+       * frame on. Otherwise the Core queues the changes and sets them after
+       * the camera has inserted a frame, from a thread of the Core. They are
+       * never set from the thread inserting the images, which may still be
+       * inside InsertImage() at that time. Changes still queued when the
+       * acquisition is stopped are set by the thread stopping it.
+       *
+       * In every case the property is set with the module lock of the
+       * camera's device adapter held, as for other calls from the Core. For
+       * changes queued between frames the Core only tries the lock; if the
+       * adapter is busy, the changes wait for the next frame. The camera's
+       * own acquisition thread does not take this lock, so the adapter must
+       * synchronize its property handlers with that thread itself, and that
+       * thread may hold the adapter's own lock across InsertImage().
+       */
+      virtual bool SupportsLivePropertyChanges() = 0;
    };
 
    /**
@@ -1306,9 +1329,27 @@ namespace MM {
       /// \deprecated Use the other forms instead.
       virtual int InsertImage(const Device* caller, const unsigned char* buf, unsigned width, unsigned height, unsigned byteDepth, const char* serializedMetadata, const bool doProcess = true) = 0;
       virtual void ClearImageBuffer(const Device* caller) = 0;
+      /**
+       * \brief Prepare the image buffer for images of the given format.
+       *
+       * The caller's bit depth (GetBitDepth()) decides whether the images
+       * can be stored bit-packed.
+       */
+      virtual bool InitializeImageBuffer(const Device* caller, unsigned channels, unsigned slices, unsigned int w, unsigned int h, unsigned int pixDepth) = 0;
+      /// \deprecated Use the form taking the caller instead.
       virtual bool InitializeImageBuffer(unsigned channels, unsigned slices, unsigned int w, unsigned int h, unsigned int pixDepth) = 0;
       /// \deprecated Use the other forms instead.
       virtual int InsertMultiChannel(const Device* caller, const unsigned char* buf, unsigned numChannels, unsigned width, unsigned height, unsigned byteDepth, Metadata* md = 0) = 0;
+      /**
+       * \brief Return true while the image buffer is filling up.
+       *
+       * Backpressure starts when the buffer is filled to its high watermark
+       * and ends when consumers have drained it to its low watermark. While
+       * it lasts, the Core may drop or delay inserted images according to
+       * its backpressure policy; cameras may instead reduce their frame rate
+       * to avoid an overflow.
+       */
+      virtual bool IsImageBufferBackpressured(const Device* caller) = 0;
 
       // Formerly intended for use by autofocus
       MM_DEPRECATED(virtual const char* GetImage()) = 0;
@@ -0,0 +1,66 @@
+#include <catch2/catch_all.hpp>
+
+#include "ImgBuffer.h"
+
+#include <cstdint>
+
+TEST_CASE("ImgBuffer pixels are aligned", "[ImgBuffer]")
+{
+   ImgBuffer img(17, 3, 2);
+   CHECK(reinterpret_cast<std::uintptr_t>(img.GetPixels()) %
+         ImgBuffer::PixelAlignment == 0);
+   CHECK(img.Capacity() >= 17 * 3 * 2);
+   CHECK(img.Capacity() % ImgBuffer::PixelAlignment == 0);
+}
+
+TEST_CASE("ImgBuffer keeps storage when shrinking", "[ImgBuffer]")
+{
+   ImgBuffer img(512, 512, 2);
+   const unsigned char* pixels = img.GetPixels();
+   const std::size_t capacity = img.Capacity();
+
+   img.Resize(128, 128);
+   CHECK(img.GetPixels() == pixels);
+   CHECK(img.Capacity() == capacity);
+   CHECK(img.Width() == 128);
+
+   img.Resize(512, 256, 4);
+   CHECK(img.GetPixels() == pixels);
+   CHECK(img.Depth() == 4);
+
+   img.Resize(1024, 1024, 4);
+   CHECK(img.Capacity() >= 1024 * 1024 * 4);
+   CHECK(reinterpret_cast<std::uintptr_t>(img.GetPixels()) %
+         ImgBuffer::PixelAlignment == 0);
+}
+
+TEST_CASE("ImgBuffer copy", "[ImgBuffer]")
+{
+   ImgBuffer src(4, 2, 1);
+   src.ResetPixels();
+   src.GetPixelsRW()[5] = 42;
+
+   ImgBuffer copy(src);
+   CHECK(copy.Width() == 4);
+   CHECK(copy.Height() == 2);
+   CHECK(copy.GetPixels()[5] == 42);
+   CHECK(copy.GetPixels() != src.GetPixels());
+
+   ImgBuffer assigned(100, 100, 1);
+   const unsigned char* pixels = assigned.GetPixels();
+   assigned = src;
+   CHECK(assigned.GetPixels() == pixels);
+   CHECK(assigned.GetPixels()[5] == 42);
+   CHECK(assigned.Width() == 4);
+}
+
+TEST_CASE("ImgBuffer empty", "[ImgBuffer]")
+{
+   ImgBuffer img;
+   CHECK(img.GetPixels() == nullptr);
+   CHECK(img.Capacity() == 0);
+   img.ResetPixels();
+
+   ImgBuffer copy(img);
+   CHECK(copy.Width() == 0);
+}
@@ -92,6 +92,48 @@ AC_DEFUN([MM_LIB_WITH_PKG_CONFIG], [
 ])
 
 
+# MM_CXXLIB_WITH_PKG_CONFIG(var-prefix, name, pkg-config-name,
+# [pkg-config-flags-hook], [path-prefix], [libs], [header], [link-test-prog],
+# [action-if-found], [action-if-not-found])
+#
+# Like MM_LIB_WITH_PKG_CONFIG, for C++ libraries; compiler flags go in
+# $1_CXXFLAGS. Use AC_LANG_PROGRAM to construct the link-test-prog argument.
+AC_DEFUN([MM_CXXLIB_WITH_PKG_CONFIG], [
+   AC_LANG_ASSERT([C++])
+   mm_cxxlib_with_pkg_config_have_$1=
+   MM_LIB_CHECK_ARG_VARS_CXX([$1], [$2],
+   [
+      mm_cxxlib_with_pkg_config_have_$1=yes
+   ],
+   [
+      mm_cxxlib_with_pkg_config_skip_pkg_config=no
+      m4_ifval([$5], [test -n "$5" && mm_cxxlib_with_pkg_config_skip_pkg_config=yes])
+      AS_IF([test "x$mm_cxxlib_with_pkg_config_skip_pkg_config" = xno],
+      [
+         MM_LIB_SET_FLAGS_PKGCONFIG([$1], [$3], [$4],
+         [
+            $1_CXXFLAGS="$$1_CFLAGS"
+            $1_CFLAGS=
+            MM_CXXLIB_IFELSE([$1], [$2], [with flags from pkg-config],
+                             [$7], [$8],
+                             [mm_cxxlib_with_pkg_config_have_$1=yes],
+                             [MM_LIB_CLEAR_FLAGS([$1])])
+         ])
+      ])
+      AS_IF([test "x$mm_cxxlib_with_pkg_config_have_$1" != xyes],
+      [
+         _MM_LIB_SIMPLE_CXX_DO_TEST([$1], [$2], [$5], [with hard-coded flags],
+                                    [$6], [$7], [$8],
+                                    [mm_cxxlib_with_pkg_config_have_$1=yes],
+                                    [mm_cxxlib_with_pkg_config_have_$1=no
+                                     MM_LIB_CLEAR_FLAGS([$1])])
+      ])
+   ])
+   AS_IF([test "x$mm_cxxlib_with_pkg_config_have_$1" = xyes],
+         [$9], m4_argn([10], $@))
+])
+
+
 # _MM_LIB_SIMPLE_DO_TEST(var-prefix, name, [path-prefix], [message-suffix],
 # [libs], [header], [function], [action-if], [action-else])
 AC_DEFUN([_MM_LIB_SIMPLE_DO_TEST], [
@@ -78,18 +78,24 @@ AC_DEFUN([MM_LIB_MSGPACK], [
 ])
 
 
-# Check for OpenCV video capture
+# Check for OpenCV 3.x or 4.x video capture (C++ API)
 #
 # MM_LIB_OPENCV([OpenCV prefix], [action-if-found], [action-if-not-found])
 #
-# Defines precious variables OPENCV_CPPFLAGS, OPENCV_CFLAGS, OPENCV_LDFLAGS,
-# OPENCV_LIBS.
+# Defines precious variables OPENCV_CPPFLAGS, OPENCV_CXXFLAGS, OPENCV_LDFLAGS,
+# OPENCV_LIBS. OpenCV 3.x has no opencv4 pkg-config metadata, and is found
+# with the hard-coded flags.
 #
 AC_DEFUN([MM_LIB_OPENCV], [
-   MM_LIB_WITH_PKG_CONFIG([OPENCV], [OpenCV], [opencv], [],
-      [$1], [-lopencv_highgui -lopencv_imgproc -lopencv_core],
-      [opencv/highgui.h], [cvGetCaptureProperty],
+   AC_LANG_PUSH([C++])
+   MM_CXXLIB_WITH_PKG_CONFIG([OPENCV], [OpenCV], [opencv4], [],
+      [$1], [-lopencv_videoio -lopencv_imgcodecs -lopencv_imgproc -lopencv_core],
+      [opencv2/videoio.hpp],
+      [AC_LANG_PROGRAM([[#include <opencv2/videoio.hpp>]],
+                       [[cv::VideoCapture capture;
+                         capture.get(cv::CAP_PROP_FPS);]])],
       [$2], [$3])
+   AC_LANG_POP([C++])
 ])
 
 